@@ -0,0 +1,422 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include "stack.h"
+#include "rpn.h"
+#include "program.h"
+#include "pool.h"
+#include "grid.h"
+#include "analysis.h"
+
+/*
+ * Roots and extrema are bracketed on coarse grid evaluated at once by the grid module - the root
+ * lays between neighbouring samples of opposite signs (or exactly in sample with zero value), the
+ * minimum around sample smaller than both its neighbours, and the maximum the same way.
+ * The brackets are independent, so they are distributed to thread pool by groups of
+ * ANL_BRACKETS_PER_TASK and refined by Brent's methods: root by combination of bisection,
+ * secant and inverse quadratic interpolation, extremum by combination of golden section search
+ * and parabolic interpolation. Neither of them needs derivative, and both converge superlinearly
+ * for smooth functions, while they never do worse than bisection or golden section.
+ *
+ * Sign change does not always mean root - the function may jump over zero (pole, step); such
+ * brackets converge to the discontinuity, where the value does not get much smaller than at the
+ * bracket ends, so they are left out. Similarly, sample next to pole looks like extremum, but the
+ * refined value runs away far beyond its neighbours.
+ */
+
+#define ANL_GOLDEN 0.3819660112501051   /* golden section ratio of Brent's minimization */
+
+/* bracket of one root or extremum */
+typedef struct
+{
+    int kind;                           /* enum anl_kind */
+    double a, fa;                       /* the left end */
+    double b, fb;                       /* the right end */
+    double m, fm;                       /* sample in between (extremum only) */
+} anl_bracket;
+
+/* shared state of refinement */
+typedef struct
+{
+    rpn_program* prog;
+    anl_bracket* brackets;
+    anl_point* points;                  /* result of every bracket, iterations are -1 if it was left out */
+    int count;
+    double scale;                       /* magnitude of interval ends, absolute tolerances are relative to it */
+    volatile long evaluations;
+} anl_refinement;
+
+/**
+ * Finds root in bracket [a, b] with values of opposite signs by Brent's method
+ * Returns number of iterations, or -1 if there is discontinuity instead of root
+ */
+static int anl_root(anl_refinement* ref, const anl_bracket* br, anl_point* point, long* evaluations)
+{
+    double a, b, c, d, e, fa, fb, fc, tol, m, p, q, r, s;
+    int i;
+
+    a = br->a;
+    b = br->b;
+    fa = br->fa;
+    fb = br->fb;
+    c = b;
+    fc = fb;
+    d = e = b - a;
+
+    for (i = 0; i < ANL_MAX_ITERATIONS; i++)
+    {
+        /* b is the best estimate, c the opposite end of bracket, a the previous estimate */
+        if ((fb > 0 && fc > 0) || (fb < 0 && fc < 0))
+        {
+            c = a;
+            fc = fa;
+            d = e = b - a;
+        }
+        if (fabs(fc) < fabs(fb))
+        {
+            a = b;
+            b = c;
+            c = a;
+            fa = fb;
+            fb = fc;
+            fc = fa;
+        }
+
+        tol = 2 * DBL_EPSILON * fabs(b) + ANL_ROOT_TOLERANCE * ref->scale;
+        m = (c - b) / 2;
+        if (fabs(m) <= tol || fb == 0)
+            break;
+
+        if (fabs(e) >= tol && fabs(fa) > fabs(fb))
+        {
+            /* secant, or inverse quadratic interpolation if there are three distinct points */
+            s = fb / fa;
+            if (a == c)
+            {
+                p = 2 * m * s;
+                q = 1 - s;
+            }
+            else
+            {
+                q = fa / fc;
+                r = fb / fc;
+                p = s * (2 * m * q * (q - r) - (b - a) * (r - 1));
+                q = (q - 1) * (r - 1) * (s - 1);
+            }
+            if (p > 0)
+                q = -q;
+            p = fabs(p);
+
+            /* the interpolation is accepted, if it falls into bracket and converges fast enough */
+            if (2 * p < 3 * m * q - fabs(tol * q) && 2 * p < fabs(e * q))
+            {
+                e = d;
+                d = p / q;
+            }
+            else
+                d = e = m;
+        }
+        else
+            d = e = m;
+
+        a = b;
+        fa = fb;
+        b += (fabs(d) > tol) ? d : ((m > 0) ? tol : -tol);
+        fb = prog_evaluate(ref->prog, b);
+        (*evaluations)++;
+    }
+
+    point->kind = ANL_ROOT;
+    point->x = b;
+    point->value = fb;
+
+    /* discontinuity - the value did not get much smaller than at the bracket ends */
+    if (!(fabs(fb) <= ANL_DISCONTINUITY_RATIO * ((fabs(br->fa) > fabs(br->fb)) ? fabs(br->fa) : fabs(br->fb))))
+        return -1;
+
+    return i;
+}
+
+/**
+ * Finds extremum in bracket [a, b] around sample m by Brent's method; "sign" is 1 for minimum and
+ * -1 for maximum
+ * Returns number of iterations, or -1 if there is pole instead of extremum
+ */
+static int anl_extremum(anl_refinement* ref, const anl_bracket* br, double sign, anl_point* point, long* evaluations)
+{
+    double a, b, d, e, p, q, r, u, v, w, x, fu, fv, fw, fx, xm, tol, tol2;
+    int i;
+
+    a = br->a;
+    b = br->b;
+    x = w = v = br->m;
+    fx = fw = fv = sign * br->fm;
+    d = e = 0;
+
+    for (i = 0; i < ANL_MAX_ITERATIONS; i++)
+    {
+        xm = (a + b) / 2;
+        tol = ANL_EXTREMUM_TOLERANCE * (fabs(x) + ref->scale);
+        tol2 = 2 * tol;
+        if (fabs(x - xm) <= tol2 - (b - a) / 2)
+            break;
+
+        if (fabs(e) > tol)
+        {
+            /* parabola through x, w and v */
+            r = (x - w) * (fx - fv);
+            q = (x - v) * (fx - fw);
+            p = (x - v) * q - (x - w) * r;
+            q = 2 * (q - r);
+            if (q > 0)
+                p = -p;
+            q = fabs(q);
+            r = e;
+            e = d;
+
+            /* it is accepted, if its minimum falls into bracket and the step is getting smaller */
+            if (fabs(p) >= fabs(q * r / 2) || p <= q * (a - x) || p >= q * (b - x))
+            {
+                e = (x >= xm) ? a - x : b - x;
+                d = ANL_GOLDEN * e;
+            }
+            else
+            {
+                d = p / q;
+                u = x + d;
+                if (u - a < tol2 || b - u < tol2)
+                    d = (xm > x) ? tol : -tol;
+            }
+        }
+        else
+        {
+            e = (x >= xm) ? a - x : b - x;
+            d = ANL_GOLDEN * e;
+        }
+
+        u = (fabs(d) >= tol) ? x + d : x + ((d > 0) ? tol : -tol);
+        fu = sign * prog_evaluate(ref->prog, u);
+        (*evaluations)++;
+
+        /* narrow bracket around the best point so far (undefined value is never better) */
+        if (fu <= fx)
+        {
+            if (u >= x)
+                a = x;
+            else
+                b = x;
+            v = w;
+            fv = fw;
+            w = x;
+            fw = fx;
+            x = u;
+            fx = fu;
+        }
+        else
+        {
+            if (u < x)
+                a = u;
+            else
+                b = u;
+            if (fu <= fw || w == x)
+            {
+                v = w;
+                fv = fw;
+                w = u;
+                fw = fu;
+            }
+            else if (fu <= fv || v == x || v == w)
+            {
+                v = u;
+                fv = fu;
+            }
+        }
+    }
+
+    point->kind = (sign > 0) ? ANL_MINIMUM : ANL_MAXIMUM;
+    point->x = x;
+    point->value = sign * fx;
+
+    /* smooth extremum is not farther from the middle sample than the bracket ends are (it's at most
+     * half of it for parabola), pole is */
+    if (!(fabs(sign * fx - br->fm) <= fabs(br->fa - br->fm) + fabs(br->fb - br->fm)))
+        return -1;
+
+    return i;
+}
+
+/**
+ * Refines one group of brackets (task routine)
+ */
+static void anl_refine_task(void* arg, int index)
+{
+    anl_refinement* ref = (anl_refinement*)arg;
+    anl_bracket* br;
+    anl_point* point;
+    long evaluations;
+    int i, last;
+
+    evaluations = 0;
+    last = (index + 1) * ANL_BRACKETS_PER_TASK;
+    if (last > ref->count)
+        last = ref->count;
+
+    for (i = index * ANL_BRACKETS_PER_TASK; i < last; i++)
+    {
+        br = &ref->brackets[i];
+        point = &ref->points[i];
+
+        if (br->kind == ANL_ROOT && br->fa == 0)
+        {
+            /* exact root in coarse sample */
+            point->kind = ANL_ROOT;
+            point->x = br->a;
+            point->value = 0;
+            point->iterations = 0;
+        }
+        else if (br->kind == ANL_ROOT)
+            point->iterations = anl_root(ref, br, point, &evaluations);
+        else
+            point->iterations = anl_extremum(ref, br, (br->kind == ANL_MINIMUM) ? 1.0 : -1.0, point, &evaluations);
+    }
+
+    pool_atomic_add(&ref->evaluations, evaluations);
+}
+
+/**
+ * Compares points by position (qsort routine)
+ */
+static int anl_compare_points(const void* a, const void* b)
+{
+    const anl_point* pa = (const anl_point*)a;
+    const anl_point* pb = (const anl_point*)b;
+
+    if (pa->x != pb->x)
+        return (pa->x < pb->x) ? -1 : 1;
+    return pa->kind - pb->kind;
+}
+
+/**
+ * Finds all roots and local extrema of program of one variable on interval [from, to]; they are
+ * bracketed on coarse grid of "intervals" intervals (0 = ANL_DEFAULT_INTERVALS) and the brackets
+ * are refined in parallel using supplied thread pool (may be NULL); found points sorted by position
+ * are stored to "result", which has to be released by anl_release
+ * - roots, which are not crossings (touching zero), are found only as extrema, unless they lay
+ *   exactly in coarse sample; two roots or extrema closer than coarse interval may be missed
+ * Returns 0 on success, 1 if the program has more variables, the interval is empty or there's not
+ * enough memory
+ */
+int anl_find(rpn_program* prog, double from, double to, int intervals, thread_pool* pool, anl_result* result)
+{
+    anl_refinement ref;
+    anl_bracket* br;
+    grid_spec grid;
+    double *values, *positions;
+    int i, count;
+
+    result->points = NULL;
+    result->count = 0;
+    result->evaluations = 0;
+
+    if (intervals <= 0)
+        intervals = ANL_DEFAULT_INTERVALS;
+    if (prog->variable_count > 1 || !(from < to))
+        return 1;
+
+    values = (double*)malloc(sizeof(double) * (intervals + 1));
+    positions = (double*)malloc(sizeof(double) * (intervals + 1));
+    ref.brackets = (anl_bracket*)malloc(sizeof(anl_bracket) * 2 * (intervals + 1));
+    ref.points = (anl_point*)malloc(sizeof(anl_point) * 2 * (intervals + 1));
+
+    grid.dimensions = 1;
+    grid.axes[0].min = from;
+    grid.axes[0].max = to;
+    grid.axes[0].count = intervals + 1;
+
+    if (values == NULL || positions == NULL || ref.brackets == NULL || ref.points == NULL
+        || grid_evaluate(prog, &grid, values, pool) != 0)
+    {
+        free(values);
+        free(positions);
+        free(ref.brackets);
+        free(ref.points);
+        return 1;
+    }
+
+    /* the same positions as of grid samples */
+    for (i = 0; i <= intervals; i++)
+        positions[i] = from + (to - from) * i / intervals;
+
+    count = 0;
+    for (i = 0; i <= intervals; i++)
+    {
+        if (values[i] == 0)
+        {
+            br = &ref.brackets[count++];
+            br->kind = ANL_ROOT;
+            br->a = br->b = positions[i];
+            br->fa = br->fb = 0;
+        }
+        else if (i < intervals && ((values[i] > 0 && values[i + 1] < 0) || (values[i] < 0 && values[i + 1] > 0)))
+        {
+            br = &ref.brackets[count++];
+            br->kind = ANL_ROOT;
+            br->a = positions[i];
+            br->fa = values[i];
+            br->b = positions[i + 1];
+            br->fb = values[i + 1];
+        }
+
+        /* extremum needs finite neighbours, flat one is bracketed at its left end */
+        if (i == 0 || i == intervals || values[i] - values[i] != 0
+            || values[i - 1] - values[i - 1] != 0 || values[i + 1] - values[i + 1] != 0)
+            continue;
+        if ((values[i] < values[i - 1] && values[i] <= values[i + 1]) || (values[i] > values[i - 1] && values[i] >= values[i + 1]))
+        {
+            br = &ref.brackets[count++];
+            br->kind = (values[i] < values[i - 1]) ? ANL_MINIMUM : ANL_MAXIMUM;
+            br->a = positions[i - 1];
+            br->fa = values[i - 1];
+            br->m = positions[i];
+            br->fm = values[i];
+            br->b = positions[i + 1];
+            br->fb = values[i + 1];
+        }
+    }
+
+    ref.prog = prog;
+    ref.count = count;
+    ref.scale = (fabs(from) > fabs(to)) ? fabs(from) : fabs(to);
+    ref.evaluations = intervals + 1;
+    pool_run(pool, anl_refine_task, &ref, (count + ANL_BRACKETS_PER_TASK - 1) / ANL_BRACKETS_PER_TASK);
+
+    /* discontinuities are left out */
+    result->count = 0;
+    for (i = 0; i < count; i++)
+    {
+        if (ref.points[i].iterations >= 0)
+            ref.points[result->count++] = ref.points[i];
+    }
+    qsort(ref.points, result->count, sizeof(anl_point), anl_compare_points);
+
+    result->points = ref.points;
+    result->evaluations = ref.evaluations;
+
+    free(values);
+    free(positions);
+    free(ref.brackets);
+
+    return 0;
+}
+
+/**
+ * Releases points found by anl_find
+ */
+void anl_release(anl_result* result)
+{
+    free(result->points);
+    result->points = NULL;
+    result->count = 0;
+}
@@ -0,0 +1,39 @@
+#ifndef MATHPARSER_ANALYSIS_H
+#define MATHPARSER_ANALYSIS_H
+
+#define ANL_DEFAULT_INTERVALS 4096      /* implicit number of coarse grid intervals brackets are searched on */
+#define ANL_BRACKETS_PER_TASK 16        /* number of brackets refined by one task */
+#define ANL_MAX_ITERATIONS 100          /* maximum number of refinement iterations of one bracket */
+#define ANL_ROOT_TOLERANCE 1e-15        /* precision of root position relative to magnitude of interval ends */
+#define ANL_EXTREMUM_TOLERANCE 1.5e-8   /* the same for extremum position (square root of machine epsilon) */
+#define ANL_DISCONTINUITY_RATIO 1e-6    /* refined root value greater than this part of bracket end values means jump over zero */
+
+/* kind of found point */
+enum anl_kind
+{
+    ANL_ROOT = 0,                       /* function crosses zero */
+    ANL_MINIMUM,                        /* local minimum */
+    ANL_MAXIMUM                         /* local maximum */
+};
+
+/* found point of function */
+typedef struct
+{
+    int kind;                           /* enum anl_kind */
+    double x;                           /* position */
+    double value;                       /* function value there */
+    int iterations;                     /* number of refinement iterations */
+} anl_point;
+
+/* result of analysis - found points sorted by position */
+typedef struct
+{
+    anl_point* points;
+    int count;
+    long evaluations;                   /* number of function evaluations (coarse grid and refinement) */
+} anl_result;
+
+int anl_find(rpn_program* prog, double from, double to, int intervals, thread_pool* pool, anl_result* result);
+void anl_release(anl_result* result);
+
+#endif
@@ -0,0 +1,424 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "stack.h"
+#include "rpn.h"
+#include "main.h"
+#include "shunting_yard.h"
+#include "program.h"
+#include "pool.h"
+#include "cache.h"
+#include "bulk.h"
+
+/*
+ * Every input line produces exactly one output line, so the output is line-aligned with
+ * the input. Errors are reported as "error <syntax_error_code> <offset within line>",
+ * where offset is -1 if the parser did not supply error position.
+ */
+
+/* growable output buffer of one line range */
+typedef struct
+{
+    char* data;
+    int length;
+    int capacity;
+    int failed;                         /* the buffer could not grow, some output is missing */
+} bulk_buffer;
+
+/* shared state of one bulk run */
+typedef struct
+{
+    char* data;                         /* mapped file contents */
+    long size;                          /* size of mapped file */
+    int chunk_count;                    /* number of line ranges */
+    enum bulk_mode mode;                /* what to emit */
+    double variable_value;              /* variable value for evaluation mode */
+    expr_cache* cache;                  /* compiled program cache shared by all threads */
+    thread_pool* pool;                  /* pool processing line ranges, reduces sums of single range too */
+    bulk_buffer* outputs;               /* output buffer for every line range */
+    int* line_counts;                   /* processed line count for every line range */
+    int* error_counts;                  /* erroneous line count for every line range */
+} bulk_context;
+
+/**
+ * Appends string to output buffer, grows the buffer if needed; if it can not grow, the buffer is
+ * marked as failed and nothing more is appended
+ */
+static void bulk_append(bulk_buffer* buf, const char* str)
+{
+    int len = (int)strlen(str);
+    char* tmp;
+
+    if (buf->failed)
+        return;
+
+    if (buf->length + len + 1 > buf->capacity)
+    {
+        tmp = (char*)realloc(buf->data, buf->capacity * 2 + len + 1);
+        if (tmp == NULL)
+        {
+            buf->failed = 1;
+            return;
+        }
+        buf->data = tmp;
+        buf->capacity = buf->capacity * 2 + len + 1;
+    }
+
+    memcpy(buf->data + buf->length, str, len + 1);
+    buf->length += len;
+}
+
+/**
+ * Appends textual representation of compiled program (in RPN notation) to output buffer
+ */
+static void bulk_append_program(bulk_buffer* buf, rpn_program* prog)
+{
+    char tmp[64];
+    prog_instruction* ins;
+    const char* name;
+    unsigned int i;
+
+    for (i = 0; i < prog->header->instruction_count; i++)
+    {
+        ins = &prog->code[i];
+
+        /* jumps are not part of RPN notation, the conditional is written as its SELECT ("if") only;
+         * the first instruction is never a jump */
+        if (ins->opcode == PROG_OP_IF || ins->opcode == PROG_OP_ELSE)
+            continue;
+
+        if (i > 0)
+            bulk_append(buf, " ");
+
+        switch (ins->opcode)
+        {
+            case PROG_OP_CONST:
+                sprintf(tmp, BULK_OUTPUT_FORMATTER, prog->constants[ins->arg]);
+                bulk_append(buf, tmp);
+                break;
+            case PROG_OP_VARIABLE:
+                bulk_append(buf, "x");
+                break;
+            case PROG_OP_FUNCTION:
+                name = sy_get_function_name(ins->arg);
+                bulk_append(buf, (name != NULL) ? name : "?");
+                break;
+            case PROG_OP_SELECT:
+                bulk_append(buf, sy_get_function_name(FUNC_IF));
+                break;
+            case PROG_OP_INDEX:
+                sprintf(tmp, "k%u", (unsigned int)ins->arg);
+                bulk_append(buf, tmp);
+                break;
+            case PROG_OP_LOOP:
+                bulk_append(buf, "loop");
+                break;
+            case PROG_OP_SUM:
+                bulk_append(buf, sy_get_function_name(FUNC_SUM));
+                break;
+            case PROG_OP_PRODUCT:
+                bulk_append(buf, sy_get_function_name(FUNC_PROD));
+                break;
+            default:
+                bulk_append(buf, sy_get_operator_name(prog_opcode_operator(ins->opcode)));
+                break;
+        }
+    }
+}
+
+/**
+ * Aligns byte position in mapped file to the beginning of the line, which starts
+ * at or after this position
+ */
+static long bulk_align_to_line(bulk_context* ctx, long pos)
+{
+    char* found;
+
+    if (pos <= 0)
+        return 0;
+    if (pos >= ctx->size)
+        return ctx->size;
+
+    found = (char*)memchr(ctx->data + pos - 1, '\n', ctx->size - pos + 1);
+    if (found == NULL)
+        return ctx->size;
+
+    return (long)(found - ctx->data) + 1;
+}
+
+/**
+ * Processes one line range - parses every line directly from the mapping, and stores
+ * the results to output buffer of this range
+ */
+static void bulk_process_range(void* arg, int index)
+{
+    bulk_context* ctx = (bulk_context*)arg;
+    bulk_buffer* buf = &ctx->outputs[index];
+    long begin, end;
+    char *line, *line_end, *error_ptr;
+    char tmp[64];
+    int length, error;
+    cache_entry* entry;
+
+    /* both boundaries are computed the same way by neighbouring ranges, so every line is processed exactly once */
+    begin = bulk_align_to_line(ctx, (long)((double)ctx->size * index / ctx->chunk_count));
+    end = bulk_align_to_line(ctx, (long)((double)ctx->size * (index + 1) / ctx->chunk_count));
+
+    buf->capacity = (int)(end - begin) + 64;
+    buf->length = 0;
+    buf->failed = 0;
+    buf->data = (char*)malloc(buf->capacity);
+    if (buf->data == NULL)
+    {
+        buf->capacity = 0;
+        buf->failed = 1;
+        return;
+    }
+    buf->data[0] = '\0';
+
+    line = ctx->data + begin;
+    while (line < ctx->data + end && !buf->failed)
+    {
+        line_end = (char*)memchr(line, '\n', (ctx->data + end) - line);
+        if (line_end == NULL)
+            line_end = ctx->data + end;
+
+        /* tolerate CRLF line endings */
+        length = (int)(line_end - line);
+        if (length > 0 && line[length - 1] == '\r')
+            length--;
+
+        /* formulas often repeat, so the compiled programs are shared through cache */
+        entry = cache_get(ctx->cache, line, length, &error, &error_ptr);
+        if (entry == NULL)
+        {
+            sprintf(tmp, "error %i %i", error, (error_ptr != NULL) ? (int)(error_ptr - line) : -1);
+            bulk_append(buf, tmp);
+            ctx->error_counts[index]++;
+        }
+        else if (ctx->mode == BULK_MODE_EVALUATE)
+        {
+            /* sums and products are reduced in parallel, unless the pool is busy with more line ranges */
+            sprintf(tmp, BULK_OUTPUT_FORMATTER, prog_evaluate_parallel(entry->program, &ctx->variable_value, ctx->pool));
+            bulk_append(buf, tmp);
+        }
+        else
+        {
+            bulk_append_program(buf, entry->program);
+        }
+        bulk_append(buf, "\n");
+
+        if (entry != NULL)
+            cache_release(ctx->cache, entry);
+
+        ctx->line_counts[index]++;
+        line = line_end + 1;
+    }
+}
+
+/**
+ * Maps input file to memory; returns NULL on failure
+ * - on platforms without mmap, the file is read to allocated memory instead
+ */
+static char* bulk_map_file(char* filename, long* size)
+{
+#ifndef _WIN32
+    int fd;
+    struct stat st;
+    void* mapped;
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    *size = (long)st.st_size;
+
+    /* empty file cannot be mapped, but it's valid input with no lines */
+    if (*size == 0)
+    {
+        close(fd);
+        return (char*)malloc(1);
+    }
+
+    mapped = mmap(NULL, (size_t)*size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    return (mapped == MAP_FAILED) ? NULL : (char*)mapped;
+#else
+    FILE* f;
+    char* data;
+
+    f = fopen(filename, "rb");
+    if (f == NULL)
+        return NULL;
+
+    fseek(f, 0, SEEK_END);
+    *size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    data = (char*)malloc(*size + 1);
+    if (data != NULL && (long)fread(data, 1, *size, f) != *size)
+    {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+
+    return data;
+#endif
+}
+
+/**
+ * Releases memory obtained by bulk_map_file
+ */
+static void bulk_unmap_file(char* data, long size)
+{
+#ifndef _WIN32
+    if (size == 0)
+        free(data);
+    else
+        munmap(data, (size_t)size);
+#else
+    free(data);
+#endif
+}
+
+/**
+ * Parses every line of supplied data as standalone expression, and writes either its compiled
+ * form or its value to output, one line for every input line. Lines are split to supplied number
+ * of ranges (0 means BULK_CHUNKS_PER_THREAD per thread of pool, which may be NULL), which are
+ * processed in parallel; programs are shared through supplied cache
+ * Returns 0 on success, 1 if there's not enough memory (nothing is written then)
+ */
+int bulk_process(char* data, long size, enum bulk_mode mode, double variable_value, expr_cache* cache,
+                 thread_pool* pool, int chunk_count, FILE* output, bulk_stats* stats)
+{
+    bulk_context ctx;
+    int i, res;
+
+    stats->lines = 0;
+    stats->errors = 0;
+
+    ctx.data = data;
+    ctx.size = size;
+    ctx.mode = mode;
+    ctx.variable_value = variable_value;
+    ctx.cache = cache;
+    ctx.pool = pool;
+    ctx.chunk_count = chunk_count;
+    if (ctx.chunk_count <= 0)
+    {
+        ctx.chunk_count = pool_thread_count(pool) * BULK_CHUNKS_PER_THREAD;
+        if (ctx.chunk_count > ctx.size / BULK_MIN_CHUNK_SIZE)
+            ctx.chunk_count = (int)(ctx.size / BULK_MIN_CHUNK_SIZE);
+        if (ctx.chunk_count < 1)
+            ctx.chunk_count = 1;
+    }
+
+    ctx.outputs = (bulk_buffer*)calloc(ctx.chunk_count, sizeof(bulk_buffer));
+    ctx.line_counts = (int*)calloc(ctx.chunk_count, sizeof(int));
+    ctx.error_counts = (int*)calloc(ctx.chunk_count, sizeof(int));
+
+    res = 0;
+    if (ctx.outputs == NULL || ctx.line_counts == NULL || ctx.error_counts == NULL)
+        res = 1;
+    else
+    {
+        pool_run(pool, bulk_process_range, &ctx, ctx.chunk_count);
+
+        /* output of every line, or none at all */
+        for (i = 0; i < ctx.chunk_count; i++)
+        {
+            if (ctx.outputs[i].failed)
+                res = 1;
+        }
+
+        /* write outputs in the order of line ranges, so the output remains aligned with input */
+        for (i = 0; i < ctx.chunk_count; i++)
+        {
+            if (res == 0)
+                fwrite(ctx.outputs[i].data, 1, ctx.outputs[i].length, output);
+            free(ctx.outputs[i].data);
+
+            stats->lines += ctx.line_counts[i];
+            stats->errors += ctx.error_counts[i];
+        }
+    }
+
+    free(ctx.outputs);
+    free(ctx.line_counts);
+    free(ctx.error_counts);
+
+    return res;
+}
+
+/**
+ * Parses every line of supplied file as standalone expression, and prints either its compiled
+ * form or its value to standard output, one line for every input line. Lines are split to
+ * ranges, which are processed in parallel using specified number of threads
+ * Returns 0 on success, 1 if the file could not be processed
+ */
+int bulk_process_file(char* filename, enum bulk_mode mode, double variable_value, int threads)
+{
+    char* data;
+    long size;
+    thread_pool* pool;
+    expr_cache* cache;
+    cache_stats cstats;
+    bulk_stats stats;
+    int res;
+
+    data = bulk_map_file(filename, &size);
+    if (data == NULL)
+    {
+        printf("Unable to map input file %s\n", filename);
+        return 1;
+    }
+
+    /* canonical operand order would change emitted programs, so use it only when evaluating */
+    cache = cache_create(0, 0, (mode == BULK_MODE_EVALUATE) ? CACHE_CANONICAL_ORDER : 0);
+    if (cache == NULL)
+    {
+        printf("Unable to allocate memory for bulk processing\n");
+        bulk_unmap_file(data, size);
+        return 1;
+    }
+
+    pool = pool_create(threads);
+
+    res = bulk_process(data, size, mode, variable_value, cache, pool, 0, stdout, &stats);
+    if (res != 0)
+        fprintf(stderr, "Not enough memory for output of bulk processing, nothing was written\n");
+    else
+    {
+        cache_get_stats(cache, &cstats);
+
+        fprintf(stderr, "Processed %i lines (%i with errors) using %i threads\n", stats.lines, stats.errors,
+                pool_thread_count(pool));
+        fprintf(stderr, "Cache: %li hits, %li canonical hits, %li misses, %li evictions, %li programs cached\n",
+                cstats.hits, cstats.canonical_hits, cstats.misses, cstats.evictions, cstats.entries);
+    }
+
+    cache_destroy(cache);
+    if (pool != NULL)
+        pool_destroy(pool);
+    bulk_unmap_file(data, size);
+
+    return res;
+}
@@ -0,0 +1,29 @@
+#ifndef MATHPARSER_BULK_H
+#define MATHPARSER_BULK_H
+
+#define BULK_CHUNKS_PER_THREAD 8        /* how many line ranges to create per thread (for load balancing) */
+#define BULK_MIN_CHUNK_SIZE 4096        /* minimal size of line range in bytes */
+#define BULK_OUTPUT_FORMATTER "%.15g"   /* formatter used when printing evaluated values and constants */
+
+enum bulk_mode
+{
+    BULK_MODE_RPN,                      /* emit compiled (RPN) form of every expression */
+    BULK_MODE_EVALUATE                  /* emit value of every expression in supplied point */
+};
+
+/* summary of bulk run */
+typedef struct
+{
+    int lines;                          /* number of processed lines */
+    int errors;                         /* number of lines with errors */
+} bulk_stats;
+
+/* thread pool (pool.h) and program cache (cache.h) */
+struct _thread_pool;
+struct _expr_cache;
+
+int bulk_process(char* data, long size, enum bulk_mode mode, double variable_value, struct _expr_cache* cache,
+                 struct _thread_pool* pool, int chunk_count, FILE* output, bulk_stats* stats);
+int bulk_process_file(char* filename, enum bulk_mode mode, double variable_value, int threads);
+
+#endif
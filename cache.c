@@ -0,0 +1,722 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stack.h"
+#include "rpn.h"
+#include "main.h"
+#include "shunting_yard.h"
+#include "program.h"
+#include "pool.h"
+#include "cache.h"
+
+/*
+ * Every program is reachable by two kinds of keys:
+ *  - normalized token stream - the input with insignificant spaces removed; it's built without
+ *    parsing, so lookups using this key skip parsing and compilation completelly; lookups hash
+ *    and compare it right over the input, the key is written out only when stored
+ *  - canonical key (prefixed by '#') - built from parsed RPN form with constants printed exactly
+ *    and optionally with operands of commutative operators sorted; it is used on miss, so "2 * x",
+ *    "2.0*x" and "x*2" may share the same compiled program
+ *
+ * Lookups do not take any lock. Writers (insertion, eviction) are serialized by lock, and they never
+ * free anything while some reader is in the middle of lookup - evicted entries are moved to retired
+ * list, and freed once there's no reader in flight and nobody holds the entry.
+ *
+ * Eviction approximates LRU by CLOCK - lookups only mark the entry as referenced, and the eviction
+ * hand goes round the live entries, giving referenced ones second chance; both lookup and eviction
+ * take constant (amortized) time, and lookups do not touch any shared list.
+ *
+ * Swapping operands of + and * does not change the result in IEEE arithmetics, so programs found
+ * by canonical key evaluate to exactly the same values; operands are never reassociated.
+ */
+
+#define FNV_OFFSET_BASIS 2166136261UL   /* FNV-1a hash initial value */
+#define FNV_PRIME 16777619UL            /* FNV-1a hash multiplier */
+
+struct _cache_key_node
+{
+    unsigned long hash;                         /* hash of the key */
+    int length;                                 /* key length */
+    char* key;                                  /* key itself, stored right after the node */
+    cache_entry* entry;                         /* entry this key leads to */
+    struct _cache_key_node* volatile next;      /* next node in bucket chain */
+    struct _cache_key_node* volatile* pprev;    /* link pointing to this node in bucket chain (for writers only) */
+    struct _cache_key_node* next_of_entry;      /* next key of the same entry */
+};
+
+struct _expr_cache
+{
+    int flags;                                  /* CACHE_* flags */
+    int capacity;                               /* maximum number of entries */
+    long max_bytes;                             /* maximum accounted memory */
+
+    unsigned long bucket_mask;                  /* bucket count minus one (count is power of two) */
+    cache_key_node* volatile* buckets;          /* hash table buckets */
+
+    pool_lock* lock;                            /* serializes writers */
+    cache_entry* hand;                          /* live entries in circular list, starting where eviction hand points */
+    cache_entry* retired;                       /* evicted entries waiting to be freed */
+    long entry_count;                           /* number of live entries */
+    long bytes;                                 /* memory accounted to live entries */
+
+    volatile long readers;                      /* number of lookups in flight */
+    volatile long hits, canonical_hits, misses, evictions;
+};
+
+/* position in input, which is read as normalized token stream */
+typedef struct
+{
+    const char* input;                          /* input expression */
+    int length;                                 /* input length */
+    int position;                               /* next input character to be read */
+    int emitted;                                /* number of characters of normalized stream read so far */
+    int pending_space;                          /* spaces were skipped since the last character */
+    int held;                                   /* character to be read after inserted space, or -1 */
+    char prev;                                  /* the last character read (except inserted space) */
+} cache_cursor;
+
+/**
+ * Computes FNV-1a hash of key
+ */
+static unsigned long cache_hash(const char* key, int length)
+{
+    unsigned long hash = FNV_OFFSET_BASIS;
+    int i;
+
+    for (i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)key[i];
+        hash = (hash * FNV_PRIME) & 0xFFFFFFFFUL;
+    }
+
+    return hash;
+}
+
+/**
+ * Determines, if the character is single-character token (operator or parenthesis)
+ */
+static int cache_is_symbol(char chr)
+{
+    return (chr != '\0' && strchr("+-*/^()?:", chr) != NULL) ? 1 : 0;
+}
+
+/**
+ * Starts reading input as normalized token stream
+ */
+static void cache_cursor_init(cache_cursor* cur, const char* input, int length)
+{
+    cur->input = input;
+    cur->length = length;
+    cur->position = 0;
+    cur->emitted = 0;
+    cur->pending_space = 0;
+    cur->held = -1;
+    cur->prev = '\0';
+}
+
+/**
+ * Reads next character of normalized token stream; returns -1 at its end
+ * - space is significant only between two characters, which could otherwise merge into one
+ *   token (i.e. "1 2" or "si n"), and after exponent mark, since the number parser looks at the
+ *   character following it
+ */
+static int cache_cursor_next(cache_cursor* cur)
+{
+    char chr;
+
+    if (cur->held >= 0)
+    {
+        chr = (char)cur->held;
+        cur->held = -1;
+    }
+    else
+    {
+        do
+        {
+            if (cur->position == cur->length)
+                return -1;
+            chr = cur->input[cur->position++];
+            if (chr == ' ')
+                cur->pending_space = 1;
+        } while (chr == ' ');
+
+        if (cur->pending_space && cur->emitted > 0 && !cache_is_symbol(cur->prev)
+            && (!cache_is_symbol(chr) || cur->prev == 'e' || cur->prev == 'E'))
+        {
+            cur->pending_space = 0;
+            cur->held = (unsigned char)chr;
+            cur->emitted++;
+            return ' ';
+        }
+        cur->pending_space = 0;
+    }
+
+    cur->prev = chr;
+    cur->emitted++;
+    return (unsigned char)chr;
+}
+
+/**
+ * Computes hash and length of normalized token stream key of input, without building the key
+ */
+static unsigned long cache_input_hash(const char* input, int length, int* key_length)
+{
+    unsigned long hash = FNV_OFFSET_BASIS;
+    cache_cursor cur;
+    int chr;
+
+    cache_cursor_init(&cur, input, length);
+    while ((chr = cache_cursor_next(&cur)) >= 0)
+    {
+        hash ^= (unsigned char)chr;
+        hash = (hash * FNV_PRIME) & 0xFFFFFFFFUL;
+    }
+
+    *key_length = cur.emitted;
+    return hash;
+}
+
+/**
+ * Builds normalized token stream key of input; the key buffer has to have room for the key
+ * (its length is given by cache_input_hash, and it never exceeds input length)
+ */
+static void cache_normalize(const char* input, int length, char* key)
+{
+    cache_cursor cur;
+    int chr;
+
+    cache_cursor_init(&cur, input, length);
+    while ((chr = cache_cursor_next(&cur)) >= 0)
+        *key++ = (char)chr;
+}
+
+/**
+ * Builds canonical key from parsed RPN form; returns allocated string or NULL if the RPN form
+ * is not valid
+ */
+static char* cache_canonical_key(c_stack* rpn_stack, int flags)
+{
+    char** parts;
+    char *one, *two, *tmp;
+    const char* name;
+    char numbuf[64];
+    rpn_element* el;
+    int i, k, sp, len;
+
+    parts = (char**)malloc(sizeof(char*) * (rpn_stack->curr + 2));
+    if (parts == NULL)
+        return NULL;
+
+    sp = 0;
+    for (i = 0; i <= rpn_stack->curr; i++)
+    {
+        el = stck_get(rpn_stack, i);
+        tmp = NULL;
+
+        if (el->type == RPN_TOKEN_CONST || el->type == RPN_TOKEN_VARIABLE)
+        {
+            /* 17 significant digits identify double exactly */
+            if (el->type == RPN_TOKEN_CONST)
+                sprintf(numbuf, "%.17g", el->value.as_double);
+            else
+                sprintf(numbuf, "v%i", el->value.as_variable);
+
+            tmp = (char*)malloc(strlen(numbuf) + 1);
+            if (tmp != NULL)
+                strcpy(tmp, numbuf);
+        }
+        else if (el->type == RPN_TOKEN_FUNCTION && sp >= el->arity)
+        {
+            /* arguments are joined by comma */
+            sprintf(numbuf, "f%i", el->value.as_function);
+            len = (int)strlen(numbuf) + 3;
+            for (k = sp - el->arity; k < sp; k++)
+                len += (int)strlen(parts[k]) + 1;
+
+            tmp = (char*)malloc(len);
+            if (tmp != NULL)
+            {
+                sprintf(tmp, "%s(", numbuf);
+                for (k = sp - el->arity; k < sp; k++)
+                {
+                    if (k > sp - el->arity)
+                        strcat(tmp, ",");
+                    strcat(tmp, parts[k]);
+                }
+                strcat(tmp, ")");
+            }
+
+            for (k = sp - el->arity; k < sp; k++)
+                free(parts[k]);
+            sp -= el->arity;
+        }
+        else if (el->type == RPN_TOKEN_OPERATOR && sp >= 2)
+        {
+            two = parts[--sp];
+            one = parts[--sp];
+
+            /* commutative operators have their operands sorted */
+            if ((flags & CACHE_CANONICAL_ORDER) && (el->value.as_operator == OP_ADD || el->value.as_operator == OP_MULTIPLY)
+                && strcmp(one, two) > 0)
+            {
+                tmp = one;
+                one = two;
+                two = tmp;
+            }
+
+            name = sy_get_operator_name(el->value.as_operator);
+            tmp = (char*)malloc(strlen(one) + strlen(two) + strlen(name) + 3);
+            if (tmp != NULL)
+                sprintf(tmp, "(%s%s%s)", one, name, two);
+            free(one);
+            free(two);
+        }
+
+        /* stack underflow or allocation failure */
+        if (tmp == NULL)
+        {
+            while (sp > 0)
+                free(parts[--sp]);
+            free(parts);
+            return NULL;
+        }
+
+        parts[sp++] = tmp;
+    }
+
+    /* join everything left on stack (one value for valid expressions) with canonical key mark */
+    len = 2;
+    for (i = 0; i < sp; i++)
+        len += (int)strlen(parts[i]) + 1;
+
+    tmp = (char*)malloc(len);
+    if (tmp != NULL)
+    {
+        strcpy(tmp, "#");
+        for (i = 0; i < sp; i++)
+        {
+            if (i > 0)
+                strcat(tmp, ",");
+            strcat(tmp, parts[i]);
+        }
+    }
+
+    for (i = 0; i < sp; i++)
+        free(parts[i]);
+    free(parts);
+
+    return tmp;
+}
+
+/**
+ * Finds entry by key - safe to call without lock, as long as the caller is registered as reader
+ * (or holds the lock)
+ */
+static cache_entry* cache_find(expr_cache* cache, const char* key, int length, unsigned long hash)
+{
+    cache_key_node* node;
+
+    for (node = cache->buckets[hash & cache->bucket_mask]; node != NULL; node = node->next)
+    {
+        if (node->hash == hash && node->length == length && memcmp(node->key, key, length) == 0)
+            return node->entry;
+    }
+
+    return NULL;
+}
+
+/**
+ * Finds entry by normalized token stream key of input (of supplied length and hash), comparing
+ * stored keys right with input - the same conditions as for cache_find apply
+ */
+static cache_entry* cache_find_input(expr_cache* cache, const char* input, int length, int key_length, unsigned long hash)
+{
+    cache_key_node* node;
+    cache_cursor cur;
+    int i;
+
+    for (node = cache->buckets[hash & cache->bucket_mask]; node != NULL; node = node->next)
+    {
+        if (node->hash != hash || node->length != key_length)
+            continue;
+
+        cache_cursor_init(&cur, input, length);
+        for (i = 0; i < key_length; i++)
+        {
+            if (cache_cursor_next(&cur) != (unsigned char)node->key[i])
+                break;
+        }
+        if (i == key_length)
+            return node->entry;
+    }
+
+    return NULL;
+}
+
+/**
+ * Adds key leading to entry and publishes it for readers - the key is either supplied one, or
+ * normalized token stream of supplied input (if key is NULL); expects the lock to be held
+ */
+static void cache_add_key(expr_cache* cache, cache_entry* entry, const char* key, const char* input, int input_length,
+                          int length, unsigned long hash)
+{
+    cache_key_node* node;
+    long size = (long)sizeof(cache_key_node) + length;
+
+    node = (cache_key_node*)malloc(size);
+    if (node == NULL)
+        return;
+
+    node->hash = hash;
+    node->length = length;
+    node->key = (char*)(node + 1);
+    if (key != NULL)
+        memcpy(node->key, key, length);
+    else
+        cache_normalize(input, input_length, node->key);
+    node->entry = entry;
+
+    node->next_of_entry = entry->keys;
+    entry->keys = node;
+    entry->bytes += size;
+    cache->bytes += size;
+
+    /* the node has to be complete before readers may see it */
+    node->next = cache->buckets[hash & cache->bucket_mask];
+    node->pprev = &cache->buckets[hash & cache->bucket_mask];
+    if (node->next != NULL)
+        node->next->pprev = &node->next;
+    pool_memory_barrier();
+    cache->buckets[hash & cache->bucket_mask] = node;
+}
+
+/**
+ * Frees entry with all its keys and program
+ */
+static void cache_free_entry(cache_entry* entry)
+{
+    cache_key_node *node, *next;
+
+    for (node = entry->keys; node != NULL; node = next)
+    {
+        next = node->next_of_entry;
+        free(node);
+    }
+
+    prog_destroy(entry->program);
+    free(entry);
+}
+
+/**
+ * Unlinks entry and all its keys, so no new reader can find it, and moves it to retired list;
+ * expects the lock to be held
+ */
+static void cache_evict(expr_cache* cache, cache_entry* victim)
+{
+    cache_key_node* node;
+
+    if (victim->next == victim)
+        cache->hand = NULL;
+    else
+    {
+        if (cache->hand == victim)
+            cache->hand = victim->next;
+        victim->prev->next = victim->next;
+        victim->next->prev = victim->prev;
+    }
+
+    /* unlinked nodes keep their "next" pointer, so readers currently standing on them may continue */
+    for (node = victim->keys; node != NULL; node = node->next_of_entry)
+    {
+        *node->pprev = node->next;
+        if (node->next != NULL)
+            node->next->pprev = node->pprev;
+    }
+
+    victim->retired = 1;
+    victim->next = cache->retired;
+    cache->retired = victim;
+
+    cache->entry_count--;
+    cache->bytes -= victim->bytes;
+    cache->evictions++;
+}
+
+/**
+ * Frees retired entries, which are not held by anyone, if there's no reader in flight;
+ * expects the lock to be held
+ */
+static void cache_reclaim(expr_cache* cache)
+{
+    cache_entry** pentry;
+    cache_entry* entry;
+
+    /* every unlink has to be visible before we look at reader counter */
+    pool_memory_barrier();
+    if (cache->readers != 0)
+        return;
+
+    pentry = &cache->retired;
+    while (*pentry != NULL)
+    {
+        entry = *pentry;
+        if (entry->refcount == 0)
+        {
+            *pentry = entry->next;
+            cache_free_entry(entry);
+        }
+        else
+        {
+            pentry = &entry->next;
+        }
+    }
+}
+
+/**
+ * Evicts entries not used recently until the cache fits into its limits (except the one which
+ * is just being handed out) - the eviction hand clears reference marks of entries it passes, and
+ * evicts the first unmarked one; expects the lock to be held
+ */
+static void cache_enforce_limits(expr_cache* cache, cache_entry* keep)
+{
+    cache_entry* victim;
+    long steps;
+
+    steps = 0;
+    while ((cache->entry_count > cache->capacity || cache->bytes > cache->max_bytes) && cache->entry_count > 1)
+    {
+        victim = cache->hand;
+        cache->hand = victim->next;
+        if (victim == keep)
+            continue;
+
+        /* marks set meanwhile by lookups (which do not take the lock) are ignored after two rounds,
+         * so the eviction always ends */
+        if (victim->referenced && steps++ < 2 * cache->entry_count)
+        {
+            victim->referenced = 0;
+            continue;
+        }
+
+        cache_evict(cache, victim);
+    }
+
+    cache_reclaim(cache);
+}
+
+/**
+ * Creates cache with specified maximum number of programs and memory limit; non-positive
+ * values mean implicit limits
+ */
+expr_cache* cache_create(int capacity, long max_bytes, int flags)
+{
+    expr_cache* cache;
+    unsigned long buckets;
+
+    cache = (expr_cache*)malloc(sizeof(expr_cache));
+    if (cache == NULL)
+        return NULL;
+
+    memset(cache, 0, sizeof(expr_cache));
+    cache->flags = flags;
+    cache->capacity = (capacity > 0) ? capacity : CACHE_DEFAULT_CAPACITY;
+    cache->max_bytes = (max_bytes > 0) ? max_bytes : CACHE_DEFAULT_MAX_BYTES;
+
+    /* keep load factor below 1 (there are usually two keys for every entry) */
+    buckets = 16;
+    while (buckets < (unsigned long)cache->capacity * 2)
+        buckets *= 2;
+
+    cache->bucket_mask = buckets - 1;
+    cache->buckets = (cache_key_node* volatile*)calloc(buckets, sizeof(cache_key_node*));
+    cache->lock = pool_lock_create();
+
+    if (cache->buckets == NULL || cache->lock == NULL)
+    {
+        free((void*)cache->buckets);
+        if (cache->lock != NULL)
+            pool_lock_destroy(cache->lock);
+        free(cache);
+        return NULL;
+    }
+
+    return cache;
+}
+
+/**
+ * Destroys cache with all programs (nobody may hold any entry at this point)
+ */
+void cache_destroy(expr_cache* cache)
+{
+    cache_entry *entry, *next;
+    long i;
+
+    entry = cache->hand;
+    for (i = 0; i < cache->entry_count; i++)
+    {
+        next = entry->next;
+        cache_free_entry(entry);
+        entry = next;
+    }
+    for (entry = cache->retired; entry != NULL; entry = next)
+    {
+        next = entry->next;
+        cache_free_entry(entry);
+    }
+
+    pool_lock_destroy(cache->lock);
+    free((void*)cache->buckets);
+    free(cache);
+}
+
+/**
+ * Retrieves compiled program for expression given by first "length" characters of input; parses
+ * and compiles it only if not cached yet. The returned entry has to be released by cache_release
+ * returns NULL and sets error (and error pointer to input) if the expression is not valid
+ */
+cache_entry* cache_get(expr_cache* cache, char* input, int length, int* error, char** error_ptr)
+{
+    char* canonical;
+    int key_length, canonical_length;
+    unsigned long hash, canonical_hash;
+    cache_entry *entry, *found;
+    c_stack* parsed;
+    rpn_program* prog;
+
+    *error = SYNTAX_ERROR_NONE;
+    *error_ptr = NULL;
+
+    /* the key is not built, lookup reads the input as normalized token stream */
+    hash = cache_input_hash(input, length, &key_length);
+
+    /* lock-free lookup */
+    pool_atomic_add(&cache->readers, 1);
+    entry = cache_find_input(cache, input, length, key_length, hash);
+    if (entry != NULL)
+    {
+        pool_atomic_add(&entry->refcount, 1);
+        entry->referenced = 1;
+    }
+    pool_atomic_add(&cache->readers, -1);
+
+    if (entry != NULL)
+    {
+        pool_atomic_add(&cache->hits, 1);
+        return entry;
+    }
+
+    pool_atomic_add(&cache->misses, 1);
+
+    /* miss - parse and compile outside of lock; errors are never cached */
+    parsed = sy_generate_rpn_stack_n(input, length, error, error_ptr);
+    if (parsed == NULL || *error != SYNTAX_ERROR_NONE)
+    {
+        if (parsed != NULL)
+            stck_destroy(parsed);
+        return NULL;
+    }
+
+    prog = prog_compile(parsed, input, length, error);
+    canonical = (prog != NULL) ? cache_canonical_key(parsed, cache->flags) : NULL;
+    stck_destroy(parsed);
+
+    if (prog == NULL)
+        return NULL;
+
+    canonical_length = (canonical != NULL) ? (int)strlen(canonical) : 0;
+    canonical_hash = (canonical != NULL) ? cache_hash(canonical, canonical_length) : 0;
+
+    pool_lock_acquire(cache->lock);
+
+    /* somebody may have inserted the same program meanwhile */
+    found = cache_find_input(cache, input, length, key_length, hash);
+    if (found == NULL && canonical != NULL)
+    {
+        found = cache_find(cache, canonical, canonical_length, canonical_hash);
+        if (found != NULL)
+        {
+            cache->canonical_hits++;
+            cache_add_key(cache, found, NULL, input, length, key_length, hash);
+        }
+    }
+
+    if (found != NULL)
+    {
+        entry = found;
+        entry->referenced = 1;
+        prog_destroy(prog);
+    }
+    else
+    {
+        entry = (cache_entry*)malloc(sizeof(cache_entry));
+        if (entry == NULL)
+        {
+            pool_lock_release(cache->lock);
+            prog_destroy(prog);
+            free(canonical);
+            *error = GENERAL_MEMORY_ERROR;
+            return NULL;
+        }
+
+        memset(entry, 0, sizeof(cache_entry));
+        entry->program = prog;
+        entry->bytes = (long)sizeof(cache_entry) + sizeof(rpn_program) + prog->image_size;
+        cache->bytes += entry->bytes;
+
+        cache_add_key(cache, entry, NULL, input, length, key_length, hash);
+        if (canonical != NULL)
+            cache_add_key(cache, entry, canonical, NULL, 0, canonical_length, canonical_hash);
+
+        /* new entry is placed right behind the eviction hand, so it is the last one visited; it is not
+         * marked as referenced, so a run of unique expressions does not push out the reused ones */
+        if (cache->hand == NULL)
+        {
+            entry->next = entry;
+            entry->prev = entry;
+            cache->hand = entry;
+        }
+        else
+        {
+            entry->next = cache->hand;
+            entry->prev = cache->hand->prev;
+            entry->prev->next = entry;
+            cache->hand->prev = entry;
+        }
+        cache->entry_count++;
+    }
+
+    pool_atomic_add(&entry->refcount, 1);
+
+    cache_enforce_limits(cache, entry);
+
+    pool_lock_release(cache->lock);
+
+    free(canonical);
+
+    return entry;
+}
+
+/**
+ * Releases entry obtained by cache_get; the program must not be used after this call
+ */
+void cache_release(expr_cache* cache, cache_entry* entry)
+{
+    (void)cache;
+
+    /* retired entries are freed by next writer, once nobody holds them */
+    pool_atomic_add(&entry->refcount, -1);
+}
+
+/**
+ * Retrieves cache statistics (counters are read without lock, so they may be slightly off
+ * while other threads use the cache)
+ */
+void cache_get_stats(expr_cache* cache, cache_stats* stats)
+{
+    stats->hits = cache->hits;
+    stats->canonical_hits = cache->canonical_hits;
+    stats->misses = cache->misses;
+    stats->evictions = cache->evictions;
+    stats->entries = cache->entry_count;
+    stats->bytes = cache->bytes;
+}
@@ -0,0 +1,48 @@
+#ifndef MATHPARSER_CACHE_H
+#define MATHPARSER_CACHE_H
+
+#define CACHE_CANONICAL_ORDER 0x0001        /* sort operands of commutative operators (+, *) when building key */
+
+#define CACHE_DEFAULT_CAPACITY 4096         /* implicit maximum number of cached programs */
+#define CACHE_DEFAULT_MAX_BYTES 16777216L   /* implicit maximum memory occupied by cached programs and keys */
+
+/* key record - every cached program may be reachable using several keys (defined in cache.c) */
+typedef struct _cache_key_node cache_key_node;
+
+/* cached program record; only "program" member is meant to be used outside the cache */
+typedef struct _cache_entry
+{
+    rpn_program* program;                   /* compiled program, valid until the entry is released */
+
+    volatile long refcount;                 /* number of users holding the entry */
+    volatile int referenced;                /* looked up since the eviction hand passed it (CLOCK eviction) */
+    int retired;                            /* entry was evicted, and waits to be freed */
+    long bytes;                             /* memory accounted to this entry */
+    cache_key_node* keys;                   /* keys leading to this entry */
+    struct _cache_entry* next;              /* next entry in live or retired list */
+    struct _cache_entry* prev;              /* previous entry in live list */
+} cache_entry;
+
+/* cache statistics, all counters are cumulative since cache creation */
+typedef struct
+{
+    long hits;                              /* lookups satisfied by normalized token stream */
+    long canonical_hits;                    /* misses which found the same program under canonical key */
+    long misses;                            /* lookups which had to parse and compile */
+    long evictions;                         /* programs evicted due to capacity or size limit */
+    long entries;                           /* number of programs currently cached */
+    long bytes;                             /* memory currently accounted to cached programs */
+} cache_stats;
+
+/* opaque cache structure, defined in cache.c */
+typedef struct _expr_cache expr_cache;
+
+expr_cache* cache_create(int capacity, long max_bytes, int flags);
+void cache_destroy(expr_cache* cache);
+
+cache_entry* cache_get(expr_cache* cache, char* input, int length, int* error, char** error_ptr);
+void cache_release(expr_cache* cache, cache_entry* entry);
+
+void cache_get_stats(expr_cache* cache, cache_stats* stats);
+
+#endif
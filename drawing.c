@@ -1,491 +1,1759 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <stdarg.h>
-#include <time.h>
-#include <math.h>
-#include "main.h"
-#include "stack.h"
-#include "rpn.h"
-#include "postscript.h"
-#include "drawing.h"
-
-/**
- * Custom function to determine if the supplied value has NaN "value" (specific floating point
- * numeric value)
- */
-static int isnan_d(double val)
-{
-    return (val != val) ? 1 : 0;
-}
-
-/**
- * Custom function to determine if supplied value is infinity (positive or negative)
- * The INFINITY macro is not defined by default on some platforms, the redefinition
- * may cause warning saying, that floating values multiplication flew over. That's
- * completelly fine, we want it to overflow to infinity
- */
-static int isinf_d(double val)
-{
-    return (val == INFINITY || val == -INFINITY) ? 1 : 0;
-}
-
-/**
- * Decides helper line distance depending on input min-max distance
- */
-static double decide_line_step(double inp)
-{
-    /*
-     * purely guessed values to make it look fine
-     * - this should guarantee at least 5 helper lines on each plot
-     */
-
-    if (inp < 1.0)
-        return 0.1;
-    else if (inp < 5.0)
-        return 0.5;
-    else if (inp < 10.0)
-        return 1.0;
-    else if (inp < 20.0)
-        return 2.0;
-    else if (inp < 50.0)
-        return 5.0;
-    else if (inp < 100.0)
-        return 10.0;
-
-    return 25.0;
-}
-
-/**
- * Prepares output document for writing; writes header also
- */
-static ps_document* drawing_prepare_output(char* filename)
-{
-    ps_document* output;
-    time_t now;
-    struct tm *gmt;
-    char* formatted_time;
-
-    /* creates postscript document structure */
-    output = ps_create_document(filename);
-    if (output == NULL)
-        return NULL;
-
-    /* format time */
-    now = time(NULL);
-    gmt = gmtime(&now);
-    formatted_time = asctime(gmt);
-
-    /* and write header */
-    ps_write_header(output, "Martin Ubl", "Matematicka funkce", formatted_time);
-
-    return output;
-}
-
-/**
- * Function drawing helper lines - mainly the frame of plot, and also helper "gray" lines by uniform distances.
- * Also draws significant points coordinate lines and their values (minimum and maximum)
- */
-static void drawing_draw_helper_lines(ps_document* output, ps_pen* pen, double* limits, double* eval_values, double step_coef, double val_coef, int fmin, int fmax, double val_step)
-{
-    double plot_step, plot_x;
-    int valcount;
-
-    /* the border is drawn with doubled thickness */
-    ps_set_line_width(output, 2);
-
-    /* draw frame */
-    ps_pen_down(pen);
-    ps_pen_draw(pen, DRAW_X_END, DRAW_Y_BEGIN);
-    ps_pen_draw(pen, DRAW_X_END, DRAW_Y_BEGIN + (limits[3] - limits[2])*val_coef);
-    ps_pen_draw(pen, DRAW_X_BEGIN, DRAW_Y_BEGIN + (limits[3] - limits[2])*val_coef);
-    ps_pen_draw(pen, DRAW_X_BEGIN, DRAW_Y_BEGIN);
-    ps_pen_up(pen);
-
-    /* set implicit font for labels */
-    ps_set_font(output, DRAW_LABEL_FONT_FAMILY, DRAW_LABEL_FONT_SIZE);
-
-    /* switch thickness back to 1 to draw helper "gray" lines */
-    ps_set_line_width(output, 1);
-
-    /* decide stepping value */
-    plot_step = decide_line_step(limits[1] - limits[0]);
-    plot_x = limits[0] + plot_step;
-    valcount = (int)(1.0 / PLOT_STEP_COEF) + 1;
-
-    /* and draw vertical lines */
-    ps_set_position(output, DRAW_X_BEGIN - 10, DRAW_Y_BEGIN - 20);
-    ps_print_text_val(output, limits[0], PARAMETER_FORMATTER);
-    while (plot_x < limits[1])
-    {
-        if (fabs(plot_x) < 0.05)
-        {
-            plot_x += plot_step;
-            continue;
-        }
-
-        ps_set_color(output, 0.7, 0.7, 0.7);
-
-        /* draw line */
-        ps_pen_move(pen, DRAW_X_BEGIN + (plot_x - limits[0]) * step_coef, DRAW_Y_BEGIN);
-        ps_pen_down(pen);
-        ps_pen_draw(pen, DRAW_X_BEGIN + (plot_x - limits[0]) * step_coef, DRAW_Y_END);
-        ps_pen_up(pen);
-
-        ps_set_color(output, 0, 0, 0);
-
-        /* draw label */
-        ps_set_position(output, DRAW_X_BEGIN + (plot_x - limits[0]) * step_coef - 10, DRAW_Y_BEGIN - 20);
-        ps_print_text_val(output, plot_x, PARAMETER_FORMATTER);
-
-        plot_x += plot_step;
-    }
-    ps_set_position(output, DRAW_X_END - 10, DRAW_Y_BEGIN - 20);
-    ps_print_text_val(output, limits[1], PARAMETER_FORMATTER);
-
-    /* draw Y axis, if in viewport */
-    if (limits[0] <= 0 && limits[1] >= 0)
-    {
-        ps_set_line_width(output, 2);
-        ps_set_color(output, 1, 0.4, 0.4);
-
-        /* draw line */
-        ps_pen_move(pen, DRAW_X_BEGIN + (0 - limits[0]) * step_coef, DRAW_Y_BEGIN);
-        ps_pen_down(pen);
-        ps_pen_draw(pen, DRAW_X_BEGIN + (0 - limits[0]) * step_coef, DRAW_Y_END);
-        ps_pen_up(pen);
-
-        /* draw label */
-        ps_set_position(output, DRAW_X_BEGIN + (0 - limits[0]) * step_coef - 10, DRAW_Y_BEGIN - 20);
-        ps_print_text_val(output, 0, PARAMETER_FORMATTER);
-
-        ps_set_line_width(output, 1);
-    }
-
-    /* and now draw vertical lines for minimum/maximum if needed and visible */
-
-    /* the formulas used for conditions just verifies, if the line would not lay somewhere
-       near the edge, and therefore be useless */
-
-    ps_set_color(output, 0.7, 0.7, 0.7);
-
-    /* minimum value line */
-    if (fmin > 5 && fmin < valcount - 5)
-    {
-        ps_pen_move(pen, DRAW_X_BEGIN + fmin*val_step*step_coef, DRAW_Y_BEGIN);
-        ps_pen_down(pen);
-        ps_pen_draw(pen, DRAW_X_BEGIN + fmin*val_step*step_coef, DRAW_Y_END);
-        ps_pen_up(pen);
-    }
-
-    /* maximum value line */
-    if (fmax > 5 && fmin < valcount - 5)
-    {
-        ps_pen_move(pen, DRAW_X_BEGIN + fmax*val_step*step_coef, DRAW_Y_BEGIN);
-        ps_pen_down(pen);
-        ps_pen_draw(pen, DRAW_X_BEGIN + fmax*val_step*step_coef, DRAW_Y_END);
-        ps_pen_up(pen);
-    }
-
-    ps_set_color(output, 0, 0, 0);
-
-    /* minimum value label */
-    if (fmin > 5 && fmin < valcount - 5)
-    {
-        ps_set_position(output, DRAW_X_BEGIN + fmin*val_step*step_coef - 10, DRAW_Y_BEGIN - 10);
-        ps_print_text_val(output, limits[0] + fmin*val_step, PARAMETER_FORMATTER);
-    }
-    /* maximum value label */
-    if (fmax > 5 && fmin < valcount - 5)
-    {
-        ps_set_position(output, DRAW_X_BEGIN + fmax*val_step*step_coef - 10, DRAW_Y_BEGIN - 10);
-        ps_print_text_val(output, limits[0] + fmax*val_step, PARAMETER_FORMATTER);
-    }
-
-
-    /* repeat similar process to horizontal lines */
-
-
-    /* decide stepping value */
-    plot_step = decide_line_step(limits[3] - limits[2]);
-    plot_x = limits[2] + plot_step;
-
-    /* draw horizontal lines */
-    ps_set_position(output, DRAW_X_BEGIN - 23, DRAW_Y_BEGIN - 6);
-    ps_print_text_val(output, limits[2], PARAMETER_FORMATTER);
-    while (plot_x < limits[3])
-    {
-        if (fabs(plot_x) < 0.05)
-        {
-            plot_x += plot_step;
-            continue;
-        }
-
-        ps_set_color(output, 0.7, 0.7, 0.7);
-
-        /* draw lines */
-        ps_pen_move(pen, DRAW_X_BEGIN, DRAW_Y_BEGIN + (plot_x - limits[2])*val_coef);
-        ps_pen_down(pen);
-        ps_pen_draw(pen, DRAW_X_END, DRAW_Y_BEGIN + (plot_x - limits[2])*val_coef);
-        ps_pen_up(pen);
-
-        ps_set_color(output, 0, 0, 0);
-
-        /* draw labels */
-        ps_set_position(output, DRAW_X_BEGIN - 23, DRAW_Y_BEGIN + (plot_x - limits[2])*val_coef - 6);
-        ps_print_text_val(output, plot_x, PARAMETER_FORMATTER);
-
-        plot_x += plot_step;
-    }
-    ps_set_position(output, DRAW_X_BEGIN - 23, DRAW_Y_END - 6);
-    ps_print_text_val(output, limits[3], PARAMETER_FORMATTER);
-
-    /* draw X axis, if in viewport */
-    if (limits[2] <= 0 && limits[3] >= 0)
-    {
-        ps_set_line_width(output, 2);
-        ps_set_color(output, 1, 0.4, 0.4);
-
-        /* draw lines */
-        ps_pen_move(pen, DRAW_X_BEGIN, DRAW_Y_BEGIN + (0 - limits[2])*val_coef);
-        ps_pen_down(pen);
-        ps_pen_draw(pen, DRAW_X_END, DRAW_Y_BEGIN + (0 - limits[2])*val_coef);
-        ps_pen_up(pen);
-
-        /* draw labels */
-        ps_set_position(output, DRAW_X_BEGIN - 23, DRAW_Y_BEGIN + (0 - limits[2])*val_coef - 6);
-        ps_print_text_val(output, 0, PARAMETER_FORMATTER);
-
-        ps_set_line_width(output, 1);
-    }
-
-    /* and now draw horizontal lines for minimum/maximum if needed and visible */
-
-    /* the formulas used for conditions just verifies, if the line would not lay somewhere
-       near the edge, and therefore be useless */
-
-    ps_set_color(output, 0.7, 0.7, 0.7);
-
-    /* minimal line */
-    if (limits[2] - eval_values[fmin] < -0.05 && fabs(eval_values[fmin]) > 0.05)
-    {
-        ps_pen_move(pen, DRAW_X_BEGIN, DRAW_Y_BEGIN + (eval_values[fmin] - limits[2])*val_coef);
-        ps_pen_down(pen);
-        ps_pen_draw(pen, DRAW_X_END, DRAW_Y_BEGIN + (eval_values[fmin] - limits[2])*val_coef);
-        ps_pen_up(pen);
-    }
-
-    /* maximal line */
-    if (limits[3] - eval_values[fmax] > 0.05 && fabs(eval_values[fmax]) > 0.05)
-    {
-        ps_pen_move(pen, DRAW_X_BEGIN, DRAW_Y_BEGIN + (eval_values[fmax] - limits[2])*val_coef);
-        ps_pen_down(pen);
-        ps_pen_draw(pen, DRAW_X_END, DRAW_Y_BEGIN + (eval_values[fmax] - limits[2])*val_coef);
-        ps_pen_up(pen);
-    }
-
-    ps_set_color(output, 0, 0, 0);
-
-    /* minimal label */
-    if (limits[2] - eval_values[fmin] < -0.05 && fabs(eval_values[fmin]) > 0.05)
-    {
-        ps_set_position(output, DRAW_X_BEGIN - 23, DRAW_Y_BEGIN + (eval_values[fmin] - limits[2])*val_coef - 6);
-        ps_print_text_val(output, eval_values[fmin], PARAMETER_FORMATTER);
-    }
-
-    /* maximal label */
-    if (limits[3] - eval_values[fmax] > 0.05 && fabs(eval_values[fmax]) > 0.05)
-    {
-        ps_set_position(output, DRAW_X_BEGIN - 23, DRAW_Y_BEGIN + (eval_values[fmax] - limits[2])*val_coef - 6);
-        ps_print_text_val(output, eval_values[fmax], PARAMETER_FORMATTER);
-    }
-}
-
-/**
- * Draws function created from parsed formula using supplied limits and output filename
- */
-void drawing_process_output(char* expr, char* output_file, c_stack* rpn_stack, double* limits)
-{
-    ps_document* output;
-    ps_pen* pen;
-    double val, val_step, plot_x, step_coef, val_coef, stored_x, stored_y, stored_dydx;
-    int penup, valcount, i, stored;
-    double* eval_values;
-    int fmax, fmin;
-    char* outexpr;
-
-    /* decide some essential values, just like number of values to be evaluated, step sizes and so */
-    val_step = PLOT_STEP_COEF * (limits[1] - limits[0]);
-    valcount = (int)(1.0/PLOT_STEP_COEF)+1;
-    eval_values = (double*)malloc(valcount*sizeof(double));
-
-    /* evaluate function values and store them to one big array, to reuse them later */
-    i = 0;
-    fmax = 0;
-    fmin = 0;
-
-    for (plot_x = limits[0]; i < valcount; plot_x += val_step)
-    {
-        eval_values[i] = rpn_evaluate_stack(rpn_stack, plot_x);
-
-        /* store maximum/minimum as index in value array */
-        if (eval_values[i] > eval_values[fmax] && eval_values[i] <= limits[3])
-            fmax = i;
-        else if (eval_values[i] < eval_values[fmin] && eval_values[i] >= limits[2])
-            fmin = i;
-
-        i++;
-    }
-
-    /* prepare drawing */
-    output = drawing_prepare_output(output_file);
-    if (output == NULL)
-    {
-        printf("Unable to create output file %s\n", output_file);
-        return;
-    }
-    pen = ps_create_pen(output, DRAW_X_BEGIN, DRAW_Y_BEGIN);
-    if (pen == NULL)
-    {
-        printf("Unable to allocate pen structure, drawing is not possible\n");
-        return;
-    }
-
-    /* coefficients to make plot equal sized on both sides (square) */
-    step_coef = (DRAW_X_END - DRAW_X_BEGIN) / (limits[1] - limits[0]);
-    val_coef = (DRAW_Y_END - DRAW_Y_BEGIN) / (limits[3] - limits[2]);
-
-    /* draw helper lines, border, etc. */
-    drawing_draw_helper_lines(output, pen, limits, eval_values, step_coef, val_coef, fmin, fmax, val_step);
-
-    /* print out f(x) = EXPR */
-    outexpr = (char*)malloc(sizeof(char) * (strlen(expr) + 8));
-    /**
-     * WARNING: there is a line, which would Splint consider an error
-     *          but it does not see, how much bytes i allocate, and that
-     *          it will always fit in there
-     **/
-    sprintf(outexpr, "f(x) = %s", expr);
-    ps_set_position(output, DRAW_X_BEGIN, DRAW_Y_END + 12);
-    ps_print_text(output, outexpr);
-    free(outexpr);
-
-    /* the plot itself would be drawn using doubled thickness */
-    ps_set_line_width(output, 2);
-
-    /* move to first point to be drawn (has to be valid and in range) */
-    i = 0;
-    plot_x = eval_values[0];
-    while (plot_x > limits[3] || plot_x < limits[2] || isnan_d(plot_x) || isinf_d(plot_x))
-        plot_x = eval_values[++i];
-
-    ps_pen_move(pen, DRAW_X_BEGIN + i*val_step*step_coef, DRAW_Y_BEGIN + (plot_x - limits[2])*val_coef);
-    ps_pen_down(pen);
-    penup = 0;
-
-    /* blue! */
-    ps_set_color(output, 0, 0, 1.0);
-
-    if (i < 1)
-        i++;
-    else if (i > 1)
-        i--;
-
-    stored = 0;
-
-    /* go through all points and draw lines */
-    for (plot_x = limits[0] + val_step*i; i < valcount; plot_x += val_step, i++)
-    {
-        val = eval_values[i];
-
-        if (stored == 0)
-        {
-            /* we will give it 2 chances to *not* change derivative value */
-            stored = 2;
-            stored_x = plot_x;
-            stored_y = val;
-            stored_dydx = fabs(eval_values[i] - eval_values[i-1]) / (val_step);
-        }
-
-        /* if the value "dropped out" of value range specified, just pick up the pen */
-        if (val > limits[3] || val < limits[2] || isnan_d(val) || isinf_d(val))
-        {
-            if (penup != 1)
-            {
-                /* this code guarantees, that lines running too fast out of plot (lots of regular functions)
-                   will not be cut somewhere far from the edge, but they will be drawn till the edge */
-                if (!isnan_d(val) && !isinf_d(val) && !isnan_d(eval_values[i - 1]) && !isinf_d(eval_values[i - 1])
-                    && eval_values[i - 1] < limits[3] && eval_values[i - 1] > limits[2])
-                {
-                    /* if previous value is larger, then we are going "down", so draw from the current to the edge */
-                    if (eval_values[i - 1] > val)
-                    {
-                        ps_pen_draw(pen, DRAW_X_BEGIN + (plot_x - limits[0]) * step_coef, DRAW_Y_BEGIN);
-                    }
-                    else /* opposite case */
-                    {
-                        ps_pen_draw(pen, DRAW_X_BEGIN + (plot_x - limits[0]) * step_coef, DRAW_Y_END);
-                    }
-                }
-                penup = 1;
-                ps_pen_up(pen);
-            }
-        }
-        else
-        {
-            /* if we just returned back to value range, do not draw, just move pen and put it down */
-            if (penup == 1)
-            {
-                /* this code guarantees, that lines running too fast out of plot (lots of regular functions)
-                   will not be cut somewhere far from the edge, but they will be drawn till the edge */
-                if (!isnan_d(eval_values[i - 1]) && !isinf_d(eval_values[i - 1]))
-                {
-                    /* if previous value is larger, then we are going "down", so draw from the top to new value */
-                    if (eval_values[i - 1] > val)
-                    {
-                        ps_pen_move(pen, DRAW_X_BEGIN + (plot_x - limits[0]) * step_coef, DRAW_Y_END);
-                        ps_pen_down(pen);
-                        ps_pen_draw(pen, DRAW_X_BEGIN + (plot_x - limits[0]) * step_coef, DRAW_Y_BEGIN + (val - limits[2])*val_coef);
-                    }
-                    else /* opposite case */
-                    {
-                        ps_pen_move(pen, DRAW_X_BEGIN + (plot_x - limits[0]) * step_coef, DRAW_Y_BEGIN);
-                        ps_pen_down(pen);
-                        ps_pen_draw(pen, DRAW_X_BEGIN + (plot_x - limits[0]) * step_coef, DRAW_Y_BEGIN + (val - limits[2])*val_coef);
-                    }
-                }
-                else
-                {
-                    ps_pen_move(pen, DRAW_X_BEGIN + (plot_x - limits[0]) * step_coef, DRAW_Y_BEGIN + (val - limits[2])*val_coef);
-                    ps_pen_down(pen);
-                }
-                penup = 0;
-            }
-            else /* otherwise draw normally */
-            {
-                /* if we have some stored value, and are not at the end */
-                if (stored > 0 && i != valcount-1)
-                {
-                    /* verify, if the derivative increased a bit in this period */
-                    if (fabs((fabs(stored_y - val) / (plot_x - stored_x)) - stored_dydx) < DRAW_MIN_DERIVATIVE)
-                        continue;
-                    /* if yes, decrease counter ("give it one more chance") and then continue to drawing */
-                    stored--;
-                }
-                ps_pen_draw(pen, DRAW_X_BEGIN + (plot_x - limits[0]) * step_coef, DRAW_Y_BEGIN + (val - limits[2])*val_coef);
-            }
-        }
-    }
-
-    /* if neccessarry, finish path */
-    if (penup == 0)
-        ps_pen_up(pen);
-
-    /* destroy pen structure */
-    ps_destroy_pen(pen);
-
-    /* finally, close document in order to save everything and so */
-    ps_close_document(output);
-
-    free(eval_values);
-}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include <math.h>
+#include "main.h"
+#include "stack.h"
+#include "rpn.h"
+#include "program.h"
+#include "multi.h"
+#include "pool.h"
+#include "raster.h"
+#include "postscript.h"
+#include "polyline.h"
+#include "heatmap.h"
+#include "implicit.h"
+#include "drawing.h"
+
+#define DRAW_STREAM_CHUNKS (DRAW_STREAM_CHUNK / DRAW_SAMPLE_CHUNK)   /* number of sampling chunks in one stream chunk */
+
+/* colors of plotted functions (red, green, blue); single function is blue */
+static const double drawing_palette[DRAW_PALETTE_SIZE][3] =
+{
+    {0, 0, 1.0}, {0.8, 0, 0}, {0, 0.6, 0}, {1.0, 0.5, 0}, {0.6, 0, 0.8}, {0, 0.6, 0.6}, {0.5, 0.3, 0.1}, {0.9, 0, 0.6}
+};
+
+/* parallel sampling state shared by all tasks, every task evaluates one chunk of samples of all functions */
+typedef struct
+{
+    multi_program* functions;
+    double* limits;
+    double* x_values;               /* positions of all samples */
+    double** eval_values;           /* values of all samples, for every function */
+    int valcount;                   /* number of samples */
+    int chunks;                     /* number of chunks */
+    int* chunk_min;                 /* index of the smallest value within limits in every chunk, -1 if there's none (may be NULL);
+                                       chunks of function F start at F*chunks */
+    int* chunk_max;                 /* index of the largest value within limits in every chunk, the same way */
+} drawing_sampling;
+
+/* uniform samples streamed by chunks of DRAW_STREAM_CHUNK, so any number of them fits in memory */
+typedef struct
+{
+    multi_program* functions;
+    double* limits;
+    thread_pool* pool;
+    long count;                     /* total number of samples */
+    long next;                      /* index of the first sample of next chunk */
+    int valcount;                   /* number of samples in current chunk */
+    int replay;                     /* current chunk is the next one (the whole range fits into it) */
+    double x_values[DRAW_STREAM_CHUNK];
+    double* eval_values[MULTI_MAX_FUNCTIONS];   /* values of current chunk, for every function */
+    int* chunk_min;                 /* DRAW_STREAM_CHUNKS entries for every function */
+    int* chunk_max;
+} drawing_stream;
+
+/* clipping stage - converts samples to device coordinates and splits plot to polylines within
+ * value limits, which are passed to the next stage */
+typedef struct
+{
+    multi_program* functions;       /* evaluates function while bracketing discontinuities */
+    int function;                   /* index of clipped function */
+    double* limits;
+    double step_coef, val_coef;
+    double previous_x;              /* position of previous sample */
+    double previous;                /* value of previous sample (NaN before the first one) */
+    int first;                      /* no sample was processed yet */
+    int penup;                      /* no polyline is in progress */
+    poly_sink sink;
+    void* context;
+} drawing_clipper;
+
+/* stage converting implicit curve polylines from function to device coordinates */
+typedef struct
+{
+    const double* limits;
+    double step_coef, val_coef;
+    poly_sink sink;
+    void* context;
+} drawing_transform;
+
+/* segment of adaptive sampling candidate for subdivision */
+typedef struct
+{
+    double deviation;               /* deviation of segment midpoint from chord of its parent segment */
+    int index;                      /* index of the first sample of segment */
+} drawing_segment;
+
+/**
+ * Custom function to determine if the supplied value has NaN "value" (specific floating point
+ * numeric value)
+ */
+static int isnan_d(double val)
+{
+    return (val != val) ? 1 : 0;
+}
+
+/**
+ * Custom function to determine if supplied value is infinity (positive or negative)
+ * The INFINITY macro is not defined by default on some platforms, the redefinition
+ * may cause warning saying, that floating values multiplication flew over. That's
+ * completelly fine, we want it to overflow to infinity
+ */
+static int isinf_d(double val)
+{
+    return (val == INFINITY || val == -INFINITY) ? 1 : 0;
+}
+
+/**
+ * Decides helper line distance depending on input min-max distance
+ */
+static double decide_line_step(double inp)
+{
+    /*
+     * purely guessed values to make it look fine
+     * - this should guarantee at least 5 helper lines on each plot
+     */
+
+    if (inp < 1.0)
+        return 0.1;
+    else if (inp < 5.0)
+        return 0.5;
+    else if (inp < 10.0)
+        return 1.0;
+    else if (inp < 20.0)
+        return 2.0;
+    else if (inp < 50.0)
+        return 5.0;
+    else if (inp < 100.0)
+        return 10.0;
+
+    return 25.0;
+}
+
+/**
+ * Prepares output document for writing; writes header also (with current time, if creation date
+ * of options is not supplied); files with raster extension (.ppm, .png) get raster document rendered
+ * using supplied thread pool, its image is made taller for pages higher than the square raster page;
+ * PostScript document is compact if options say so
+ */
+static ps_document* drawing_prepare_output(char* filename, double page_height, const drawing_options* options, thread_pool* pool)
+{
+    ps_document* output;
+    time_t now;
+    struct tm *gmt;
+    const char* formatted_time;
+    int height;
+
+    /* creates postscript (or raster) document structure */
+    if (raster_format_of(filename) != RASTER_FORMAT_NONE)
+    {
+        height = (int)ceil(DRAW_RASTER_SIZE * page_height / RASTER_PAGE_SIZE);
+        if (height < DRAW_RASTER_SIZE)
+            height = DRAW_RASTER_SIZE;
+        output = ps_create_raster_document(filename, raster_format_of(filename), DRAW_RASTER_SIZE, height, pool);
+    }
+    else
+        output = ps_create_document(filename);
+    if (output == NULL)
+        return NULL;
+    if (options->flags & DRAW_FLAG_COMPACT)
+        ps_set_compact(output, options->precision);
+
+    /* format time */
+    formatted_time = options->creation_date;
+    if (formatted_time == NULL)
+    {
+        now = time(NULL);
+        gmt = gmtime(&now);
+        formatted_time = asctime(gmt);
+    }
+
+    /* and write header */
+    ps_write_header(output, "Martin Ubl", "Matematicka funkce", formatted_time);
+
+    return output;
+}
+
+/**
+ * Function drawing helper lines - mainly the frame of plot, and also helper "gray" lines by uniform distances.
+ * Also draws significant points coordinate lines and their values (minimum and maximum)
+ */
+static void drawing_draw_helper_lines(ps_document* output, ps_pen* pen, double* limits, double step_coef, double val_coef, const drawing_extremes* extremes)
+{
+    double plot_step, plot_x, margin;
+
+    /* the border is drawn with doubled thickness */
+    ps_set_line_width(output, 2);
+
+    /* draw frame */
+    ps_pen_down(pen);
+    ps_pen_draw(pen, DRAW_X_END, DRAW_Y_BEGIN);
+    ps_pen_draw(pen, DRAW_X_END, DRAW_Y_BEGIN + (limits[3] - limits[2])*val_coef);
+    ps_pen_draw(pen, DRAW_X_BEGIN, DRAW_Y_BEGIN + (limits[3] - limits[2])*val_coef);
+    ps_pen_draw(pen, DRAW_X_BEGIN, DRAW_Y_BEGIN);
+    ps_pen_up(pen);
+
+    /* set implicit font for labels */
+    ps_set_font(output, DRAW_LABEL_FONT_FAMILY, DRAW_LABEL_FONT_SIZE);
+
+    /* switch thickness back to 1 to draw helper "gray" lines */
+    ps_set_line_width(output, 1);
+
+    /* decide stepping value */
+    plot_step = decide_line_step(limits[1] - limits[0]);
+    plot_x = limits[0] + plot_step;
+
+    /* minimum and maximum lines are not drawn this close to the edges */
+    margin = 5 * PLOT_STEP_COEF * (limits[1] - limits[0]);
+
+    /* and draw vertical lines - all of them first, so they are stroked at once (labels lie out of
+     * the frame, the order does not change the result) */
+    ps_set_color(output, 0.7, 0.7, 0.7);
+    while (plot_x < limits[1])
+    {
+        if (fabs(plot_x) >= 0.05)
+        {
+            ps_pen_move(pen, DRAW_X_BEGIN + (plot_x - limits[0]) * step_coef, DRAW_Y_BEGIN);
+            ps_pen_down(pen);
+            ps_pen_draw(pen, DRAW_X_BEGIN + (plot_x - limits[0]) * step_coef, DRAW_Y_END);
+            ps_pen_up(pen);
+        }
+        plot_x += plot_step;
+    }
+
+    /* and their labels */
+    ps_set_color(output, 0, 0, 0);
+    ps_set_position(output, DRAW_X_BEGIN - 10, DRAW_Y_BEGIN - 20);
+    ps_print_text_val(output, limits[0], PARAMETER_FORMATTER);
+    plot_x = limits[0] + plot_step;
+    while (plot_x < limits[1])
+    {
+        if (fabs(plot_x) >= 0.05)
+        {
+            ps_set_position(output, DRAW_X_BEGIN + (plot_x - limits[0]) * step_coef - 10, DRAW_Y_BEGIN - 20);
+            ps_print_text_val(output, plot_x, PARAMETER_FORMATTER);
+        }
+        plot_x += plot_step;
+    }
+    ps_set_position(output, DRAW_X_END - 10, DRAW_Y_BEGIN - 20);
+    ps_print_text_val(output, limits[1], PARAMETER_FORMATTER);
+
+    /* draw Y axis, if in viewport */
+    if (limits[0] <= 0 && limits[1] >= 0)
+    {
+        ps_set_line_width(output, 2);
+        ps_set_color(output, 1, 0.4, 0.4);
+
+        /* draw line */
+        ps_pen_move(pen, DRAW_X_BEGIN + (0 - limits[0]) * step_coef, DRAW_Y_BEGIN);
+        ps_pen_down(pen);
+        ps_pen_draw(pen, DRAW_X_BEGIN + (0 - limits[0]) * step_coef, DRAW_Y_END);
+        ps_pen_up(pen);
+
+        /* draw label */
+        ps_set_position(output, DRAW_X_BEGIN + (0 - limits[0]) * step_coef - 10, DRAW_Y_BEGIN - 20);
+        ps_print_text_val(output, 0, PARAMETER_FORMATTER);
+
+        ps_set_line_width(output, 1);
+    }
+
+    /* and now draw vertical lines for minimum/maximum if needed and visible */
+
+    /* the formulas used for conditions just verifies, if the line would not lay somewhere
+       near the edge, and therefore be useless */
+
+    ps_set_color(output, 0.7, 0.7, 0.7);
+
+    /* minimum value line */
+    if (extremes->min_x > limits[0] + margin && extremes->min_x < limits[1] - margin)
+    {
+        ps_pen_move(pen, DRAW_X_BEGIN + (extremes->min_x - limits[0])*step_coef, DRAW_Y_BEGIN);
+        ps_pen_down(pen);
+        ps_pen_draw(pen, DRAW_X_BEGIN + (extremes->min_x - limits[0])*step_coef, DRAW_Y_END);
+        ps_pen_up(pen);
+    }
+
+    /* maximum value line */
+    if (extremes->max_x > limits[0] + margin && extremes->max_x < limits[1] - margin)
+    {
+        ps_pen_move(pen, DRAW_X_BEGIN + (extremes->max_x - limits[0])*step_coef, DRAW_Y_BEGIN);
+        ps_pen_down(pen);
+        ps_pen_draw(pen, DRAW_X_BEGIN + (extremes->max_x - limits[0])*step_coef, DRAW_Y_END);
+        ps_pen_up(pen);
+    }
+
+    ps_set_color(output, 0, 0, 0);
+
+    /* minimum value label */
+    if (extremes->min_x > limits[0] + margin && extremes->min_x < limits[1] - margin)
+    {
+        ps_set_position(output, DRAW_X_BEGIN + (extremes->min_x - limits[0])*step_coef - 10, DRAW_Y_BEGIN - 10);
+        ps_print_text_val(output, extremes->min_x, PARAMETER_FORMATTER);
+    }
+    /* maximum value label */
+    if (extremes->max_x > limits[0] + margin && extremes->max_x < limits[1] - margin)
+    {
+        ps_set_position(output, DRAW_X_BEGIN + (extremes->max_x - limits[0])*step_coef - 10, DRAW_Y_BEGIN - 10);
+        ps_print_text_val(output, extremes->max_x, PARAMETER_FORMATTER);
+    }
+
+
+    /* repeat similar process to horizontal lines */
+
+
+    /* decide stepping value */
+    plot_step = decide_line_step(limits[3] - limits[2]);
+    plot_x = limits[2] + plot_step;
+
+    /* draw horizontal lines */
+    ps_set_color(output, 0.7, 0.7, 0.7);
+    while (plot_x < limits[3])
+    {
+        if (fabs(plot_x) >= 0.05)
+        {
+            ps_pen_move(pen, DRAW_X_BEGIN, DRAW_Y_BEGIN + (plot_x - limits[2])*val_coef);
+            ps_pen_down(pen);
+            ps_pen_draw(pen, DRAW_X_END, DRAW_Y_BEGIN + (plot_x - limits[2])*val_coef);
+            ps_pen_up(pen);
+        }
+        plot_x += plot_step;
+    }
+
+    /* and their labels */
+    ps_set_color(output, 0, 0, 0);
+    ps_set_position(output, DRAW_X_BEGIN - 23, DRAW_Y_BEGIN - 6);
+    ps_print_text_val(output, limits[2], PARAMETER_FORMATTER);
+    plot_x = limits[2] + plot_step;
+    while (plot_x < limits[3])
+    {
+        if (fabs(plot_x) >= 0.05)
+        {
+            ps_set_position(output, DRAW_X_BEGIN - 23, DRAW_Y_BEGIN + (plot_x - limits[2])*val_coef - 6);
+            ps_print_text_val(output, plot_x, PARAMETER_FORMATTER);
+        }
+        plot_x += plot_step;
+    }
+    ps_set_position(output, DRAW_X_BEGIN - 23, DRAW_Y_END - 6);
+    ps_print_text_val(output, limits[3], PARAMETER_FORMATTER);
+
+    /* draw X axis, if in viewport */
+    if (limits[2] <= 0 && limits[3] >= 0)
+    {
+        ps_set_line_width(output, 2);
+        ps_set_color(output, 1, 0.4, 0.4);
+
+        /* draw lines */
+        ps_pen_move(pen, DRAW_X_BEGIN, DRAW_Y_BEGIN + (0 - limits[2])*val_coef);
+        ps_pen_down(pen);
+        ps_pen_draw(pen, DRAW_X_END, DRAW_Y_BEGIN + (0 - limits[2])*val_coef);
+        ps_pen_up(pen);
+
+        /* draw labels */
+        ps_set_position(output, DRAW_X_BEGIN - 23, DRAW_Y_BEGIN + (0 - limits[2])*val_coef - 6);
+        ps_print_text_val(output, 0, PARAMETER_FORMATTER);
+
+        ps_set_line_width(output, 1);
+    }
+
+    /* and now draw horizontal lines for minimum/maximum if needed and visible */
+
+    /* the formulas used for conditions just verifies, if the line would not lay somewhere
+       near the edge, and therefore be useless */
+
+    ps_set_color(output, 0.7, 0.7, 0.7);
+
+    /* minimal line */
+    if (limits[2] - extremes->min_value < -0.05 && fabs(extremes->min_value) > 0.05)
+    {
+        ps_pen_move(pen, DRAW_X_BEGIN, DRAW_Y_BEGIN + (extremes->min_value - limits[2])*val_coef);
+        ps_pen_down(pen);
+        ps_pen_draw(pen, DRAW_X_END, DRAW_Y_BEGIN + (extremes->min_value - limits[2])*val_coef);
+        ps_pen_up(pen);
+    }
+
+    /* maximal line */
+    if (limits[3] - extremes->max_value > 0.05 && fabs(extremes->max_value) > 0.05)
+    {
+        ps_pen_move(pen, DRAW_X_BEGIN, DRAW_Y_BEGIN + (extremes->max_value - limits[2])*val_coef);
+        ps_pen_down(pen);
+        ps_pen_draw(pen, DRAW_X_END, DRAW_Y_BEGIN + (extremes->max_value - limits[2])*val_coef);
+        ps_pen_up(pen);
+    }
+
+    ps_set_color(output, 0, 0, 0);
+
+    /* minimal label */
+    if (limits[2] - extremes->min_value < -0.05 && fabs(extremes->min_value) > 0.05)
+    {
+        ps_set_position(output, DRAW_X_BEGIN - 23, DRAW_Y_BEGIN + (extremes->min_value - limits[2])*val_coef - 6);
+        ps_print_text_val(output, extremes->min_value, PARAMETER_FORMATTER);
+    }
+
+    /* maximal label */
+    if (limits[3] - extremes->max_value > 0.05 && fabs(extremes->max_value) > 0.05)
+    {
+        ps_set_position(output, DRAW_X_BEGIN - 23, DRAW_Y_BEGIN + (extremes->max_value - limits[2])*val_coef - 6);
+        ps_print_text_val(output, extremes->max_value, PARAMETER_FORMATTER);
+    }
+}
+
+
+/**
+ * Evaluates one chunk of samples of all functions (pool task routine), and finds the smallest and
+ * the largest value within limits of every function in it (the first one, if there are more equal)
+ */
+static void drawing_sample_chunk(void* arg, int index)
+{
+    drawing_sampling* sampling = (drawing_sampling*)arg;
+    double* outputs[MULTI_MAX_FUNCTIONS];
+    double* values;
+    int first, count, f, i, cmin, cmax;
+
+    first = index * DRAW_SAMPLE_CHUNK;
+    count = (sampling->valcount - first < DRAW_SAMPLE_CHUNK) ? sampling->valcount - first : DRAW_SAMPLE_CHUNK;
+    for (f = 0; f < sampling->functions->count; f++)
+        outputs[f] = sampling->eval_values[f] + first;
+
+    multi_evaluate_block(sampling->functions, sampling->x_values + first, count, outputs);
+
+    if (sampling->chunk_min == NULL)
+        return;
+
+    for (f = 0; f < sampling->functions->count; f++)
+    {
+        values = outputs[f];
+
+        /* NaN values are skipped (comparison with NaN is always false) */
+        cmin = -1;
+        cmax = -1;
+        for (i = 0; i < count; i++)
+        {
+            if (values[i] <= sampling->limits[3] && (cmax < 0 || values[i] > values[cmax]))
+                cmax = i;
+            if (values[i] >= sampling->limits[2] && (cmin < 0 || values[i] < values[cmin]))
+                cmin = i;
+        }
+
+        sampling->chunk_min[f * sampling->chunks + index] = (cmin < 0) ? -1 : first + cmin;
+        sampling->chunk_max[f * sampling->chunks + index] = (cmax < 0) ? -1 : first + cmax;
+    }
+}
+
+/**
+ * Evaluates all functions in "valcount" supplied positions, chunks of them in parallel using supplied
+ * thread pool (may be NULL); if chunk_min and chunk_max arrays are supplied, stores indexes of
+ * minimum and maximum of every chunk of every function to them
+ */
+static void drawing_evaluate(multi_program* functions, double* limits, double* x_values, double** eval_values, int valcount,
+                             thread_pool* pool, int* chunk_min, int* chunk_max)
+{
+    drawing_sampling sampling;
+
+    sampling.functions = functions;
+    sampling.limits = limits;
+    sampling.x_values = x_values;
+    sampling.eval_values = eval_values;
+    sampling.valcount = valcount;
+    sampling.chunks = (valcount + DRAW_SAMPLE_CHUNK - 1) / DRAW_SAMPLE_CHUNK;
+    sampling.chunk_min = chunk_min;
+    sampling.chunk_max = chunk_max;
+
+    pool_run(pool, drawing_sample_chunk, &sampling, sampling.chunks);
+}
+
+/**
+ * Evaluates single function (the only one of supplied functions) the same way as drawing_evaluate
+ */
+static void drawing_evaluate_single(multi_program* function, double* limits, double* x_values, double* eval_values, int valcount,
+                                    thread_pool* pool, int* chunk_min, int* chunk_max)
+{
+    double* outputs[1];
+
+    outputs[0] = eval_values;
+
+    drawing_evaluate(function, limits, x_values, outputs, valcount, pool, chunk_min, chunk_max);
+}
+
+/**
+ * Samples single function (the only one of supplied functions) uniformly, see drawing_sample
+ */
+static void drawing_sample_uniform(multi_program* function, double* limits, double* x_values, double* eval_values, int valcount,
+                                   thread_pool* pool, int* fmin, int* fmax)
+{
+    int *chunk_min, *chunk_max;
+    double val_step;
+    int chunks, i;
+
+    *fmin = -1;
+    *fmax = -1;
+
+    /* position is computed from sample index, so it does not depend on chunking */
+    val_step = (valcount > 1) ? (limits[1] - limits[0]) / (valcount - 1) : 0.0;
+    for (i = 0; i < valcount; i++)
+        x_values[i] = limits[0] + i * val_step;
+
+    chunks = (valcount + DRAW_SAMPLE_CHUNK - 1) / DRAW_SAMPLE_CHUNK;
+    chunk_min = (int*)malloc(sizeof(int) * (chunks + 1));
+    chunk_max = (int*)malloc(sizeof(int) * (chunks + 1));
+    if (chunk_min == NULL || chunk_max == NULL)
+    {
+        free(chunk_min);
+        free(chunk_max);
+        for (i = 0; i < valcount; i++)
+            eval_values[i] = NAN;
+        return;
+    }
+
+    drawing_evaluate_single(function, limits, x_values, eval_values, valcount, pool, chunk_min, chunk_max);
+
+    /* the earlier sample wins among equal ones, the same as if the samples were processed one by one */
+    for (i = 0; i < chunks; i++)
+    {
+        if (chunk_max[i] >= 0 && (*fmax < 0 || eval_values[chunk_max[i]] > eval_values[*fmax]))
+            *fmax = chunk_max[i];
+        if (chunk_min[i] >= 0 && (*fmin < 0 || eval_values[chunk_min[i]] < eval_values[*fmin]))
+            *fmin = chunk_min[i];
+    }
+    if (*fmin < 0)
+        *fmin = 0;
+    if (*fmax < 0)
+        *fmax = 0;
+
+    free(chunk_min);
+    free(chunk_max);
+}
+
+/**
+ * Evaluates "valcount" samples of function uniformly distributed in range of limits, stores their
+ * positions and values, and finds indexes of minimum and maximum within value limits (zero, if
+ * there's no such value)
+ * - chunks of samples are evaluated in parallel using supplied thread pool (may be NULL), and
+ *   merged in order, so the result is the same for any number of threads
+ */
+void drawing_sample(rpn_program* prog, double* limits, double* x_values, double* eval_values, int valcount, thread_pool* pool, int* fmin, int* fmax)
+{
+    multi_program single;
+
+    multi_init_single(&single, prog);
+    drawing_sample_uniform(&single, limits, x_values, eval_values, valcount, pool, fmin, fmax);
+}
+
+/**
+ * Destroys stream
+ */
+static void drawing_stream_destroy(drawing_stream* stream)
+{
+    free(stream->eval_values[0]);
+    free(stream->chunk_min);
+    free(stream->chunk_max);
+    free(stream);
+}
+
+/**
+ * Creates stream of "count" uniform samples of all functions in range of limits, chunks are
+ * evaluated using supplied thread pool (may be NULL)
+ */
+static drawing_stream* drawing_stream_create(multi_program* functions, double* limits, long count, thread_pool* pool)
+{
+    drawing_stream* stream;
+    int f;
+
+    stream = (drawing_stream*)malloc(sizeof(drawing_stream));
+    if (stream == NULL)
+        return NULL;
+
+    /* values of all functions in one block */
+    stream->eval_values[0] = (double*)malloc(sizeof(double) * DRAW_STREAM_CHUNK * functions->count);
+    stream->chunk_min = (int*)malloc(sizeof(int) * DRAW_STREAM_CHUNKS * functions->count);
+    stream->chunk_max = (int*)malloc(sizeof(int) * DRAW_STREAM_CHUNKS * functions->count);
+    if (stream->eval_values[0] == NULL || stream->chunk_min == NULL || stream->chunk_max == NULL)
+    {
+        drawing_stream_destroy(stream);
+        return NULL;
+    }
+    for (f = 1; f < functions->count; f++)
+        stream->eval_values[f] = stream->eval_values[0] + f * DRAW_STREAM_CHUNK;
+
+    stream->functions = functions;
+    stream->limits = limits;
+    stream->pool = pool;
+    stream->count = count;
+    stream->next = 0;
+    stream->valcount = 0;
+    stream->replay = 0;
+
+    return stream;
+}
+
+/**
+ * Evaluates next chunk of stream; position is computed from sample index the same way as by
+ * drawing_sample, so the samples do not depend on chunking
+ * Returns number of samples in chunk, 0 at the end of stream
+ */
+static int drawing_stream_next(drawing_stream* stream)
+{
+    double val_step;
+    int i;
+
+    if (stream->replay)
+    {
+        stream->replay = 0;
+        return stream->valcount;
+    }
+
+    if (stream->next >= stream->count)
+        return 0;
+
+    stream->valcount = (stream->count - stream->next < DRAW_STREAM_CHUNK) ? (int)(stream->count - stream->next) : DRAW_STREAM_CHUNK;
+
+    val_step = (stream->count > 1) ? (stream->limits[1] - stream->limits[0]) / (stream->count - 1) : 0.0;
+    for (i = 0; i < stream->valcount; i++)
+        stream->x_values[i] = stream->limits[0] + (stream->next + i) * val_step;
+
+    drawing_evaluate(stream->functions, stream->limits, stream->x_values, stream->eval_values, stream->valcount, stream->pool,
+                     stream->chunk_min, stream->chunk_max);
+    stream->next += stream->valcount;
+
+    return stream->valcount;
+}
+
+/**
+ * Restarts stream from the first sample; if all samples fit into one chunk, they are not evaluated again
+ */
+static void drawing_stream_rewind(drawing_stream* stream)
+{
+    if (stream->next == stream->count && stream->next == stream->valcount)
+    {
+        stream->replay = 1;
+        return;
+    }
+
+    stream->next = 0;
+    stream->valcount = 0;
+    stream->replay = 0;
+}
+
+/**
+ * Goes through whole stream and finds minimum and maximum within value limits of every function
+ * (stored to extremes[F]) by the same rule as drawing_sample (the first sample, if no value is
+ * smaller or greater)
+ */
+static void drawing_stream_extremes(drawing_stream* stream, drawing_extremes* extremes)
+{
+    drawing_extremes* ext;
+    double* values;
+    int count, chunks, f, i, index;
+
+    for (f = 0; f < stream->functions->count; f++)
+    {
+        extremes[f].min_x = stream->limits[0];
+        extremes[f].max_x = stream->limits[0];
+        extremes[f].min_value = NAN;
+        extremes[f].max_value = NAN;
+    }
+
+    while ((count = drawing_stream_next(stream)) > 0)
+    {
+        chunks = (count + DRAW_SAMPLE_CHUNK - 1) / DRAW_SAMPLE_CHUNK;
+        for (f = 0; f < stream->functions->count; f++)
+        {
+            ext = &extremes[f];
+            values = stream->eval_values[f];
+
+            for (i = 0; i < chunks; i++)
+            {
+                index = stream->chunk_max[f * chunks + i];
+                if (index >= 0 && (values[index] > ext->max_value || ext->max_value != ext->max_value))
+                {
+                    ext->max_x = stream->x_values[index];
+                    ext->max_value = values[index];
+                }
+                index = stream->chunk_min[f * chunks + i];
+                if (index >= 0 && (values[index] < ext->min_value || ext->min_value != ext->min_value))
+                {
+                    ext->min_x = stream->x_values[index];
+                    ext->min_value = values[index];
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Merges extremes of "count" functions to the extremes of the whole plot (the first function is
+ * the reference, extremes not defined are skipped)
+ */
+static void drawing_merge_extremes(const drawing_extremes* extremes, int count, drawing_extremes* merged)
+{
+    int f;
+
+    *merged = extremes[0];
+    for (f = 1; f < count; f++)
+    {
+        if (extremes[f].max_value > merged->max_value || isnan_d(merged->max_value))
+        {
+            merged->max_x = extremes[f].max_x;
+            merged->max_value = extremes[f].max_value;
+        }
+        if (extremes[f].min_value < merged->min_value || isnan_d(merged->min_value))
+        {
+            merged->min_x = extremes[f].min_x;
+            merged->min_value = extremes[f].min_value;
+        }
+    }
+}
+
+/**
+ * Finds minimum and maximum within value limits of "valcount" samples of function uniformly
+ * distributed in range of limits, the same as drawing_sample would; samples are streamed, so
+ * the memory used does not depend on their number
+ * Returns 1 on success, 0 if memory allocation failed
+ */
+int drawing_sample_extremes(rpn_program* prog, double* limits, long valcount, thread_pool* pool, drawing_extremes* extremes)
+{
+    drawing_stream* stream;
+    multi_program single;
+
+    multi_init_single(&single, prog);
+    stream = drawing_stream_create(&single, limits, valcount, pool);
+    if (stream == NULL)
+        return 0;
+
+    drawing_stream_extremes(stream, extremes);
+    drawing_stream_destroy(stream);
+
+    return 1;
+}
+
+/**
+ * Converts function value to vertical position in plot; values out of limits are clamped to one
+ * plot height above or below, so they do not dominate deviations
+ */
+static double drawing_plot_y(double* limits, double val_coef, double val)
+{
+    double y = (val - limits[2]) * val_coef;
+
+    if (y < DRAW_Y_BEGIN - DRAW_Y_END)
+        return DRAW_Y_BEGIN - DRAW_Y_END;
+    if (y > 2 * (DRAW_Y_END - DRAW_Y_BEGIN))
+        return 2 * (DRAW_Y_END - DRAW_Y_BEGIN);
+
+    return y;
+}
+
+/**
+ * Decides, how much the midpoint of segment deviates from chord of segment ends (in plot units);
+ * if some of the values is not finite, and some is, the deviation is one plot height, so the
+ * segment is subdivided to find the edge
+ */
+static double drawing_deviation(double* limits, double val_coef, double left, double middle, double right)
+{
+    int finite;
+
+    finite = !isnan_d(left) && !isinf_d(left);
+    finite += !isnan_d(middle) && !isinf_d(middle);
+    finite += !isnan_d(right) && !isinf_d(right);
+
+    if (finite == 0)
+        return 0.0;
+    if (finite < 3)
+        return DRAW_Y_END - DRAW_Y_BEGIN;
+
+    return fabs(drawing_plot_y(limits, val_coef, middle)
+                - (drawing_plot_y(limits, val_coef, left) + drawing_plot_y(limits, val_coef, right)) / 2);
+}
+
+/**
+ * Compares segments by deviation, the greatest first (for qsort); equal ones keep position order
+ */
+static int drawing_compare_segments(const void* a, const void* b)
+{
+    const drawing_segment* first = (const drawing_segment*)a;
+    const drawing_segment* second = (const drawing_segment*)b;
+
+    if (first->deviation != second->deviation)
+        return (first->deviation > second->deviation) ? -1 : 1;
+
+    return first->index - second->index;
+}
+
+/**
+ * Finds indexes of minimum and maximum within value limits (zero, if there's no such value)
+ */
+static void drawing_find_extremes(double* limits, double* eval_values, int valcount, int* fmin, int* fmax)
+{
+    int i;
+
+    *fmin = -1;
+    *fmax = -1;
+
+    /* NaN values are skipped (comparison with NaN is always false) */
+    for (i = 0; i < valcount; i++)
+    {
+        if (eval_values[i] <= limits[3] && (*fmax < 0 || eval_values[i] > eval_values[*fmax]))
+            *fmax = i;
+        if (eval_values[i] >= limits[2] && (*fmin < 0 || eval_values[i] < eval_values[*fmin]))
+            *fmin = i;
+    }
+
+    if (*fmin < 0)
+        *fmin = 0;
+    if (*fmax < 0)
+        *fmax = 0;
+}
+
+/**
+ * Samples single function (the only one of supplied functions, which may have bound parameters)
+ * adaptively - starts with DRAW_ADAPTIVE_INITIAL uniform samples, and then
+ * repeatedly halves segments, whose midpoint deviated from chord of the parent segment by more
+ * than DRAW_ADAPTIVE_TOLERANCE (in plot units), until they are narrower than DRAW_ADAPTIVE_MIN_WIDTH;
+ * when there are more such segments than evaluations left, the most deviated ones are halved
+ * - x_values and eval_values have to have space for "max_count" samples, which is also the
+ *   maximum number of evaluations
+ * - midpoints of every pass are evaluated in parallel using supplied thread pool (may be NULL)
+ * returns number of samples (sorted by position), or 0 if memory allocation failed
+ */
+static int drawing_adaptive(multi_program* function, double* limits, double* x_values, double* eval_values, int max_count,
+                            thread_pool* pool, int* fmin, int* fmax)
+{
+    drawing_segment* segments;
+    double *mid_x, *mid_values, *new_x, *new_values, *deviations, *new_deviations;
+    double step_coef, val_coef;
+    int count, active, chosen, i, j, k;
+
+    count = (max_count < DRAW_ADAPTIVE_INITIAL) ? max_count : DRAW_ADAPTIVE_INITIAL;
+    if (count < 2)
+        return 0;
+
+    step_coef = (DRAW_X_END - DRAW_X_BEGIN) / (limits[1] - limits[0]);
+    val_coef = (DRAW_Y_END - DRAW_Y_BEGIN) / (limits[3] - limits[2]);
+
+    /* deviation of every segment (from its parent), zero if it should not be halved anymore */
+    segments = (drawing_segment*)malloc(sizeof(drawing_segment) * max_count);
+    mid_x = (double*)malloc(sizeof(double) * max_count);
+    mid_values = (double*)malloc(sizeof(double) * max_count);
+    new_x = (double*)malloc(sizeof(double) * max_count);
+    new_values = (double*)malloc(sizeof(double) * max_count);
+    deviations = (double*)malloc(sizeof(double) * max_count);
+    new_deviations = (double*)malloc(sizeof(double) * max_count);
+    if (segments == NULL || mid_x == NULL || mid_values == NULL || new_x == NULL || new_values == NULL
+        || deviations == NULL || new_deviations == NULL)
+        count = 0;
+    else
+        drawing_sample_uniform(function, limits, x_values, eval_values, count, pool, fmin, fmax);
+
+    /* every initial segment is halved at least once */
+    for (i = 0; i < count - 1; i++)
+        deviations[i] = INFINITY;
+
+    while (count > 0)
+    {
+        /* collect segments to be halved */
+        active = 0;
+        for (i = 0; i < count - 1; i++)
+        {
+            if (deviations[i] > DRAW_ADAPTIVE_TOLERANCE
+                && (x_values[i + 1] - x_values[i]) * step_coef >= 2 * DRAW_ADAPTIVE_MIN_WIDTH)
+            {
+                segments[active].deviation = deviations[i];
+                segments[active].index = i;
+                active++;
+            }
+        }
+
+        chosen = (active < max_count - count) ? active : max_count - count;
+        if (chosen == 0)
+            break;
+
+        /* not enough evaluations left - halve only the most deviated segments */
+        if (chosen < active)
+        {
+            qsort(segments, active, sizeof(drawing_segment), drawing_compare_segments);
+            for (i = 0; i < chosen; i++)
+                deviations[segments[i].index] = -deviations[segments[i].index];
+            for (i = 0, j = 0; i < count - 1; i++)
+            {
+                if (deviations[i] < 0)
+                {
+                    deviations[i] = -deviations[i];
+                    segments[j++].index = i;
+                }
+            }
+        }
+
+        /* evaluate midpoints of chosen segments */
+        for (i = 0; i < chosen; i++)
+        {
+            k = segments[i].index;
+            mid_x[i] = x_values[k] + (x_values[k + 1] - x_values[k]) / 2;
+        }
+        drawing_evaluate_single(function, limits, mid_x, mid_values, chosen, pool, NULL, NULL);
+
+        /* and insert them between segment ends, both halves inherit deviation of midpoint */
+        for (i = 0, j = 0, k = 0; i < count; i++)
+        {
+            new_x[k] = x_values[i];
+            new_values[k] = eval_values[i];
+            new_deviations[k] = 0.0;
+            k++;
+
+            if (j < chosen && segments[j].index == i)
+            {
+                new_deviations[k - 1] = drawing_deviation(limits, val_coef, eval_values[i], mid_values[j], eval_values[i + 1]);
+                new_x[k] = mid_x[j];
+                new_values[k] = mid_values[j];
+                new_deviations[k] = new_deviations[k - 1];
+                k++;
+                j++;
+            }
+            else if (i < count - 1)
+                new_deviations[k - 1] = deviations[i];
+        }
+
+        count = k;
+        memcpy(x_values, new_x, sizeof(double) * count);
+        memcpy(eval_values, new_values, sizeof(double) * count);
+        memcpy(deviations, new_deviations, sizeof(double) * count);
+    }
+
+    drawing_find_extremes(limits, eval_values, count, fmin, fmax);
+
+    free(segments);
+    free(mid_x);
+    free(mid_values);
+    free(new_x);
+    free(new_values);
+    free(deviations);
+    free(new_deviations);
+
+    return count;
+}
+
+/**
+ * Samples function adaptively, see drawing_adaptive
+ * returns number of samples (sorted by position), or 0 if memory allocation failed
+ */
+int drawing_sample_adaptive(rpn_program* prog, double* limits, double* x_values, double* eval_values, int max_count, thread_pool* pool, int* fmin, int* fmax)
+{
+    multi_program single;
+
+    multi_init_single(&single, prog);
+
+    return drawing_adaptive(&single, limits, x_values, eval_values, max_count, pool, fmin, fmax);
+}
+
+/**
+ * Final stage of plot polyline - draws it using pen (context is ps_pen structure)
+ */
+static void drawing_pen_sink(void* context, int command, double x, double y)
+{
+    ps_pen* pen = (ps_pen*)context;
+
+    if (command == POLY_MOVE)
+    {
+        ps_pen_move(pen, x, y);
+        ps_pen_down(pen);
+    }
+    else if (command == POLY_DRAW)
+        ps_pen_draw(pen, x, y);
+    else
+        ps_pen_up(pen);
+}
+
+/**
+ * Initializes clipping stage of function with supplied index passing polylines to supplied sink
+ */
+static void drawing_clipper_init(drawing_clipper* clip, multi_program* functions, int function, double* limits, poly_sink sink, void* context)
+{
+    clip->functions = functions;
+    clip->function = function;
+    clip->limits = limits;
+    clip->step_coef = (DRAW_X_END - DRAW_X_BEGIN) / (limits[1] - limits[0]);
+    clip->val_coef = (DRAW_Y_END - DRAW_Y_BEGIN) / (limits[3] - limits[2]);
+    clip->previous_x = limits[0];
+    clip->previous = NAN;
+    clip->first = 1;
+    clip->penup = 1;
+    clip->sink = sink;
+    clip->context = context;
+}
+
+/**
+ * Decides, whether the value is finite and within value limits
+ */
+static int drawing_in_limits(const double* limits, double val)
+{
+    return !isnan_d(val) && !isinf_d(val) && val <= limits[3] && val >= limits[2];
+}
+
+/**
+ * Retrieves vertical distance of two values (in plot units, values out of limits are clamped
+ * by drawing_plot_y); it's the largest possible distance, if some of them is not finite
+ */
+static double drawing_jump(drawing_clipper* clip, double first, double second)
+{
+    if (isnan_d(first) || isinf_d(first) || isnan_d(second) || isinf_d(second))
+        return 3 * (DRAW_Y_END - DRAW_Y_BEGIN);
+
+    return fabs(drawing_plot_y(clip->limits, clip->val_coef, first) - drawing_plot_y(clip->limits, clip->val_coef, second));
+}
+
+/**
+ * Narrows range between two samples to the part containing the largest jump of function value
+ * by bisection (if function is not defined in midpoint, the part towards defined end is kept)
+ * Returns 1 if the jump remains - there's a pole, jump or edge of domain; 0 if the function is
+ * continuous in the range
+ */
+static int drawing_bracket(drawing_clipper* clip, double* a, double* fa, double* b, double* fb)
+{
+    double m, fm;
+    int i;
+
+    for (i = 0; i < DRAW_BISECTION_STEPS; i++)
+    {
+        m = *a + (*b - *a) / 2;
+        if (m <= *a || m >= *b)
+            break;
+
+        fm = multi_evaluate(clip->functions, clip->function, m);
+
+        if (isnan_d(fm) || isinf_d(fm))
+        {
+            if (!isnan_d(*fa) && !isinf_d(*fa))
+            {
+                *b = m;
+                *fb = fm;
+            }
+            else
+            {
+                *a = m;
+                *fa = fm;
+            }
+        }
+        else if (drawing_jump(clip, *fa, fm) >= drawing_jump(clip, fm, *fb))
+        {
+            *b = m;
+            *fb = fm;
+        }
+        else
+        {
+            *a = m;
+            *fa = fm;
+        }
+    }
+
+    return drawing_jump(clip, *fa, *fb) > DRAW_DISCONTINUITY_JUMP;
+}
+
+/**
+ * Retrieves vertical plot position of value, values out of limits are moved to the nearest edge
+ */
+static double drawing_edge_y(drawing_clipper* clip, double val)
+{
+    if (val > clip->limits[3])
+        return DRAW_Y_END;
+    if (val < clip->limits[2])
+        return DRAW_Y_BEGIN;
+
+    return DRAW_Y_BEGIN + (val - clip->limits[2]) * clip->val_coef;
+}
+
+/**
+ * Finds, where continuous function crosses value limits between position "inside" (with value
+ * within limits) and "outside" (with value out of them) by bisection, and passes the point on
+ * the edge to the next stage as supplied command; if the function is not defined there, the last
+ * point within limits is passed instead
+ */
+static void drawing_clip_crossing(drawing_clipper* clip, int command, double inside, double outside, double fo)
+{
+    double m, fm, fi;
+
+    fi = NAN;
+    while (fabs(outside - inside) * clip->step_coef > DRAW_CROSSING_PRECISION)
+    {
+        m = inside + (outside - inside) / 2;
+        if (m == inside || m == outside)
+            break;
+
+        fm = multi_evaluate(clip->functions, clip->function, m);
+        if (drawing_in_limits(clip->limits, fm))
+        {
+            inside = m;
+            fi = fm;
+        }
+        else
+        {
+            outside = m;
+            fo = fm;
+        }
+    }
+
+    if (isnan_d(fo) && !isnan_d(fi))
+        clip->sink(clip->context, command, DRAW_X_BEGIN + (inside - clip->limits[0]) * clip->step_coef, drawing_edge_y(clip, fi));
+    else if (!isnan_d(fo))
+        clip->sink(clip->context, command, DRAW_X_BEGIN + (outside - clip->limits[0]) * clip->step_coef, drawing_edge_y(clip, fo));
+}
+
+/**
+ * Continues polyline in progress from position x0 (value within limits) to x1, where the
+ * value is out of limits - draws up to the edge and lifts the pen
+ */
+static void drawing_clip_exit(drawing_clipper* clip, double x0, double x1, double f1)
+{
+    drawing_clip_crossing(clip, POLY_DRAW, x0, x1, f1);
+    clip->sink(clip->context, POLY_END, 0, 0);
+    clip->penup = 1;
+}
+
+/**
+ * Starts new polyline on the edge, where function returns to value limits between position x0
+ * (value out of limits) and x1 (value f1 within them)
+ */
+static void drawing_clip_enter(drawing_clipper* clip, double x0, double f0, double x1, double f1)
+{
+    if (isnan_d(f0))
+        clip->sink(clip->context, POLY_MOVE, DRAW_X_BEGIN + (x1 - clip->limits[0]) * clip->step_coef, drawing_edge_y(clip, f1));
+    else
+    {
+        drawing_clip_crossing(clip, POLY_MOVE, x1, x0, f0);
+        clip->sink(clip->context, POLY_DRAW, DRAW_X_BEGIN + (x1 - clip->limits[0]) * clip->step_coef, drawing_edge_y(clip, f1));
+    }
+    clip->penup = 0;
+}
+
+/**
+ * Lifts the pen at discontinuity bracketed by [a, b] - the polyline in progress is drawn up to
+ * "a" (or to the edge, if the value there is out of limits), and if the sample following
+ * discontinuity is in limits, new polyline starts from "b" (or from the edge)
+ */
+static void drawing_clip_break(drawing_clipper* clip, double a, double fa, double b, double fb, double x, double val)
+{
+    if (clip->penup == 0)
+    {
+        if (drawing_in_limits(clip->limits, fa))
+        {
+            clip->sink(clip->context, POLY_DRAW, DRAW_X_BEGIN + (a - clip->limits[0]) * clip->step_coef, drawing_edge_y(clip, fa));
+            clip->sink(clip->context, POLY_END, 0, 0);
+            clip->penup = 1;
+        }
+        else
+            drawing_clip_exit(clip, clip->previous_x, a, fa);
+    }
+
+    if (drawing_in_limits(clip->limits, val))
+    {
+        if (drawing_in_limits(clip->limits, fb))
+        {
+            clip->sink(clip->context, POLY_MOVE, DRAW_X_BEGIN + (b - clip->limits[0]) * clip->step_coef, drawing_edge_y(clip, fb));
+            clip->sink(clip->context, POLY_DRAW, DRAW_X_BEGIN + (x - clip->limits[0]) * clip->step_coef, drawing_edge_y(clip, val));
+            clip->penup = 0;
+        }
+        else
+            drawing_clip_enter(clip, b, fb, x, val);
+    }
+}
+
+/**
+ * Checks the range between previous and supplied sample for discontinuity, and handles it
+ * - poles, jumps and edges of domain lift the pen exactly there
+ * - steep continuous run through the whole plot is drawn from edge to edge
+ * Returns 1 if the sample was handled, 0 if it should be processed normally
+ */
+static int drawing_clip_discontinuity(drawing_clipper* clip, double x, double val)
+{
+    double* limits = clip->limits;
+    double a, fa, b, fb;
+    int in_previous, in_current;
+
+    in_previous = drawing_in_limits(limits, clip->previous);
+    in_current = drawing_in_limits(limits, val);
+
+    /* only changes of sign out of the plot, or large jumps within it are suspicious */
+    if (!in_previous && !in_current)
+    {
+        if (isnan_d(clip->previous) || isinf_d(clip->previous) || isnan_d(val) || isinf_d(val)
+            || (clip->previous > limits[3]) == (val > limits[3]))
+            return 0;
+    }
+    else if (drawing_jump(clip, clip->previous, val) <= DRAW_DISCONTINUITY_SPAN)
+        return 0;
+
+    a = clip->previous_x;
+    fa = clip->previous;
+    b = x;
+    fb = val;
+
+    if (drawing_bracket(clip, &a, &fa, &b, &fb))
+    {
+        drawing_clip_break(clip, a, fa, b, fb, x, val);
+        return 1;
+    }
+
+    /* continuous function running through the whole plot between samples */
+    if (!in_previous && !in_current)
+    {
+        clip->sink(clip->context, POLY_MOVE, DRAW_X_BEGIN + (x - limits[0]) * clip->step_coef, drawing_edge_y(clip, clip->previous));
+        clip->sink(clip->context, POLY_DRAW, DRAW_X_BEGIN + (x - limits[0]) * clip->step_coef, drawing_edge_y(clip, val));
+        clip->sink(clip->context, POLY_END, 0, 0);
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Passes chunk of samples (sorted by position) through clipping stage
+ */
+static void drawing_clip(drawing_clipper* clip, const double* x_values, const double* eval_values, int valcount)
+{
+    double val, previous, previous_x;
+    int i, handled;
+
+    for (i = 0; i < valcount; i++)
+    {
+        val = eval_values[i];
+        previous = clip->previous;
+        previous_x = clip->previous_x;
+
+        handled = !clip->first && drawing_clip_discontinuity(clip, x_values[i], val);
+
+        clip->previous_x = x_values[i];
+        clip->previous = val;
+        clip->first = 0;
+
+        if (handled)
+            continue;
+
+        if (!drawing_in_limits(clip->limits, val))
+        {
+            /* if the value "dropped out" of value range specified, draw to the edge and pick up the pen */
+            if (clip->penup == 0)
+                drawing_clip_exit(clip, previous_x, x_values[i], val);
+        }
+        else if (clip->penup == 1)
+        {
+            /* if we just returned back to value range, start from the edge (previous value is NaN before the first sample) */
+            drawing_clip_enter(clip, previous_x, previous, x_values[i], val);
+        }
+        else /* otherwise draw normally */
+            clip->sink(clip->context, POLY_DRAW, DRAW_X_BEGIN + (x_values[i] - clip->limits[0]) * clip->step_coef, drawing_edge_y(clip, val));
+    }
+}
+
+/**
+ * Finishes polyline in progress, if any
+ */
+static void drawing_clip_finish(drawing_clipper* clip)
+{
+    if (clip->penup == 0)
+        clip->sink(clip->context, POLY_END, 0, 0);
+    clip->penup = 1;
+}
+
+/**
+ * Passes samples (sorted by position) of function through clipping stage only - the plot is split
+ * to polylines within value limits (in device coordinates), which are passed to supplied sink
+ */
+void drawing_trace(rpn_program* prog, double* limits, const double* x_values, const double* eval_values, int valcount,
+                   void (*sink)(void* context, int command, double x, double y), void* context)
+{
+    drawing_clipper clipper;
+    multi_program single;
+
+    multi_init_single(&single, prog);
+    drawing_clipper_init(&clipper, &single, 0, limits, sink, context);
+    drawing_clip(&clipper, x_values, eval_values, valcount);
+    drawing_clip_finish(&clipper);
+}
+
+/**
+ * Retrieves number of columns and rows of legend of supplied number of functions - lines are stacked
+ * above the plot, up to DRAW_LEGEND_MAX_ROWS in a column, more functions fill columns evenly
+ */
+static void drawing_legend_layout(int count, int* columns, int* rows)
+{
+    *columns = (count + DRAW_LEGEND_MAX_ROWS - 1) / DRAW_LEGEND_MAX_ROWS;
+    if (*columns < 1)
+        *columns = 1;
+    *rows = (count + *columns - 1) / *columns;
+}
+
+/**
+ * Retrieves position of baseline start of f-th line of legend of supplied number of functions;
+ * columns go from left to right, the first line of each on the top
+ */
+void drawing_legend_position(int count, int f, double* x, double* y)
+{
+    int columns, rows;
+
+    drawing_legend_layout(count, &columns, &rows);
+    *x = DRAW_X_BEGIN + (f / rows) * (DRAW_X_END - DRAW_X_BEGIN) / columns;
+    *y = DRAW_Y_END + DRAW_LEGEND_OFFSET + (rows - 1 - f % rows) * DRAW_LEGEND_LINE_HEIGHT;
+}
+
+/**
+ * Retrieves height of page holding plot with legend of supplied number of functions - the square
+ * raster page, unless the legend reaches above it
+ */
+double drawing_page_height(int count)
+{
+    double x, y;
+
+    drawing_legend_position(count, 0, &x, &y);
+    y += DRAW_LABEL_FONT_SIZE;
+
+    return (y > RASTER_PAGE_SIZE) ? y : RASTER_PAGE_SIZE;
+}
+
+/**
+ * Prints legend - "f(x) = EXPR" for single function, or "fN(x) = EXPR" lines in colors of functions
+ * stacked above the plot; lines of legend laid out in more columns are cut to width of their column
+ */
+void drawing_print_legend(ps_document* output, char** expressions, int count)
+{
+    char* outexpr;
+    double x, y;
+    int f, columns, rows;
+    size_t max_length;
+
+    drawing_legend_layout(count, &columns, &rows);
+    max_length = (size_t)((DRAW_X_END - DRAW_X_BEGIN) / columns / DRAW_LEGEND_CHAR_WIDTH);
+
+    for (f = 0; f < count; f++)
+    {
+        outexpr = (char*)malloc(sizeof(char) * (strlen(expressions[f]) + 16));
+        if (outexpr == NULL)
+            return;
+
+        /**
+         * WARNING: there is a line, which would Splint consider an error
+         *          but it does not see, how much bytes i allocate, and that
+         *          it will always fit in there
+         **/
+        if (count == 1)
+            sprintf(outexpr, "f(x) = %s", expressions[f]);
+        else
+        {
+            sprintf(outexpr, "f%i(x) = %s", f + 1, expressions[f]);
+            ps_set_color(output, drawing_palette[f % DRAW_PALETTE_SIZE][0], drawing_palette[f % DRAW_PALETTE_SIZE][1],
+                         drawing_palette[f % DRAW_PALETTE_SIZE][2]);
+        }
+        if (columns > 1 && strlen(outexpr) > max_length)
+            strcpy(outexpr + max_length - 3, "...");
+
+        drawing_legend_position(count, f, &x, &y);
+        ps_set_position(output, x, y);
+        ps_print_text(output, outexpr);
+        free(outexpr);
+    }
+
+    if (count > 1)
+        ps_set_color(output, 0, 0, 0);
+}
+
+/**
+ * Draws functions created from compiled formulas using supplied limits and output filename;
+ * samples are evaluated using supplied thread pool (may be NULL), either uniformly, or
+ * adaptively (if DRAW_FLAG_ADAPTIVE is set)
+ * - the plot is drawn by pipeline of stages: sampling, clipping to value limits, decimation to
+ *   pixel columns, simplification and PostScript output; uniform samples are streamed through it
+ *   by chunks, and their extremes (labeled in plot) are found by pre-pass, so the memory used
+ *   does not depend on number of samples
+ * - more functions are always sampled uniformly, all of them in one pass (with shared
+ *   subexpressions evaluated once); every one has its own clipping, decimation and simplification,
+ *   and its reduced polylines are recorded and drawn at once in its own color
+ * Returns 0 on success, 1 if drawing was not possible (the reason is printed)
+ */
+int drawing_process_output(char** expressions, multi_program* functions, char* output_file, double* limits, thread_pool* pool,
+                           const drawing_options* options)
+{
+    ps_document* output;
+    ps_pen* pen;
+    drawing_stream* stream;
+    drawing_clipper clippers[MULTI_MAX_FUNCTIONS];
+    drawing_extremes extremes, function_extremes[MULTI_MAX_FUNCTIONS];
+    poly_decimator decimators[MULTI_MAX_FUNCTIONS];
+    poly_recorder recorders[MULTI_MAX_FUNCTIONS];
+    poly_simplifier* simplifiers;
+    double step_coef, val_coef;
+    double *x_values, *eval_values;
+    long samples;
+    int valcount, fmax, fmin, f;
+
+    samples = (options->samples > 0) ? options->samples : DRAW_DEFAULT_SAMPLES;
+    stream = NULL;
+    x_values = NULL;
+    eval_values = NULL;
+    valcount = 0;
+    extremes.min_x = limits[0];
+    extremes.max_x = limits[0];
+    extremes.min_value = NAN;
+    extremes.max_value = NAN;
+
+    if (!(options->flags & DRAW_FLAG_ADAPTIVE) || functions->count > 1)
+    {
+        /* the pre-pass finds extremes; if all samples fit into one chunk, they are evaluated only once */
+        stream = drawing_stream_create(functions, limits, samples, pool);
+        if (stream != NULL)
+        {
+            drawing_stream_extremes(stream, function_extremes);
+            drawing_merge_extremes(function_extremes, functions->count, &extremes);
+            drawing_stream_rewind(stream);
+        }
+    }
+    else
+    {
+        /* adaptive sampling holds all samples, the budget limits its memory */
+        valcount = (samples < DRAW_ADAPTIVE_MAX_SAMPLES) ? (int)samples : DRAW_ADAPTIVE_MAX_SAMPLES;
+        x_values = (double*)malloc(valcount*sizeof(double));
+        eval_values = (double*)malloc(valcount*sizeof(double));
+        if (x_values != NULL && eval_values != NULL)
+            valcount = drawing_adaptive(functions, limits, x_values, eval_values, valcount, pool, &fmin, &fmax);
+        else
+            valcount = 0;
+
+        if (valcount > 0 && eval_values[fmin] >= limits[2])
+        {
+            extremes.min_x = x_values[fmin];
+            extremes.min_value = eval_values[fmin];
+        }
+        if (valcount > 0 && eval_values[fmax] <= limits[3])
+        {
+            extremes.max_x = x_values[fmax];
+            extremes.max_value = eval_values[fmax];
+        }
+    }
+
+    simplifiers = (poly_simplifier*)malloc(sizeof(poly_simplifier) * functions->count);
+    if ((stream == NULL && valcount == 0) || simplifiers == NULL)
+    {
+        printf("Unable to allocate memory for samples, drawing is not possible\n");
+        if (stream != NULL)
+            drawing_stream_destroy(stream);
+        free(simplifiers);
+        free(x_values);
+        free(eval_values);
+        return 1;
+    }
+
+    /* prepare drawing */
+    output = drawing_prepare_output(output_file, drawing_page_height(functions->count), options, pool);
+    pen = (output != NULL) ? ps_create_pen(output, DRAW_X_BEGIN, DRAW_Y_BEGIN) : NULL;
+    if (pen == NULL)
+    {
+        if (output == NULL)
+            printf("Unable to create output file %s\n", output_file);
+        else
+            printf("Unable to allocate pen structure, drawing is not possible\n");
+        if (stream != NULL)
+            drawing_stream_destroy(stream);
+        free(simplifiers);
+        free(x_values);
+        free(eval_values);
+        return 1;
+    }
+
+    /* coefficients to make plot equal sized on both sides (square) */
+    step_coef = (DRAW_X_END - DRAW_X_BEGIN) / (limits[1] - limits[0]);
+    val_coef = (DRAW_Y_END - DRAW_Y_BEGIN) / (limits[3] - limits[2]);
+
+    /* draw helper lines, border, etc. */
+    drawing_draw_helper_lines(output, pen, limits, step_coef, val_coef, &extremes);
+
+    /* print out f(x) = EXPR */
+    drawing_print_legend(output, expressions, functions->count);
+
+    /* the plot itself would be drawn using doubled thickness */
+    ps_set_line_width(output, 2);
+
+    /* blue! (more functions are drawn in their colors later) */
+    if (functions->count == 1)
+        ps_set_color(output, drawing_palette[0][0], drawing_palette[0][1], drawing_palette[0][2]);
+
+    /* clipped polylines pass through decimation (at most 4 points per pixel column) and simplification,
+     * which removes vertices not visibly changing the line; single function is drawn directly */
+    for (f = 0; f < functions->count; f++)
+    {
+        poly_recorder_init(&recorders[f]);
+        if (functions->count == 1)
+            poly_simplifier_init(&simplifiers[f], POLY_SIMPLIFY_TOLERANCE, drawing_pen_sink, pen);
+        else
+            poly_simplifier_init(&simplifiers[f], POLY_SIMPLIFY_TOLERANCE, poly_record, &recorders[f]);
+        poly_decimator_init(&decimators[f], DRAW_X_BEGIN, POLY_COLUMN_WIDTH, poly_simplify, &simplifiers[f]);
+        drawing_clipper_init(&clippers[f], functions, f, limits, poly_decimate, &decimators[f]);
+    }
+
+    if (stream != NULL)
+    {
+        while ((valcount = drawing_stream_next(stream)) > 0)
+        {
+            for (f = 0; f < functions->count; f++)
+                drawing_clip(&clippers[f], stream->x_values, stream->eval_values[f], valcount);
+        }
+    }
+    else
+        drawing_clip(&clippers[0], x_values, eval_values, valcount);
+
+    for (f = 0; f < functions->count; f++)
+        drawing_clip_finish(&clippers[f]);
+
+    /* recorded functions are drawn one by one */
+    if (functions->count > 1)
+    {
+        for (f = 0; f < functions->count; f++)
+        {
+            ps_set_color(output, drawing_palette[f % DRAW_PALETTE_SIZE][0], drawing_palette[f % DRAW_PALETTE_SIZE][1],
+                         drawing_palette[f % DRAW_PALETTE_SIZE][2]);
+            poly_replay(&recorders[f], drawing_pen_sink, pen);
+            poly_recorder_release(&recorders[f]);
+        }
+    }
+
+    /* destroy pen structure */
+    ps_destroy_pen(pen);
+
+    /* finally, close document in order to save everything and so */
+    ps_close_document(output);
+
+    if (stream != NULL)
+        drawing_stream_destroy(stream);
+    free(simplifiers);
+    free(x_values);
+    free(eval_values);
+
+    return 0;
+}
+
+/**
+ * Retrieves number of heatmap pixels along each axis - the pixels of plot area for raster output,
+ * DRAW_HEATMAP_RESOLUTION for PostScript
+ */
+int drawing_heatmap_resolution(const char* output_file)
+{
+    if (raster_format_of(output_file) != RASTER_FORMAT_NONE)
+        return (int)((DRAW_X_END - DRAW_X_BEGIN) * DRAW_RASTER_SIZE / RASTER_PAGE_SIZE + 0.5);
+
+    return DRAW_HEATMAP_RESOLUTION;
+}
+
+/**
+ * Draws axis labels and ticks of heatmap (no helper lines, they would cover it)
+ */
+static void drawing_heatmap_labels(ps_document* output, ps_pen* pen, const double* limits)
+{
+    double step_coef, val_coef, plot_step, plot_x;
+
+    step_coef = (DRAW_X_END - DRAW_X_BEGIN) / (limits[1] - limits[0]);
+    val_coef = (DRAW_Y_END - DRAW_Y_BEGIN) / (limits[3] - limits[2]);
+
+    ps_set_font(output, DRAW_LABEL_FONT_FAMILY, DRAW_LABEL_FONT_SIZE);
+    ps_set_line_width(output, 1);
+
+    ps_set_position(output, DRAW_X_BEGIN - 10, DRAW_Y_BEGIN - 20);
+    ps_print_text_val(output, limits[0], PARAMETER_FORMATTER);
+    plot_step = decide_line_step(limits[1] - limits[0]);
+    for (plot_x = limits[0] + plot_step; plot_x < limits[1] - plot_step / 2; plot_x += plot_step)
+    {
+        ps_pen_move(pen, DRAW_X_BEGIN + (plot_x - limits[0]) * step_coef, DRAW_Y_BEGIN - 5);
+        ps_pen_down(pen);
+        ps_pen_draw(pen, DRAW_X_BEGIN + (plot_x - limits[0]) * step_coef, DRAW_Y_BEGIN);
+        ps_pen_up(pen);
+
+        ps_set_position(output, DRAW_X_BEGIN + (plot_x - limits[0]) * step_coef - 10, DRAW_Y_BEGIN - 20);
+        ps_print_text_val(output, (fabs(plot_x) < plot_step / 2) ? 0 : plot_x, PARAMETER_FORMATTER);
+    }
+    ps_set_position(output, DRAW_X_END - 10, DRAW_Y_BEGIN - 20);
+    ps_print_text_val(output, limits[1], PARAMETER_FORMATTER);
+
+    ps_set_position(output, DRAW_X_BEGIN - 23, DRAW_Y_BEGIN - 6);
+    ps_print_text_val(output, limits[2], PARAMETER_FORMATTER);
+    plot_step = decide_line_step(limits[3] - limits[2]);
+    for (plot_x = limits[2] + plot_step; plot_x < limits[3] - plot_step / 2; plot_x += plot_step)
+    {
+        ps_pen_move(pen, DRAW_X_BEGIN - 5, DRAW_Y_BEGIN + (plot_x - limits[2]) * val_coef);
+        ps_pen_down(pen);
+        ps_pen_draw(pen, DRAW_X_BEGIN, DRAW_Y_BEGIN + (plot_x - limits[2]) * val_coef);
+        ps_pen_up(pen);
+
+        ps_set_position(output, DRAW_X_BEGIN - 23, DRAW_Y_BEGIN + (plot_x - limits[2]) * val_coef - 6);
+        ps_print_text_val(output, (fabs(plot_x) < plot_step / 2) ? 0 : plot_x, PARAMETER_FORMATTER);
+    }
+    ps_set_position(output, DRAW_X_BEGIN - 23, DRAW_Y_END - 6);
+    ps_print_text_val(output, limits[3], PARAMETER_FORMATTER);
+}
+
+/**
+ * Draws heatmap of evaluated function of x and y colorized by supplied colormap (with contours
+ * between "levels" value ranges, if positive) to supplied output file; the colorbar above it shows
+ * the value range; colorization rows are distributed to supplied thread pool (may be NULL)
+ * - the map is only read, so it may be drawn again with another colormap without evaluation
+ * Returns 0 on success, 1 if drawing was not possible (the reason is printed)
+ */
+int drawing_process_heatmap(const char* expression, const heat_map* map, int colormap, int levels, char* output_file,
+                            thread_pool* pool, const drawing_options* options)
+{
+    ps_document* output;
+    ps_pen* pen;
+    unsigned char* rgb;
+    unsigned char colorbar[HEAT_COLORMAP_SIZE * 3];
+    char* legend;
+
+    rgb = (unsigned char*)malloc((size_t)map->width * map->height * 3);
+    legend = (char*)malloc(strlen(expression) + 16);
+    if (rgb == NULL || legend == NULL)
+    {
+        printf("Unable to allocate memory for heatmap pixels, drawing is not possible\n");
+        free(rgb);
+        free(legend);
+        return 1;
+    }
+
+    output = drawing_prepare_output(output_file, RASTER_PAGE_SIZE, options, pool);
+    pen = (output != NULL) ? ps_create_pen(output, DRAW_X_BEGIN, DRAW_Y_BEGIN) : NULL;
+    if (pen == NULL)
+    {
+        if (output == NULL)
+            printf("Unable to create output file %s\n", output_file);
+        else
+        {
+            printf("Unable to allocate pen structure, drawing is not possible\n");
+            ps_close_document(output);
+        }
+        free(rgb);
+        free(legend);
+        return 1;
+    }
+
+    heat_colorize(map, colormap, levels, rgb, pool);
+    ps_image(output, DRAW_X_BEGIN, DRAW_Y_BEGIN, DRAW_X_END - DRAW_X_BEGIN, DRAW_Y_END - DRAW_Y_BEGIN, map->width, map->height, rgb);
+
+    /* frame with doubled thickness */
+    ps_set_line_width(output, 2);
+    ps_pen_move(pen, DRAW_X_BEGIN, DRAW_Y_BEGIN);
+    ps_pen_down(pen);
+    ps_pen_draw(pen, DRAW_X_END, DRAW_Y_BEGIN);
+    ps_pen_draw(pen, DRAW_X_END, DRAW_Y_END);
+    ps_pen_draw(pen, DRAW_X_BEGIN, DRAW_Y_END);
+    ps_pen_draw(pen, DRAW_X_BEGIN, DRAW_Y_BEGIN);
+    ps_pen_up(pen);
+
+    drawing_heatmap_labels(output, pen, map->limits);
+
+    /* colorbar with value range at the right side above the plot */
+    heat_colorbar(colormap, HEAT_COLORMAP_SIZE, colorbar);
+    ps_image(output, DRAW_X_END - DRAW_COLORBAR_WIDTH, DRAW_Y_END + 10, DRAW_COLORBAR_WIDTH, DRAW_COLORBAR_HEIGHT,
+             HEAT_COLORMAP_SIZE, 1, colorbar);
+    ps_set_position(output, DRAW_X_END - DRAW_COLORBAR_WIDTH - 50, DRAW_Y_END + 12);
+    ps_print_text_val(output, map->min, PARAMETER_FORMATTER);
+    ps_set_position(output, DRAW_X_END + 5, DRAW_Y_END + 12);
+    ps_print_text_val(output, map->max, PARAMETER_FORMATTER);
+
+    /* print out f(x, y) = EXPR */
+    sprintf(legend, "f(x, y) = %s", expression);
+    ps_set_position(output, DRAW_X_BEGIN, DRAW_Y_END + 12);
+    ps_print_text(output, legend);
+
+    ps_destroy_pen(pen);
+    ps_close_document(output);
+
+    free(rgb);
+    free(legend);
+
+    return 0;
+}
+
+/**
+ * Converts polyline of implicit curve to device coordinates and passes it to the next stage
+ * (context is drawing_transform structure)
+ */
+static void drawing_transform_sink(void* context, int command, double x, double y)
+{
+    drawing_transform* tr = (drawing_transform*)context;
+
+    tr->sink(tr->context, command, DRAW_X_BEGIN + (x - tr->limits[0]) * tr->step_coef, DRAW_Y_BEGIN + (y - tr->limits[2]) * tr->val_coef);
+}
+
+/**
+ * Draws implicit curve F(x, y) = 0 of compiled formula of variables x (variable 0) and y (variable 1)
+ * within supplied limits (xmin, xmax, ymin, ymax) to supplied output file; the curve is traced by
+ * quadtree of IMPL_COARSE_CELLS cells refined IMPL_MAX_DEPTH times (cell centers are examined too,
+ * if DRAW_FLAG_THOROUGH is set), evaluated using supplied thread pool (may be NULL), and its
+ * polylines are simplified and drawn; tracing statistics are stored to "stats"
+ * Returns 0 on success, 1 if drawing was not possible (the reason is printed)
+ */
+int drawing_process_implicit(const char* expression, rpn_program* prog, char* output_file, double* limits, thread_pool* pool,
+                             const drawing_options* options, impl_stats* stats)
+{
+    ps_document* output;
+    ps_pen* pen;
+    drawing_extremes extremes;
+    drawing_transform transform;
+    poly_simplifier* simplifier;
+    char* legend;
+    int res;
+
+    simplifier = (poly_simplifier*)malloc(sizeof(poly_simplifier));
+    legend = (char*)malloc(strlen(expression) + 16);
+    if (simplifier == NULL || legend == NULL)
+    {
+        printf("Unable to allocate memory for curve tracing, drawing is not possible\n");
+        free(simplifier);
+        free(legend);
+        return 1;
+    }
+
+    output = drawing_prepare_output(output_file, RASTER_PAGE_SIZE, options, pool);
+    pen = (output != NULL) ? ps_create_pen(output, DRAW_X_BEGIN, DRAW_Y_BEGIN) : NULL;
+    if (pen == NULL)
+    {
+        if (output == NULL)
+            printf("Unable to create output file %s\n", output_file);
+        else
+        {
+            printf("Unable to allocate pen structure, drawing is not possible\n");
+            ps_close_document(output);
+        }
+        free(simplifier);
+        free(legend);
+        return 1;
+    }
+
+    transform.limits = limits;
+    transform.step_coef = (DRAW_X_END - DRAW_X_BEGIN) / (limits[1] - limits[0]);
+    transform.val_coef = (DRAW_Y_END - DRAW_Y_BEGIN) / (limits[3] - limits[2]);
+    transform.sink = poly_simplify;
+    transform.context = simplifier;
+
+    /* there are no extremes of implicit curve to label */
+    extremes.min_x = limits[0];
+    extremes.max_x = limits[0];
+    extremes.min_value = NAN;
+    extremes.max_value = NAN;
+    drawing_draw_helper_lines(output, pen, limits, transform.step_coef, transform.val_coef, &extremes);
+
+    /* print out f(x, y) = 0: EXPR */
+    sprintf(legend, "f(x, y) = 0: %s", expression);
+    ps_set_position(output, DRAW_X_BEGIN, DRAW_Y_END + 12);
+    ps_print_text(output, legend);
+
+    /* the curve is drawn blue using doubled thickness */
+    ps_set_line_width(output, 2);
+    ps_set_color(output, drawing_palette[0][0], drawing_palette[0][1], drawing_palette[0][2]);
+
+    poly_simplifier_init(simplifier, POLY_SIMPLIFY_TOLERANCE, drawing_pen_sink, pen);
+    res = impl_trace(prog, limits, IMPL_COARSE_CELLS, IMPL_MAX_DEPTH, (options->flags & DRAW_FLAG_THOROUGH) ? IMPL_FLAG_CENTER_CHECK : 0,
+                     pool, drawing_transform_sink, &transform, stats);
+    if (res != 0)
+        printf("Unable to allocate memory for curve tracing, the curve is not drawn\n");
+
+    ps_destroy_pen(pen);
+    ps_close_document(output);
+
+    free(simplifier);
+    free(legend);
+
+    return res;
+}
@@ -1,18 +1,83 @@
-#ifndef MATHPARSER_DRAWING_H
-#define MATHPARSER_DRAWING_H
-
-#define PLOT_STEP_COEF 0.0001                   /* we will step by this percentage value when drawing */
-#define DRAW_X_BEGIN 25.0                       /* absolute X position of drawing start */
-#define DRAW_X_END   570.0                      /* absolute X position of drawing end */
-#define DRAW_Y_BEGIN 25.0                       /* absolute Y position of drawing start */
-#define DRAW_Y_END   570.0                      /* absolute Y position of drawing end*/
-
-#define PARAMETER_FORMATTER "%.4g"              /* formatter to use when printing number labels */
-#define DRAW_LABEL_FONT_FAMILY "Times-Roman"    /* implicit font family to use for labels */
-#define DRAW_LABEL_FONT_SIZE 10                 /* implicit label font size */
-
-#define DRAW_MIN_DERIVATIVE 0.01                /* minimum derivative difference to draw next line segment */
-
-void drawing_process_output(char* expr, char* output_file, c_stack* rpn_stack, double* limits);
-
-#endif
+#ifndef MATHPARSER_DRAWING_H
+#define MATHPARSER_DRAWING_H
+
+#define PLOT_STEP_COEF 0.0001                   /* we will step by this percentage value when drawing */
+#define DRAW_X_BEGIN 25.0                       /* absolute X position of drawing start */
+#define DRAW_X_END   570.0                      /* absolute X position of drawing end */
+#define DRAW_Y_BEGIN 25.0                       /* absolute Y position of drawing start */
+#define DRAW_Y_END   570.0                      /* absolute Y position of drawing end*/
+
+#define PARAMETER_FORMATTER "%.4g"              /* formatter to use when printing number labels */
+#define DRAW_LABEL_FONT_FAMILY "Times-Roman"    /* implicit font family to use for labels */
+#define DRAW_LABEL_FONT_SIZE 10                 /* implicit label font size */
+#define DRAW_LEGEND_LINE_HEIGHT 12              /* distance of lines of legend with more functions */
+#define DRAW_LEGEND_OFFSET 12.0                 /* height of the lowest legend line above the plot */
+#define DRAW_LEGEND_MAX_ROWS 16                 /* lines of legend in one column, more functions are laid out in more columns */
+#define DRAW_LEGEND_CHAR_WIDTH 7.5              /* maximum width of legend character (raster font), lines are cut to their column */
+#define DRAW_PAGE_HEIGHT 792.0                  /* height of PostScript page (Letter), legend has to fit in it */
+#define DRAW_PALETTE_SIZE 8                     /* number of function colors, more functions repeat them */
+#define DRAW_RASTER_SIZE 1024                   /* width and height of raster (PPM, PNG) output in pixels */
+#define DRAW_HEATMAP_RESOLUTION 300             /* width and height of heatmap in PostScript output in pixels */
+#define DRAW_COLORBAR_WIDTH 180.0               /* width of colorbar above heatmap */
+#define DRAW_COLORBAR_HEIGHT 10.0               /* height of colorbar above heatmap */
+
+#define DRAW_DEFAULT_SAMPLES 10001              /* implicit number of samples (1/PLOT_STEP_COEF segments) */
+#define DRAW_SAMPLE_CHUNK 1024                  /* number of samples evaluated by one task of parallel sampling */
+#define DRAW_STREAM_CHUNK (16*DRAW_SAMPLE_CHUNK) /* number of uniform samples held in memory at once */
+
+#define DRAW_ADAPTIVE_INITIAL 65                /* number of uniform samples adaptive sampling starts with */
+#define DRAW_ADAPTIVE_TOLERANCE 0.1             /* maximum deviation of segment midpoint from chord (in plot units) */
+#define DRAW_ADAPTIVE_MIN_WIDTH 0.01            /* segments narrower than this (in plot units) are not halved */
+#define DRAW_ADAPTIVE_MAX_SAMPLES 1048576       /* maximum evaluation budget of adaptive sampling (it holds all samples) */
+
+#define DRAW_DISCONTINUITY_SPAN 50.0            /* neighbouring samples farther apart vertically (in plot units) are checked for discontinuity */
+#define DRAW_DISCONTINUITY_JUMP 1.0             /* minimum jump (in plot units) remaining after bisection to lift the pen */
+#define DRAW_BISECTION_STEPS 60                 /* maximum number of bisection steps bracketing discontinuity */
+#define DRAW_CROSSING_PRECISION 0.01            /* precision of position (in plot units), where plot crosses value limits */
+
+#define DRAW_FLAG_ADAPTIVE 0x0001               /* sample adaptively, not uniformly */
+#define DRAW_FLAG_THOROUGH 0x0002               /* examine also cell centers while tracing implicit curve */
+#define DRAW_FLAG_COMPACT 0x0004                /* write compact PostScript output */
+
+/* output document (postscript.h) */
+struct _ps_document;
+
+/* evaluated heatmap (heatmap.h) */
+struct _heat_map;
+
+/* statistics of implicit curve tracing (implicit.h) */
+struct _impl_stats;
+
+/* plot drawing options */
+typedef struct
+{
+    int flags;                                  /* DRAW_FLAG_* */
+    long samples;                               /* number of uniform samples, or evaluation budget of adaptive sampling (0 = default) */
+    const char* creation_date;                  /* creation date written to output header (NULL = current time) */
+    int precision;                              /* decimals of coordinates of compact output (0 = default) */
+} drawing_options;
+
+/* positions and values of function minimum and maximum within value limits, labeled in plot */
+typedef struct
+{
+    double min_x, min_value;
+    double max_x, max_value;
+} drawing_extremes;
+
+void drawing_sample(rpn_program* prog, double* limits, double* x_values, double* eval_values, int valcount, thread_pool* pool, int* fmin, int* fmax);
+int drawing_sample_extremes(rpn_program* prog, double* limits, long valcount, thread_pool* pool, drawing_extremes* extremes);
+int drawing_sample_adaptive(rpn_program* prog, double* limits, double* x_values, double* eval_values, int max_count, thread_pool* pool, int* fmin, int* fmax);
+void drawing_trace(rpn_program* prog, double* limits, const double* x_values, const double* eval_values, int valcount,
+                   void (*sink)(void* context, int command, double x, double y), void* context);
+void drawing_legend_position(int count, int f, double* x, double* y);
+double drawing_page_height(int count);
+void drawing_print_legend(struct _ps_document* output, char** expressions, int count);
+int drawing_process_output(char** expressions, multi_program* functions, char* output_file, double* limits, thread_pool* pool,
+                           const drawing_options* options);
+int drawing_heatmap_resolution(const char* output_file);
+int drawing_process_heatmap(const char* expression, const struct _heat_map* map, int colormap, int levels, char* output_file,
+                            thread_pool* pool, const drawing_options* options);
+int drawing_process_implicit(const char* expression, rpn_program* prog, char* output_file, double* limits, thread_pool* pool,
+                             const drawing_options* options, struct _impl_stats* stats);
+
+#endif
@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stack.h"
+#include "rpn.h"
+#include "main.h"
+#include "program.h"
+#include "pool.h"
+#include "grid.h"
+
+/*
+ * The grid is evaluated in tiles of GRID_TILE_SIZE consecutive samples (in row-major order,
+ * the last axis changes fastest). Every tile is one task for thread pool; it fills arrays
+ * of coordinates and evaluates them using block evaluator, which applies every instruction
+ * to a run of samples along the innermost axis at once.
+ */
+
+/* shared state of one grid evaluation */
+typedef struct
+{
+    rpn_program* prog;
+    const grid_spec* grid;
+    double* axis_values[GRID_MAX_DIMENSIONS];   /* precomputed coordinates of every axis */
+    long sample_count;
+    double* out;
+} grid_context;
+
+/**
+ * Retrieves total number of grid samples, or -1 if the grid is not valid
+ */
+long grid_sample_count(const grid_spec* grid)
+{
+    long count;
+    int d;
+
+    if (grid->dimensions < 1 || grid->dimensions > GRID_MAX_DIMENSIONS)
+        return -1;
+
+    count = 1;
+    for (d = 0; d < grid->dimensions; d++)
+    {
+        if (grid->axes[d].count < 1)
+            return -1;
+        count *= grid->axes[d].count;
+    }
+
+    return count;
+}
+
+/**
+ * Finds variable name, which is listed more than once (every variable needs its own axis)
+ * Returns index of its second occurrence, or -1 if all names differ
+ */
+int grid_find_duplicate(const char** names, int count)
+{
+    int i, j;
+
+    for (i = 1; i < count; i++)
+    {
+        for (j = 0; j < i; j++)
+        {
+            if (strcmp(names[i], names[j]) == 0)
+                return i;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * Evaluates one tile of grid - task routine for thread pool
+ */
+static void grid_evaluate_tile(void* arg, int tile)
+{
+    grid_context* ctx = (grid_context*)arg;
+    double coordinates[GRID_MAX_DIMENSIONS][GRID_TILE_SIZE];
+    double* variables[GRID_MAX_DIMENSIONS];
+    int index[GRID_MAX_DIMENSIONS];
+    const grid_axis* axes = ctx->grid->axes;
+    int inner = ctx->grid->dimensions - 1;
+    int used = (int)ctx->prog->variable_count;
+    long first, rest;
+    double value;
+    int d, i, k, n, run;
+
+    first = (long)tile * GRID_TILE_SIZE;
+    n = (ctx->sample_count - first < GRID_TILE_SIZE) ? (int)(ctx->sample_count - first) : GRID_TILE_SIZE;
+
+    /* decompose index of the first sample to axis indices */
+    rest = first;
+    for (d = inner; d >= 0; d--)
+    {
+        index[d] = (int)(rest % axes[d].count);
+        rest /= axes[d].count;
+    }
+
+    /* fill coordinates of variables used by program, row by row (row is a run along the innermost axis) */
+    for (i = 0; i < n; i += run)
+    {
+        run = axes[inner].count - index[inner];
+        if (run > n - i)
+            run = n - i;
+
+        for (d = 0; d < used; d++)
+        {
+            if (d == inner)
+                memcpy(&coordinates[d][i], ctx->axis_values[d] + index[d], run * sizeof(double));
+            else
+            {
+                value = ctx->axis_values[d][index[d]];
+                for (k = 0; k < run; k++)
+                    coordinates[d][i + k] = value;
+            }
+        }
+
+        /* move to the beginning of the next row */
+        index[inner] = 0;
+        for (d = inner - 1; d >= 0; d--)
+        {
+            if (++index[d] < axes[d].count)
+                break;
+            index[d] = 0;
+        }
+    }
+
+    for (d = 0; d < used; d++)
+        variables[d] = coordinates[d];
+
+    prog_evaluate_block(ctx->prog, variables, n, ctx->out + first);
+}
+
+/**
+ * Evaluates program in every point of grid, variable N takes values of axis N; results are
+ * stored to "out" in row-major order (the last axis changes fastest)
+ * - tiles are distributed to supplied thread pool (NULL means serial evaluation)
+ * returns 0 on success, 1 if the grid is not valid or has less axes than program variables
+ */
+int grid_evaluate(rpn_program* prog, const grid_spec* grid, double* out, thread_pool* pool)
+{
+    grid_context ctx;
+    long tiles;
+    int d, i, res;
+
+    ctx.sample_count = grid_sample_count(grid);
+    if (ctx.sample_count < 0 || (int)prog->variable_count > grid->dimensions)
+        return 1;
+
+    ctx.prog = prog;
+    ctx.grid = grid;
+    ctx.out = out;
+
+    /* coordinates are computed once, not in every tile (and not accumulated, so the last one is exactly max) */
+    res = 0;
+    for (d = 0; d < grid->dimensions; d++)
+    {
+        ctx.axis_values[d] = (double*)malloc(sizeof(double) * grid->axes[d].count);
+        if (ctx.axis_values[d] == NULL)
+        {
+            res = 1;
+            continue;
+        }
+
+        for (i = 0; i < grid->axes[d].count; i++)
+        {
+            if (grid->axes[d].count > 1)
+                ctx.axis_values[d][i] = grid->axes[d].min + (grid->axes[d].max - grid->axes[d].min) * i / (grid->axes[d].count - 1);
+            else
+                ctx.axis_values[d][i] = grid->axes[d].min;
+        }
+    }
+
+    if (res == 0)
+    {
+        tiles = (ctx.sample_count + GRID_TILE_SIZE - 1) / GRID_TILE_SIZE;
+        pool_run(pool, grid_evaluate_tile, &ctx, (int)tiles);
+    }
+
+    for (d = 0; d < grid->dimensions; d++)
+        free(ctx.axis_values[d]);
+
+    return res;
+}
@@ -0,0 +1,26 @@
+#ifndef MATHPARSER_GRID_H
+#define MATHPARSER_GRID_H
+
+#define GRID_MAX_DIMENSIONS 8           /* maximum number of grid axes (and variables) */
+#define GRID_TILE_SIZE 1024             /* samples evaluated by one task; with coordinates fits L1/L2 cache */
+
+/* one grid axis - "count" samples evenly distributed over [min, max] */
+typedef struct
+{
+    double min;
+    double max;
+    int count;
+} grid_axis;
+
+/* N-dimensional grid; axis N holds values of variable N, the last axis is the innermost one */
+typedef struct
+{
+    int dimensions;
+    grid_axis axes[GRID_MAX_DIMENSIONS];
+} grid_spec;
+
+long grid_sample_count(const grid_spec* grid);
+int grid_find_duplicate(const char** names, int count);
+int grid_evaluate(rpn_program* prog, const grid_spec* grid, double* out, thread_pool* pool);
+
+#endif
@@ -0,0 +1,292 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "stack.h"
+#include "rpn.h"
+#include "program.h"
+#include "pool.h"
+#include "grid.h"
+#include "heatmap.h"
+
+/*
+ * Heatmap values are evaluated by the grid module - the pixel centers form 2D grid with y as the
+ * outer axis and x as the inner one, so the rows of image are runs of block evaluator, and tiles
+ * of consecutive pixels are distributed to thread pool. The values are kept, so changing only the
+ * colormap (or contour levels) does not evaluate anything, only colorization runs again.
+ *
+ * Colormap is linear interpolation between its stops, sampled to lookup table once per
+ * colorization. Contours are pixels, whose value falls to other of "levels" equal value ranges
+ * than the value of pixel on the right or below.
+ */
+
+/* colormap stops (red, green, blue), evenly distributed over the value range */
+static const double heat_stops[][3] =
+{
+    /* viridis */
+    {0.267, 0.005, 0.329}, {0.283, 0.141, 0.458}, {0.254, 0.265, 0.530}, {0.207, 0.372, 0.553},
+    {0.164, 0.471, 0.558}, {0.128, 0.567, 0.551}, {0.135, 0.659, 0.518}, {0.267, 0.749, 0.441},
+    {0.478, 0.821, 0.318}, {0.741, 0.873, 0.150}, {0.993, 0.906, 0.144},
+    /* gray */
+    {0, 0, 0}, {1, 1, 1},
+    /* hot */
+    {0, 0, 0}, {0.9, 0, 0}, {1, 0.9, 0}, {1, 1, 1},
+    /* jet */
+    {0, 0, 0.5}, {0, 0, 1}, {0, 0.5, 1}, {0, 1, 1}, {0.5, 1, 0.5}, {1, 1, 0}, {1, 0.5, 0}, {1, 0, 0}, {0.5, 0, 0},
+    /* coolwarm */
+    {0.230, 0.299, 0.754}, {0.865, 0.865, 0.865}, {0.706, 0.016, 0.150}
+};
+
+/* colormap - name and range of its stops */
+typedef struct
+{
+    const char* name;
+    int first;
+    int count;
+} heat_colormap;
+
+/* known colormaps, the first one is HEAT_DEFAULT_COLORMAP */
+static const heat_colormap heat_colormaps[] =
+{
+    { "viridis", 0, 11 },
+    { "gray", 11, 2 },
+    { "hot", 13, 4 },
+    { "jet", 17, 9 },
+    { "coolwarm", 26, 3 }
+};
+
+/* color of pixels, whose value is not finite (i.e. out of function domain) */
+static const unsigned char heat_invalid_color[3] = { 255, 255, 255 };
+
+/* color of contour pixels */
+static const unsigned char heat_contour_color[3] = { 0, 0, 0 };
+
+/* shared state of one colorization */
+typedef struct
+{
+    const heat_map* map;
+    unsigned char lut[HEAT_COLORMAP_SIZE][3];
+    int levels;
+    unsigned char* rgb;
+} heat_coloring;
+
+/**
+ * Finds colormap by name, returns its index or -1 if there's no such colormap
+ */
+int heat_find_colormap(const char* name)
+{
+    int i;
+
+    for (i = 0; i < (int)(sizeof(heat_colormaps) / sizeof(heat_colormap)); i++)
+    {
+        if (strcmp(heat_colormaps[i].name, name) == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+/**
+ * Retrieves name of colormap with supplied index, or NULL if there's no such colormap (may be
+ * used to list them all)
+ */
+const char* heat_colormap_name(int colormap)
+{
+    if (colormap < 0 || colormap >= (int)(sizeof(heat_colormaps) / sizeof(heat_colormap)))
+        return NULL;
+    return heat_colormaps[colormap].name;
+}
+
+/**
+ * Evaluates program of variables y (variable 0) and x (variable 1) in centers of width x height
+ * pixels covering supplied limits (xmin, xmax, ymin, ymax); tiles are distributed to supplied
+ * thread pool (may be NULL)
+ * Returns evaluated values, or NULL if there's not enough memory or the program has more variables
+ */
+heat_map* heat_evaluate(rpn_program* prog, const double* limits, int width, int height, thread_pool* pool)
+{
+    heat_map* map;
+    grid_spec grid;
+    long count, i;
+    double pixel_width, pixel_height;
+
+    if (width < 1 || height < 1)
+        return NULL;
+
+    map = (heat_map*)malloc(sizeof(heat_map));
+    if (map == NULL)
+        return NULL;
+
+    map->width = width;
+    map->height = height;
+    memcpy(map->limits, limits, sizeof(map->limits));
+    map->values = (double*)malloc(sizeof(double) * width * height);
+    if (map->values == NULL)
+    {
+        free(map);
+        return NULL;
+    }
+
+    /* pixel centers - y goes from the top row down */
+    pixel_width = (limits[1] - limits[0]) / width;
+    pixel_height = (limits[3] - limits[2]) / height;
+    grid.dimensions = 2;
+    grid.axes[0].min = limits[3] - pixel_height / 2;
+    grid.axes[0].max = limits[2] + pixel_height / 2;
+    grid.axes[0].count = height;
+    grid.axes[1].min = limits[0] + pixel_width / 2;
+    grid.axes[1].max = limits[1] - pixel_width / 2;
+    grid.axes[1].count = width;
+
+    if (grid_evaluate(prog, &grid, map->values, pool) != 0)
+    {
+        heat_destroy(map);
+        return NULL;
+    }
+
+    /* range of finite values, colormap is spread over it */
+    map->min = 0;
+    map->max = 0;
+    count = (long)width * height;
+    for (i = 0; i < count && map->values[i] - map->values[i] != 0; i++)
+        ;
+    if (i < count)
+    {
+        map->min = map->max = map->values[i];
+        for (; i < count; i++)
+        {
+            if (map->values[i] - map->values[i] != 0)
+                continue;
+            if (map->values[i] < map->min)
+                map->min = map->values[i];
+            else if (map->values[i] > map->max)
+                map->max = map->values[i];
+        }
+    }
+
+    return map;
+}
+
+/**
+ * Destroys evaluated values
+ */
+void heat_destroy(heat_map* map)
+{
+    free(map->values);
+    free(map);
+}
+
+/**
+ * Retrieves color of colormap at supplied position (0..1)
+ */
+static void heat_color(int colormap, double t, unsigned char* rgb)
+{
+    const heat_colormap* cmap = &heat_colormaps[colormap];
+    double pos, frac;
+    int stop, c;
+
+    pos = t * (cmap->count - 1);
+    stop = (int)pos;
+    if (stop >= cmap->count - 1)
+        stop = cmap->count - 2;
+    frac = pos - stop;
+
+    for (c = 0; c < 3; c++)
+        rgb[c] = (unsigned char)(255 * (heat_stops[cmap->first + stop][c] * (1 - frac) + heat_stops[cmap->first + stop + 1][c] * frac) + 0.5);
+}
+
+/**
+ * Retrieves lookup table index of value, or -1 if the value is not finite
+ */
+static int heat_index(const heat_map* map, double value)
+{
+    double t;
+
+    if (value - value != 0)
+        return -1;
+
+    t = (map->max > map->min) ? (value - map->min) / (map->max - map->min) : 0.5;
+    return (int)(t * (HEAT_COLORMAP_SIZE - 1) + 0.5);
+}
+
+/**
+ * Colorizes one band of rows (task routine)
+ */
+static void heat_colorize_rows(void* arg, int task)
+{
+    heat_coloring* ctx = (heat_coloring*)arg;
+    const heat_map* map = ctx->map;
+    int first = task * HEAT_ROWS_PER_TASK;
+    int last = first + HEAT_ROWS_PER_TASK;
+    int row, col, index, level, neighbour;
+    const double* values;
+    unsigned char* out;
+
+    if (last > map->height)
+        last = map->height;
+
+    for (row = first; row < last; row++)
+    {
+        values = map->values + (long)row * map->width;
+        out = ctx->rgb + (long)row * map->width * 3;
+
+        for (col = 0; col < map->width; col++, out += 3)
+        {
+            index = heat_index(map, values[col]);
+            if (index < 0)
+            {
+                memcpy(out, heat_invalid_color, 3);
+                continue;
+            }
+            memcpy(out, ctx->lut[index], 3);
+
+            if (ctx->levels <= 0)
+                continue;
+
+            /* contour passes between pixels of different levels (index is 0..SIZE-1 in both) */
+            level = index * ctx->levels / HEAT_COLORMAP_SIZE;
+            if (col + 1 < map->width)
+            {
+                neighbour = heat_index(map, values[col + 1]);
+                if (neighbour >= 0 && neighbour * ctx->levels / HEAT_COLORMAP_SIZE != level)
+                    memcpy(out, heat_contour_color, 3);
+            }
+            if (row + 1 < map->height)
+            {
+                neighbour = heat_index(map, values[col + map->width]);
+                if (neighbour >= 0 && neighbour * ctx->levels / HEAT_COLORMAP_SIZE != level)
+                    memcpy(out, heat_contour_color, 3);
+            }
+        }
+    }
+}
+
+/**
+ * Colorizes evaluated values by supplied colormap to RGB pixels (width * height * 3 bytes, the top
+ * row first); if "levels" is positive, the value range is split to that many parts and contours
+ * between them are drawn; rows are distributed to supplied thread pool (may be NULL)
+ */
+void heat_colorize(const heat_map* map, int colormap, int levels, unsigned char* rgb, thread_pool* pool)
+{
+    heat_coloring ctx;
+    int i;
+
+    ctx.map = map;
+    ctx.levels = levels;
+    ctx.rgb = rgb;
+    for (i = 0; i < HEAT_COLORMAP_SIZE; i++)
+        heat_color(colormap, (double)i / (HEAT_COLORMAP_SIZE - 1), ctx.lut[i]);
+
+    pool_run(pool, heat_colorize_rows, &ctx, (map->height + HEAT_ROWS_PER_TASK - 1) / HEAT_ROWS_PER_TASK);
+}
+
+/**
+ * Fills colorbar - row of "length" RGB pixels going through the whole colormap
+ */
+void heat_colorbar(int colormap, int length, unsigned char* rgb)
+{
+    int i;
+
+    for (i = 0; i < length; i++)
+        heat_color(colormap, (length > 1) ? (double)i / (length - 1) : 0.5, rgb + i * 3);
+}
@@ -0,0 +1,27 @@
+#ifndef MATHPARSER_HEATMAP_H
+#define MATHPARSER_HEATMAP_H
+
+#define HEAT_COLORMAP_SIZE 256          /* number of colors of colormap lookup table */
+#define HEAT_ROWS_PER_TASK 16           /* number of rows colorized by one task */
+#define HEAT_DEFAULT_COLORMAP "viridis" /* colormap used when none is supplied */
+
+/* values of function of x and y evaluated in pixel centers of rectangular area; they are
+ * evaluated once and may be colorized any number of times */
+typedef struct _heat_map
+{
+    int width, height;                  /* number of pixels */
+    double limits[4];                   /* xmin, xmax, ymin, ymax of the area */
+    double* values;                     /* row-major values, the top row (ymax) first */
+    double min, max;                    /* range of finite values (both 0 if there's none) */
+} heat_map;
+
+int heat_find_colormap(const char* name);
+const char* heat_colormap_name(int colormap);
+
+heat_map* heat_evaluate(rpn_program* prog, const double* limits, int width, int height, thread_pool* pool);
+void heat_destroy(heat_map* map);
+
+void heat_colorize(const heat_map* map, int colormap, int levels, unsigned char* rgb, thread_pool* pool);
+void heat_colorbar(int colormap, int length, unsigned char* rgb);
+
+#endif
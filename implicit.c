@@ -0,0 +1,549 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stack.h"
+#include "rpn.h"
+#include "program.h"
+#include "pool.h"
+#include "polyline.h"
+#include "implicit.h"
+
+/*
+ * Implicit curve F(x, y) = 0 is traced on quadtree of cells. The function is evaluated in corners
+ * of coarse grid first; only cells, whose corners have different signs (so the curve passes
+ * through them), are split to four, and their children are examined the same way, until the
+ * finest level is reached. With IMPL_FLAG_CENTER_CHECK, the center of cell is evaluated too,
+ * so also the curves entering and leaving the cell through the same edge are found.
+ * All new points of one level are evaluated at once by block evaluator, split to tasks of
+ * IMPL_BLOCK points.
+ *
+ * The finest cells are processed by marching squares - the curve crosses edges with different
+ * signs at their ends (at linearly interpolated position), and the crossings are connected by
+ * line segments. Both cells sharing an edge compute the same crossing from the same values, so
+ * the segments are chained to polylines by the edges their ends lay on.
+ */
+
+/* quadtree cell, in units of the finest cells; corner values go counter-clockwise from the lower left */
+typedef struct
+{
+    long i, j;
+    long size;
+    double v[4];
+} impl_cell;
+
+/* line segment of curve; its ends lay on edges of the finest grid identified by keys */
+typedef struct
+{
+    long key[2];
+    double x[2], y[2];
+    int used;
+} impl_segment;
+
+/* entry of edge table - the segment ends laying on the edge */
+typedef struct
+{
+    long key;                           /* -1 for empty entry */
+    long ends[2];                       /* segment index * 2 + end, -1 if there's none */
+} impl_edge;
+
+/* points evaluated at once */
+typedef struct
+{
+    rpn_program* prog;
+    double* x;
+    double* y;
+    double* out;
+    long count;
+    long capacity;
+} impl_batch;
+
+/* state of one tracing */
+typedef struct
+{
+    const double* limits;
+    long resolution;                    /* number of the finest cells along each axis */
+    impl_batch batch;
+
+    impl_segment* segments;
+    long segment_count;
+    long segment_capacity;
+} impl_tracer;
+
+/**
+ * Adds point to be evaluated, returns 0 on success, 1 if there's not enough memory
+ */
+static int impl_batch_add(impl_batch* batch, double x, double y)
+{
+    long capacity;
+    double *grown_x, *grown_y, *grown_out;
+
+    if (batch->count == batch->capacity)
+    {
+        capacity = (batch->capacity > 0) ? batch->capacity * 2 : IMPL_BLOCK;
+        grown_x = (double*)realloc(batch->x, sizeof(double) * capacity);
+        if (grown_x != NULL)
+            batch->x = grown_x;
+        grown_y = (double*)realloc(batch->y, sizeof(double) * capacity);
+        if (grown_y != NULL)
+            batch->y = grown_y;
+        grown_out = (double*)realloc(batch->out, sizeof(double) * capacity);
+        if (grown_out != NULL)
+            batch->out = grown_out;
+        if (grown_x == NULL || grown_y == NULL || grown_out == NULL)
+            return 1;
+        batch->capacity = capacity;
+    }
+
+    batch->x[batch->count] = x;
+    batch->y[batch->count] = y;
+    batch->count++;
+    return 0;
+}
+
+/**
+ * Evaluates one block of points (task routine)
+ */
+static void impl_batch_task(void* arg, int index)
+{
+    impl_batch* batch = (impl_batch*)arg;
+    long first = (long)index * IMPL_BLOCK;
+    int n = (batch->count - first < IMPL_BLOCK) ? (int)(batch->count - first) : IMPL_BLOCK;
+    double* variables[2];
+
+    variables[0] = batch->x + first;
+    variables[1] = batch->y + first;
+    prog_evaluate_block(batch->prog, variables, n, batch->out + first);
+}
+
+/**
+ * Evaluates all added points using supplied thread pool (may be NULL)
+ */
+static void impl_batch_run(impl_batch* batch, thread_pool* pool, impl_stats* stats)
+{
+    pool_run(pool, impl_batch_task, batch, (int)((batch->count + IMPL_BLOCK - 1) / IMPL_BLOCK));
+    stats->points += batch->count;
+}
+
+/**
+ * Adds point given by position on the finest grid to be evaluated
+ */
+static int impl_add_grid_point(impl_tracer* tr, long i, long j)
+{
+    const double* limits = tr->limits;
+
+    return impl_batch_add(&tr->batch, limits[0] + (limits[1] - limits[0]) * i / tr->resolution,
+                          limits[2] + (limits[3] - limits[2]) * j / tr->resolution);
+}
+
+/**
+ * Decides, whether the curve passes through the cell - values of corners (and center, if supplied)
+ * have different signs; infinite values count by their sign (the curve often meets the edge of
+ * domain there), undefined ones are left out
+ */
+static int impl_sign_change(const impl_cell* cell, const double* center)
+{
+    int positive = 0, negative = 0, k;
+
+    for (k = 0; k < 4; k++)
+    {
+        if (cell->v[k] != cell->v[k])
+            continue;
+        if (cell->v[k] > 0)
+            positive = 1;
+        else
+            negative = 1;
+    }
+
+    if (center != NULL && *center == *center)
+    {
+        if (*center > 0)
+            positive = 1;
+        else
+            negative = 1;
+    }
+
+    return positive && negative;
+}
+
+/**
+ * Adds segment connecting two edge crossings; returns 0 on success, 1 if there's not enough memory
+ */
+static int impl_add_segment(impl_tracer* tr, const long* keys, const double* xs, const double* ys, int a, int b)
+{
+    impl_segment* grown;
+    impl_segment* seg;
+    long capacity;
+
+    if (tr->segment_count == tr->segment_capacity)
+    {
+        capacity = (tr->segment_capacity > 0) ? tr->segment_capacity * 2 : IMPL_BLOCK;
+        grown = (impl_segment*)realloc(tr->segments, sizeof(impl_segment) * capacity);
+        if (grown == NULL)
+            return 1;
+        tr->segments = grown;
+        tr->segment_capacity = capacity;
+    }
+
+    seg = &tr->segments[tr->segment_count++];
+    seg->key[0] = keys[a];
+    seg->key[1] = keys[b];
+    seg->x[0] = xs[a];
+    seg->y[0] = ys[a];
+    seg->x[1] = xs[b];
+    seg->y[1] = ys[b];
+    seg->used = 0;
+    return 0;
+}
+
+/**
+ * Extracts segments of curve passing through the finest cell (marching squares)
+ * Returns 0 on success, 1 if there's not enough memory
+ */
+static int impl_march(impl_tracer* tr, const impl_cell* cell)
+{
+    /* edges go from lower to higher grid point: bottom, right, top, left (corner indices) */
+    static const int edge_from[4] = { 0, 1, 3, 0 };
+    static const int edge_to[4] = { 1, 2, 2, 3 };
+    const double* limits = tr->limits;
+    long keys[4], edge_keys[4];
+    double xs[4], ys[4], t, center, va, vb;
+    long row = tr->resolution + 1;
+    int count, e, res;
+
+    /* horizontal edge is identified by its left point, vertical by its lower point */
+    edge_keys[0] = 2 * (cell->j * row + cell->i);
+    edge_keys[1] = 2 * (cell->j * row + cell->i + 1) + 1;
+    edge_keys[2] = 2 * ((cell->j + 1) * row + cell->i);
+    edge_keys[3] = 2 * (cell->j * row + cell->i) + 1;
+
+    count = 0;
+    for (e = 0; e < 4; e++)
+    {
+        va = cell->v[edge_from[e]];
+        vb = cell->v[edge_to[e]];
+        if (va != va || vb != vb || (va > 0) == (vb > 0))
+            continue;
+
+        /* the same interpolation from the lower point in both cells sharing the edge; the crossing
+         * is at the finite end, if the other one is infinite */
+        if (va - va != 0)
+            t = (vb - vb != 0) ? 0.5 : 1;
+        else if (vb - vb != 0)
+            t = 0;
+        else
+            t = va / (va - vb);
+        keys[count] = edge_keys[e];
+        if (e == 0 || e == 2)
+        {
+            xs[count] = limits[0] + (limits[1] - limits[0]) * (cell->i + t) / tr->resolution;
+            ys[count] = limits[2] + (limits[3] - limits[2]) * (cell->j + (e == 2 ? 1 : 0)) / tr->resolution;
+        }
+        else
+        {
+            xs[count] = limits[0] + (limits[1] - limits[0]) * (cell->i + (e == 1 ? 1 : 0)) / tr->resolution;
+            ys[count] = limits[2] + (limits[3] - limits[2]) * (cell->j + t) / tr->resolution;
+        }
+        count++;
+    }
+
+    if (count == 2)
+        return impl_add_segment(tr, keys, xs, ys, 0, 1);
+    if (count < 4)
+        return 0;
+
+    /* saddle - if the center has the sign of lower left and upper right corners, they are connected,
+     * and the curve cuts off the other two corners; otherwise it cuts off these two */
+    center = (cell->v[0] + cell->v[1] + cell->v[2] + cell->v[3]) / 4;
+    if ((center > 0) == (cell->v[0] > 0))
+    {
+        res = impl_add_segment(tr, keys, xs, ys, 0, 1);
+        res |= impl_add_segment(tr, keys, xs, ys, 2, 3);
+    }
+    else
+    {
+        res = impl_add_segment(tr, keys, xs, ys, 3, 0);
+        res |= impl_add_segment(tr, keys, xs, ys, 1, 2);
+    }
+    return res;
+}
+
+/**
+ * Finds entry of edge with supplied key in edge table, or the empty entry it belongs to
+ */
+static impl_edge* impl_find_edge(impl_edge* table, unsigned long mask, long key)
+{
+    unsigned long slot = ((unsigned long)key * 2654435761UL) & mask;
+
+    while (table[slot].key != -1 && table[slot].key != key)
+        slot = (slot + 1) & mask;
+
+    return &table[slot];
+}
+
+/**
+ * Retrieves the other segment end laying on the same edge as supplied end (segment * 2 + end),
+ * or -1 if there's none
+ */
+static long impl_partner(impl_tracer* tr, impl_edge* table, unsigned long mask, long end)
+{
+    impl_edge* edge = impl_find_edge(table, mask, tr->segments[end / 2].key[end % 2]);
+
+    return (edge->ends[0] == end) ? edge->ends[1] : edge->ends[0];
+}
+
+/**
+ * Chains segments sharing their ends to polylines and passes them to sink
+ * Returns 0 on success, 1 if there's not enough memory
+ */
+static int impl_chain(impl_tracer* tr, poly_sink sink, void* context, impl_stats* stats)
+{
+    impl_edge* table;
+    impl_edge* edge;
+    impl_segment* seg;
+    unsigned long size, mask;
+    long s, k, end, other, start, steps;
+
+    for (size = 16; size < (unsigned long)tr->segment_count * 4; size *= 2)
+        ;
+    mask = size - 1;
+
+    table = (impl_edge*)malloc(sizeof(impl_edge) * size);
+    if (table == NULL)
+        return 1;
+    for (k = 0; k < (long)size; k++)
+    {
+        table[k].key = -1;
+        table[k].ends[0] = table[k].ends[1] = -1;
+    }
+
+    for (s = 0; s < tr->segment_count * 2; s++)
+    {
+        edge = impl_find_edge(table, mask, tr->segments[s / 2].key[s % 2]);
+        edge->key = tr->segments[s / 2].key[s % 2];
+        if (edge->ends[0] == -1)
+            edge->ends[0] = s;
+        else if (edge->ends[1] == -1)
+            edge->ends[1] = s;
+    }
+
+    for (s = 0; s < tr->segment_count; s++)
+    {
+        if (tr->segments[s].used)
+            continue;
+
+        /* walk back to the beginning of the chain (or around the loop) */
+        start = s;
+        end = s * 2;
+        for (steps = 0; steps < tr->segment_count; steps++)
+        {
+            other = impl_partner(tr, table, mask, end);
+            if (other < 0 || other / 2 == s || tr->segments[other / 2].used)
+                break;
+            start = other / 2;
+            end = start * 2 + 1 - other % 2;
+        }
+
+        /* and draw the chain forwards - every segment adds its end, which is not shared with the previous one */
+        seg = &tr->segments[start];
+        seg->used = 1;
+        sink(context, POLY_MOVE, seg->x[end % 2], seg->y[end % 2]);
+        sink(context, POLY_DRAW, seg->x[1 - end % 2], seg->y[1 - end % 2]);
+        end = start * 2 + 1 - end % 2;
+        for (;;)
+        {
+            other = impl_partner(tr, table, mask, end);
+            if (other < 0 || tr->segments[other / 2].used)
+                break;
+            seg = &tr->segments[other / 2];
+            seg->used = 1;
+            sink(context, POLY_DRAW, seg->x[1 - other % 2], seg->y[1 - other % 2]);
+            end = other - other % 2 + 1 - other % 2;
+        }
+        sink(context, POLY_END, 0, 0);
+        stats->paths++;
+    }
+
+    free(table);
+    return 0;
+}
+
+/**
+ * Traces implicit curve F(x, y) = 0 of program of variables x (variable 0) and y (variable 1) within
+ * supplied limits (xmin, xmax, ymin, ymax); starts with coarse x coarse grid, cells the curve passes
+ * through are halved "depth" times; flags are IMPL_FLAG_*; points are evaluated using supplied
+ * thread pool (may be NULL); polylines of curve (in function coordinates) are passed to supplied sink
+ * and statistics are stored to "stats"
+ * Returns 0 on success, 1 if the grid is not valid or there's not enough memory
+ */
+int impl_trace(rpn_program* prog, const double* limits, int coarse, int depth, int flags, thread_pool* pool,
+               poly_sink sink, void* context, impl_stats* stats)
+{
+    impl_tracer tr;
+    impl_cell *cells, *children, *cell, *child;
+    double* centers;
+    long count, child_count, k, base, i, j, half;
+    int level, res, refine;
+
+    memset(stats, 0, sizeof(impl_stats));
+    if (coarse < 1 || depth < 0 || depth > 30 || ((long)coarse << depth) > IMPL_MAX_RESOLUTION)
+        return 1;
+
+    tr.limits = limits;
+    tr.resolution = (long)coarse << depth;
+    tr.batch.prog = prog;
+    tr.batch.x = tr.batch.y = tr.batch.out = NULL;
+    tr.batch.count = tr.batch.capacity = 0;
+    tr.segments = NULL;
+    tr.segment_count = tr.segment_capacity = 0;
+
+    cells = NULL;
+    children = NULL;
+    centers = NULL;
+    res = 0;
+
+    /* corners of coarse grid */
+    for (j = 0; j <= coarse && res == 0; j++)
+    {
+        for (i = 0; i <= coarse && res == 0; i++)
+            res = impl_add_grid_point(&tr, i << depth, j << depth);
+    }
+
+    count = (long)coarse * coarse;
+    cells = (impl_cell*)malloc(sizeof(impl_cell) * count);
+    if (res != 0 || cells == NULL)
+        res = 1;
+    else
+    {
+        impl_batch_run(&tr.batch, pool, stats);
+        for (k = 0; k < count; k++)
+        {
+            i = k % coarse;
+            j = k / coarse;
+            cell = &cells[k];
+            cell->i = i << depth;
+            cell->j = j << depth;
+            cell->size = 1L << depth;
+            cell->v[0] = tr.batch.out[j * (coarse + 1) + i];
+            cell->v[1] = tr.batch.out[j * (coarse + 1) + i + 1];
+            cell->v[2] = tr.batch.out[(j + 1) * (coarse + 1) + i + 1];
+            cell->v[3] = tr.batch.out[(j + 1) * (coarse + 1) + i];
+        }
+        stats->cells += count;
+    }
+
+    for (level = 0; level < depth && res == 0; level++)
+    {
+        half = 1L << (depth - level - 1);
+
+        /* centers of all cells, if they are checked too */
+        free(centers);
+        centers = NULL;
+        if (flags & IMPL_FLAG_CENTER_CHECK)
+        {
+            tr.batch.count = 0;
+            for (k = 0; k < count && res == 0; k++)
+                res = impl_add_grid_point(&tr, cells[k].i + half, cells[k].j + half);
+            centers = (double*)malloc(sizeof(double) * (count > 0 ? count : 1));
+            if (res != 0 || centers == NULL)
+            {
+                res = 1;
+                break;
+            }
+            impl_batch_run(&tr.batch, pool, stats);
+            memcpy(centers, tr.batch.out, sizeof(double) * count);
+        }
+
+        /* edge midpoints and centers of cells the curve passes through */
+        tr.batch.count = 0;
+        child_count = 0;
+        for (k = 0; k < count && res == 0; k++)
+        {
+            cell = &cells[k];
+            if (!impl_sign_change(cell, (centers != NULL) ? &centers[k] : NULL))
+                continue;
+
+            res = impl_add_grid_point(&tr, cell->i + half, cell->j);
+            res |= impl_add_grid_point(&tr, cell->i + cell->size, cell->j + half);
+            res |= impl_add_grid_point(&tr, cell->i + half, cell->j + cell->size);
+            res |= impl_add_grid_point(&tr, cell->i, cell->j + half);
+            res |= impl_add_grid_point(&tr, cell->i + half, cell->j + half);
+            child_count += 4;
+        }
+
+        free(children);
+        children = (impl_cell*)malloc(sizeof(impl_cell) * (child_count > 0 ? child_count : 1));
+        if (res != 0 || children == NULL)
+        {
+            res = 1;
+            break;
+        }
+        impl_batch_run(&tr.batch, pool, stats);
+
+        /* children get values of parent corners and new points: bottom, right, top, left, center */
+        base = 0;
+        child = children;
+        for (k = 0; k < count; k++)
+        {
+            cell = &cells[k];
+            refine = impl_sign_change(cell, (centers != NULL) ? &centers[k] : NULL);
+            if (!refine)
+                continue;
+
+            for (i = 0; i < 4; i++)
+            {
+                child[i].size = half;
+                child[i].i = cell->i + ((i == 1 || i == 2) ? half : 0);
+                child[i].j = cell->j + ((i >= 2) ? half : 0);
+            }
+            child[0].v[0] = cell->v[0];
+            child[0].v[1] = tr.batch.out[base];
+            child[0].v[2] = tr.batch.out[base + 4];
+            child[0].v[3] = tr.batch.out[base + 3];
+            child[1].v[0] = tr.batch.out[base];
+            child[1].v[1] = cell->v[1];
+            child[1].v[2] = tr.batch.out[base + 1];
+            child[1].v[3] = tr.batch.out[base + 4];
+            child[2].v[0] = tr.batch.out[base + 4];
+            child[2].v[1] = tr.batch.out[base + 1];
+            child[2].v[2] = cell->v[2];
+            child[2].v[3] = tr.batch.out[base + 2];
+            child[3].v[0] = tr.batch.out[base + 3];
+            child[3].v[1] = tr.batch.out[base + 4];
+            child[3].v[2] = tr.batch.out[base + 2];
+            child[3].v[3] = cell->v[3];
+
+            child += 4;
+            base += 5;
+        }
+        stats->cells += child_count;
+
+        /* children become cells of the next level */
+        cell = cells;
+        cells = children;
+        children = cell;
+        count = child_count;
+    }
+
+    /* the finest cells */
+    for (k = 0; k < count && res == 0; k++)
+    {
+        if (!impl_sign_change(&cells[k], NULL))
+            continue;
+        stats->leaves++;
+        res = impl_march(&tr, &cells[k]);
+    }
+    stats->segments = tr.segment_count;
+
+    if (res == 0)
+        res = impl_chain(&tr, sink, context, stats);
+
+    free(cells);
+    free(children);
+    free(centers);
+    free(tr.batch.x);
+    free(tr.batch.y);
+    free(tr.batch.out);
+    free(tr.segments);
+
+    return res;
+}
@@ -0,0 +1,24 @@
+#ifndef MATHPARSER_IMPLICIT_H
+#define MATHPARSER_IMPLICIT_H
+
+#define IMPL_COARSE_CELLS 64            /* implicit number of cells of initial grid along each axis */
+#define IMPL_MAX_DEPTH 4                /* implicit number of halvings of cells the curve passes through */
+#define IMPL_MAX_RESOLUTION 65536       /* maximum number of finest cells along each axis */
+#define IMPL_BLOCK 1024                 /* number of points evaluated by one task */
+
+#define IMPL_FLAG_CENTER_CHECK 0x0001   /* refine also cells, whose center has other sign than their corners */
+
+/* statistics of implicit curve tracing */
+typedef struct _impl_stats
+{
+    long points;                        /* number of evaluated points */
+    long cells;                         /* number of examined cells (of all levels) */
+    long leaves;                        /* number of finest cells the curve passes through */
+    long segments;                      /* number of extracted line segments */
+    long paths;                         /* number of polylines the segments were chained to */
+} impl_stats;
+
+int impl_trace(rpn_program* prog, const double* limits, int coarse, int depth, int flags, thread_pool* pool,
+               poly_sink sink, void* context, impl_stats* stats);
+
+#endif
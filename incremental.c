@@ -0,0 +1,797 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "stack.h"
+#include "rpn.h"
+#include "main.h"
+#include "shunting_yard.h"
+#include "program.h"
+#include "incremental.h"
+
+/*
+ * The expression is split to parenthesized groups. Every group is compiled from its "reduced"
+ * content, where every nested group is replaced by "($N)" placeholder, which is evaluated as
+ * variable holding values of that nested group. Every group also keeps its evaluated values
+ * (column) for all samples.
+ *
+ * After an edit, the group tree is rebuilt from text, but:
+ *  - groups with unchanged content are taken from previous tree as they are, including their
+ *    evaluated values; nothing inside them is parsed or evaluated again
+ *  - groups with changed content, but unchanged reduced content (i.e. the parents of edited
+ *    group) keep their program, and only evaluate it again using values of nested groups
+ *  - only the rest (the innermost group containing the edit, and newly created groups) is parsed
+ *
+ * Groups are immutable and reference counted, so the new tree may share them with the previous
+ * one, which is kept until the new one is successfully built.
+ *
+ * All live groups are kept in two hash tables, by content and by reduced content, so finding
+ * a group to reuse does not depend on the number of groups. A group, which kept its program,
+ * copies values of the group it took the program from, and evaluates only the samples where
+ * values of its nested groups differ, so an edit costs time proportional to the changed path.
+ */
+
+#define FNV_OFFSET_BASIS 2166136261UL   /* FNV-1a hash initial value */
+#define FNV_PRIME 16777619UL            /* FNV-1a hash multiplier */
+
+/* reference counted program, may be shared by more groups */
+typedef struct
+{
+    int refcount;
+    rpn_program* program;
+} inc_program;
+
+struct _inc_node
+{
+    int refcount;                       /* number of trees (parents) referencing this group */
+    char* content;                      /* group content, without enclosing parentheses */
+    int content_length;
+    char* reduced;                      /* content with nested groups replaced by placeholders */
+    int reduced_length;
+    inc_program* program;               /* compiled reduced content */
+    int child_count;                    /* number of directly nested groups */
+    inc_node** children;                /* directly nested groups, in order of appearance */
+    double* column;                     /* values of this group for every sample */
+    unsigned long content_hash;
+    unsigned long reduced_hash;
+    int indexed;                        /* the group is in lookup tables */
+    inc_node* next_content;             /* next group in the same bucket of table by content */
+    inc_node* next_reduced;             /* next group in the same bucket of table by reduced content */
+};
+
+static inc_node* inc_build(inc_session* session, int begin, int end, int* error, int* error_offset);
+
+/**
+ * Computes FNV-1a hash of text
+ */
+static unsigned long inc_hash(const char* text, int length)
+{
+    unsigned long hash = FNV_OFFSET_BASIS;
+    int i;
+
+    for (i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)text[i];
+        hash = (hash * FNV_PRIME) & 0xFFFFFFFFUL;
+    }
+
+    return hash;
+}
+
+/**
+ * Doubles number of buckets of lookup tables; the tables are kept as they are if there's not
+ * enough memory (the chains are just longer)
+ */
+static void inc_grow_index(inc_session* session)
+{
+    inc_node **by_content, **by_reduced;
+    inc_node *node, *next;
+    unsigned long mask;
+    int i, count;
+
+    count = session->bucket_count * 2;
+    by_content = (inc_node**)calloc(count, sizeof(inc_node*));
+    by_reduced = (inc_node**)calloc(count, sizeof(inc_node*));
+    if (by_content == NULL || by_reduced == NULL)
+    {
+        free(by_content);
+        free(by_reduced);
+        return;
+    }
+
+    mask = (unsigned long)count - 1;
+    for (i = 0; i < session->bucket_count; i++)
+    {
+        for (node = session->by_content[i]; node != NULL; node = next)
+        {
+            next = node->next_content;
+            node->next_content = by_content[node->content_hash & mask];
+            by_content[node->content_hash & mask] = node;
+        }
+        for (node = session->by_reduced[i]; node != NULL; node = next)
+        {
+            next = node->next_reduced;
+            node->next_reduced = by_reduced[node->reduced_hash & mask];
+            by_reduced[node->reduced_hash & mask] = node;
+        }
+    }
+
+    free(session->by_content);
+    free(session->by_reduced);
+    session->by_content = by_content;
+    session->by_reduced = by_reduced;
+    session->bucket_count = count;
+}
+
+/**
+ * Adds successfully built group to lookup tables
+ */
+static void inc_index_node(inc_session* session, inc_node* node)
+{
+    unsigned long mask;
+
+    if (session->node_count >= session->bucket_count)
+        inc_grow_index(session);
+
+    mask = (unsigned long)session->bucket_count - 1;
+    node->next_content = session->by_content[node->content_hash & mask];
+    session->by_content[node->content_hash & mask] = node;
+    node->next_reduced = session->by_reduced[node->reduced_hash & mask];
+    session->by_reduced[node->reduced_hash & mask] = node;
+    node->indexed = 1;
+    session->node_count++;
+}
+
+/**
+ * Removes group from lookup tables
+ */
+static void inc_unindex_node(inc_session* session, inc_node* node)
+{
+    inc_node** link;
+    unsigned long mask;
+
+    mask = (unsigned long)session->bucket_count - 1;
+    for (link = &session->by_content[node->content_hash & mask]; *link != node; link = &(*link)->next_content)
+        ;
+    *link = node->next_content;
+    for (link = &session->by_reduced[node->reduced_hash & mask]; *link != node; link = &(*link)->next_reduced)
+        ;
+    *link = node->next_reduced;
+    node->indexed = 0;
+    session->node_count--;
+}
+
+/**
+ * Releases group reference, frees the group if nobody uses it
+ */
+static void inc_release_node(inc_session* session, inc_node* node)
+{
+    int i;
+
+    if (--node->refcount > 0)
+        return;
+
+    if (node->indexed)
+        inc_unindex_node(session, node);
+
+    for (i = 0; i < node->child_count; i++)
+        inc_release_node(session, node->children[i]);
+
+    if (node->program != NULL && --node->program->refcount == 0)
+    {
+        prog_destroy(node->program->program);
+        free(node->program);
+    }
+
+    free(node->children);
+    free(node->content);
+    free(node->reduced);
+    free(node->column);
+    free(node);
+}
+
+/**
+ * Finds live group with the same content, NULL if not found
+ */
+static inc_node* inc_find_content(inc_session* session, const char* content, int length, unsigned long hash)
+{
+    inc_node* node;
+
+    for (node = session->by_content[hash & (session->bucket_count - 1)]; node != NULL; node = node->next_content)
+    {
+        if (node->content_hash == hash && node->content_length == length && memcmp(node->content, content, length) == 0)
+            return node;
+    }
+
+    return NULL;
+}
+
+/**
+ * Finds live group with the same reduced content, NULL if not found
+ */
+static inc_node* inc_find_reduced(inc_session* session, const char* reduced, int length, unsigned long hash)
+{
+    inc_node* node;
+
+    for (node = session->by_reduced[hash & (session->bucket_count - 1)]; node != NULL; node = node->next_reduced)
+    {
+        if (node->reduced_hash == hash && node->reduced_length == length && memcmp(node->reduced, reduced, length) == 0)
+            return node;
+    }
+
+    return NULL;
+}
+
+/**
+ * Finds live group with the content, which text range [begin, end) had before the edit being
+ * parsed, i.e. the previous version of group containing the edit; NULL if not found
+ */
+static inc_node* inc_find_previous(inc_session* session, int begin, int end)
+{
+    inc_node* node;
+    char* content;
+    int length, prefix;
+
+    if (begin > session->edit_offset || end < session->edit_offset + session->edit_length)
+        return NULL;
+
+    length = end - begin - session->edit_length + session->removed_length;
+    content = (char*)malloc(length + 1);
+    if (content == NULL)
+        return NULL;
+
+    prefix = session->edit_offset - begin;
+    memcpy(content, session->text + begin, prefix);
+    memcpy(content + prefix, session->removed, session->removed_length);
+    memcpy(content + prefix + session->removed_length, session->text + session->edit_offset + session->edit_length,
+           length - prefix - session->removed_length);
+
+    node = inc_find_content(session, content, length, inc_hash(content, length));
+    free(content);
+
+    return node;
+}
+
+/**
+ * Extends range [first, last] of samples by samples, where the two columns differ (bit by bit,
+ * so that NaNs and signed zeros are compared properly)
+ */
+static void inc_changed_range(const double* column, const double* previous, int count, int* first, int* last)
+{
+    int i;
+
+    for (i = 0; i < *first && memcmp(&column[i], &previous[i], sizeof(double)) == 0; i++)
+        ;
+    if (i < *first)
+        *first = i;
+
+    for (i = count - 1; i > *last && memcmp(&column[i], &previous[i], sizeof(double)) == 0; i--)
+        ;
+    if (i > *last)
+        *last = i;
+}
+
+/**
+ * Builds reduced content of group with text range [begin, end) and nested groups, whose
+ * delimiters are at supplied positions; also builds map from reduced content position to text
+ * position. Returns 0 on success
+ */
+static int inc_build_reduced(inc_session* session, inc_node* node, int begin, int end, int* opens, int* closes, int** map)
+{
+    char slot[INC_SLOT_TEXT_SIZE];
+    int i, k, pos, len;
+
+    /* content length is the upper bound, plus placeholders */
+    node->reduced = (char*)malloc(end - begin + node->child_count * INC_SLOT_TEXT_SIZE + 1);
+    *map = (int*)malloc(sizeof(int) * (end - begin + node->child_count * INC_SLOT_TEXT_SIZE + 1));
+    if (node->reduced == NULL || *map == NULL)
+        return 1;
+
+    len = 0;
+    pos = begin;
+    for (k = 0; k <= node->child_count; k++)
+    {
+        /* copy text preceding nested group (or the rest of content) */
+        for (; pos < ((k < node->child_count) ? opens[k] : end); pos++)
+        {
+            (*map)[len] = pos;
+            node->reduced[len++] = session->text[pos];
+        }
+
+        if (k == node->child_count)
+            break;
+
+        /* and replace the group by placeholder - opening delimiter is kept, the closing one is
+         * copied with the following text (it may open the next argument) */
+        sprintf(slot, "%c$%i", session->text[opens[k]], k);
+        for (i = 0; slot[i] != '\0'; i++)
+        {
+            (*map)[len] = opens[k];
+            node->reduced[len++] = slot[i];
+        }
+
+        pos = closes[k];
+    }
+
+    (*map)[len] = end;
+    node->reduced[len] = '\0';
+    node->reduced_length = len;
+
+    return 0;
+}
+
+/**
+ * Fills already allocated group with text range [begin, end) - builds nested groups, whose
+ * delimiters are at supplied positions, compiles (or reuses) program and evaluates the group
+ * returns error code (SYNTAX_ERROR_NONE on success) and sets its offset in text
+ */
+static int inc_fill_node(inc_session* session, inc_node* node, int begin, int end, int* opens, int* closes, int* error_offset)
+{
+    inc_node* found;
+    int* map;
+    double** variables;
+    int k, error, first, last;
+    char* error_ptr;
+    c_stack* parsed;
+    rpn_program* prog;
+
+    /* build nested groups first, we need their values */
+    for (k = 0; k < node->child_count; k++)
+    {
+        node->children[k] = inc_build(session, opens[k] + 1, closes[k], &error, error_offset);
+        if (node->children[k] == NULL)
+        {
+            /* only successfully built groups will be released */
+            node->child_count = k;
+            return error;
+        }
+    }
+
+    *error_offset = begin;
+
+    if (inc_build_reduced(session, node, begin, end, opens, closes, &map) != 0)
+    {
+        free(map);
+        return GENERAL_MEMORY_ERROR;
+    }
+
+    /* only nested groups changed - reuse the program, preferably from previous version of the
+     * group (many groups may have the same reduced content, but their values differ) */
+    node->reduced_hash = inc_hash(node->reduced, node->reduced_length);
+    found = inc_find_previous(session, begin, end);
+    if (found == NULL || found->reduced_hash != node->reduced_hash || found->reduced_length != node->reduced_length
+        || memcmp(found->reduced, node->reduced, node->reduced_length) != 0)
+        found = inc_find_reduced(session, node->reduced, node->reduced_length, node->reduced_hash);
+    if (found != NULL)
+    {
+        node->program = found->program;
+        node->program->refcount++;
+        session->stats.programs_reused++;
+    }
+    else
+    {
+        parsed = sy_generate_rpn_stack_ex(node->reduced, node->reduced_length, SY_FLAG_SLOTS, &error, &error_ptr);
+        if (parsed == NULL || error != SYNTAX_ERROR_NONE)
+        {
+            if (error_ptr != NULL)
+                *error_offset = map[error_ptr - node->reduced];
+            if (parsed != NULL)
+                stck_destroy(parsed);
+            free(map);
+            return error;
+        }
+
+        prog = prog_compile(parsed, node->reduced, node->reduced_length, &error);
+        stck_destroy(parsed);
+        if (prog == NULL)
+        {
+            free(map);
+            return error;
+        }
+
+        node->program = (inc_program*)malloc(sizeof(inc_program));
+        if (node->program == NULL)
+        {
+            prog_destroy(prog);
+            free(map);
+            return GENERAL_MEMORY_ERROR;
+        }
+        node->program->refcount = 1;
+        node->program->program = prog;
+        session->stats.groups_parsed++;
+    }
+
+    free(map);
+
+    variables = (double**)malloc(sizeof(double*) * (node->child_count + 1));
+    if (variables == NULL)
+        return GENERAL_MEMORY_ERROR;
+
+    /* the group with the same program has nested groups at the same positions, so only samples,
+     * where values of some nested group differ, are evaluated again */
+    first = 0;
+    last = session->sample_count - 1;
+    if (found != NULL)
+    {
+        first = session->sample_count;
+        last = -1;
+        for (k = 0; k < node->child_count; k++)
+        {
+            if (node->children[k] != found->children[k])
+                inc_changed_range(node->children[k]->column, found->children[k]->column, session->sample_count, &first, &last);
+        }
+        memcpy(node->column, found->column, sizeof(double) * session->sample_count);
+    }
+
+    /* evaluate the group - x is variable 0, placeholders follow */
+    if (first <= last)
+    {
+        variables[0] = session->samples + first;
+        for (k = 0; k < node->child_count; k++)
+            variables[k + 1] = node->children[k]->column + first;
+
+        prog_evaluate_block(node->program->program, variables, last - first + 1, node->column + first);
+        session->stats.samples_evaluated += last - first + 1;
+    }
+    free(variables);
+
+    *error_offset = -1;
+
+    return SYNTAX_ERROR_NONE;
+}
+
+/**
+ * Determines, if parenthesis on supplied position opens sum or product call - its body
+ * depends on index variable, so nothing inside may be evaluated separately as a group
+ */
+static int inc_is_loop_call(const char* text, int begin, int pos)
+{
+    const char* name;
+    int i, len;
+
+    for (i = pos; i > begin && text[i - 1] == ' '; i--)
+        ;
+    for (len = 0; i > begin && (isalnum((unsigned char)text[i - 1]) || text[i - 1] == '_'); i--)
+        len++;
+
+    name = sy_get_function_name(FUNC_SUM);
+    if (len == (int)strlen(name) && strncmp(text + i, name, len) == 0)
+        return 1;
+
+    name = sy_get_function_name(FUNC_PROD);
+    return len == (int)strlen(name) && strncmp(text + i, name, len) == 0;
+}
+
+/**
+ * Finds directly nested groups of text range [begin, end) - a group is either parenthesized
+ * subexpression, or one argument of function call with more arguments (argument list is not
+ * an expression on its own); stores positions of group delimiters (parentheses or commas),
+ * if arrays are supplied
+ * returns number of groups, or -1 and sets offset of error, if parentheses are not paired
+ */
+static int inc_find_groups(inc_session* session, int begin, int end, int* opens, int* closes, int* error_offset)
+{
+    char* text = session->text;
+    int i, j, k, start, depth, comma, count;
+
+    count = 0;
+    for (i = begin; i < end; i++)
+    {
+        if (text[i] == ')')
+        {
+            *error_offset = i;
+            return -1;
+        }
+        if (text[i] != '(')
+            continue;
+
+        /* find matching parenthesis, and look for commas directly inside */
+        comma = 0;
+        depth = 0;
+        for (j = i; j < end; j++)
+        {
+            if (text[j] == '(')
+                depth++;
+            else if (text[j] == ')' && --depth == 0)
+                break;
+            else if (text[j] == ',' && depth == 1)
+                comma = 1;
+        }
+        if (j == end)
+        {
+            *error_offset = end;
+            return -1;
+        }
+
+        /* empty parentheses (i.e. call without arguments) and sums or products are left as they are */
+        for (k = i + 1; k < j && text[k] == ' '; k++)
+            ;
+        if (k == j || inc_is_loop_call(text, begin, i))
+        {
+            i = j;
+            continue;
+        }
+
+        if (!comma)
+        {
+            if (opens != NULL)
+            {
+                opens[count] = i;
+                closes[count] = j;
+            }
+            count++;
+        }
+        else
+        {
+            /* every argument is group delimited by parenthesis or comma */
+            start = i;
+            depth = 0;
+            for (k = i + 1; k <= j; k++)
+            {
+                if (text[k] == '(')
+                    depth++;
+                else if (text[k] == ')' && depth > 0)
+                    depth--;
+                else if (depth == 0 && (text[k] == ',' || k == j))
+                {
+                    if (opens != NULL)
+                    {
+                        opens[count] = start;
+                        closes[count] = k;
+                    }
+                    count++;
+                    start = k;
+                }
+            }
+        }
+
+        i = j;
+    }
+
+    return count;
+}
+
+/**
+ * Builds group from text range [begin, end), reusing groups of previous tree where possible
+ * returns NULL and sets error and its offset in text if the content is not valid
+ */
+static inc_node* inc_build(inc_session* session, int begin, int end, int* error, int* error_offset)
+{
+    inc_node *node;
+    int *opens, *closes;
+    int count;
+    unsigned long hash;
+
+    /* unchanged group - reuse it completelly */
+    hash = inc_hash(session->text + begin, end - begin);
+    node = inc_find_content(session, session->text + begin, end - begin, hash);
+    if (node != NULL)
+    {
+        node->refcount++;
+        session->stats.groups_reused++;
+        *error = SYNTAX_ERROR_NONE;
+        return node;
+    }
+
+    /* find directly nested groups (count them first, to know how much memory we need) */
+    count = inc_find_groups(session, begin, end, NULL, NULL, error_offset);
+    if (count < 0)
+    {
+        *error = SYNTAX_ERROR_MISSING_PARENTHESIS;
+        return NULL;
+    }
+
+    *error = GENERAL_MEMORY_ERROR;
+    *error_offset = begin;
+
+    node = (inc_node*)calloc(1, sizeof(inc_node));
+    if (node == NULL)
+        return NULL;
+
+    node->refcount = 1;
+    node->child_count = count;
+    node->content_hash = hash;
+    node->content_length = end - begin;
+    node->content = (char*)malloc(end - begin + 1);
+    node->children = (inc_node**)calloc(count + 1, sizeof(inc_node*));
+    node->column = (double*)malloc(sizeof(double) * (session->sample_count + 1));
+    opens = (int*)malloc(sizeof(int) * (count + 1));
+    closes = (int*)malloc(sizeof(int) * (count + 1));
+
+    if (node->content != NULL && node->children != NULL && node->column != NULL && opens != NULL && closes != NULL)
+    {
+        memcpy(node->content, session->text + begin, end - begin);
+        node->content[end - begin] = '\0';
+
+        /* store positions of nested groups */
+        inc_find_groups(session, begin, end, opens, closes, error_offset);
+
+        *error = inc_fill_node(session, node, begin, end, opens, closes, error_offset);
+    }
+    else
+    {
+        node->child_count = 0;
+    }
+
+    free(opens);
+    free(closes);
+
+    if (*error != SYNTAX_ERROR_NONE)
+    {
+        inc_release_node(session, node);
+        return NULL;
+    }
+
+    inc_index_node(session, node);
+
+    return node;
+}
+
+/**
+ * Rebuilds group tree from current text; keeps the previous tree if the text is not valid
+ * returns error code (SYNTAX_ERROR_NONE on success)
+ */
+static int inc_parse(inc_session* session, int* error_offset)
+{
+    inc_node* root;
+    double *old_values, *new_values;
+    int error, i;
+
+    memset(&session->stats, 0, sizeof(inc_stats));
+    session->stats.changed_first = -1;
+    session->stats.changed_last = -1;
+    *error_offset = -1;
+
+    if (session->length == 0)
+    {
+        session->valid = 0;
+        return SYNTAX_ERROR_NOTHING_TO_PARSE;
+    }
+
+    error = SYNTAX_ERROR_NONE;
+    root = inc_build(session, 0, session->length, &error, error_offset);
+
+    if (root == NULL)
+    {
+        session->valid = 0;
+        return error;
+    }
+
+    /* find range of changed samples, so the caller may redraw only that part */
+    old_values = (session->root != NULL) ? session->root->column : NULL;
+    new_values = root->column;
+    for (i = 0; i < session->sample_count; i++)
+    {
+        /* NaN is not equal to itself, but it's still the same value for drawing */
+        if (old_values == NULL || (old_values[i] != new_values[i] && (old_values[i] == old_values[i] || new_values[i] == new_values[i])))
+        {
+            if (session->stats.changed_first == -1)
+                session->stats.changed_first = i;
+            session->stats.changed_last = i;
+        }
+    }
+
+    if (session->root != NULL)
+        inc_release_node(session, session->root);
+
+    session->root = root;
+    session->valid = 1;
+
+    return SYNTAX_ERROR_NONE;
+}
+
+/**
+ * Creates editing session evaluating the expression in supplied samples (the samples are copied)
+ */
+inc_session* inc_create(const double* samples, int sample_count)
+{
+    inc_session* session;
+
+    session = (inc_session*)calloc(1, sizeof(inc_session));
+    if (session == NULL)
+        return NULL;
+
+    session->capacity = 64;
+    session->text = (char*)malloc(session->capacity);
+    session->samples = (double*)malloc(sizeof(double) * (sample_count + 1));
+    session->bucket_count = INC_INITIAL_BUCKETS;
+    session->by_content = (inc_node**)calloc(session->bucket_count, sizeof(inc_node*));
+    session->by_reduced = (inc_node**)calloc(session->bucket_count, sizeof(inc_node*));
+    if (session->text == NULL || session->samples == NULL || session->by_content == NULL || session->by_reduced == NULL)
+    {
+        free(session->text);
+        free(session->samples);
+        free(session->by_content);
+        free(session->by_reduced);
+        free(session);
+        return NULL;
+    }
+
+    session->text[0] = '\0';
+    session->sample_count = sample_count;
+    memcpy(session->samples, samples, sizeof(double) * sample_count);
+
+    return session;
+}
+
+/**
+ * Destroys editing session
+ */
+void inc_destroy(inc_session* session)
+{
+    if (session->root != NULL)
+        inc_release_node(session, session->root);
+
+    free(session->text);
+    free(session->samples);
+    free(session->by_content);
+    free(session->by_reduced);
+    free(session);
+}
+
+/**
+ * Replaces whole expression text; groups of previous text are still reused, if possible
+ * returns error code (SYNTAX_ERROR_NONE on success), and sets error offset within text
+ */
+int inc_set_text(inc_session* session, const char* text, int length, int* error_offset)
+{
+    return inc_edit(session, 0, session->length, text, length, error_offset);
+}
+
+/**
+ * Applies edit to expression text - deletes "deleted" characters at offset and inserts supplied
+ * text there; then reparses only groups affected by the edit
+ * returns error code (SYNTAX_ERROR_NONE on success), and sets error offset within text
+ */
+int inc_edit(inc_session* session, int offset, int deleted, const char* inserted, int inserted_length, int* error_offset)
+{
+    char *tmp, *removed;
+    int new_length, error;
+
+    *error_offset = -1;
+
+    if (offset < 0 || deleted < 0 || inserted_length < 0 || offset + deleted > session->length)
+        return SYNTAX_ERROR_UNEXPECTED_SYMBOL;
+
+    new_length = session->length - deleted + inserted_length;
+    if (new_length + 1 > session->capacity)
+    {
+        tmp = (char*)realloc(session->text, new_length * 2 + 1);
+        if (tmp == NULL)
+            return GENERAL_MEMORY_ERROR;
+        session->text = tmp;
+        session->capacity = new_length * 2 + 1;
+    }
+
+    /* keep the deleted text, so that previous versions of edited groups may be found */
+    removed = (char*)malloc(deleted + 1);
+    if (removed == NULL)
+        return GENERAL_MEMORY_ERROR;
+    memcpy(removed, session->text + offset, deleted);
+
+    /* move the tail and put the inserted text in place */
+    memmove(session->text + offset + inserted_length, session->text + offset + deleted, session->length - offset - deleted + 1);
+    memcpy(session->text + offset, inserted, inserted_length);
+    session->length = new_length;
+
+    session->edit_offset = offset;
+    session->edit_length = inserted_length;
+    session->removed = removed;
+    session->removed_length = deleted;
+
+    error = inc_parse(session, error_offset);
+
+    session->removed = NULL;
+    session->removed_length = 0;
+    free(removed);
+
+    return error;
+}
+
+/**
+ * Retrieves values of expression for all samples, or NULL if the current text is not valid
+ */
+double* inc_values(inc_session* session)
+{
+    return (session->valid && session->root != NULL) ? session->root->column : NULL;
+}
@@ -0,0 +1,52 @@
+#ifndef MATHPARSER_INCREMENTAL_H
+#define MATHPARSER_INCREMENTAL_H
+
+#define INC_SLOT_TEXT_SIZE 16           /* maximum length of "($N)" placeholder text */
+#define INC_INITIAL_BUCKETS 64          /* initial number of buckets of group lookup tables (power of two) */
+
+/* statistics of last (re)parse */
+typedef struct
+{
+    int groups_parsed;                  /* groups, whose content had to be parsed and compiled */
+    int groups_reused;                  /* unchanged groups reused including evaluated values */
+    int programs_reused;                /* changed groups, which kept their program and were only re-evaluated */
+    int samples_evaluated;              /* samples evaluated, summed over all evaluated groups */
+    int changed_first;                  /* first sample with changed value (-1 if nothing changed) */
+    int changed_last;                   /* last sample with changed value (-1 if nothing changed) */
+} inc_stats;
+
+/* opaque parenthesized group record, defined in incremental.c */
+typedef struct _inc_node inc_node;
+
+/* editing session - expression text with evaluated values for fixed set of samples */
+typedef struct
+{
+    char* text;                         /* current expression text (terminated) */
+    int length;                         /* current text length */
+    int capacity;                       /* allocated text size */
+
+    double* samples;                    /* variable values to evaluate the expression in */
+    int sample_count;                   /* number of samples */
+
+    inc_node* root;                     /* group tree of last successfully parsed text */
+    inc_node** by_content;              /* live groups hashed by content (chained buckets) */
+    inc_node** by_reduced;              /* live groups hashed by reduced content (chained buckets) */
+    int bucket_count;                   /* number of buckets of both tables (power of two) */
+    int node_count;                     /* number of live groups */
+    int valid;                          /* the tree matches current text */
+    int edit_offset;                    /* position of edit being parsed */
+    int edit_length;                    /* length of text inserted by the edit */
+    const char* removed;                /* text deleted by the edit */
+    int removed_length;
+    inc_stats stats;                    /* statistics of last (re)parse */
+} inc_session;
+
+inc_session* inc_create(const double* samples, int sample_count);
+void inc_destroy(inc_session* session);
+
+int inc_set_text(inc_session* session, const char* text, int length, int* error_offset);
+int inc_edit(inc_session* session, int offset, int deleted, const char* inserted, int inserted_length, int* error_offset);
+
+double* inc_values(inc_session* session);
+
+#endif
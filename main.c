@@ -1,141 +1,1142 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <time.h>
-#include "stack.h"
-#include "rpn.h"
-#include "main.h"
-#include "shunting_yard.h"
-#include "drawing.h"
-
-#include "test.h"
-
-/**
- * Function for parsing limits from input string
- * Returns NULL if not possible to parse
- */
-static double* parse_limits(char* input)
-{
-    double* limits;
-
-    limits = (double*)malloc(sizeof(double) * 4);
-    if (sscanf(input, "%lf:%lf:%lf:%lf", &limits[0], &limits[1], &limits[2], &limits[3]) != 4)
-    {
-        printf("Invalid limits string supplied, falling back to default intervals\n");
-        free(limits);
-        return NULL;
-    }
-
-    return limits;
-}
-
-/**
- * Application entry point - main function
- */
-int main(int argc, char **argv)
-{
-    char *input, *error_ptr;
-    c_stack *parsed;
-    int error;
-    double* limits;
-
-    /* "unit testing" */
-    if (argc == 2 && strcmp(argv[1], "-test") == 0)
-    {
-        /* just return value from testing function */
-        return test_evaluation();
-    }
-
-    /* verify argument count */
-    if (argc < 3 || argc > 5)
-    {
-        printf("\nUsage: %s <func> <out-file> [<limits>]\n\n", argv[0]);
-        printf("<func>      - expression representing math function\n");
-        printf("<out-file>  - output PostScript file\n");
-        printf("<limits>    - supplied limits in xmin:xmax:ymin:ymax format\n\n");
-        printf("Or you can run test routine by typing: \n");
-        printf("    %s -test\n\n", argv[0]);
-        return 1;
-    }
-
-    /* function body is supplied as 1th parameter */
-    input = argv[1];
-
-    /* parse input to RPN form */
-    parsed = sy_generate_rpn_stack(input, &error, &error_ptr);
-
-    /* the parsing routine may return error */
-    if (parsed == NULL || error != SYNTAX_ERROR_NONE)
-    {
-        printf("\n");
-
-        switch (error)
-        {
-            case SYNTAX_ERROR_MISSING_PARENTHESIS:
-                printf("Syntax error: missing parenthesis in supplied expression\n");
-                break;
-            case SYNTAX_ERROR_REAL_NOTATION:
-                printf("Syntax error: wrong floating point value notation\n");
-                break;
-            case SYNTAX_ERROR_OPERATOR_FREQUENCY:
-                printf("Syntax error: operator chain not recognized\n");
-                break;
-            case SYNTAX_ERROR_FUNCTION_PARENTHESIS:
-                printf("Syntax error: function argument not enclosed in parenthesis\n");
-                break;
-            case SYNTAX_ERROR_BINARY_OPERATOR_OPERANDS:
-                printf("Syntax error: missing binary operator operands\n");
-                break;
-            case SYNTAX_ERROR_INVALID_CHARACTER:
-                printf("Syntax error: invalid character in supplied expression\n");
-                break;
-            case SYNTAX_ERROR_UNEXPECTED_SYMBOL:
-                printf("Syntax error: unexpected symbol in supplied expression\n");
-                break;
-            case SYNTAX_ERROR_NOTHING_TO_PARSE:
-                printf("Error: nothing to parse\n");
-                break;
-        }
-
-        /* there we draw the "pointing" character ^ to error position, just like other parsers often have */
-        if (error_ptr != NULL)
-        {
-            printf("\n  %s\n  ", input);
-            /* print spaces until we hit the error position */
-            while (input != error_ptr)
-            {
-                printf(" ");
-                input++;
-            }
-            printf("^\n");
-        }
-
-        return 1;
-    }
-
-    limits = NULL;
-
-    /* this means, the limits are supplied (or at least we assume that) */
-    if (argc == 4)
-        limits = parse_limits(argv[3]);
-
-    /* limits weren't parsed successfully, or supplied at all */
-    if (limits == NULL)
-    {
-        /* use implicit */
-        limits = (double*)malloc(sizeof(double) * 4);
-        limits[0] = -10.0;
-        limits[1] = 10.0;
-        limits[2] = -10.0;
-        limits[3] = 10.0;
-    }
-
-    /* evaluate RPN stack and draw function to file*/
-    drawing_process_output(input, argv[2], parsed, limits);
-
-    /* cleanup */
-    stck_destroy(parsed);
-    free(limits);
-
-    return 0;
-}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "stack.h"
+#include "rpn.h"
+#include "main.h"
+#include "shunting_yard.h"
+#include "program.h"
+#include "multi.h"
+#include "userfunc.h"
+#include "pool.h"
+#include "drawing.h"
+#include "postscript.h"
+#include "bulk.h"
+#include "grid.h"
+#include "sweep.h"
+#include "heatmap.h"
+#include "polyline.h"
+#include "implicit.h"
+#include "analysis.h"
+#include "quadrature.h"
+
+#include "test.h"
+
+/**
+ * Function for parsing limits from input string
+ * Returns NULL if not possible to parse
+ */
+static double* parse_limits(char* input)
+{
+    double* limits;
+
+    limits = (double*)malloc(sizeof(double) * 4);
+    if (sscanf(input, "%lf:%lf:%lf:%lf", &limits[0], &limits[1], &limits[2], &limits[3]) != 4)
+    {
+        printf("Invalid limits string supplied, falling back to default intervals\n");
+        free(limits);
+        return NULL;
+    }
+
+    return limits;
+}
+
+/**
+ * Runs bulk processing of expression file, parses optional arguments following the filename
+ * Returns application exit code
+ */
+static int run_bulk(int argc, char **argv)
+{
+    enum bulk_mode mode;
+    double variable_value;
+    int threads, i;
+
+    mode = BULK_MODE_RPN;
+    variable_value = 0.0;
+    threads = 0;
+
+    for (i = 3; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-eval") == 0 && i + 1 < argc && sscanf(argv[i + 1], "%lf", &variable_value) == 1)
+        {
+            mode = BULK_MODE_EVALUATE;
+            i++;
+        }
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc && sscanf(argv[i + 1], "%i", &threads) == 1)
+        {
+            i++;
+        }
+        else
+        {
+            printf("Unrecognized bulk processing option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    return bulk_process_file(argv[2], mode, variable_value, threads);
+}
+
+/**
+ * Prints syntax error message, and points to error position in input, if known
+ */
+static void print_syntax_error(char* input, int error, char* error_ptr)
+{
+    printf("\n");
+
+    switch (error)
+    {
+        case SYNTAX_ERROR_MISSING_PARENTHESIS:
+            printf("Syntax error: missing parenthesis in supplied expression\n");
+            break;
+        case SYNTAX_ERROR_REAL_NOTATION:
+            printf("Syntax error: wrong floating point value notation\n");
+            break;
+        case SYNTAX_ERROR_OPERATOR_FREQUENCY:
+            printf("Syntax error: operator chain not recognized\n");
+            break;
+        case SYNTAX_ERROR_FUNCTION_PARENTHESIS:
+            printf("Syntax error: function argument not enclosed in parenthesis\n");
+            break;
+        case SYNTAX_ERROR_BINARY_OPERATOR_OPERANDS:
+            printf("Syntax error: missing binary operator operands\n");
+            break;
+        case SYNTAX_ERROR_INVALID_CHARACTER:
+            printf("Syntax error: invalid character in supplied expression\n");
+            break;
+        case SYNTAX_ERROR_UNEXPECTED_SYMBOL:
+            printf("Syntax error: unexpected symbol in supplied expression\n");
+            break;
+        case SYNTAX_ERROR_NOTHING_TO_PARSE:
+            printf("Error: nothing to parse\n");
+            break;
+        case SYNTAX_ERROR_MISSING_OPERAND:
+            printf("Syntax error: missing operand in supplied expression\n");
+            break;
+        case SYNTAX_ERROR_ARGUMENT_COUNT:
+            printf("Syntax error: function called with wrong number of arguments\n");
+            break;
+        case SYNTAX_ERROR_DEFINITION:
+            printf("Syntax error: malformed function definition, or the name cannot be used\n");
+            break;
+        case SYNTAX_ERROR_RECURSION:
+            printf("Syntax error: function definition is recursive\n");
+            break;
+        case SYNTAX_ERROR_INCOMPLETE_CONDITION:
+            printf("Syntax error: conditional operator '?' without ':' part\n");
+            break;
+        case SYNTAX_ERROR_INDEX_VARIABLE:
+            printf("Syntax error: sum or product without index variable name, or nested too deep\n");
+            break;
+        case SYNTAX_ERROR_TOO_LONG:
+            printf("Syntax error: expression is too long, or nested too deep\n");
+            break;
+    }
+
+    /* there we draw the "pointing" character ^ to error position, just like other parsers often have */
+    if (error_ptr != NULL)
+    {
+        printf("\n  %s\n  ", input);
+        /* print spaces until we hit the error position */
+        while (input != error_ptr)
+        {
+            printf(" ");
+            input++;
+        }
+        printf("^\n");
+    }
+}
+
+/**
+ * Parses supplied expression to RPN form; when something fails, prints error message with
+ * error position and returns NULL
+ */
+static c_stack* parse_expression(char* input)
+{
+    char *error_ptr;
+    c_stack *parsed;
+    int error;
+
+    /* parse input to RPN form */
+    parsed = sy_generate_rpn_stack(input, &error, &error_ptr);
+
+    /* the parsing routine may return error */
+    if (parsed == NULL || error != SYNTAX_ERROR_NONE)
+    {
+        print_syntax_error(input, error, error_ptr);
+        return NULL;
+    }
+
+    return parsed;
+}
+
+/**
+ * Adds user defined function; when something fails, prints error message with error position
+ * Returns 0 on success
+ */
+static int define_function(char* definition)
+{
+    char *error_ptr;
+    int error;
+
+    error = uf_define(definition, &error_ptr);
+    if (error != SYNTAX_ERROR_NONE)
+    {
+        print_syntax_error(definition, error, error_ptr);
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Parses and compiles supplied expression; prints error message and returns NULL on failure
+ */
+static rpn_program* compile_expression(char* input)
+{
+    c_stack *parsed;
+    rpn_program *prog;
+
+    parsed = parse_expression(input);
+    if (parsed == NULL)
+        return NULL;
+
+    prog = prog_compile(parsed, input, (int)strlen(input), NULL);
+    stck_destroy(parsed);
+
+    if (prog == NULL)
+        printf("\nError: expression could not be compiled (missing operand, or too large)\n");
+
+    return prog;
+}
+
+/**
+ * Splits supplied list of expressions separated by ';' (in place), parses them and compiles them to
+ * be evaluated together; prints error message and returns NULL on failure
+ */
+static multi_program* compile_functions(char* input, char** expressions, int* count)
+{
+    c_stack* parsed[MULTI_MAX_FUNCTIONS];
+    multi_program* functions;
+    char* separator;
+    int i;
+
+    *count = 1;
+    expressions[0] = input;
+    while ((separator = strchr(expressions[*count - 1], ';')) != NULL)
+    {
+        if (*count == MULTI_MAX_FUNCTIONS)
+        {
+            printf("\nError: at most %i functions may be drawn at once\n", MULTI_MAX_FUNCTIONS);
+            return NULL;
+        }
+        *separator = '\0';
+        expressions[(*count)++] = separator + 1;
+    }
+
+    for (i = 0; i < *count; i++)
+    {
+        parsed[i] = parse_expression(expressions[i]);
+        if (parsed[i] == NULL)
+            break;
+    }
+
+    functions = NULL;
+    if (i == *count)
+    {
+        functions = multi_compile(parsed, expressions, *count, 0);
+        if (functions == NULL)
+            printf("\nError: expression could not be compiled (missing operand, or too large)\n");
+    }
+
+    while (i > 0)
+        stck_destroy(parsed[--i]);
+
+    return functions;
+}
+
+/**
+ * Takes optional "-j <threads>", "-samples <count>", "-adaptive", "-compact" and "-precision <decimals>"
+ * from the end of arguments (and drops them from argument count); number of threads is 0 if not
+ * supplied (use all processors)
+ */
+static void take_drawing_options(int* argc, char **argv, int* threads, drawing_options* options)
+{
+    *threads = 0;
+    options->flags = 0;
+    options->samples = 0;
+    options->creation_date = NULL;
+    options->precision = 0;
+
+    while (*argc >= 4)
+    {
+        if (strcmp(argv[*argc - 1], "-adaptive") == 0)
+        {
+            options->flags |= DRAW_FLAG_ADAPTIVE;
+            *argc -= 1;
+        }
+        else if (strcmp(argv[*argc - 1], "-compact") == 0)
+        {
+            options->flags |= DRAW_FLAG_COMPACT;
+            *argc -= 1;
+        }
+        else if (*argc >= 5 && strcmp(argv[*argc - 2], "-precision") == 0 && sscanf(argv[*argc - 1], "%i", &options->precision) == 1)
+            *argc -= 2;
+        else if (*argc >= 5 && strcmp(argv[*argc - 2], "-j") == 0 && sscanf(argv[*argc - 1], "%i", threads) == 1)
+            *argc -= 2;
+        else if (*argc >= 5 && strcmp(argv[*argc - 2], "-samples") == 0 && sscanf(argv[*argc - 1], "%li", &options->samples) == 1)
+            *argc -= 2;
+        else
+            break;
+    }
+}
+
+/**
+ * Draws functions to output file, samples are evaluated using supplied number of threads
+ */
+static void draw_functions(char** expressions, multi_program* functions, char* output_file, double* limits, int threads,
+                           const drawing_options* options)
+{
+    thread_pool* pool;
+
+    pool = pool_create(threads);
+    drawing_process_output(expressions, functions, output_file, limits, pool, options);
+    if (pool != NULL)
+        pool_destroy(pool);
+}
+
+/**
+ * Retrieves limits from argument on specified position, or implicit ones, if not supplied
+ * or not valid
+ */
+static double* get_limits(int argc, char **argv, int index)
+{
+    double* limits;
+
+    limits = NULL;
+
+    /* this means, the limits are supplied (or at least we assume that) */
+    if (argc > index)
+        limits = parse_limits(argv[index]);
+
+    /* limits weren't parsed successfully, or supplied at all */
+    if (limits == NULL)
+    {
+        /* use implicit */
+        limits = (double*)malloc(sizeof(double) * 4);
+        limits[0] = -10.0;
+        limits[1] = 10.0;
+        limits[2] = -10.0;
+        limits[3] = 10.0;
+    }
+
+    return limits;
+}
+
+/**
+ * Compiles expression and stores compiled program to binary file
+ * Returns application exit code
+ */
+static int run_compile(char **argv)
+{
+    rpn_program *prog;
+    int res;
+
+    prog = compile_expression(argv[2]);
+    if (prog == NULL)
+        return 1;
+
+    res = prog_save(prog, argv[3]);
+    if (res != 0)
+        printf("Unable to write compiled program to %s\n", argv[3]);
+    else
+        printf("Compiled %u instructions, %u constants (stack depth %u) to %s\n", prog->header->instruction_count,
+               prog->header->constant_count, prog->header->stack_depth, argv[3]);
+
+    prog_destroy(prog);
+
+    return res;
+}
+
+/**
+ * Loads compiled program from binary file; either draws it (if output file was supplied)
+ * or prints its metadata
+ * Returns application exit code
+ */
+static int run_load(int argc, char **argv)
+{
+    rpn_program *prog;
+    multi_program single;
+    char *source;
+    double* limits;
+    int error, threads;
+    drawing_options options;
+
+    take_drawing_options(&argc, argv, &threads, &options);
+
+    prog = prog_load(argv[2], &error);
+    if (prog == NULL)
+    {
+        switch (error)
+        {
+            case PROG_LOAD_IO:
+                printf("Unable to read compiled program from %s\n", argv[2]);
+                break;
+            case PROG_LOAD_VERSION:
+                printf("Compiled program %s has unsupported version or byte order\n", argv[2]);
+                break;
+            case PROG_LOAD_CHECKSUM:
+                printf("Compiled program %s is damaged (checksum mismatch)\n", argv[2]);
+                break;
+            default:
+                printf("File %s is not a valid compiled program (error %i)\n", argv[2], error);
+                break;
+        }
+        return 1;
+    }
+
+    /* source is not terminated in the image */
+    source = (char*)malloc(prog->header->source_length + 1);
+    memcpy(source, prog->source, prog->header->source_length);
+    source[prog->header->source_length] = '\0';
+
+    if (argc >= 4 && prog->variable_count > 1)
+    {
+        printf("Compiled program %s has %u variables, only function of one variable may be drawn\n", argv[2], prog->variable_count);
+        free(source);
+        prog_destroy(prog);
+        return 1;
+    }
+
+    if (argc >= 4)
+    {
+        limits = get_limits(argc, argv, 4);
+        multi_init_single(&single, prog);
+        draw_functions(&source, &single, argv[3], limits, threads, &options);
+        free(limits);
+    }
+    else
+    {
+        printf("Expression:   %s\n", source);
+        printf("Version:      %u\n", (unsigned int)prog->header->version);
+        printf("Instructions: %u\n", prog->header->instruction_count);
+        printf("Constants:    %u\n", prog->header->constant_count);
+        printf("Stack depth:  %u\n", prog->header->stack_depth);
+        printf("Variables:    %u\n", prog->variable_count);
+        printf("Depends on x: %s\n", (prog->header->flags & PROG_FLAG_X_DEPENDENT) ? "yes" : "no");
+    }
+
+    free(source);
+    prog_destroy(prog);
+
+    return 0;
+}
+
+/**
+ * Parses grid axes in "min:max:count,min:max:count,..." format
+ * Returns number of parsed axes, or -1 if not possible to parse
+ */
+static int parse_axes(char* input, grid_spec* grid)
+{
+    int consumed;
+
+    grid->dimensions = 0;
+    while (grid->dimensions < GRID_MAX_DIMENSIONS)
+    {
+        if (sscanf(input, "%lf:%lf:%i%n", &grid->axes[grid->dimensions].min, &grid->axes[grid->dimensions].max,
+                   &grid->axes[grid->dimensions].count, &consumed) != 3 || grid->axes[grid->dimensions].count < 1)
+            return -1;
+
+        grid->dimensions++;
+        input += consumed;
+
+        if (*input == '\0')
+            return grid->dimensions;
+        if (*input++ != ',')
+            return -1;
+    }
+
+    return -1;
+}
+
+/**
+ * Evaluates expression of more variables in every point of N-dimensional grid; either writes values
+ * to binary file (native doubles, the last axis changes fastest), or prints just their range
+ * Returns application exit code
+ */
+static int run_grid(int argc, char **argv)
+{
+    const char* names[GRID_MAX_DIMENSIONS];
+    char *names_buf, *chr, *error_ptr, *out_file;
+    grid_spec grid;
+    c_stack *parsed;
+    rpn_program *prog;
+    thread_pool* pool;
+    double *values, min, max;
+    long count, i;
+    int name_count, threads, error, res;
+    FILE* f;
+
+    out_file = NULL;
+    threads = 0;
+
+    for (i = 5; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc && sscanf(argv[i + 1], "%i", &threads) == 1)
+            i++;
+        else if (out_file == NULL)
+            out_file = argv[i];
+        else
+        {
+            printf("Unrecognized grid evaluation option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if (parse_axes(argv[4], &grid) < 0)
+    {
+        printf("Invalid axes string supplied, expected min:max:count for every variable, separated by comma\n");
+        return 1;
+    }
+
+    /* split variable names in place of their copy */
+    names_buf = (char*)malloc(strlen(argv[3]) + 1);
+    strcpy(names_buf, argv[3]);
+    name_count = 0;
+    for (chr = names_buf; name_count < GRID_MAX_DIMENSIONS; )
+    {
+        names[name_count++] = chr;
+        chr = strchr(chr, ',');
+        if (chr == NULL)
+            break;
+        *chr++ = '\0';
+    }
+
+    if (chr != NULL || name_count != grid.dimensions)
+    {
+        printf("Every variable needs exactly one axis (%i variables, %i axes supplied)\n", name_count, grid.dimensions);
+        free(names_buf);
+        return 1;
+    }
+
+    i = grid_find_duplicate(names, name_count);
+    if (i >= 0)
+    {
+        printf("Variable %s is listed more than once, every variable needs its own axis\n", names[i]);
+        free(names_buf);
+        return 1;
+    }
+
+    parsed = sy_generate_rpn_stack_vars(argv[2], (int)strlen(argv[2]), 0, names, name_count, &error, &error_ptr);
+    free(names_buf);
+    if (parsed == NULL || error != SYNTAX_ERROR_NONE)
+    {
+        print_syntax_error(argv[2], error, error_ptr);
+        if (parsed != NULL)
+            stck_destroy(parsed);
+        return 1;
+    }
+
+    prog = prog_compile(parsed, argv[2], (int)strlen(argv[2]), NULL);
+    stck_destroy(parsed);
+    if (prog == NULL)
+    {
+        printf("\nError: expression could not be compiled (missing operand, or too large)\n");
+        return 1;
+    }
+
+    count = grid_sample_count(&grid);
+    values = (double*)malloc(sizeof(double) * count);
+    if (values == NULL)
+    {
+        printf("Unable to allocate memory for %li samples\n", count);
+        prog_destroy(prog);
+        return 1;
+    }
+
+    pool = pool_create(threads);
+    res = grid_evaluate(prog, &grid, values, pool);
+    printf("Evaluated %li samples of %i variables using %i threads\n", count, grid.dimensions, pool_thread_count(pool));
+    if (pool != NULL)
+        pool_destroy(pool);
+
+    if (res == 0 && out_file != NULL)
+    {
+        f = fopen(out_file, "wb");
+        if (f == NULL || fwrite(values, sizeof(double), count, f) != (size_t)count)
+        {
+            printf("Unable to write values to %s\n", out_file);
+            res = 1;
+        }
+        if (f != NULL)
+            fclose(f);
+    }
+    else if (res == 0)
+    {
+        /* NaN values are skipped (comparison with NaN is always false) */
+        min = INFINITY;
+        max = -INFINITY;
+        for (i = 0; i < count; i++)
+        {
+            if (values[i] < min)
+                min = values[i];
+            if (values[i] > max)
+                max = values[i];
+        }
+        printf("Minimum: %g\nMaximum: %g\n", min, max);
+    }
+
+    free(values);
+    prog_destroy(prog);
+
+    return res;
+}
+
+/**
+ * Renders frames of function with named parameter for evenly distributed parameter values
+ * Returns application exit code
+ */
+static int run_sweep(int argc, char **argv)
+{
+    const char* names[2];
+    char *error_ptr;
+    c_stack *parsed;
+    multi_program *functions;
+    sweep_spec sweep;
+    double* limits;
+    int threads, error, res;
+    drawing_options options;
+
+    take_drawing_options(&argc, argv, &threads, &options);
+
+    if (argc < 6 || argc > 7 || sscanf(argv[4], "%lf:%lf:%i", &sweep.from, &sweep.to, &sweep.frames) != 3
+        || sweep.frames < 1 || sweep.frames > SWEEP_MAX_FRAMES)
+    {
+        printf("Invalid sweep range supplied, expected from:to:frames (at most %i frames)\n", SWEEP_MAX_FRAMES);
+        return 1;
+    }
+
+    if (strcmp(argv[3], "x") == 0)
+    {
+        printf("Parameter has to be named differently than variable x\n");
+        return 1;
+    }
+
+    /* the parameter is variable following x */
+    names[0] = "x";
+    names[1] = argv[3];
+    sweep.parameter = argv[3];
+
+    parsed = sy_generate_rpn_stack_vars(argv[2], (int)strlen(argv[2]), 0, names, 2, &error, &error_ptr);
+    if (parsed == NULL || error != SYNTAX_ERROR_NONE)
+    {
+        print_syntax_error(argv[2], error, error_ptr);
+        if (parsed != NULL)
+            stck_destroy(parsed);
+        return 1;
+    }
+
+    functions = multi_compile(&parsed, &argv[2], 1, 1);
+    stck_destroy(parsed);
+    if (functions == NULL)
+    {
+        printf("\nError: expression could not be compiled (missing operand, or too large)\n");
+        return 1;
+    }
+
+    limits = get_limits(argc, argv, 6);
+
+    res = sweep_render(argv[2], functions, &sweep, argv[5], limits, threads, &options);
+
+    multi_destroy(functions);
+    free(limits);
+
+    return res;
+}
+
+/**
+ * Draws heatmap of function of x and y; the values are evaluated once in pixels of output and
+ * colorized by supplied colormap
+ * Returns application exit code
+ */
+static int run_heatmap(int argc, char **argv)
+{
+    const char* names[2];
+    char *error_ptr;
+    c_stack *parsed;
+    rpn_program *prog;
+    heat_map *map;
+    thread_pool *pool;
+    double* limits;
+    int i, threads, error, res, colormap, levels, resolution;
+    drawing_options options;
+
+    threads = 0;
+    levels = 0;
+    colormap = heat_find_colormap(HEAT_DEFAULT_COLORMAP);
+    limits = NULL;
+    options.flags = 0;
+    options.samples = 0;
+    options.creation_date = NULL;
+    options.precision = 0;
+
+    for (i = 4; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc && sscanf(argv[i + 1], "%i", &threads) == 1)
+            i++;
+        else if (strcmp(argv[i], "-contours") == 0 && i + 1 < argc && sscanf(argv[i + 1], "%i", &levels) == 1)
+            i++;
+        else if (strcmp(argv[i], "-precision") == 0 && i + 1 < argc && sscanf(argv[i + 1], "%i", &options.precision) == 1)
+            i++;
+        else if (strcmp(argv[i], "-compact") == 0)
+            options.flags |= DRAW_FLAG_COMPACT;
+        else if (strcmp(argv[i], "-colormap") == 0 && i + 1 < argc && heat_find_colormap(argv[i + 1]) >= 0)
+            colormap = heat_find_colormap(argv[++i]);
+        else if (limits == NULL && strchr(argv[i], ':') != NULL && (limits = parse_limits(argv[i])) != NULL)
+            continue;
+        else
+        {
+            printf("Unrecognized heatmap option: %s (colormaps:", argv[i]);
+            for (i = 0; heat_colormap_name(i) != NULL; i++)
+                printf(" %s", heat_colormap_name(i));
+            printf(")\n");
+            free(limits);
+            return 1;
+        }
+    }
+
+    if (limits == NULL)
+        limits = get_limits(0, argv, 0);
+
+    /* y is the outer axis of evaluated grid, so its rows are the rows of image */
+    names[0] = "y";
+    names[1] = "x";
+
+    parsed = sy_generate_rpn_stack_vars(argv[2], (int)strlen(argv[2]), 0, names, 2, &error, &error_ptr);
+    if (parsed == NULL || error != SYNTAX_ERROR_NONE)
+    {
+        print_syntax_error(argv[2], error, error_ptr);
+        if (parsed != NULL)
+            stck_destroy(parsed);
+        free(limits);
+        return 1;
+    }
+
+    prog = prog_compile(parsed, argv[2], (int)strlen(argv[2]), NULL);
+    stck_destroy(parsed);
+    if (prog == NULL)
+    {
+        printf("\nError: expression could not be compiled (missing operand, or too large)\n");
+        free(limits);
+        return 1;
+    }
+
+    pool = pool_create(threads);
+    resolution = drawing_heatmap_resolution(argv[3]);
+    map = heat_evaluate(prog, limits, resolution, resolution, pool);
+    if (map != NULL)
+    {
+        res = drawing_process_heatmap(argv[2], map, colormap, levels, argv[3], pool, &options);
+        heat_destroy(map);
+    }
+    else
+    {
+        printf("Unable to allocate memory for %i x %i heatmap pixels\n", resolution, resolution);
+        res = 1;
+    }
+    if (pool != NULL)
+        pool_destroy(pool);
+
+    prog_destroy(prog);
+    free(limits);
+
+    return res;
+}
+
+/**
+ * Draws implicit curve F(x, y) = 0; it is traced by quadtree refined only in cells the curve
+ * passes through, and the number of evaluated points is compared to the dense grid of the same
+ * resolution
+ * Returns application exit code
+ */
+static int run_implicit(int argc, char **argv)
+{
+    const char* names[2];
+    char *error_ptr;
+    c_stack *parsed;
+    rpn_program *prog;
+    thread_pool *pool;
+    impl_stats stats;
+    double* limits;
+    double dense;
+    int i, threads, error, res;
+    drawing_options options;
+
+    threads = 0;
+    limits = NULL;
+    options.flags = 0;
+    options.samples = 0;
+    options.creation_date = NULL;
+    options.precision = 0;
+
+    for (i = 4; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc && sscanf(argv[i + 1], "%i", &threads) == 1)
+            i++;
+        else if (strcmp(argv[i], "-thorough") == 0)
+            options.flags |= DRAW_FLAG_THOROUGH;
+        else if (strcmp(argv[i], "-precision") == 0 && i + 1 < argc && sscanf(argv[i + 1], "%i", &options.precision) == 1)
+            i++;
+        else if (strcmp(argv[i], "-compact") == 0)
+            options.flags |= DRAW_FLAG_COMPACT;
+        else if (limits == NULL && strchr(argv[i], ':') != NULL && (limits = parse_limits(argv[i])) != NULL)
+            continue;
+        else
+        {
+            printf("Unrecognized implicit curve option: %s\n", argv[i]);
+            free(limits);
+            return 1;
+        }
+    }
+
+    if (limits == NULL)
+        limits = get_limits(0, argv, 0);
+
+    names[0] = "x";
+    names[1] = "y";
+
+    parsed = sy_generate_rpn_stack_vars(argv[2], (int)strlen(argv[2]), 0, names, 2, &error, &error_ptr);
+    if (parsed == NULL || error != SYNTAX_ERROR_NONE)
+    {
+        print_syntax_error(argv[2], error, error_ptr);
+        if (parsed != NULL)
+            stck_destroy(parsed);
+        free(limits);
+        return 1;
+    }
+
+    prog = prog_compile(parsed, argv[2], (int)strlen(argv[2]), NULL);
+    stck_destroy(parsed);
+    if (prog == NULL)
+    {
+        printf("\nError: expression could not be compiled (missing operand, or too large)\n");
+        free(limits);
+        return 1;
+    }
+
+    pool = pool_create(threads);
+    res = drawing_process_implicit(argv[2], prog, argv[3], limits, pool, &options, &stats);
+    if (pool != NULL)
+        pool_destroy(pool);
+
+    if (res == 0)
+    {
+        dense = (double)(IMPL_COARSE_CELLS << IMPL_MAX_DEPTH) + 1;
+        dense *= dense;
+        printf("Traced %li segments in %li paths evaluating %li points (%.2f%% of %.0f point dense grid)\n",
+               stats.segments, stats.paths, stats.points, 100.0 * stats.points / dense, dense);
+    }
+
+    prog_destroy(prog);
+    free(limits);
+
+    return res;
+}
+
+/**
+ * Finds all roots and local extrema of function on interval and prints them
+ * Returns application exit code
+ */
+static int run_analyze(int argc, char **argv)
+{
+    static const char* kinds[] = { "root", "minimum", "maximum" };
+    rpn_program *prog;
+    thread_pool *pool;
+    anl_result result;
+    double from, to, start, elapsed;
+    int i, threads, intervals, res;
+
+    threads = 0;
+    intervals = 0;
+    from = -10.0;
+    to = 10.0;
+
+    for (i = 3; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc && sscanf(argv[i + 1], "%i", &threads) == 1)
+            i++;
+        else if (strcmp(argv[i], "-intervals") == 0 && i + 1 < argc && sscanf(argv[i + 1], "%i", &intervals) == 1)
+            i++;
+        else if (sscanf(argv[i], "%lf:%lf", &from, &to) == 2)
+            continue;
+        else
+        {
+            printf("Unrecognized analysis option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    prog = compile_expression(argv[2]);
+    if (prog == NULL)
+        return 1;
+
+    pool = pool_create(threads);
+    start = pool_wall_time();
+    res = anl_find(prog, from, to, intervals, pool, &result);
+    elapsed = pool_wall_time() - start;
+
+    if (res != 0)
+        printf("Unable to analyze function on [%g, %g] (empty interval, or not enough memory)\n", from, to);
+    else
+    {
+        for (i = 0; i < result.count; i++)
+            printf("%-8s x = %-24.17g f(x) = %g\n", kinds[result.points[i].kind], result.points[i].x, result.points[i].value);
+        printf("Found %i points on [%g, %g] in %.1f us (%li evaluations, %i threads)\n", result.count, from, to,
+               elapsed * 1e6, result.evaluations, pool_thread_count(pool));
+        anl_release(&result);
+    }
+
+    if (pool != NULL)
+        pool_destroy(pool);
+    prog_destroy(prog);
+
+    return res;
+}
+
+/**
+ * Integrates function over interval and prints the integral with its error estimate
+ * Returns application exit code
+ */
+static int run_integrate(int argc, char **argv)
+{
+    rpn_program *prog;
+    thread_pool *pool;
+    quad_result result;
+    double a, b, tolerance, start, elapsed;
+    int i, threads, res;
+
+    threads = 0;
+    tolerance = QUAD_DEFAULT_TOLERANCE;
+
+    if (sscanf(argv[3], "%lf:%lf", &a, &b) != 2)
+    {
+        printf("Invalid bounds string supplied, expected from:to\n");
+        return 1;
+    }
+
+    for (i = 4; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc && sscanf(argv[i + 1], "%i", &threads) == 1)
+            i++;
+        else if (strcmp(argv[i], "-tol") == 0 && i + 1 < argc && sscanf(argv[i + 1], "%lf", &tolerance) == 1 && tolerance > 0)
+            i++;
+        else
+        {
+            printf("Unrecognized integration option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    prog = compile_expression(argv[2]);
+    if (prog == NULL)
+        return 1;
+
+    pool = pool_create(threads);
+    start = pool_wall_time();
+    res = quad_integrate(prog, a, b, tolerance, pool, &result);
+    elapsed = pool_wall_time() - start;
+
+    if (res != 0)
+        printf("Unable to integrate function on [%g, %g] (bounds not finite, or not enough memory)\n", a, b);
+    else
+    {
+        printf("Integral on [%g, %g] = %.17g\n", a, b, result.value);
+        printf("Error estimate %g in %i panels (%li evaluations, %.1f us, %i threads)\n", result.error, result.panels,
+               result.evaluations, elapsed * 1e6, pool_thread_count(pool));
+        if (!result.converged)
+        {
+            printf("Tolerance %g not reached - the integral may diverge\n", tolerance);
+            res = 1;
+        }
+    }
+
+    if (pool != NULL)
+        pool_destroy(pool);
+    prog_destroy(prog);
+
+    return res;
+}
+
+/**
+ * Application entry point - main function
+ */
+int main(int argc, char **argv)
+{
+    multi_program *functions;
+    char *expressions[MULTI_MAX_FUNCTIONS];
+    double* limits;
+    int res, threads, count;
+    drawing_options options;
+
+    /* user defined functions precede everything else, so they may be used in every mode */
+    atexit(uf_clear);
+    while (argc >= 3 && strcmp(argv[1], "-def") == 0)
+    {
+        if (define_function(argv[2]) != 0)
+            return 1;
+
+        /* drop the definition from arguments, keep application name in place */
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
+    }
+
+    /* "unit testing" */
+    if (argc == 2 && strcmp(argv[1], "-test") == 0)
+    {
+        /* just return combined value from testing functions */
+        res = test_evaluation();
+        res |= test_serialization();
+        res |= test_cache();
+        res |= test_incremental();
+        res |= test_incremental_large();
+        res |= test_definitions();
+        res |= test_grid();
+        res |= test_conditionals();
+        res |= test_reductions();
+        res |= test_sampling();
+        res |= test_adaptive_sampling();
+        res |= test_decimation();
+        res |= test_simplification();
+        res |= test_streaming();
+        res |= test_discontinuities();
+        res |= test_multi();
+        res |= test_parameters();
+        res |= test_raster();
+        res |= test_heatmap();
+        res |= test_implicit();
+        res |= test_analysis();
+        res |= test_integration();
+        res |= test_formatting();
+        res |= test_compact_output();
+        res |= test_graphics_state();
+        res |= test_legend();
+        res |= test_bulk();
+        res |= test_bulk_distinct();
+        return res;
+    }
+
+    /* bulk processing of file with one expression per line */
+    if (argc >= 3 && strcmp(argv[1], "-bulk") == 0)
+    {
+        return run_bulk(argc, argv);
+    }
+
+    /* evaluation of expression of more variables on grid */
+    if (argc >= 5 && strcmp(argv[1], "-grid") == 0)
+    {
+        return run_grid(argc, argv);
+    }
+
+    /* rendering frames of function with parameter */
+    if (argc >= 6 && argc <= 15 && strcmp(argv[1], "-sweep") == 0)
+    {
+        return run_sweep(argc, argv);
+    }
+
+    /* drawing heatmap of function of two variables */
+    if (argc >= 4 && strcmp(argv[1], "-heatmap") == 0)
+    {
+        return run_heatmap(argc, argv);
+    }
+
+    /* drawing implicit curve of function of two variables */
+    if (argc >= 4 && strcmp(argv[1], "-implicit") == 0)
+    {
+        return run_implicit(argc, argv);
+    }
+
+    /* finding roots and extrema of function */
+    if (argc >= 3 && strcmp(argv[1], "-analyze") == 0)
+    {
+        return run_analyze(argc, argv);
+    }
+
+    /* definite integral of function */
+    if (argc >= 4 && strcmp(argv[1], "-integrate") == 0)
+    {
+        return run_integrate(argc, argv);
+    }
+
+    /* compiling expression to binary file */
+    if (argc == 4 && strcmp(argv[1], "-compile") == 0)
+    {
+        return run_compile(argv);
+    }
+
+    /* loading compiled expression from binary file */
+    if (argc >= 3 && argc <= 13 && strcmp(argv[1], "-load") == 0)
+    {
+        return run_load(argc, argv);
+    }
+
+    take_drawing_options(&argc, argv, &threads, &options);
+
+    /* verify argument count */
+    if (argc < 3 || argc > 5)
+    {
+        printf("\nUsage: %s <func> <out-file> [<limits>] [-j <threads>] [-samples <count>] [-adaptive] [-compact] [-precision <decimals>]\n\n", argv[0]);
+        printf("<func>      - expression representing math function, or more of them separated by ';'\n");
+        printf("<out-file>  - output PostScript file, or PPM/PNG image (by .ppm or .png extension)\n");
+        printf("<limits>    - supplied limits in xmin:xmax:ymin:ymax format\n");
+        printf("<threads>   - number of threads evaluating samples (all processors by default)\n");
+        printf("<count>     - number of uniform samples, or maximum number of adaptive samples (%i by default)\n", DRAW_DEFAULT_SAMPLES);
+        printf("-adaptive   - sample single function adaptively, denser where it bends, instead of uniformly\n");
+        printf("-compact    - write smaller PostScript output (short procedures, relative coordinates)\n");
+        printf("<decimals>  - decimals of coordinates of compact output (%i by default)\n\n", PS_COMPACT_DECIMALS);
+        printf("Every mode may be preceded by user function definitions, i.e.: \n");
+        printf("    %s -def \"f(t) = t^2 + 1\" \"f(x)*2\" <out-file>\n\n", argv[0]);
+        printf("Or you can run test routine by typing: \n");
+        printf("    %s -test\n\n", argv[0]);
+        printf("Or process file with one expression per line by typing: \n");
+        printf("    %s -bulk <in-file> [-eval <x>] [-j <threads>]\n\n", argv[0]);
+        printf("Or evaluate expression of more variables on grid by typing: \n");
+        printf("    %s -grid <func> <variables> <axes> [<out-file>] [-j <threads>]\n", argv[0]);
+        printf("    i.e. %s -grid \"sin(x)*cos(y)\" x,y -3:3:2048,-3:3:2048 values.bin\n\n", argv[0]);
+        printf("Or render frames of function with parameter for evenly distributed values of it by typing: \n");
+        printf("    %s -sweep <func> <parameter> <from>:<to>:<frames> <out-prefix> [<limits>] [-j <threads>] [-samples <count>] [-adaptive]\n", argv[0]);
+        printf("    i.e. %s -sweep \"sin(a*x)\" a 0.5:5:500 frame (writes frame0000.ps to frame0499.ps)\n\n", argv[0]);
+        printf("Or draw heatmap of function of x and y by typing: \n");
+        printf("    %s -heatmap <func> <out-file> [<limits>] [-colormap <name>] [-contours <levels>] [-compact] [-j <threads>]\n", argv[0]);
+        printf("    i.e. %s -heatmap \"sin(x)*cos(y)\" heat.png -3:3:-3:3 -colormap jet -contours 10\n\n", argv[0]);
+        printf("Or draw implicit curve F(x, y) = 0 by typing: \n");
+        printf("    %s -implicit <func> <out-file> [<limits>] [-thorough] [-compact] [-j <threads>]\n", argv[0]);
+        printf("    i.e. %s -implicit \"x^2 + y^2 - 4\" circle.ps -3:3:-3:3\n\n", argv[0]);
+        printf("Or find roots and local extrema of function by typing: \n");
+        printf("    %s -analyze <func> [<from>:<to>] [-intervals <count>] [-j <threads>]\n", argv[0]);
+        printf("    i.e. %s -analyze \"x^3 - 4*x + 1\" -5:5\n\n", argv[0]);
+        printf("Or integrate function over interval by typing: \n");
+        printf("    %s -integrate <func> <from>:<to> [-tol <tolerance>] [-j <threads>]\n", argv[0]);
+        printf("    i.e. %s -integrate \"exp(-x^2)\" -5:5 -tol 1e-12\n\n", argv[0]);
+        printf("Or compile expression to binary file, and load it later by typing: \n");
+        printf("    %s -compile <func> <bin-file>\n", argv[0]);
+        printf("    %s -load <bin-file> [<out-file> [<limits>]] [-j <threads>] [-samples <count>] [-adaptive]\n\n", argv[0]);
+        return 1;
+    }
+
+    /* function bodies (separated by ';') are supplied as 1th parameter */
+    functions = compile_functions(argv[1], expressions, &count);
+    if (functions == NULL)
+        return 1;
+
+    limits = get_limits(argc, argv, 3);
+
+    /* evaluate compiled expressions and draw functions to file*/
+    draw_functions(expressions, functions, argv[2], limits, threads, &options);
+
+    /* cleanup */
+    multi_destroy(functions);
+    free(limits);
+
+    return 0;
+}
@@ -0,0 +1,643 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stack.h"
+#include "rpn.h"
+#include "main.h"
+#include "shunting_yard.h"
+#include "program.h"
+#include "userfunc.h"
+#include "multi.h"
+
+/*
+ * Shared subexpressions are searched in expanded RPN form of all functions (user defined functions
+ * inlined, constants folded). Every element ends one subtree; its hash is computed from the element
+ * and hashes of its operands, so equal subtrees have equal hash and length wherever they are.
+ *
+ * Subtrees are taken from the longest ones, and subtree is shared, if it occurs at least twice out
+ * of occurrences of subtrees shared before. Subtrees with sums, products or their index variables
+ * are never shared, their value depends on enclosing loop (and levels of index variables on depth).
+ *
+ * Every shared subtree is compiled to separate program, which refers to shorter shared subtrees in
+ * it as to variables, and so do function programs. Block evaluation evaluates shared programs and
+ * then all functions for one block of samples, before it moves to the next block.
+ *
+ * Functions may have parameters - variables following x, whose values are the same for all
+ * samples (bound by multi_bind). Subtrees, which depend on parameters but not on x, are shared
+ * even if they occur only once; they are evaluated once when parameters are bound, and their
+ * values are just copied to every block.
+ */
+
+#define FNV_OFFSET_BASIS 2166136261UL   /* FNV-1a hash initial value */
+#define FNV_PRIME 16777619UL            /* FNV-1a hash multiplier */
+
+/* subtree, which may be shared */
+typedef struct
+{
+    unsigned long hash;                 /* hash of subtree elements */
+    int function;                       /* index of function the subtree is in */
+    int start, end;                     /* first and last element of subtree */
+} multi_subtree;
+
+/* expanded function with subtree of every element */
+typedef struct
+{
+    c_stack* expanded;                  /* expanded RPN form */
+    int* starts;                        /* the first element of subtree ending at element */
+    unsigned long* hashes;              /* hash of subtree ending at element */
+    char* plain;                        /* subtree ending at element has no sum, product or index variable */
+    char* varying;                      /* subtree ending at element depends on x */
+    int* shared;                        /* index of shared subtree equal to subtree ending at element, -1 if none */
+    char* covered;                      /* element is within occurrence of subtree shared before */
+} multi_function;
+
+/**
+ * Adds value to FNV-1a hash
+ */
+static unsigned long multi_hash_add(unsigned long hash, const void* data, int length)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    int i;
+
+    for (i = 0; i < length; i++)
+    {
+        hash ^= bytes[i];
+        hash = (hash * FNV_PRIME) & 0xFFFFFFFFUL;
+    }
+
+    return hash;
+}
+
+/**
+ * Returns number of values the element pops from evaluation stack
+ */
+static int multi_element_pops(const rpn_element* el)
+{
+    switch (el->type)
+    {
+        case RPN_TOKEN_OPERATOR:
+            return 2;
+        case RPN_TOKEN_FUNCTION:
+            return el->arity;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Compares two elements; returns 1 if they are the same
+ */
+static int multi_same_element(const rpn_element* first, const rpn_element* second)
+{
+    if (first->type != second->type)
+        return 0;
+
+    switch (first->type)
+    {
+        case RPN_TOKEN_CONST:
+            return memcmp(&first->value.as_double, &second->value.as_double, sizeof(double)) == 0;
+        case RPN_TOKEN_VARIABLE:
+            return first->value.as_variable == second->value.as_variable;
+        case RPN_TOKEN_OPERATOR:
+            return first->value.as_operator == second->value.as_operator;
+        default:
+            return first->value.as_function == second->value.as_function && first->arity == second->arity;
+    }
+}
+
+/**
+ * Hashes element itself (without operands)
+ */
+static unsigned long multi_hash_element(const rpn_element* el)
+{
+    unsigned long hash = FNV_OFFSET_BASIS;
+    int type = (int)el->type;
+
+    hash = multi_hash_add(hash, &type, sizeof(int));
+    switch (el->type)
+    {
+        case RPN_TOKEN_CONST:
+            return multi_hash_add(hash, &el->value.as_double, sizeof(double));
+        case RPN_TOKEN_VARIABLE:
+            return multi_hash_add(hash, &el->value.as_variable, sizeof(int));
+        case RPN_TOKEN_OPERATOR:
+            return multi_hash_add(hash, &el->value.as_operator, sizeof(int));
+        default:
+            hash = multi_hash_add(hash, &el->value.as_function, sizeof(int));
+            return multi_hash_add(hash, &el->arity, sizeof(int));
+    }
+}
+
+/**
+ * Decides, whether the element makes its subtree dependent on enclosing sum or product
+ */
+static int multi_loop_element(const rpn_element* el)
+{
+    if (el->type == RPN_TOKEN_VARIABLE)
+        return RPN_IS_INDEX_VARIABLE(el->value.as_variable);
+
+    return el->type == RPN_TOKEN_FUNCTION && (el->value.as_function == FUNC_LOOP
+        || el->value.as_function == FUNC_SUM || el->value.as_function == FUNC_PROD);
+}
+
+/**
+ * Expands function and finds subtree of every element
+ * returns 0 on success, 1 if the function is not valid (or uses other variable than x, parameters
+ * and index variables, the next identifiers are used by shared subexpressions), or memory allocation failed
+ */
+static int multi_analyze(multi_function* fn, c_stack* rpn_stack, int parameter_count)
+{
+    rpn_element* el;
+    int* roots;
+    int i, j, top, pops, count;
+    unsigned long hash;
+
+    fn->expanded = uf_expand(rpn_stack, NULL);
+    if (fn->expanded == NULL || fn->expanded->curr < 0)
+        return 1;
+
+    count = fn->expanded->curr + 1;
+    fn->starts = (int*)malloc(sizeof(int) * count);
+    fn->hashes = (unsigned long*)malloc(sizeof(unsigned long) * count);
+    fn->plain = (char*)malloc(count);
+    fn->varying = (char*)malloc(count);
+    fn->shared = (int*)malloc(sizeof(int) * count);
+    fn->covered = (char*)malloc(count);
+    roots = (int*)malloc(sizeof(int) * count);
+    if (fn->starts == NULL || fn->hashes == NULL || fn->plain == NULL || fn->varying == NULL || fn->shared == NULL || fn->covered == NULL || roots == NULL)
+    {
+        free(roots);
+        return 1;
+    }
+
+    /* stack of last elements of operand subtrees, just like evaluation stack */
+    top = 0;
+    for (i = 0; i < count; i++)
+    {
+        el = stck_get(fn->expanded, i);
+        pops = multi_element_pops(el);
+        if (pops > top || (el->type == RPN_TOKEN_VARIABLE && el->value.as_variable > parameter_count))
+        {
+            free(roots);
+            return 1;
+        }
+
+        hash = multi_hash_element(el);
+        fn->plain[i] = !multi_loop_element(el);
+        fn->varying[i] = (el->type == RPN_TOKEN_VARIABLE && el->value.as_variable == SY_VARIABLE_X);
+        for (j = top - pops; j < top; j++)
+        {
+            hash = multi_hash_add(hash, &fn->hashes[roots[j]], sizeof(unsigned long));
+            fn->plain[i] = fn->plain[i] && fn->plain[roots[j]];
+            fn->varying[i] = fn->varying[i] || fn->varying[roots[j]];
+        }
+
+        fn->starts[i] = (pops > 0) ? fn->starts[roots[top - pops]] : i;
+        fn->hashes[i] = hash;
+        fn->shared[i] = -1;
+        fn->covered[i] = 0;
+
+        top -= pops;
+        roots[top++] = i;
+    }
+
+    free(roots);
+
+    return (top == 1) ? 0 : 1;
+}
+
+/**
+ * Compares two subtrees element by element; returns 1 if they are the same
+ */
+static int multi_same_subtree(multi_function* functions, const multi_subtree* first, const multi_subtree* second)
+{
+    int i;
+
+    if (first->hash != second->hash || first->end - first->start != second->end - second->start)
+        return 0;
+
+    for (i = 0; i <= first->end - first->start; i++)
+    {
+        if (!multi_same_element(stck_get(functions[first->function].expanded, first->start + i),
+                                stck_get(functions[second->function].expanded, second->start + i)))
+            return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * Orders subtrees by length (the longest first), then by hash (for qsort)
+ */
+static int multi_compare_subtrees(const void* a, const void* b)
+{
+    const multi_subtree* first = (const multi_subtree*)a;
+    const multi_subtree* second = (const multi_subtree*)b;
+
+    if (first->end - first->start != second->end - second->start)
+        return (first->end - first->start > second->end - second->start) ? -1 : 1;
+    if (first->hash != second->hash)
+        return (first->hash < second->hash) ? -1 : 1;
+    if (first->function != second->function)
+        return first->function - second->function;
+
+    return first->start - second->start;
+}
+
+/**
+ * Chooses shared subtrees and marks every subtree equal to some of them; the representative
+ * occurrence of every shared subtree is stored to "chosen" (the longest first)
+ * returns number of shared subtrees
+ */
+static int multi_choose_shared(multi_function* functions, int count, int parameter_count, multi_subtree* chosen)
+{
+    multi_subtree *subtrees, *first;
+    int *members;
+    int total, i, j, k, f, group_end, class_size, uncovered, shared_count, share;
+
+    total = 0;
+    for (f = 0; f < count; f++)
+        total += functions[f].expanded->curr + 1;
+
+    subtrees = (multi_subtree*)malloc(sizeof(multi_subtree) * (total + 1));
+    members = (int*)malloc(sizeof(int) * (total + 1));
+    if (subtrees == NULL || members == NULL)
+    {
+        free(subtrees);
+        free(members);
+        return 0;
+    }
+
+    /* candidates are subtrees with at least one operation */
+    total = 0;
+    for (f = 0; f < count; f++)
+    {
+        for (i = 0; i <= functions[f].expanded->curr; i++)
+        {
+            if (!functions[f].plain[i] || functions[f].starts[i] == i)
+                continue;
+            subtrees[total].hash = functions[f].hashes[i];
+            subtrees[total].function = f;
+            subtrees[total].start = functions[f].starts[i];
+            subtrees[total].end = i;
+            total++;
+        }
+    }
+
+    qsort(subtrees, total, sizeof(multi_subtree), multi_compare_subtrees);
+
+    shared_count = 0;
+    for (i = 0; i < total; i = group_end)
+    {
+        /* group of subtrees with the same length and hash */
+        for (group_end = i + 1; group_end < total; group_end++)
+        {
+            if (subtrees[group_end].hash != subtrees[i].hash
+                || subtrees[group_end].end - subtrees[group_end].start != subtrees[i].end - subtrees[i].start)
+                break;
+        }
+
+        /* split it to classes of equal subtrees (hashes of different ones are equal rarely) */
+        for (j = i; j < group_end; j++)
+        {
+            if (functions[subtrees[j].function].shared[subtrees[j].end] != -1 || shared_count == MULTI_MAX_SHARED)
+                continue;
+
+            first = &subtrees[j];
+            class_size = 0;
+            uncovered = 0;
+            for (k = j; k < group_end; k++)
+            {
+                if (functions[subtrees[k].function].shared[subtrees[k].end] == -1 && multi_same_subtree(functions, first, &subtrees[k]))
+                {
+                    members[class_size++] = k;
+                    if (!functions[subtrees[k].function].covered[subtrees[k].end])
+                        uncovered++;
+                }
+            }
+
+            /* the class is shared only if it would be evaluated more than once, or for every sample
+             * while it depends on parameters only */
+            share = uncovered >= 2 || (uncovered == 1 && parameter_count > 0 && !functions[first->function].varying[first->end]);
+            for (k = 0; k < class_size; k++)
+                functions[subtrees[members[k]].function].shared[subtrees[members[k]].end] = share ? shared_count : -2;
+            if (!share)
+                continue;
+
+            for (k = 0; k < class_size; k++)
+            {
+                f = subtrees[members[k]].function;
+                if (!functions[f].covered[subtrees[members[k]].end])
+                    memset(functions[f].covered + subtrees[members[k]].start, 1, subtrees[members[k]].end - subtrees[members[k]].start + 1);
+            }
+            chosen[shared_count++] = *first;
+        }
+    }
+
+    free(subtrees);
+    free(members);
+
+    return shared_count;
+}
+
+/**
+ * Creates RPN stack of subtree of function ending at supplied element; subtrees equal to shared
+ * ones (except the subtree itself) are replaced by variables with their values
+ * - shared subtrees are numbered from the longest one, variables from the shortest one
+ * returns NULL if memory allocation failed
+ */
+static c_stack* multi_rewrite(const multi_program* multi, multi_function* fn, int end)
+{
+    c_stack* out;
+    rpn_element *el, **reversed;
+    int i, count;
+
+    reversed = (rpn_element**)malloc(sizeof(rpn_element*) * (end - fn->starts[end] + 1));
+    out = stck_create(end - fn->starts[end] + 1);
+    if (reversed == NULL || out == NULL)
+    {
+        free(reversed);
+        if (out != NULL)
+            stck_destroy(out);
+        return NULL;
+    }
+
+    /* from the end, so the longest subtree is replaced */
+    count = 0;
+    for (i = end; i >= fn->starts[end]; i--)
+    {
+        el = (rpn_element*)malloc(sizeof(rpn_element));
+        if (el == NULL)
+            break;
+
+        if (i != end && fn->shared[i] >= 0)
+        {
+            el->type = RPN_TOKEN_VARIABLE;
+            el->value.as_variable = MULTI_SHARED_VARIABLE(multi, multi->shared_count - 1 - fn->shared[i]);
+            el->arity = 0;
+            i = fn->starts[i];
+        }
+        else
+            memcpy(el, stck_get(fn->expanded, i), sizeof(rpn_element));
+
+        reversed[count++] = el;
+    }
+
+    while (count > 0)
+        stck_push(out, reversed[--count]);
+
+    if (i >= fn->starts[end])
+    {
+        stck_destroy(out);
+        out = NULL;
+    }
+    free(reversed);
+
+    return out;
+}
+
+/**
+ * Releases analysis of functions
+ */
+static void multi_release(multi_function* functions, int count)
+{
+    int f;
+
+    for (f = 0; f < count; f++)
+    {
+        if (functions[f].expanded != NULL)
+            stck_destroy(functions[f].expanded);
+        free(functions[f].starts);
+        free(functions[f].hashes);
+        free(functions[f].plain);
+        free(functions[f].varying);
+        free(functions[f].shared);
+        free(functions[f].covered);
+    }
+}
+
+/**
+ * Evaluates shared subexpressions, which do not depend on x, for bound parameter values
+ */
+static void multi_evaluate_invariants(multi_program* multi)
+{
+    double values[1 + MULTI_MAX_PARAMETERS + MULTI_MAX_SHARED];
+    int j;
+
+    values[0] = 0.0;
+    for (j = 0; j < multi->parameter_count; j++)
+        values[MULTI_PARAMETER_VARIABLE(j)] = multi->parameters[j];
+
+    /* they may use only parameters and other shared subexpressions not depending on x */
+    for (j = 0; j < multi->shared_count; j++)
+    {
+        values[MULTI_SHARED_VARIABLE(multi, j)] = 0.0;
+        if (multi->invariant[j])
+        {
+            multi->invariant_values[j] = prog_evaluate_vars(multi->shared[j], values);
+            values[MULTI_SHARED_VARIABLE(multi, j)] = multi->invariant_values[j];
+        }
+    }
+}
+
+/**
+ * Compiles functions (RPN stacks of parsed expressions) to be evaluated together; subexpressions
+ * occurring more than once (in one or more functions) are evaluated only once
+ * - variables following x up to "parameter_count" are parameters, all of them are zero until
+ *   bound by multi_bind
+ * returns NULL if some of functions is not valid, or memory allocation failed
+ */
+multi_program* multi_compile(c_stack** rpn_stacks, char** sources, int count, int parameter_count)
+{
+    multi_program* multi;
+    multi_function functions[MULTI_MAX_FUNCTIONS];
+    multi_subtree chosen[MULTI_MAX_SHARED];
+    multi_subtree* subtree;
+    c_stack* rewritten;
+    int f, j, fail;
+
+    if (count < 1 || count > MULTI_MAX_FUNCTIONS || parameter_count < 0 || parameter_count > MULTI_MAX_PARAMETERS)
+        return NULL;
+
+    multi = (multi_program*)malloc(sizeof(multi_program));
+    if (multi == NULL)
+        return NULL;
+    multi->count = 0;
+    multi->shared_count = 0;
+    multi->parameter_count = parameter_count;
+    for (j = 0; j < parameter_count; j++)
+        multi->parameters[j] = 0.0;
+
+    memset(functions, 0, sizeof(functions));
+    fail = 0;
+    for (f = 0; f < count && fail == 0; f++)
+        fail = multi_analyze(&functions[f], rpn_stacks[f], parameter_count);
+
+    if (fail == 0)
+    {
+        multi->shared_count = multi_choose_shared(functions, count, parameter_count, chosen);
+
+        /* the shortest shared subtree first, so every one is evaluated before it's used */
+        for (j = 0; j < multi->shared_count; j++)
+            multi->shared[j] = NULL;
+        for (j = 0; j < multi->shared_count && fail == 0; j++)
+        {
+            subtree = &chosen[multi->shared_count - 1 - j];
+            multi->invariant[j] = !functions[subtree->function].varying[subtree->end];
+            rewritten = multi_rewrite(multi, &functions[subtree->function], subtree->end);
+            multi->shared[j] = (rewritten != NULL) ? prog_compile(rewritten, "", 0, NULL) : NULL;
+            fail = (multi->shared[j] == NULL);
+            if (rewritten != NULL)
+                stck_destroy(rewritten);
+        }
+
+        for (f = 0; f < count && fail == 0; f++)
+        {
+            rewritten = multi_rewrite(multi, &functions[f], functions[f].expanded->curr);
+            multi->programs[f] = (rewritten != NULL) ? prog_compile(rewritten, sources[f], (int)strlen(sources[f]), NULL) : NULL;
+            fail = (multi->programs[f] == NULL);
+            if (rewritten != NULL)
+                stck_destroy(rewritten);
+            if (fail == 0)
+                multi->count++;
+        }
+    }
+
+    multi_release(functions, count);
+
+    if (fail != 0)
+    {
+        for (j = 0; j < multi->shared_count && multi->shared[j] != NULL; j++)
+            ;
+        multi->shared_count = j;
+        multi_destroy(multi);
+        return NULL;
+    }
+
+    multi_evaluate_invariants(multi);
+
+    return multi;
+}
+
+/**
+ * Initializes structure to evaluate single program without shared subexpressions (the program
+ * is not owned by it, the structure should not be destroyed)
+ */
+void multi_init_single(multi_program* multi, rpn_program* prog)
+{
+    multi->count = 1;
+    multi->programs[0] = prog;
+    multi->shared_count = 0;
+    multi->parameter_count = 0;
+}
+
+/**
+ * Binds parameter values (one for each parameter) - evaluates subexpressions not depending on x;
+ * structure copy may be bound to other values, so the same functions may be evaluated for more
+ * parameter values at once
+ */
+void multi_bind(multi_program* multi, const double* parameters)
+{
+    int j;
+
+    for (j = 0; j < multi->parameter_count; j++)
+        multi->parameters[j] = parameters[j];
+
+    multi_evaluate_invariants(multi);
+}
+
+/**
+ * Destroys compiled functions with their shared subexpressions
+ */
+void multi_destroy(multi_program* multi)
+{
+    int i;
+
+    for (i = 0; i < multi->count; i++)
+        prog_destroy(multi->programs[i]);
+    for (i = 0; i < multi->shared_count; i++)
+        prog_destroy(multi->shared[i]);
+
+    free(multi);
+}
+
+/**
+ * Evaluates one function in supplied point
+ */
+double multi_evaluate(multi_program* multi, int function, double x)
+{
+    double values[1 + MULTI_MAX_PARAMETERS + MULTI_MAX_SHARED];
+    int j;
+
+    values[0] = x;
+    for (j = 0; j < multi->parameter_count; j++)
+        values[MULTI_PARAMETER_VARIABLE(j)] = multi->parameters[j];
+    for (j = 0; j < multi->shared_count; j++)
+    {
+        if (multi->invariant[j])
+            values[MULTI_SHARED_VARIABLE(multi, j)] = multi->invariant_values[j];
+        else
+            values[MULTI_SHARED_VARIABLE(multi, j)] = prog_evaluate_vars(multi->shared[j], values);
+    }
+
+    return prog_evaluate_vars(multi->programs[function], values);
+}
+
+/**
+ * Fills block of variable values with the same value
+ */
+static void multi_fill(double* values, double value)
+{
+    int i;
+
+    for (i = 0; i < PROG_BLOCK_SIZE; i++)
+        values[i] = value;
+}
+
+/**
+ * Evaluates all functions in "count" points, values of function F are stored to out[F];
+ * for every block of samples, shared subexpressions are evaluated first, then all functions
+ * (parameters and subexpressions not depending on x are filled to their blocks only once)
+ */
+void multi_evaluate_block(multi_program* multi, const double* x_values, int count, double** out)
+{
+    double parameter_values[MULTI_MAX_PARAMETERS][PROG_BLOCK_SIZE];
+    double shared_values[MULTI_MAX_SHARED][PROG_BLOCK_SIZE];
+    double* variables[1 + MULTI_MAX_PARAMETERS + MULTI_MAX_SHARED];
+    int base, n, j, f;
+
+    variables[0] = (double*)x_values;
+
+    if (multi->shared_count == 0 && multi->parameter_count == 0)
+    {
+        for (f = 0; f < multi->count; f++)
+            prog_evaluate_block(multi->programs[f], variables, count, out[f]);
+        return;
+    }
+
+    for (j = 0; j < multi->parameter_count; j++)
+    {
+        multi_fill(parameter_values[j], multi->parameters[j]);
+        variables[MULTI_PARAMETER_VARIABLE(j)] = parameter_values[j];
+    }
+    for (j = 0; j < multi->shared_count; j++)
+    {
+        if (multi->invariant[j])
+            multi_fill(shared_values[j], multi->invariant_values[j]);
+        variables[MULTI_SHARED_VARIABLE(multi, j)] = shared_values[j];
+    }
+
+    for (base = 0; base < count; base += PROG_BLOCK_SIZE)
+    {
+        n = (count - base < PROG_BLOCK_SIZE) ? count - base : PROG_BLOCK_SIZE;
+        variables[0] = (double*)x_values + base;
+
+        for (j = 0; j < multi->shared_count; j++)
+        {
+            if (!multi->invariant[j])
+                prog_evaluate_block(multi->shared[j], variables, n, shared_values[j]);
+        }
+        for (f = 0; f < multi->count; f++)
+            prog_evaluate_block(multi->programs[f], variables, n, out[f] + base);
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef MATHPARSER_MULTI_H
+#define MATHPARSER_MULTI_H
+
+#define MULTI_MAX_FUNCTIONS 32                      /* maximum number of functions evaluated together */
+#define MULTI_MAX_SHARED 64                         /* maximum number of shared subexpressions */
+#define MULTI_MAX_PARAMETERS 8                      /* maximum number of parameters (constant for all samples) */
+#define MULTI_PARAMETER_VARIABLE(index) (1 + (index))   /* variable identifier of parameter with supplied index */
+#define MULTI_SHARED_VARIABLE(multi, index) (1 + (multi)->parameter_count + (index))   /* variable identifier of value of shared subexpression */
+
+/* functions of x evaluated together in one pass; subexpressions occurring more than once are
+ * compiled to separate programs, evaluated only once, and their values are passed to programs
+ * using them as additional variables; subexpressions of parameters only (not of x) are evaluated
+ * once, when parameter values are bound */
+typedef struct
+{
+    int count;                                      /* number of functions */
+    rpn_program* programs[MULTI_MAX_FUNCTIONS];     /* function programs; variable 0 is x, then parameters and shared subexpressions */
+    int shared_count;                               /* number of shared subexpressions */
+    rpn_program* shared[MULTI_MAX_SHARED];          /* shared subexpressions, every one may use the ones before it */
+    char invariant[MULTI_MAX_SHARED];               /* shared subexpression does not depend on x */
+    double invariant_values[MULTI_MAX_SHARED];      /* values of subexpressions not depending on x for bound parameters */
+    int parameter_count;                            /* number of parameters */
+    double parameters[MULTI_MAX_PARAMETERS];        /* bound parameter values */
+} multi_program;
+
+multi_program* multi_compile(c_stack** rpn_stacks, char** sources, int count, int parameter_count);
+void multi_init_single(multi_program* multi, rpn_program* prog);
+void multi_bind(multi_program* multi, const double* parameters);
+void multi_destroy(multi_program* multi);
+
+double multi_evaluate(multi_program* multi, int function, double x);
+void multi_evaluate_block(multi_program* multi, const double* x_values, int count, double** out);
+
+#endif
@@ -0,0 +1,331 @@
+#include <stdlib.h>
+#include <math.h>
+#include "polyline.h"
+
+/*
+ * Polyline stages receive points of plotted function one by one (as commands of poly_sink)
+ * and pass reduced polyline to the next stage, which is usually the PostScript pen. Every
+ * stage holds only a constant amount of points, so any number of samples may stream through.
+ *
+ * Decimation splits the plot to pixel columns. From all points of one column, only the first
+ * one, the last one and the ones with minimal and maximal Y coordinate are passed on (in order
+ * they came in). Lines connecting them cover the same pixels as the original polyline, so the
+ * output size depends on plot width, not on number of samples.
+ *
+ * Simplification (Ramer-Douglas-Peucker) keeps both ends of polyline, finds the vertex farthest
+ * from line connecting them, and if it's farther than tolerance, keeps it and processes both parts
+ * the same way. Vertices are collected to window of fixed size; when it's full, it's simplified and
+ * its last vertex starts the next window, so the memory is bounded and vertex is never delayed for
+ * more than one window.
+ *
+ * Recording stores the reduced polyline of one of several functions sampled together, so it's
+ * drawn at once after sampling; its size is bounded by the stages before it, not by samples.
+ */
+
+/**
+ * Initializes decimation stage passing its output to supplied sink
+ */
+void poly_decimator_init(poly_decimator* dec, double origin, double column_width, poly_sink sink, void* context)
+{
+    dec->sink = sink;
+    dec->context = context;
+    dec->origin = origin;
+    dec->column_width = column_width;
+    dec->column = 0;
+    dec->count = 0;
+    dec->points_in = 0;
+    dec->points_out = 0;
+}
+
+/**
+ * Passes point to next stage
+ */
+static void poly_decimator_emit(poly_decimator* dec, int command, const poly_point* point)
+{
+    dec->sink(dec->context, command, point->x, point->y);
+    dec->points_out++;
+}
+
+/**
+ * Passes the rest of collected column to next stage - the first point was passed when the column
+ * was started, so only minimum and maximum (in order of input) and the last point remain
+ */
+static void poly_decimator_flush(poly_decimator* dec)
+{
+    const poly_point *earlier, *later;
+
+    if (dec->count < 2)
+        return;
+
+    if (dec->min.index <= dec->max.index)
+    {
+        earlier = &dec->min;
+        later = &dec->max;
+    }
+    else
+    {
+        earlier = &dec->max;
+        later = &dec->min;
+    }
+
+    /* the first and the last point are emitted anyway */
+    if (earlier->index != dec->first.index && earlier->index != dec->last.index)
+        poly_decimator_emit(dec, POLY_DRAW, earlier);
+    if (later->index != earlier->index && later->index != dec->first.index && later->index != dec->last.index)
+        poly_decimator_emit(dec, POLY_DRAW, later);
+
+    poly_decimator_emit(dec, POLY_DRAW, &dec->last);
+}
+
+/**
+ * Starts new column with supplied point, passing it to next stage
+ */
+static void poly_decimator_start(poly_decimator* dec, int command, long column, double x, double y)
+{
+    dec->column = column;
+    dec->count = 1;
+    dec->first.x = x;
+    dec->first.y = y;
+    dec->first.index = dec->points_in;
+    dec->last = dec->first;
+    dec->min = dec->first;
+    dec->max = dec->first;
+
+    poly_decimator_emit(dec, command, &dec->first);
+}
+
+/**
+ * Decimation stage sink - receives polyline command (decimator is poly_decimator structure)
+ */
+void poly_decimate(void* decimator, int command, double x, double y)
+{
+    poly_decimator* dec = (poly_decimator*)decimator;
+    long column;
+
+    if (command == POLY_END)
+    {
+        poly_decimator_flush(dec);
+        dec->count = 0;
+        dec->sink(dec->context, POLY_END, x, y);
+        return;
+    }
+
+    column = (long)floor((x - dec->origin) / dec->column_width);
+
+    if (command == POLY_MOVE || dec->count == 0 || column != dec->column)
+    {
+        poly_decimator_flush(dec);
+        poly_decimator_start(dec, command, column, x, y);
+    }
+    else
+    {
+        dec->last.x = x;
+        dec->last.y = y;
+        dec->last.index = dec->points_in;
+        if (y < dec->min.y)
+            dec->min = dec->last;
+        if (y > dec->max.y)
+            dec->max = dec->last;
+        dec->count++;
+    }
+
+    dec->points_in++;
+}
+
+/**
+ * Initializes simplification stage passing its output to supplied sink
+ */
+void poly_simplifier_init(poly_simplifier* simp, double tolerance, poly_sink sink, void* context)
+{
+    simp->sink = sink;
+    simp->context = context;
+    simp->tolerance = tolerance;
+    simp->count = 0;
+    simp->points_in = 0;
+    simp->points_out = 0;
+}
+
+/**
+ * Retrieves distance of point from segment connecting a and b
+ */
+static double poly_segment_distance(const poly_point* point, const poly_point* a, const poly_point* b)
+{
+    double dx, dy, px, py, length, t;
+
+    dx = b->x - a->x;
+    dy = b->y - a->y;
+    px = point->x - a->x;
+    py = point->y - a->y;
+
+    length = dx * dx + dy * dy;
+    t = (length > 0.0) ? (px * dx + py * dy) / length : 0.0;
+    if (t < 0.0)
+        t = 0.0;
+    else if (t > 1.0)
+        t = 1.0;
+
+    px -= t * dx;
+    py -= t * dy;
+
+    return sqrt(px * px + py * py);
+}
+
+/**
+ * Simplifies the window and passes kept vertices (except the first one, which was passed before)
+ * to next stage; the last vertex stays in window as the first one of next window
+ */
+static void poly_simplifier_flush(poly_simplifier* simp)
+{
+    int i, first, last, farthest, top;
+    double distance, max_distance;
+
+    if (simp->count < 2)
+        return;
+
+    for (i = 0; i < simp->count; i++)
+        simp->keep[i] = 0;
+    simp->keep[0] = 1;
+    simp->keep[simp->count - 1] = 1;
+
+    /* ranges are processed in order, the stack holds ends of ranges, which start at previous kept vertex */
+    first = 0;
+    top = 0;
+    simp->stack[top++] = simp->count - 1;
+    while (top > 0)
+    {
+        last = simp->stack[top - 1];
+
+        farthest = -1;
+        max_distance = simp->tolerance;
+        for (i = first + 1; i < last; i++)
+        {
+            distance = poly_segment_distance(&simp->window[i], &simp->window[first], &simp->window[last]);
+            if (distance > max_distance)
+            {
+                max_distance = distance;
+                farthest = i;
+            }
+        }
+
+        if (farthest >= 0)
+        {
+            simp->keep[farthest] = 1;
+            simp->stack[top++] = farthest;
+        }
+        else
+        {
+            first = last;
+            top--;
+        }
+    }
+
+    for (i = 1; i < simp->count; i++)
+    {
+        if (simp->keep[i])
+        {
+            simp->sink(simp->context, POLY_DRAW, simp->window[i].x, simp->window[i].y);
+            simp->points_out++;
+        }
+    }
+
+    simp->window[0] = simp->window[simp->count - 1];
+    simp->count = 1;
+}
+
+/**
+ * Simplification stage sink - receives polyline command (simplifier is poly_simplifier structure)
+ */
+void poly_simplify(void* simplifier, int command, double x, double y)
+{
+    poly_simplifier* simp = (poly_simplifier*)simplifier;
+
+    if (command == POLY_END)
+    {
+        poly_simplifier_flush(simp);
+        simp->count = 0;
+        simp->sink(simp->context, POLY_END, x, y);
+        return;
+    }
+
+    if (command == POLY_MOVE || simp->count == 0)
+    {
+        poly_simplifier_flush(simp);
+        simp->count = 0;
+        simp->sink(simp->context, command, x, y);
+        simp->points_out++;
+    }
+    else if (simp->count == POLY_SIMPLIFY_WINDOW)
+        poly_simplifier_flush(simp);
+
+    simp->window[simp->count].x = x;
+    simp->window[simp->count].y = y;
+    simp->window[simp->count].index = simp->points_in;
+    simp->count++;
+    simp->points_in++;
+}
+
+/**
+ * Initializes empty recording stage
+ */
+void poly_recorder_init(poly_recorder* rec)
+{
+    rec->entries = NULL;
+    rec->count = 0;
+    rec->capacity = 0;
+    rec->failed = 0;
+}
+
+/**
+ * Recording stage sink - stores polyline command (recorder is poly_recorder structure); when memory
+ * allocation fails, the recording stops
+ */
+void poly_record(void* recorder, int command, double x, double y)
+{
+    poly_recorder* rec = (poly_recorder*)recorder;
+    poly_record_entry* entries;
+    long capacity;
+
+    if (rec->failed)
+        return;
+
+    if (rec->count == rec->capacity)
+    {
+        capacity = (rec->capacity > 0) ? 2 * rec->capacity : POLY_RECORD_INITIAL;
+        entries = (poly_record_entry*)realloc(rec->entries, sizeof(poly_record_entry) * capacity);
+        if (entries == NULL)
+        {
+            rec->failed = 1;
+            return;
+        }
+        rec->entries = entries;
+        rec->capacity = capacity;
+    }
+
+    rec->entries[rec->count].command = command;
+    rec->entries[rec->count].x = x;
+    rec->entries[rec->count].y = y;
+    rec->count++;
+}
+
+/**
+ * Passes recorded commands to supplied sink; if the recording was cut, polyline in progress is finished
+ */
+void poly_replay(poly_recorder* rec, poly_sink sink, void* context)
+{
+    long i;
+
+    for (i = 0; i < rec->count; i++)
+        sink(context, rec->entries[i].command, rec->entries[i].x, rec->entries[i].y);
+
+    if (rec->count > 0 && rec->entries[rec->count - 1].command != POLY_END)
+        sink(context, POLY_END, 0, 0);
+}
+
+/**
+ * Releases recorded commands
+ */
+void poly_recorder_release(poly_recorder* rec)
+{
+    free(rec->entries);
+    poly_recorder_init(rec);
+}
@@ -0,0 +1,88 @@
+#ifndef MATHPARSER_POLYLINE_H
+#define MATHPARSER_POLYLINE_H
+
+#define POLY_COLUMN_WIDTH 1.0           /* width of one output pixel column (in device units) */
+#define POLY_SIMPLIFY_TOLERANCE 0.25    /* maximum distance of removed vertex from simplified polyline (in device units) */
+#define POLY_SIMPLIFY_WINDOW 1024       /* maximum number of vertices simplified at once */
+#define POLY_RECORD_INITIAL 256         /* initial number of commands recording stage has space for */
+
+/* polyline command, passed from one stage to the next one */
+enum poly_command
+{
+    POLY_MOVE,                          /* start new polyline in supplied point */
+    POLY_DRAW,                          /* continue polyline to supplied point */
+    POLY_END                            /* finish polyline (point is ignored) */
+};
+
+/* polyline stage or final consumer - receives commands with points in device coordinates */
+typedef void (*poly_sink)(void* context, int command, double x, double y);
+
+/* vertex of polyline, with its position in input */
+typedef struct
+{
+    double x, y;
+    long index;
+} poly_point;
+
+/* min/max decimation stage (M4) - keeps first, last, minimal and maximal point of every pixel column */
+typedef struct
+{
+    poly_sink sink;                     /* next stage */
+    void* context;                      /* context of next stage */
+    double origin;                      /* device X coordinate of column 0 */
+    double column_width;                /* width of one column */
+
+    long column;                        /* column of points collected so far */
+    long count;                         /* number of points collected in the column (0 = none) */
+    poly_point first, last, min, max;   /* points of the column, which may be emitted */
+
+    long points_in;                     /* number of points received */
+    long points_out;                    /* number of points passed to next stage */
+} poly_decimator;
+
+/* Ramer-Douglas-Peucker simplification stage - removes vertices closer than tolerance to the
+ * simplified polyline; works in windows of POLY_SIMPLIFY_WINDOW vertices */
+typedef struct
+{
+    poly_sink sink;                     /* next stage */
+    void* context;                      /* context of next stage */
+    double tolerance;                   /* maximum distance of removed vertex */
+
+    poly_point window[POLY_SIMPLIFY_WINDOW];    /* vertices waiting for simplification, the first one was passed on */
+    int count;                          /* number of vertices in window (0 = no polyline in progress) */
+    char keep[POLY_SIMPLIFY_WINDOW];    /* vertex of window is kept */
+    int stack[POLY_SIMPLIFY_WINDOW];    /* ends of ranges waiting for processing */
+
+    long points_in;                     /* number of points received */
+    long points_out;                    /* number of points passed to next stage */
+} poly_simplifier;
+
+/* recorded polyline command */
+typedef struct
+{
+    int command;                        /* enum poly_command */
+    double x, y;
+} poly_record_entry;
+
+/* recording stage - stores reduced polyline, so it may be passed on later (polylines of several
+ * functions are produced together, but each of them is drawn at once) */
+typedef struct
+{
+    poly_record_entry* entries;         /* recorded commands */
+    long count;                         /* number of recorded commands */
+    long capacity;                      /* number of commands entries have space for */
+    int failed;                         /* memory allocation failed, commands after the last recorded one were lost */
+} poly_recorder;
+
+void poly_decimator_init(poly_decimator* dec, double origin, double column_width, poly_sink sink, void* context);
+void poly_decimate(void* decimator, int command, double x, double y);
+
+void poly_simplifier_init(poly_simplifier* simp, double tolerance, poly_sink sink, void* context);
+void poly_simplify(void* simplifier, int command, double x, double y);
+
+void poly_recorder_init(poly_recorder* rec);
+void poly_record(void* recorder, int command, double x, double y);
+void poly_replay(poly_recorder* rec, poly_sink sink, void* context);
+void poly_recorder_release(poly_recorder* rec);
+
+#endif
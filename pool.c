@@ -0,0 +1,353 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifndef _WIN32
+#include <pthread.h>
+#include <unistd.h>
+#else
+#include <windows.h>
+#endif
+#include "pool.h"
+
+/*
+ * The pool runs "parallel for" batches - every batch consists of "count" tasks identified
+ * by their index, and the caller thread participates on processing too. Batch started while
+ * another one is being processed (i.e. from within its task) is processed serially by its caller,
+ * so routines may use the pool no matter whether they run in its task. On platforms without
+ * POSIX threads (i.e. MSVS case) the tasks are just processed serially by the caller.
+ */
+
+struct _thread_pool
+{
+    int thread_count;                   /* number of threads including the caller */
+#ifndef _WIN32
+    pthread_t* workers;                 /* worker threads (thread_count - 1 of them) */
+    pthread_mutex_t lock;               /* guards everything below */
+    pthread_cond_t work_cond;           /* signalled when new batch is ready */
+    pthread_cond_t done_cond;           /* signalled when worker finishes its batch */
+
+    pool_task_routine routine;          /* routine of current batch */
+    void* arg;                          /* argument of current batch */
+    int count;                          /* number of tasks in current batch */
+    int next;                           /* next task index to be picked */
+    int finished;                       /* number of workers done with current batch */
+    unsigned long generation;           /* batch counter, so the workers know there's something new */
+    int running;                        /* flag of batch being processed */
+    int shutdown;                       /* flag for workers to exit */
+#endif
+};
+
+struct _pool_lock
+{
+#ifndef _WIN32
+    pthread_mutex_t mutex;
+#else
+    CRITICAL_SECTION section;
+#endif
+};
+
+/**
+ * Retrieves number of online processors, to be used as implicit thread count
+ */
+int pool_default_threads(void)
+{
+#if !defined(_WIN32) && defined(_SC_NPROCESSORS_ONLN)
+    long cnt = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (cnt < 1)
+        return 1;
+    if (cnt > POOL_MAX_THREADS)
+        return POOL_MAX_THREADS;
+    return (int)cnt;
+#else
+    return 1;
+#endif
+}
+
+#ifndef _WIN32
+/**
+ * Picks tasks of current batch until there's nothing left; expects the lock to be held
+ */
+static void pool_process_tasks(thread_pool* pool)
+{
+    int index;
+
+    while (pool->next < pool->count)
+    {
+        index = pool->next++;
+
+        pthread_mutex_unlock(&pool->lock);
+        pool->routine(pool->arg, index);
+        pthread_mutex_lock(&pool->lock);
+    }
+}
+
+/**
+ * Worker thread body - waits for batch, processes it and reports back
+ */
+static void* pool_worker(void* param)
+{
+    thread_pool* pool = (thread_pool*)param;
+    unsigned long seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    while (1)
+    {
+        while (!pool->shutdown && pool->generation == seen)
+            pthread_cond_wait(&pool->work_cond, &pool->lock);
+
+        if (pool->shutdown)
+            break;
+
+        seen = pool->generation;
+
+        pool_process_tasks(pool);
+
+        pool->finished++;
+        pthread_cond_signal(&pool->done_cond);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+#endif
+
+/**
+ * Creates thread pool with specified number of threads (including the caller one);
+ * non-positive count means the implicit thread count
+ */
+thread_pool* pool_create(int threads)
+{
+    thread_pool* pool;
+#ifndef _WIN32
+    int i;
+#endif
+
+    if (threads <= 0)
+        threads = pool_default_threads();
+    if (threads > POOL_MAX_THREADS)
+        threads = POOL_MAX_THREADS;
+
+    pool = (thread_pool*)malloc(sizeof(thread_pool));
+    if (pool == NULL)
+        return NULL;
+
+    memset(pool, 0, sizeof(thread_pool));
+    pool->thread_count = 1;
+
+#ifndef _WIN32
+    pool->workers = NULL;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+
+    if (threads > 1)
+    {
+        pool->workers = (pthread_t*)malloc(sizeof(pthread_t) * (threads - 1));
+        if (pool->workers == NULL)
+            return pool;
+
+        /* when thread creation fails, we just continue with less threads */
+        for (i = 0; i < threads - 1; i++)
+        {
+            if (pthread_create(&pool->workers[i], NULL, pool_worker, pool) != 0)
+                break;
+            pool->thread_count++;
+        }
+    }
+#endif
+
+    return pool;
+}
+
+/**
+ * Stops all worker threads and frees the pool structure
+ */
+void pool_destroy(thread_pool* pool)
+{
+#ifndef _WIN32
+    int i;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (i = 0; i < pool->thread_count - 1; i++)
+        pthread_join(pool->workers[i], NULL);
+
+    free(pool->workers);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work_cond);
+    pthread_cond_destroy(&pool->done_cond);
+#endif
+
+    free(pool);
+}
+
+/**
+ * Retrieves number of threads working in the pool (including the caller one)
+ */
+int pool_thread_count(thread_pool* pool)
+{
+    return (pool != NULL) ? pool->thread_count : 1;
+}
+
+/**
+ * Runs "count" tasks with supplied routine, every task receives its index; returns after
+ * all tasks are finished. NULL pool is valid and means serial processing, as well as the pool
+ * processing another batch
+ */
+void pool_run(thread_pool* pool, pool_task_routine routine, void* arg, int count)
+{
+    int i;
+
+    if (count <= 0)
+        return;
+
+    /* nothing to parallelize */
+    if (pool == NULL || pool->thread_count == 1 || count == 1)
+    {
+        for (i = 0; i < count; i++)
+            routine(arg, i);
+        return;
+    }
+
+#ifndef _WIN32
+    pthread_mutex_lock(&pool->lock);
+
+    /* the workers are busy with another batch, which may even wait for this one */
+    if (pool->running)
+    {
+        pthread_mutex_unlock(&pool->lock);
+        for (i = 0; i < count; i++)
+            routine(arg, i);
+        return;
+    }
+
+    pool->running = 1;
+    pool->routine = routine;
+    pool->arg = arg;
+    pool->count = count;
+    pool->next = 0;
+    pool->finished = 0;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work_cond);
+
+    /* caller thread also helps */
+    pool_process_tasks(pool);
+
+    /* and waits for everyone else to finish */
+    while (pool->finished < pool->thread_count - 1)
+        pthread_cond_wait(&pool->done_cond, &pool->lock);
+
+    pool->running = 0;
+    pthread_mutex_unlock(&pool->lock);
+#endif
+}
+
+/**
+ * Creates mutual exclusion lock
+ */
+pool_lock* pool_lock_create(void)
+{
+    pool_lock* lock = (pool_lock*)malloc(sizeof(pool_lock));
+    if (lock == NULL)
+        return NULL;
+
+#ifndef _WIN32
+    pthread_mutex_init(&lock->mutex, NULL);
+#else
+    InitializeCriticalSection(&lock->section);
+#endif
+
+    return lock;
+}
+
+/**
+ * Destroys mutual exclusion lock (must not be held)
+ */
+void pool_lock_destroy(pool_lock* lock)
+{
+#ifndef _WIN32
+    pthread_mutex_destroy(&lock->mutex);
+#else
+    DeleteCriticalSection(&lock->section);
+#endif
+
+    free(lock);
+}
+
+/**
+ * Acquires lock, waits if someone else holds it
+ */
+void pool_lock_acquire(pool_lock* lock)
+{
+#ifndef _WIN32
+    pthread_mutex_lock(&lock->mutex);
+#else
+    EnterCriticalSection(&lock->section);
+#endif
+}
+
+/**
+ * Releases previously acquired lock
+ */
+void pool_lock_release(pool_lock* lock)
+{
+#ifndef _WIN32
+    pthread_mutex_unlock(&lock->mutex);
+#else
+    LeaveCriticalSection(&lock->section);
+#endif
+}
+
+/**
+ * Atomically adds delta to supplied value and returns the new value; acts as full memory barrier
+ */
+long pool_atomic_add(volatile long* value, long delta)
+{
+#if defined(__GNUC__)
+    return __sync_add_and_fetch(value, delta);
+#elif defined(_WIN32)
+    return InterlockedExchangeAdd(value, delta) + delta;
+#else
+    /* no atomic support known, but also no threads in that case */
+    return (*value += delta);
+#endif
+}
+
+/**
+ * Full memory barrier - no load or store is reordered across this call
+ */
+void pool_memory_barrier(void)
+{
+#if defined(__GNUC__)
+    __sync_synchronize();
+#elif defined(_WIN32)
+    MemoryBarrier();
+#endif
+}
+
+/**
+ * Retrieves wall clock time in seconds from unspecified starting point (for measuring duration
+ * of parallel work, where processor time of the caller is not relevant)
+ */
+double pool_wall_time(void)
+{
+#if !defined(_WIN32) && defined(CLOCK_MONOTONIC)
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1.0e9;
+#elif defined(_WIN32)
+    return (double)GetTickCount() / 1000.0;
+#else
+    return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
@@ -0,0 +1,33 @@
+#ifndef MATHPARSER_POOL_H
+#define MATHPARSER_POOL_H
+
+#define POOL_MAX_THREADS 256            /* maximum number of worker threads in one pool */
+
+/* task routine prototype - receives shared argument and index of task to be processed */
+typedef void (*pool_task_routine)(void* arg, int index);
+
+/* opaque thread pool structure, defined in pool.c */
+typedef struct _thread_pool thread_pool;
+
+/* opaque mutual exclusion lock, defined in pool.c */
+typedef struct _pool_lock pool_lock;
+
+int pool_default_threads(void);
+
+thread_pool* pool_create(int threads);
+void pool_destroy(thread_pool* pool);
+int pool_thread_count(thread_pool* pool);
+
+void pool_run(thread_pool* pool, pool_task_routine routine, void* arg, int count);
+
+pool_lock* pool_lock_create(void);
+void pool_lock_destroy(pool_lock* lock);
+void pool_lock_acquire(pool_lock* lock);
+void pool_lock_release(pool_lock* lock);
+
+long pool_atomic_add(volatile long* value, long delta);
+void pool_memory_barrier(void);
+
+double pool_wall_time(void);
+
+#endif
@@ -1,165 +1,713 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include "main.h"
-#include "postscript.h"
-
-/**
- * Creates document structure, opens file for writing
- */
-ps_document* ps_create_document(char* filename)
-{
-    ps_document* doc = (ps_document*)malloc(sizeof(ps_document));
-    if (!doc)
-        return NULL;
-    doc->filename = filename;
-    doc->file = fopen(filename, "w");
-
-    /* if the file could not be opened, return NULL and let the caller handle it */
-    if (doc->file == NULL)
-    {
-        free(doc);
-        return NULL;
-    }
-
-    return doc;
-}
-
-/**
- * Closes document file handle and frees the structure
- */
-void ps_close_document(ps_document* doc)
-{
-    fclose(doc->file);
-    free(doc);
-}
-
-/**
-* Creates pen structure and points it to initial location
-*/
-ps_pen* ps_create_pen(ps_document* doc, double init_x, double init_y)
-{
-    ps_pen* pen = (ps_pen*)malloc(sizeof(ps_pen));
-    if (pen == NULL)
-        return NULL;
-    pen->document = doc;
-    pen->pos_x = init_x;
-    pen->pos_y = init_y;
-    return pen;
-}
-
-/**
- * Destroys pen structure
- */
-void ps_destroy_pen(ps_pen* pen)
-{
-    free(pen);
-}
-
-/**
- * Writes PostScript header to file with supplied values
- */
-void ps_write_header(ps_document* doc, const char* creator, const char* title, const char* datestring)
-{
-    fprintf(doc->file, PS_FORMAT_IDENTIFIER "\n");
-    fprintf(doc->file, PS_CREATOR_IDENTIFIER "%s\n", creator);
-    fprintf(doc->file, PS_TITLE_IDENTIFIER "%s\n", title);
-    fprintf(doc->file, PS_CREATION_DATE_IDENTIFIER "%s", datestring);
-    fprintf(doc->file, PS_END_COMMENTS_IDENTIFIER "\n");
-}
-
-/**
- * Sets font to be used, needs to have supplied font family and size multiplier
- */
-void ps_set_font(ps_document* doc, const char* font_family, int size)
-{
-    fprintf(doc->file, "/%s " PS_FIND_FONT " %i " PS_SCALE_FONT " " PS_SET_FONT "\n", font_family, size);
-}
-
-/**
- * Prints plain text on current location
- */
-void ps_print_text(ps_document* doc, char* text)
-{
-    fprintf(doc->file, "(%s) " PS_TEXT_PRINT "\n", text);
-}
-
-/**
- * Prints numeric value on current location, using custom number formatter
- */
-void ps_print_text_val(ps_document* doc, double val, const char* formatter)
-{
-    char outbuff[64];
-    /* due to absence of snprintf in MSVC, and also in C89, the Splint tool
-     * will complain at following line */
-    sprintf(outbuff, "(%s) " PS_TEXT_PRINT "\n", formatter);
-    fprintf(doc->file, outbuff, val);
-}
-
-/**
- * Sets output color, this applies to all shapes, lines and text
- */
-void ps_set_color(ps_document* doc, double r, double g, double b)
-{
-    fprintf(doc->file, "%f %f %f " PS_SET_COLOR "\n", r, g, b);
-}
-
-/**
- * Sets current position in document
- */
-void ps_set_position(ps_document* doc, double to_x, double to_y)
-{
-    fprintf(doc->file, "%f %f " PS_MOVE_TO "\n", to_x, to_y);
-}
-
-/**
- * Moves pen to specified location
- */
-void ps_pen_move(ps_pen* pen, double to_x, double to_y)
-{
-    pen->pos_x = to_x;
-    pen->pos_y = to_y;
-}
-
-/**
- * Puts pen down, starting new path
- */
-void ps_pen_down(ps_pen* pen)
-{
-    fprintf(pen->document->file, PS_NEW_PATH "\n");
-    fprintf(pen->document->file, "%f %f " PS_MOVE_TO "\n", pen->pos_x, pen->pos_y);
-}
-
-/**
- * Draws line from current position to supplied position, and updates pen position
- */
-void ps_pen_draw(ps_pen* pen, double to_x, double to_y)
-{
-    pen->pos_x = to_x;
-    pen->pos_y = to_y;
-
-    fprintf(pen->document->file, "%f %f " PS_LINE_TO "\n", pen->pos_x, pen->pos_y);
-}
-
-/**
- * Closes path (making it circular) drawn with pen
- */
-void ps_pen_close_path(ps_pen* pen)
-{
-    fprintf(pen->document->file, PS_CLOSE_PATH "\n");
-}
-
-/**
- * Puts pen up, stroking the path we've drawn
- */
-void ps_pen_up(ps_pen* pen)
-{
-    fprintf(pen->document->file, PS_STROKE "\n");
-}
-
-/**
- * Sets line thickness
- */
-void ps_set_line_width(ps_document* doc, double width)
-{
-    fprintf(doc->file, "%f " PS_LINEWIDTH "\n", width);
-}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "main.h"
+#include "raster.h"
+#include "postscript.h"
+
+/* powers of ten, which scale numbers to supported number of decimals */
+static const double ps_powers[PS_MAX_DECIMALS + 1] =
+{
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9
+};
+
+/**
+ * Formats number with fixed number of decimals (0 to PS_MAX_DECIMALS), exactly as printf "%.*f"
+ * does, but without locale (always decimal point) and much faster; the output buffer has to
+ * have at least PS_NUMBER_LENGTH bytes
+ * - the number is scaled by power of ten, and the rounding error of scaling is recovered exactly
+ *   (Dekker's product), so ties are decided by the exact binary value as printf decides them
+ * - numbers of more than 9 integer digits or more than 52 bits when scaled, infinities and NaN
+ *   are left to printf
+ * Returns length of formatted number
+ */
+int ps_format_number(char* out, double val, int decimals)
+{
+    char digits[24];
+    double abs_val, scale, scaled, error, high, low, rounded, diff;
+    unsigned long whole, fraction;
+    int length, count, i;
+
+    abs_val = fabs(val);
+    if (decimals < 0 || decimals > PS_MAX_DECIMALS || !(abs_val < 1e9))
+        return sprintf(out, "%.*f", decimals, val);
+
+    /* exact product abs_val * scale = scaled + error (scale has no more than 26 significant bits,
+     * so only abs_val needs to be split) */
+    scale = ps_powers[decimals];
+    scaled = abs_val * scale;
+    if (!(scaled < 4503599627370496.0))
+        return sprintf(out, "%.*f", decimals, val);
+    high = abs_val * 134217729.0;
+    high = high - (high - abs_val);
+    low = abs_val - high;
+    error = (high * scale - scaled) + low * scale;
+
+    /* round half to even, decided by the exact value (the difference from half is exact whenever
+     * it's close to zero) */
+    rounded = floor(scaled);
+    diff = (scaled - rounded) - 0.5;
+    if (diff + error > 0 || (diff + error == 0 && fmod(rounded, 2) != 0))
+        rounded += 1;
+
+    /* both parts are integers below 1e9, the division is corrected if it was rounded across one */
+    high = floor(rounded / scale);
+    low = rounded - high * scale;
+    if (low < 0)
+    {
+        high -= 1;
+        low += scale;
+    }
+    else if (low >= scale)
+    {
+        high += 1;
+        low -= scale;
+    }
+    whole = (unsigned long)high;
+    fraction = (unsigned long)low;
+
+    length = 0;
+    /* negative zero keeps its sign, as with printf */
+    if (val < 0 || (val == 0 && 1 / val < 0))
+        out[length++] = '-';
+
+    count = 0;
+    do
+    {
+        digits[count++] = (char)('0' + whole % 10);
+        whole /= 10;
+    } while (whole > 0);
+    while (count > 0)
+        out[length++] = digits[--count];
+
+    if (decimals > 0)
+    {
+        out[length++] = '.';
+        for (i = decimals - 1; i >= 0; i--)
+        {
+            out[length + i] = (char)('0' + fraction % 10);
+            fraction /= 10;
+        }
+        length += decimals;
+    }
+    out[length] = '\0';
+
+    return length;
+}
+
+/**
+ * Writes buffered output of document to its file
+ */
+static void ps_flush(ps_document* doc)
+{
+    if (doc->buffer_length > 0)
+        fwrite(doc->buffer, 1, (size_t)doc->buffer_length, doc->file);
+    doc->buffer_length = 0;
+}
+
+/**
+ * Appends bytes to output buffer of document, long data are written directly
+ */
+static void ps_write(ps_document* doc, const char* data, int length)
+{
+    if (doc->buffer_length + length > PS_BUFFER_SIZE)
+    {
+        ps_flush(doc);
+        if (length > PS_BUFFER_SIZE)
+        {
+            fwrite(data, 1, (size_t)length, doc->file);
+            return;
+        }
+    }
+    memcpy(doc->buffer + doc->buffer_length, data, (size_t)length);
+    doc->buffer_length += length;
+}
+
+/**
+ * Appends string to output buffer of document
+ */
+static void ps_write_string(ps_document* doc, const char* text)
+{
+    ps_write(doc, text, (int)strlen(text));
+}
+
+/**
+ * Shortens formatted number for compact output - drops trailing zeros of decimals (and the point
+ * then), zero integer part of fraction and sign of zero
+ * Returns new length
+ */
+static int ps_trim_number(char* number, int length)
+{
+    int start;
+
+    if (memchr(number, '.', (size_t)length) != NULL)
+    {
+        while (number[length - 1] == '0')
+            length--;
+        if (number[length - 1] == '.')
+            length--;
+    }
+
+    start = (number[0] == '-') ? 1 : 0;
+    if (length == start + 1 && number[start] == '0')
+    {
+        number[0] = '0';
+        return 1;
+    }
+    if (length > start + 1 && number[start] == '0' && number[start + 1] == '.')
+    {
+        memmove(number + start, number + start + 1, (size_t)(length - start - 1));
+        length--;
+    }
+
+    return length;
+}
+
+/**
+ * Appends number with supplied number of decimals, followed by space, to output buffer of document;
+ * compact output drops needless characters of the number
+ */
+static void ps_write_decimals(ps_document* doc, double val, int decimals)
+{
+    int length;
+
+    if (doc->buffer_length + PS_NUMBER_LENGTH > PS_BUFFER_SIZE)
+        ps_flush(doc);
+    length = ps_format_number(doc->buffer + doc->buffer_length, val, decimals);
+    if (doc->compact >= 0)
+        length = ps_trim_number(doc->buffer + doc->buffer_length, length);
+    doc->buffer_length += length;
+    doc->buffer[doc->buffer_length++] = ' ';
+}
+
+/**
+ * Appends number with PS_DECIMALS decimals, followed by space, to output buffer of document
+ */
+static void ps_write_number(ps_document* doc, double val)
+{
+    ps_write_decimals(doc, val, PS_DECIMALS);
+}
+
+/**
+ * Ends pending line of path commands of compact output
+ */
+static void ps_end_run(ps_document* doc)
+{
+    if (doc->run > 0)
+        ps_write_string(doc, "\n");
+    doc->run = 0;
+}
+
+/**
+ * Appends command (its short procedure in compact output) ending line to output buffer of document
+ */
+static void ps_write_command(ps_document* doc, const char* command, const char* compact_command)
+{
+    ps_write_string(doc, (doc->compact < 0) ? command : compact_command);
+    ps_write_string(doc, "\n");
+}
+
+/**
+ * Appends command, which ends path or subpath, to output buffer of document; compact output
+ * writes it on pending line of path commands
+ */
+static void ps_write_path_end(ps_document* doc, const char* command, const char* compact_command)
+{
+    if (doc->run > 0)
+        ps_write_string(doc, " ");
+    doc->run = 0;
+    ps_write_command(doc, command, compact_command);
+}
+
+/**
+ * Appends path vertex (with moveto or lineto) to output buffer of document - plain output writes
+ * absolute position; compact output rounds the position to its decimals, and except for the first
+ * command of line writes lines only as offset from the previous vertex (exact in the rounded units,
+ * so every line ends in the rounded position), PS_COMPACT_RUN commands on one line
+ */
+static void ps_write_vertex(ps_document* doc, double x, double y, int move)
+{
+    double scale, units_x, units_y;
+
+    if (doc->compact < 0)
+    {
+        ps_write_number(doc, x);
+        ps_write_number(doc, y);
+        ps_write_command(doc, move ? PS_MOVE_TO : PS_LINE_TO, NULL);
+        return;
+    }
+
+    scale = ps_powers[doc->compact];
+    units_x = floor(x * scale + 0.5);
+    units_y = floor(y * scale + 0.5);
+
+    if (doc->run > 0)
+        ps_write_string(doc, " ");
+    if (doc->run > 0 && !move)
+    {
+        ps_write_decimals(doc, (units_x - doc->last_x) / scale, doc->compact);
+        ps_write_decimals(doc, (units_y - doc->last_y) / scale, doc->compact);
+        ps_write_string(doc, PS_COMPACT_RLINE_TO);
+    }
+    else
+    {
+        ps_write_decimals(doc, units_x / scale, doc->compact);
+        ps_write_decimals(doc, units_y / scale, doc->compact);
+        ps_write_string(doc, move ? PS_COMPACT_MOVE_TO : PS_COMPACT_LINE_TO);
+    }
+    doc->last_x = units_x;
+    doc->last_y = units_y;
+
+    if (++doc->run == PS_COMPACT_RUN)
+        ps_end_run(doc);
+}
+
+/**
+ * Appends integer to output buffer of document
+ */
+static void ps_write_int(ps_document* doc, int val)
+{
+    char number[16];
+
+    sprintf(number, "%i", val);
+    ps_write_string(doc, number);
+}
+
+/**
+ * Strokes pending path drawn with pen (it has to be stroked before graphics state changes, or
+ * anything else is painted); stroke clears current point
+ */
+static void ps_stroke_pending(ps_document* doc)
+{
+    if (!doc->stroke_pending)
+        return;
+
+    ps_write_path_end(doc, PS_STROKE, PS_COMPACT_STROKE);
+    doc->stroke_pending = 0;
+    doc->state &= ~PS_STATE_POSITION;
+}
+
+/**
+ * Creates document structure, opens file for writing
+ */
+ps_document* ps_create_document(char* filename)
+{
+    ps_document* doc = (ps_document*)malloc(sizeof(ps_document));
+    if (!doc)
+        return NULL;
+    doc->filename = filename;
+    doc->file = fopen(filename, "w");
+    doc->raster = NULL;
+    doc->raster_format = RASTER_FORMAT_NONE;
+    doc->pool = NULL;
+    doc->buffer = (char*)malloc(PS_BUFFER_SIZE);
+    doc->buffer_length = 0;
+    doc->compact = -1;
+    doc->run = 0;
+    doc->state = 0;
+    doc->stroke_pending = 0;
+
+    /* if the file could not be opened, return NULL and let the caller handle it */
+    if (doc->file == NULL || doc->buffer == NULL)
+    {
+        if (doc->file != NULL)
+            fclose(doc->file);
+        free(doc->buffer);
+        free(doc);
+        return NULL;
+    }
+
+    return doc;
+}
+
+/**
+ * Creates raster document - the page is drawn to image of supplied size, which is rendered
+ * using supplied thread pool (may be NULL) and written in supplied format on closing
+ */
+ps_document* ps_create_raster_document(char* filename, int format, int width, int height, struct _thread_pool* pool)
+{
+    ps_document* doc = (ps_document*)malloc(sizeof(ps_document));
+    if (!doc)
+        return NULL;
+    doc->filename = filename;
+    doc->raster_format = format;
+    doc->pool = pool;
+    doc->buffer = NULL;
+    doc->buffer_length = 0;
+    doc->compact = -1;
+    doc->run = 0;
+    doc->state = 0;
+    doc->stroke_pending = 0;
+    doc->raster = raster_create(width, height);
+    if (doc->raster == NULL)
+    {
+        free(doc);
+        return NULL;
+    }
+
+    doc->file = fopen(filename, "wb");
+    if (doc->file == NULL)
+    {
+        raster_destroy(doc->raster);
+        free(doc);
+        return NULL;
+    }
+
+    return doc;
+}
+
+/**
+ * Switches PostScript document to compact output - short procedures defined in prolog, coordinates
+ * rounded to supplied number of decimals (0 means PS_COMPACT_DECIMALS) and path vertices batched
+ * onto lines; has to be called before the header is written
+ */
+void ps_set_compact(ps_document* doc, int decimals)
+{
+    if (doc->raster != NULL)
+        return;
+
+    if (decimals <= 0)
+        decimals = PS_COMPACT_DECIMALS;
+    doc->compact = (decimals > PS_MAX_DECIMALS) ? PS_MAX_DECIMALS : decimals;
+}
+
+/**
+ * Closes document file handle and frees the structure; raster document is rendered and written first,
+ * buffered output of PostScript document is flushed
+ */
+void ps_close_document(ps_document* doc)
+{
+    if (doc->raster != NULL)
+    {
+        raster_render(doc->raster, doc->pool);
+        raster_write(doc->raster, doc->raster_format, doc->file);
+        raster_destroy(doc->raster);
+    }
+    else
+    {
+        ps_stroke_pending(doc);
+        ps_end_run(doc);
+        ps_flush(doc);
+    }
+    fclose(doc->file);
+    free(doc->buffer);
+    free(doc);
+}
+
+/**
+* Creates pen structure and points it to initial location
+*/
+ps_pen* ps_create_pen(ps_document* doc, double init_x, double init_y)
+{
+    ps_pen* pen = (ps_pen*)malloc(sizeof(ps_pen));
+    if (pen == NULL)
+        return NULL;
+    pen->document = doc;
+    pen->pos_x = init_x;
+    pen->pos_y = init_y;
+    return pen;
+}
+
+/**
+ * Destroys pen structure
+ */
+void ps_destroy_pen(ps_pen* pen)
+{
+    free(pen);
+}
+
+/**
+ * Writes PostScript header to file with supplied values
+ */
+void ps_write_header(ps_document* doc, const char* creator, const char* title, const char* datestring)
+{
+    /* image has no header */
+    if (doc->raster != NULL)
+        return;
+
+    ps_write_string(doc, PS_FORMAT_IDENTIFIER "\n" PS_CREATOR_IDENTIFIER);
+    ps_write_string(doc, creator);
+    ps_write_string(doc, "\n" PS_TITLE_IDENTIFIER);
+    ps_write_string(doc, title);
+    ps_write_string(doc, "\n" PS_CREATION_DATE_IDENTIFIER);
+    ps_write_string(doc, datestring);
+    ps_write_string(doc, PS_END_COMMENTS_IDENTIFIER "\n");
+
+    if (doc->compact >= 0)
+        ps_write_string(doc, PS_BEGIN_PROLOG_IDENTIFIER "\n" PS_COMPACT_PROLOG PS_END_PROLOG_IDENTIFIER "\n");
+}
+
+/**
+ * Sets font to be used, needs to have supplied font family and size multiplier
+ */
+void ps_set_font(ps_document* doc, const char* font_family, int size)
+{
+    /* image has only one font */
+    if (doc->raster != NULL)
+    {
+        raster_set_font_size(doc->raster, size);
+        return;
+    }
+
+    /* font does not change strokes, pending path may go on */
+    if ((doc->state & PS_STATE_FONT) && doc->font_size == size && strcmp(doc->font_family, font_family) == 0)
+        return;
+    doc->state &= ~PS_STATE_FONT;
+    if (strlen(font_family) < PS_FONT_NAME_LENGTH)
+    {
+        strcpy(doc->font_family, font_family);
+        doc->font_size = size;
+        doc->state |= PS_STATE_FONT;
+    }
+
+    ps_end_run(doc);
+    ps_write_string(doc, "/");
+    ps_write_string(doc, font_family);
+    ps_write_string(doc, " " PS_FIND_FONT " ");
+    ps_write_int(doc, size);
+    ps_write_string(doc, " " PS_SCALE_FONT " " PS_SET_FONT "\n");
+}
+
+/**
+ * Prints plain text on current location
+ */
+void ps_print_text(ps_document* doc, char* text)
+{
+    if (doc->raster != NULL)
+    {
+        raster_text(doc->raster, text);
+        return;
+    }
+
+    /* text moves current point */
+    ps_stroke_pending(doc);
+    doc->state &= ~PS_STATE_POSITION;
+    ps_end_run(doc);
+    ps_write_string(doc, "(");
+    ps_write_string(doc, text);
+    ps_write_string(doc, ") ");
+    ps_write_command(doc, PS_TEXT_PRINT, PS_COMPACT_TEXT_PRINT);
+}
+
+/**
+ * Prints numeric value on current location, using custom number formatter
+ */
+void ps_print_text_val(ps_document* doc, double val, const char* formatter)
+{
+    char outbuff[64];
+
+    /* due to absence of snprintf in MSVC, and also in C89, the Splint tool
+     * will complain at following line */
+    sprintf(outbuff, formatter, val);
+    ps_print_text(doc, outbuff);
+}
+
+/**
+ * Sets output color, this applies to all shapes, lines and text
+ */
+void ps_set_color(ps_document* doc, double r, double g, double b)
+{
+    if (doc->raster != NULL)
+    {
+        raster_set_color(doc->raster, r, g, b);
+        return;
+    }
+
+    if ((doc->state & PS_STATE_COLOR) && doc->color[0] == r && doc->color[1] == g && doc->color[2] == b)
+        return;
+    doc->color[0] = r;
+    doc->color[1] = g;
+    doc->color[2] = b;
+    doc->state |= PS_STATE_COLOR;
+
+    ps_stroke_pending(doc);
+    ps_end_run(doc);
+    ps_write_number(doc, r);
+    ps_write_number(doc, g);
+    ps_write_number(doc, b);
+    ps_write_command(doc, PS_SET_COLOR, PS_COMPACT_SET_COLOR);
+}
+
+/**
+ * Sets current position in document
+ */
+void ps_set_position(ps_document* doc, double to_x, double to_y)
+{
+    if (doc->raster != NULL)
+    {
+        raster_move_to(doc->raster, to_x, to_y);
+        return;
+    }
+
+    ps_stroke_pending(doc);
+    if ((doc->state & PS_STATE_POSITION) && doc->pos_x == to_x && doc->pos_y == to_y)
+        return;
+    doc->pos_x = to_x;
+    doc->pos_y = to_y;
+    doc->state |= PS_STATE_POSITION;
+
+    ps_end_run(doc);
+    ps_write_number(doc, to_x);
+    ps_write_number(doc, to_y);
+    ps_write_command(doc, PS_MOVE_TO, PS_COMPACT_MOVE_TO);
+}
+
+/**
+ * Moves pen to specified location
+ */
+void ps_pen_move(ps_pen* pen, double to_x, double to_y)
+{
+    pen->pos_x = to_x;
+    pen->pos_y = to_y;
+}
+
+/**
+ * Puts pen down, starting new path - or new subpath of pending path, which is not stroked yet
+ */
+void ps_pen_down(ps_pen* pen)
+{
+    if (pen->document->raster != NULL)
+    {
+        raster_move_to(pen->document->raster, pen->pos_x, pen->pos_y);
+        return;
+    }
+
+    pen->document->state &= ~PS_STATE_POSITION;
+    if (pen->document->stroke_pending)
+        pen->document->stroke_pending = 0;
+    else
+    {
+        /* compact output starts line of path commands */
+        ps_end_run(pen->document);
+        if (pen->document->compact < 0)
+            ps_write_command(pen->document, PS_NEW_PATH, NULL);
+        else
+            ps_write_string(pen->document, PS_COMPACT_NEW_PATH " ");
+    }
+    ps_write_vertex(pen->document, pen->pos_x, pen->pos_y, 1);
+}
+
+/**
+ * Draws line from current position to supplied position, and updates pen position
+ */
+void ps_pen_draw(ps_pen* pen, double to_x, double to_y)
+{
+    pen->pos_x = to_x;
+    pen->pos_y = to_y;
+
+    if (pen->document->raster != NULL)
+    {
+        raster_line_to(pen->document->raster, to_x, to_y);
+        return;
+    }
+
+    ps_write_vertex(pen->document, pen->pos_x, pen->pos_y, 0);
+}
+
+/**
+ * Closes path (making it circular) drawn with pen
+ */
+void ps_pen_close_path(ps_pen* pen)
+{
+    if (pen->document->raster != NULL)
+    {
+        raster_close_path(pen->document->raster);
+        return;
+    }
+
+    /* current point returns to start of subpath, the next vertex is not written as offset */
+    ps_write_path_end(pen->document, PS_CLOSE_PATH, PS_COMPACT_CLOSE_PATH);
+}
+
+/**
+ * Puts pen up, the path we've drawn is stroked when graphics state changes, or anything else is
+ * painted (so paths drawn with the same state are stroked at once)
+ */
+void ps_pen_up(ps_pen* pen)
+{
+    /* lines of image are recorded as they are drawn */
+    if (pen->document->raster != NULL)
+        return;
+
+    pen->document->stroke_pending = 1;
+}
+
+/**
+ * Sets line thickness
+ */
+void ps_set_line_width(ps_document* doc, double width)
+{
+    if (doc->raster != NULL)
+    {
+        raster_set_line_width(doc->raster, width);
+        return;
+    }
+
+    if ((doc->state & PS_STATE_LINEWIDTH) && doc->line_width == width)
+        return;
+    doc->line_width = width;
+    doc->state |= PS_STATE_LINEWIDTH;
+
+    ps_stroke_pending(doc);
+    ps_end_run(doc);
+    ps_write_number(doc, width);
+    ps_write_command(doc, PS_LINEWIDTH, PS_COMPACT_LINEWIDTH);
+}
+
+/**
+ * Paints RGB image (pixel_width x pixel_height pixels, the top row first) to rectangle with supplied
+ * lower left corner and size; image data follow the operator as hexadecimal digits
+ */
+void ps_image(ps_document* doc, double x, double y, double width, double height, int pixel_width, int pixel_height,
+              const unsigned char* rgb)
+{
+    static const char digits[] = "0123456789abcdef";
+    char line[PS_IMAGE_LINE_BYTES * 2 + 1];
+    long size, i;
+    int length;
+
+    if (doc->raster != NULL)
+    {
+        raster_image_rgb(doc->raster, x, y, width, height, pixel_width, pixel_height, rgb);
+        return;
+    }
+
+    /* graphics state is restored after image */
+    ps_stroke_pending(doc);
+    ps_end_run(doc);
+    ps_write_string(doc, PS_GSAVE "\n");
+    ps_write_number(doc, x);
+    ps_write_number(doc, y);
+    ps_write_string(doc, PS_TRANSLATE " ");
+    ps_write_number(doc, width);
+    ps_write_number(doc, height);
+    ps_write_string(doc, PS_SCALE "\n/DeviceRGB " PS_SET_COLOR_SPACE "\n<< /ImageType 1 /Width ");
+    ps_write_int(doc, pixel_width);
+    ps_write_string(doc, " /Height ");
+    ps_write_int(doc, pixel_height);
+    ps_write_string(doc, " /BitsPerComponent 8 /Decode [0 1 0 1 0 1]\n   /ImageMatrix [");
+    ps_write_int(doc, pixel_width);
+    ps_write_string(doc, " 0 0 ");
+    ps_write_int(doc, -pixel_height);
+    ps_write_string(doc, " 0 ");
+    ps_write_int(doc, pixel_height);
+    ps_write_string(doc, "] /DataSource currentfile /ASCIIHexDecode filter >> " PS_IMAGE "\n");
+
+    size = (long)pixel_width * pixel_height * 3;
+    length = 0;
+    for (i = 0; i < size; i++)
+    {
+        line[length++] = digits[rgb[i] >> 4];
+        line[length++] = digits[rgb[i] & 0xF];
+        if (length == PS_IMAGE_LINE_BYTES * 2 || i == size - 1)
+        {
+            line[length++] = '\n';
+            ps_write(doc, line, length);
+            length = 0;
+        }
+    }
+
+    /* end of hexadecimal data */
+    ps_write_string(doc, ">\n" PS_GRESTORE "\n");
+}
@@ -1,60 +1,126 @@
-#ifndef MATHPARSER_POSTSCRIPT_H
-#define MATHPARSER_POSTSCRIPT_H
-
-#define PS_FORMAT_IDENTIFIER            "%%!PS-Adobe-2.0"       /* identifies format of file (recognized mainly by printers) */
-#define PS_CREATOR_IDENTIFIER           "%%%%Creator: "         /* creator signature */
-#define PS_TITLE_IDENTIFIER             "%%%%Title: "           /* document title */
-#define PS_CREATION_DATE_IDENTIFIER     "%%%%CreationDate: "    /* date and time of creation */
-#define PS_END_COMMENTS_IDENTIFIER      "%%%%EndComments"       /* ends comment section */
-
-#define PS_NEW_PATH     "newpath"       /* creates new path (begins drawing there) */
-#define PS_CLOSE_PATH   "closepath"     /* closes path (first point with ending) */
-#define PS_STROKE       "stroke"        /* strokes path (finishes line drawing) */
-#define PS_MOVE_TO      "moveto"        /* moves pen/internal position to specified coords */
-#define PS_LINE_TO      "lineto"        /* draws line from current to new point */
-#define PS_LINEWIDTH    "setlinewidth"  /* sets line thickness */
-#define PS_SET_COLOR    "setrgbcolor"   /* sets color of output shapes */
-#define PS_FIND_FONT    "findfont"      /* finds font in system */
-#define PS_SCALE_FONT   "scalefont"     /* sets font size ("scale") */
-#define PS_SET_FONT     "setfont"       /* finishes font options and sets font to use */
-#define PS_TEXT_PRINT   "show"          /* command for printing anything preceding (on stack while parsing) (i.e. text) */
-
-/* document structure, holding name, and file handle pointer */
-struct _ps_document
-{
-    char* filename;
-    FILE* file;
-};
-typedef struct _ps_document ps_document;
-
-/* pen structure, holding current position and document we are drawing in */
-struct _ps_pen
-{
-    ps_document* document;
-    double pos_x, pos_y;
-};
-typedef struct _ps_pen ps_pen;
-
-ps_document* ps_create_document(char* filename);
-void ps_close_document(ps_document* doc);
-
-ps_pen* ps_create_pen(ps_document* doc, double init_x, double init_y);
-void ps_destroy_pen(ps_pen* pen);
-
-void ps_write_header(ps_document* doc, const char* creator, const char* title, const char* datestring);
-
-void ps_set_font(ps_document* doc, const char* font_family, int size);
-void ps_print_text(ps_document* doc, char* text);
-void ps_print_text_val(ps_document* doc, double val, const char* formatter);
-
-void ps_set_position(ps_document* doc, double to_x, double to_y);
-void ps_set_color(ps_document* doc, double r, double g, double b);
-
-void ps_pen_move(ps_pen* pen, double to_x, double to_y);
-void ps_pen_down(ps_pen* pen);
-void ps_pen_draw(ps_pen* pen, double to_x, double to_y);
-void ps_pen_up(ps_pen* pen);
-
-void ps_set_line_width(ps_document* doc, double width);
-
-#endif
+#ifndef MATHPARSER_POSTSCRIPT_H
+#define MATHPARSER_POSTSCRIPT_H
+
+#define PS_FORMAT_IDENTIFIER            "%!PS-Adobe-2.0"        /* identifies format of file (recognized mainly by printers) */
+#define PS_CREATOR_IDENTIFIER           "%%Creator: "           /* creator signature */
+#define PS_TITLE_IDENTIFIER             "%%Title: "             /* document title */
+#define PS_CREATION_DATE_IDENTIFIER     "%%CreationDate: "      /* date and time of creation */
+#define PS_END_COMMENTS_IDENTIFIER      "%%EndComments"         /* ends comment section */
+#define PS_BEGIN_PROLOG_IDENTIFIER      "%%BeginProlog"         /* starts procedure definitions */
+#define PS_END_PROLOG_IDENTIFIER        "%%EndProlog"           /* ends procedure definitions */
+
+#define PS_NEW_PATH     "newpath"       /* creates new path (begins drawing there) */
+#define PS_CLOSE_PATH   "closepath"     /* closes path (first point with ending) */
+#define PS_STROKE       "stroke"        /* strokes path (finishes line drawing) */
+#define PS_MOVE_TO      "moveto"        /* moves pen/internal position to specified coords */
+#define PS_LINE_TO      "lineto"        /* draws line from current to new point */
+#define PS_LINEWIDTH    "setlinewidth"  /* sets line thickness */
+#define PS_SET_COLOR    "setrgbcolor"   /* sets color of output shapes */
+#define PS_FIND_FONT    "findfont"      /* finds font in system */
+#define PS_SCALE_FONT   "scalefont"     /* sets font size ("scale") */
+#define PS_SET_FONT     "setfont"       /* finishes font options and sets font to use */
+#define PS_TEXT_PRINT   "show"          /* command for printing anything preceding (on stack while parsing) (i.e. text) */
+#define PS_GSAVE        "gsave"         /* saves graphics state (i.e. coordinate system) */
+#define PS_GRESTORE     "grestore"      /* restores saved graphics state */
+#define PS_TRANSLATE    "translate"     /* moves origin of coordinate system */
+#define PS_SCALE        "scale"         /* scales coordinate system */
+#define PS_SET_COLOR_SPACE "setcolorspace" /* sets color space of following operations */
+#define PS_IMAGE        "image"         /* paints sampled image to unit square */
+
+/* short procedures of compact output, bound to the operators in prolog */
+#define PS_COMPACT_PROLOG   "/n {" PS_NEW_PATH "} bind def /m {" PS_MOVE_TO "} bind def /l {" PS_LINE_TO "} bind def " \
+                            "/r {rlineto} bind def /p {" PS_CLOSE_PATH "} bind def /s {" PS_STROKE "} bind def\n" \
+                            "/c {" PS_SET_COLOR "} bind def /w {" PS_LINEWIDTH "} bind def /t {" PS_TEXT_PRINT "} bind def\n"
+#define PS_COMPACT_NEW_PATH     "n"
+#define PS_COMPACT_MOVE_TO      "m"
+#define PS_COMPACT_LINE_TO      "l"
+#define PS_COMPACT_RLINE_TO     "r"     /* draws line by supplied offset from current point */
+#define PS_COMPACT_CLOSE_PATH   "p"
+#define PS_COMPACT_STROKE       "s"
+#define PS_COMPACT_SET_COLOR    "c"
+#define PS_COMPACT_LINEWIDTH    "w"
+#define PS_COMPACT_TEXT_PRINT   "t"
+
+#define PS_IMAGE_LINE_BYTES 36          /* number of image bytes written on one line (as hexadecimal digits) */
+#define PS_BUFFER_SIZE 65536            /* size of output buffer of PostScript document */
+#define PS_DECIMALS 6                   /* number of decimals of written numbers (the same as printf "%f") */
+#define PS_MAX_DECIMALS 9               /* maximum number of decimals the number formatter supports */
+#define PS_NUMBER_LENGTH 330            /* buffer size sufficient for any formatted number (even DBL_MAX) */
+#define PS_COMPACT_DECIMALS 3           /* implicit number of decimals of coordinates in compact output (finer than device pixel) */
+#define PS_COMPACT_RUN 8                /* maximum number of path vertices written on one line of compact output */
+#define PS_FONT_NAME_LENGTH 64          /* maximum length of font name remembered in graphics state (longer ones are always set) */
+
+/* parts of graphics state known to be set in PostScript document (redundant changes are not written) */
+#define PS_STATE_COLOR      0x0001
+#define PS_STATE_LINEWIDTH  0x0002
+#define PS_STATE_FONT       0x0004
+#define PS_STATE_POSITION   0x0008      /* current point set by ps_set_position */
+
+/* raster image (raster.h) and thread pool (pool.h), used by raster documents */
+struct _raster_image;
+struct _thread_pool;
+
+/* document structure, holding name, and file handle pointer; raster document draws the same
+ * page to image instead, written when the document is closed; PostScript document tracks its
+ * graphics state, so it writes only changes of it */
+struct _ps_document
+{
+    char* filename;
+    FILE* file;
+    struct _raster_image* raster;       /* NULL for PostScript document */
+    int raster_format;                  /* enum raster_format of raster document */
+    struct _thread_pool* pool;          /* pool used to render raster document (may be NULL) */
+    char* buffer;                       /* output buffer of PostScript document (NULL for raster one) */
+    int buffer_length;                  /* number of bytes waiting in buffer */
+    int compact;                        /* number of decimals of coordinates in compact output, -1 for plain output */
+    int run;                            /* number of path vertices on current line of compact output */
+    double last_x, last_y;              /* last written vertex of compact output, in units of its last decimal */
+    int state;                          /* PS_STATE_* of graphics state known to be set */
+    double color[3];                    /* current color */
+    double line_width;                  /* current line thickness */
+    char font_family[PS_FONT_NAME_LENGTH];
+    int font_size;                      /* current font */
+    double pos_x, pos_y;                /* current point */
+    int stroke_pending;                 /* path drawn with pen is not stroked yet, following ones join it until state changes */
+};
+typedef struct _ps_document ps_document;
+
+/* pen structure, holding current position and document we are drawing in */
+struct _ps_pen
+{
+    ps_document* document;
+    double pos_x, pos_y;
+};
+typedef struct _ps_pen ps_pen;
+
+int ps_format_number(char* out, double val, int decimals);
+
+ps_document* ps_create_document(char* filename);
+ps_document* ps_create_raster_document(char* filename, int format, int width, int height, struct _thread_pool* pool);
+void ps_set_compact(ps_document* doc, int decimals);
+void ps_close_document(ps_document* doc);
+
+ps_pen* ps_create_pen(ps_document* doc, double init_x, double init_y);
+void ps_destroy_pen(ps_pen* pen);
+
+void ps_write_header(ps_document* doc, const char* creator, const char* title, const char* datestring);
+
+void ps_set_font(ps_document* doc, const char* font_family, int size);
+void ps_print_text(ps_document* doc, char* text);
+void ps_print_text_val(ps_document* doc, double val, const char* formatter);
+
+void ps_set_position(ps_document* doc, double to_x, double to_y);
+void ps_set_color(ps_document* doc, double r, double g, double b);
+
+void ps_pen_move(ps_pen* pen, double to_x, double to_y);
+void ps_pen_down(ps_pen* pen);
+void ps_pen_draw(ps_pen* pen, double to_x, double to_y);
+void ps_pen_close_path(ps_pen* pen);
+void ps_pen_up(ps_pen* pen);
+
+void ps_set_line_width(ps_document* doc, double width);
+
+void ps_image(ps_document* doc, double x, double y, double width, double height, int pixel_width, int pixel_height,
+              const unsigned char* rgb);
+
+#endif
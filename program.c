@@ -0,0 +1,1206 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "stack.h"
+#include "rpn.h"
+#include "main.h"
+#include "shunting_yard.h"
+#include "userfunc.h"
+#include "pool.h"
+#include "program.h"
+
+/* the image layout relies on these sizes, so let the compiler verify them (array of negative size is an error) */
+typedef char prog_header_size_check[(sizeof(prog_header) == 40) ? 1 : -1];
+typedef char prog_instruction_size_check[(sizeof(prog_instruction) == 4) ? 1 : -1];
+
+#define FNV_OFFSET_BASIS 2166136261UL   /* FNV-1a hash initial value */
+#define FNV_PRIME 16777619UL            /* FNV-1a hash multiplier */
+
+#define PROG_BRANCH_FIRST 0             /* block evaluation takes only the first branch of conditional */
+#define PROG_BRANCH_SECOND 1            /* block evaluation takes only the second branch */
+#define PROG_BRANCH_BOTH 2              /* block evaluation takes both branches and selects values */
+
+#define PROG_REDUCE_PART 4096           /* iterations of sum or product reduced as one part, parts may run in parallel */
+
+/* lanes of block evaluation - values which differ between lanes, and values shared by them */
+typedef struct
+{
+    double** variables;             /* variable values of every lane (variables[N][base + lane]), or NULL */
+    int base;                       /* first sample of block in variable values */
+    const double* values;           /* variable values shared by all lanes, if there are no per lane ones */
+    const double* indices;          /* index values of running loops, shared by all lanes */
+    int depth;                      /* number of running loops */
+    const double* lane_index;       /* index of the innermost running loop in every lane, or NULL if shared */
+} prog_lanes;
+
+/* sum or product being reduced */
+typedef struct
+{
+    rpn_program* prog;
+    unsigned int loop;              /* position of LOOP instruction */
+    const double* values;           /* variable values */
+    double indices[RPN_MAX_LOOP_DEPTH]; /* index values of enclosing loops */
+    int depth;                      /* nesting level of the loop */
+    double from;                    /* the first index value */
+    long count;                     /* number of iterations */
+    int product;                    /* the loop is product, not sum */
+    double* parts;                  /* reduced value of every part of range */
+} prog_reduction;
+
+/**
+ * Computes 32-bit FNV-1a checksum of supplied memory block
+ */
+static unsigned int prog_checksum(const unsigned char* data, long size)
+{
+    unsigned long hash = FNV_OFFSET_BASIS;
+    long i;
+
+    for (i = 0; i < size; i++)
+    {
+        hash ^= data[i];
+        hash = (hash * FNV_PRIME) & 0xFFFFFFFFUL;
+    }
+
+    return (unsigned int)hash;
+}
+
+/**
+ * Computes image size of program with supplied header size and element counts
+ */
+static long prog_image_size(long header_size, unsigned long instructions, unsigned long constants, unsigned long source_length)
+{
+    return (long)(header_size + constants * sizeof(double) + instructions * sizeof(prog_instruction) + source_length);
+}
+
+/**
+ * Sets program pointers to point to appropriate parts of image (image and header size
+ * have to be set already)
+ */
+static void prog_locate_sections(rpn_program* prog)
+{
+    char* base = (char*)prog->image;
+
+    prog->header = (prog_header*)base;
+    prog->constants = (double*)(base + prog->header_size);
+    prog->code = (prog_instruction*)(base + prog->header_size + prog->header->constant_count * sizeof(double));
+    prog->source = (char*)prog->code + prog->header->instruction_count * sizeof(prog_instruction);
+}
+
+/**
+ * Returns operator (enum operator_type) computed by supplied opcode, or OP_NONE if the opcode
+ * is not an operator
+ * - arithmetic and comparison opcodes follow the same order as operators
+ */
+int prog_opcode_operator(int opcode)
+{
+    if (opcode >= PROG_OP_ADD && opcode <= PROG_OP_POWER)
+        return OP_ADD + (opcode - PROG_OP_ADD);
+    if (opcode >= PROG_OP_LESS && opcode <= PROG_OP_NOT_EQUAL)
+        return OP_LESS + (opcode - PROG_OP_LESS);
+
+    return OP_NONE;
+}
+
+/**
+ * Returns opcode computing supplied operator (enum operator_type)
+ */
+static int prog_operator_opcode(int op)
+{
+    if (op >= OP_LESS)
+        return PROG_OP_LESS + (op - OP_LESS);
+
+    return PROG_OP_ADD + (op - OP_ADD);
+}
+
+/**
+ * Returns number of values the instruction pops from evaluation stack
+ * - conditional counts with both branches evaluated, the condition stays on stack until SELECT
+ */
+static int prog_instruction_pops(const prog_instruction* ins)
+{
+    switch (ins->opcode)
+    {
+        case PROG_OP_CONST:
+        case PROG_OP_VARIABLE:
+        case PROG_OP_INDEX:
+        case PROG_OP_IF:
+        case PROG_OP_ELSE:
+            return 0;
+        case PROG_OP_FUNCTION:
+            return rpn_function_arity(ins->arg);
+        case PROG_OP_SELECT:
+            return 3;
+        case PROG_OP_SUM:
+        case PROG_OP_PRODUCT:
+            return 1;
+        default:
+            return 2;
+    }
+}
+
+/**
+ * Returns number of values the instruction pushes to evaluation stack
+ */
+static int prog_instruction_pushes(const prog_instruction* ins)
+{
+    return (ins->opcode == PROG_OP_IF || ins->opcode == PROG_OP_ELSE || ins->opcode == PROG_OP_LOOP) ? 0 : 1;
+}
+
+/**
+ * Returns the oldest format version, whose images may contain the opcode
+ */
+static int prog_opcode_version(int opcode)
+{
+    if (opcode >= PROG_OP_INDEX)
+        return 4;
+    if (opcode >= PROG_OP_LESS)
+        return 3;
+    return 1;
+}
+
+/**
+ * Validates every instruction of program and verifies stack depth stored in header
+ * - every opcode has to exist in the format version declared in header
+ * - conditionals have to be properly nested, and every branch has to leave exactly one value
+ *   without touching anything below it, so skipping it does not change the rest of evaluation
+ * - the same holds for bodies of sums and products, which also have to be nested with conditionals,
+ *   and index variables have to refer to running loops
+ * returns PROG_LOAD_OK if the program may be safely evaluated
+ */
+static int prog_validate(rpn_program* prog)
+{
+    prog_instruction* ins;
+    unsigned int open[PROG_MAX_STACK_DEPTH];    /* IF, ELSE or LOOP instruction of unfinished conditionals and loops */
+    int open_depth[PROG_MAX_STACK_DEPTH];       /* stack depth with condition at IF instruction, or without range at LOOP */
+    unsigned int i, target;
+    int depth, level, floor, loops;
+
+    if (prog->header->stack_depth > PROG_MAX_STACK_DEPTH)
+        return PROG_LOAD_BOUNDS;
+
+    depth = 0;
+    level = 0;
+    floor = 0;
+    loops = 0;
+    for (i = 0; i < prog->header->instruction_count; i++)
+    {
+        ins = &prog->code[i];
+
+        if (ins->opcode >= PROG_OP_COUNT || ins->reserved != 0
+            || prog_opcode_version(ins->opcode) > prog->header->version)
+            return PROG_LOAD_FORMAT;
+
+        if (ins->opcode == PROG_OP_CONST && ins->arg >= prog->header->constant_count)
+            return PROG_LOAD_BOUNDS;
+        if (ins->opcode == PROG_OP_VARIABLE && ins->arg >= prog->variable_count)
+            return PROG_LOAD_BOUNDS;
+        if (ins->opcode == PROG_OP_FUNCTION && (ins->arg >= FUNC_COUNT || ins->arg == FUNC_LOOP
+            || ins->arg == FUNC_SUM || ins->arg == FUNC_PROD))
+            return PROG_LOAD_BOUNDS;
+        if (ins->opcode == PROG_OP_INDEX && ins->arg >= loops)
+            return PROG_LOAD_BOUNDS;
+
+        /* IF and ELSE jump forward to the matching ELSE and SELECT */
+        target = i + ins->arg;
+        if (ins->opcode == PROG_OP_IF || ins->opcode == PROG_OP_ELSE)
+        {
+            if (ins->arg == 0 || target >= prog->header->instruction_count
+                || prog->code[target].opcode != ((ins->opcode == PROG_OP_IF) ? PROG_OP_ELSE : PROG_OP_SELECT))
+                return PROG_LOAD_BOUNDS;
+        }
+
+        if (ins->opcode == PROG_OP_IF)
+        {
+            if (level == PROG_MAX_STACK_DEPTH || depth < 1)
+                return PROG_LOAD_BOUNDS;
+            open[level] = i;
+            open_depth[level] = depth;
+            level++;
+        }
+        else if (ins->opcode == PROG_OP_ELSE || ins->opcode == PROG_OP_SELECT)
+        {
+            /* the instruction has to be the one, where the innermost conditional jumps to, with one
+             * more value (the first branch) on stack for ELSE, and two more for SELECT */
+            if (level == 0 || open[level - 1] + prog->code[open[level - 1]].arg != i
+                || prog->code[open[level - 1]].opcode != ((ins->opcode == PROG_OP_ELSE) ? PROG_OP_IF : PROG_OP_ELSE)
+                || depth != open_depth[level - 1] + ((ins->opcode == PROG_OP_ELSE) ? 1 : 2))
+                return PROG_LOAD_BOUNDS;
+
+            if (ins->opcode == PROG_OP_ELSE)
+                open[level - 1] = i;
+            else
+                level--;
+        }
+        else if (ins->opcode == PROG_OP_LOOP)
+        {
+            /* the range must not be taken from below the current floor */
+            if (level == PROG_MAX_STACK_DEPTH || loops == RPN_MAX_LOOP_DEPTH || depth - 2 < floor || ins->arg == 0
+                || target >= prog->header->instruction_count || prog->code[target].arg != ins->arg
+                || (prog->code[target].opcode != PROG_OP_SUM && prog->code[target].opcode != PROG_OP_PRODUCT))
+                return PROG_LOAD_BOUNDS;
+            open[level] = i;
+            open_depth[level] = depth - 2;
+            level++;
+            loops++;
+        }
+        else if (ins->opcode == PROG_OP_SUM || ins->opcode == PROG_OP_PRODUCT)
+        {
+            /* the body leaves exactly one value */
+            if (level == 0 || prog->code[open[level - 1]].opcode != PROG_OP_LOOP
+                || open[level - 1] + prog->code[open[level - 1]].arg != i || depth != open_depth[level - 1] + 1)
+                return PROG_LOAD_BOUNDS;
+            level--;
+            loops--;
+        }
+
+        /* values below the condition (and below the first branch value in second branch) must not be popped */
+        floor = 0;
+        if (level > 0)
+            floor = open_depth[level - 1] + ((prog->code[open[level - 1]].opcode == PROG_OP_ELSE) ? 1 : 0);
+
+        /* simulate evaluation stack, it must not underflow or exceed declared depth */
+        depth -= prog_instruction_pops(ins);
+        if (depth < floor)
+            return PROG_LOAD_BOUNDS;
+        depth += prog_instruction_pushes(ins);
+        if (depth > (int)prog->header->stack_depth)
+            return PROG_LOAD_BOUNDS;
+    }
+
+    if (level != 0)
+        return PROG_LOAD_BOUNDS;
+
+    return PROG_LOAD_OK;
+}
+
+/**
+ * Inserts instruction to program code at supplied position, "count" instructions are already emitted
+ */
+static void prog_insert_instruction(prog_instruction* code, int position, int count, int opcode)
+{
+    memmove(&code[position + 1], &code[position], (count - position) * sizeof(prog_instruction));
+    code[position].opcode = (unsigned char)opcode;
+    code[position].reserved = 0;
+    code[position].arg = 0;
+}
+
+/**
+ * Emits program from expanded RPN stack (without calls of user defined functions)
+ * returns NULL and stores code of error to supplied location, if the RPN stack is not valid, the
+ * program is too large or memory allocation failed
+ */
+static rpn_program* prog_emit(c_stack* rpn_stack, const char* source, int source_length, int* error)
+{
+    rpn_program* prog;
+    prog_instruction* ins;
+    rpn_element* el;
+    unsigned int constant_count, variable_count, instruction_count;
+    int i, depth, max_depth, flags, count, first, second, loops;
+    int* starts;
+    int loop_starts[RPN_MAX_LOOP_DEPTH];  /* LOOP instructions of unfinished sums and products */
+
+    /* first pass - count constants, variables and instructions, and verify stack usage */
+    constant_count = 0;
+    variable_count = 0;
+    instruction_count = 0;
+    depth = 0;
+    max_depth = 0;
+    flags = 0;
+    loops = 0;
+    for (i = 0; i <= rpn_stack->curr; i++)
+    {
+        el = stck_get(rpn_stack, i);
+        instruction_count++;
+
+        if (el->type == RPN_TOKEN_CONST)
+            constant_count++;
+        else if (el->type == RPN_TOKEN_VARIABLE && RPN_IS_INDEX_VARIABLE(el->value.as_variable))
+        {
+            if (RPN_INDEX_LEVEL(el->value.as_variable) >= loops)
+            {
+                *error = SYNTAX_ERROR_INDEX_VARIABLE;
+                return NULL;
+            }
+        }
+        else if (el->type == RPN_TOKEN_VARIABLE)
+        {
+            if (el->value.as_variable == SY_VARIABLE_X)
+                flags |= PROG_FLAG_X_DEPENDENT;
+            if ((unsigned int)el->value.as_variable >= variable_count)
+                variable_count = el->value.as_variable + 1;
+        }
+        else if (el->type == RPN_TOKEN_FUNCTION)
+        {
+            depth -= rpn_function_arity(el->value.as_function);
+            /* conditional needs IF and ELSE besides SELECT */
+            if (el->value.as_function == FUNC_IF)
+                instruction_count += 2;
+
+            if (el->value.as_function == FUNC_LOOP && ++loops > RPN_MAX_LOOP_DEPTH)
+            {
+                *error = SYNTAX_ERROR_INDEX_VARIABLE;
+                return NULL;
+            }
+            if ((el->value.as_function == FUNC_SUM || el->value.as_function == FUNC_PROD) && --loops < 0)
+            {
+                *error = SYNTAX_ERROR_MISSING_OPERAND;
+                return NULL;
+            }
+        }
+        else
+            depth -= 2;
+
+        if (depth < 0)
+        {
+            *error = SYNTAX_ERROR_MISSING_OPERAND;
+            return NULL;
+        }
+
+        depth++;
+        if (depth > max_depth)
+            max_depth = depth;
+    }
+
+    /* the program has to leave exactly one value - its result */
+    if (depth != 1)
+    {
+        *error = SYNTAX_ERROR_MISSING_OPERAND;
+        return NULL;
+    }
+
+    /* jump distances have to fit to instruction argument */
+    if (max_depth > PROG_MAX_STACK_DEPTH || constant_count > 0xFFFFU || variable_count > 0xFFFFU || instruction_count > 0x10000U)
+    {
+        *error = SYNTAX_ERROR_TOO_LONG;
+        return NULL;
+    }
+
+    *error = GENERAL_MEMORY_ERROR;
+    prog = (rpn_program*)malloc(sizeof(rpn_program));
+    if (prog == NULL)
+        return NULL;
+
+    /* start instruction of every value on stack during the second pass */
+    starts = (int*)malloc((max_depth + 1) * sizeof(int));
+
+    prog->header_size = (long)sizeof(prog_header);
+    prog->variable_count = variable_count;
+    prog->image_size = prog_image_size(prog->header_size, instruction_count, constant_count, source_length);
+    prog->image = calloc(1, prog->image_size);
+    prog->mapped = 0;
+    if (prog->image == NULL || starts == NULL)
+    {
+        free(prog->image);
+        free(starts);
+        free(prog);
+        return NULL;
+    }
+
+    prog->header = (prog_header*)prog->image;
+    memcpy(prog->header->magic, PROG_MAGIC, 4);
+    prog->header->version = PROG_FORMAT_VERSION;
+    prog->header->flags = (unsigned short)flags;
+    prog->header->byte_order = (unsigned int)PROG_BYTE_ORDER_MARK;
+    prog->header->instruction_count = instruction_count;
+    prog->header->constant_count = constant_count;
+    prog->header->stack_depth = max_depth;
+    prog->header->source_length = source_length;
+    prog->header->variable_count = variable_count;
+    prog_locate_sections(prog);
+
+    /* second pass - emit instructions and constants */
+    constant_count = 0;
+    count = 0;
+    depth = 0;
+    loops = 0;
+    for (i = 0; i <= rpn_stack->curr; i++)
+    {
+        el = stck_get(rpn_stack, i);
+
+        /* conditional - IF goes before the first branch and ELSE before the second one, both are
+         * inserted to already emitted code (the later first, so the earlier position stays valid) */
+        if (el->type == RPN_TOKEN_FUNCTION && el->value.as_function == FUNC_IF)
+        {
+            first = starts[depth - 2];
+            second = starts[depth - 1];
+            depth -= 2;
+
+            prog_insert_instruction(prog->code, second, count++, PROG_OP_ELSE);
+            prog_insert_instruction(prog->code, first, count++, PROG_OP_IF);
+            second++;
+
+            prog->code[first].arg = (unsigned short)(second - first);
+            prog->code[second].arg = (unsigned short)(count - second);
+
+            ins = &prog->code[count++];
+            ins->opcode = PROG_OP_SELECT;
+            continue;
+        }
+
+        ins = &prog->code[count];
+
+        switch (el->type)
+        {
+            case RPN_TOKEN_CONST:
+                prog->constants[constant_count] = el->value.as_double;
+                ins->opcode = PROG_OP_CONST;
+                ins->arg = (unsigned short)constant_count++;
+                starts[depth++] = count;
+                break;
+            case RPN_TOKEN_VARIABLE:
+                if (RPN_IS_INDEX_VARIABLE(el->value.as_variable))
+                {
+                    ins->opcode = PROG_OP_INDEX;
+                    ins->arg = (unsigned short)RPN_INDEX_LEVEL(el->value.as_variable);
+                }
+                else
+                {
+                    ins->opcode = PROG_OP_VARIABLE;
+                    ins->arg = (unsigned short)el->value.as_variable;
+                }
+                starts[depth++] = count;
+                break;
+            case RPN_TOKEN_OPERATOR:
+                ins->opcode = (unsigned char)prog_operator_opcode(el->value.as_operator);
+                depth--;
+                break;
+            case RPN_TOKEN_FUNCTION:
+                /* range of loop stays on stack as one value until the end of body, the same
+                 * as in RPN form, so starts of values are not affected */
+                if (el->value.as_function == FUNC_LOOP)
+                {
+                    ins->opcode = PROG_OP_LOOP;
+                    loop_starts[loops++] = count;
+                }
+                else if (el->value.as_function == FUNC_SUM || el->value.as_function == FUNC_PROD)
+                {
+                    ins->opcode = (el->value.as_function == FUNC_SUM) ? PROG_OP_SUM : PROG_OP_PRODUCT;
+                    first = loop_starts[--loops];
+                    ins->arg = (unsigned short)(count - first);
+                    prog->code[first].arg = ins->arg;
+                }
+                else
+                {
+                    ins->opcode = PROG_OP_FUNCTION;
+                    ins->arg = (unsigned short)el->value.as_function;
+                }
+                depth -= rpn_function_arity(el->value.as_function) - 1;
+                break;
+        }
+
+        count++;
+    }
+
+    free(starts);
+
+    if (source_length > 0)
+        memcpy(prog->source, source, source_length);
+
+    prog->header->checksum = prog_checksum((unsigned char*)prog->image + prog->header_size, prog->image_size - prog->header_size);
+
+    *error = SYNTAX_ERROR_NONE;
+    return prog;
+}
+
+/**
+ * Compiles RPN stack (output of shunting-yard algorithm) to program - calls of user defined
+ * functions are inlined and constant subexpressions folded first
+ * the source expression is stored within program as metadata
+ * returns NULL if the RPN stack is not valid, the program is too large or memory allocation failed;
+ * the code of error is stored to supplied location then (may be NULL)
+ */
+rpn_program* prog_compile(c_stack* rpn_stack, const char* source, int source_length, int* error)
+{
+    rpn_program* prog;
+    c_stack* expanded;
+    rpn_element* el;
+    int res;
+
+    expanded = uf_expand(rpn_stack, &res);
+    if (expanded == NULL)
+    {
+        if (error != NULL)
+            *error = res;
+        return NULL;
+    }
+
+    /* empty parentheses are empty value, which is assumed to be 0 */
+    if (expanded->curr == STCK_INVALID)
+    {
+        el = rpn_build_element(RPN_TOKEN_CONST);
+        el->value.as_double = 0.0;
+        stck_push(expanded, el);
+    }
+
+    prog = prog_emit(expanded, source, source_length, &res);
+    stck_destroy(expanded);
+    if (error != NULL)
+        *error = res;
+
+    return prog;
+}
+
+/**
+ * Destroys program and releases its image (either allocated or mapped)
+ */
+void prog_destroy(rpn_program* prog)
+{
+#ifndef _WIN32
+    if (prog->mapped)
+        munmap(prog->image, (size_t)prog->image_size);
+    else
+        free(prog->image);
+#else
+    free(prog->image);
+#endif
+
+    free(prog);
+}
+
+/**
+ * Adds value to sum using Kahan (compensated) summation - the compensation keeps low order
+ * bits lost by previous additions
+ */
+static void prog_kahan_add(double* sum, double* compensation, double value)
+{
+    double y, t;
+
+    y = value - *compensation;
+    t = *sum + y;
+    *compensation = (t - *sum) - y;
+    *sum = t;
+}
+
+static double prog_loop(rpn_program* prog, unsigned int loop, double from, double to, const double* values,
+                        const double* indices, int depth, thread_pool* pool);
+
+/**
+ * Evaluates loops starting in every lane - each lane has its own range, variable values and
+ * index values, so the loops are evaluated one by one; result replaces range start (from)
+ */
+static void prog_loop_lanes(rpn_program* prog, unsigned int loop, const prog_lanes* lanes, double* from, const double* to, int n)
+{
+    double indices[RPN_MAX_LOOP_DEPTH];
+    double* values;
+    unsigned int v;
+    int i;
+
+    values = NULL;
+    if (lanes->variables != NULL)
+    {
+        values = (double*)malloc((prog->variable_count + 1) * sizeof(double));
+        if (values == NULL)
+        {
+            for (i = 0; i < n; i++)
+                from[i] = NAN;
+            return;
+        }
+    }
+
+    if (lanes->depth > 0)
+        memcpy(indices, lanes->indices, lanes->depth * sizeof(double));
+
+    for (i = 0; i < n; i++)
+    {
+        if (lanes->lane_index != NULL)
+            indices[lanes->depth - 1] = lanes->lane_index[i];
+        if (values != NULL)
+        {
+            for (v = 0; v < prog->variable_count; v++)
+                values[v] = lanes->variables[v][lanes->base + i];
+        }
+
+        from[i] = prog_loop(prog, loop, from[i], to[i], (values != NULL) ? values : lanes->values, indices, lanes->depth, NULL);
+    }
+
+    free(values);
+}
+
+/**
+ * Evaluates instructions [begin, end) of program for "n" lanes at once, and stores result of
+ * every lane to out
+ * - every instruction is applied to whole block of lanes, so the dispatch cost is paid once
+ *   per block, and the inner loops are simple enough to be vectorized by compiler
+ * - conditional evaluates only one branch, if the condition is the same in whole block,
+ *   otherwise both branches are evaluated and SELECT picks values by condition (mask)
+ */
+static void prog_run_lanes(rpn_program* prog, unsigned int begin, unsigned int end, const prog_lanes* lanes, int n, double* out)
+{
+    double stack[PROG_MAX_STACK_DEPTH][PROG_BLOCK_SIZE];
+    unsigned char branches[PROG_MAX_STACK_DEPTH];   /* evaluated branches of unfinished conditionals */
+    prog_instruction* ins;
+    prog_instruction* last;
+    double *top, *below, value;
+    double* args[RPN_MAX_ARITY];
+    int sp, i, k, arity, level, all, none;
+
+    last = prog->code + end;
+    sp = -1;
+    level = -1;
+
+    for (ins = prog->code + begin; ins != last; ins++)
+    {
+        switch (ins->opcode)
+        {
+            case PROG_OP_CONST:
+                top = stack[++sp];
+                value = prog->constants[ins->arg];
+                for (i = 0; i < n; i++)
+                    top[i] = value;
+                break;
+            case PROG_OP_VARIABLE:
+                top = stack[++sp];
+                if (lanes->variables != NULL)
+                    memcpy(top, lanes->variables[ins->arg] + lanes->base, n * sizeof(double));
+                else
+                {
+                    value = lanes->values[ins->arg];
+                    for (i = 0; i < n; i++)
+                        top[i] = value;
+                }
+                break;
+            case PROG_OP_INDEX:
+                top = stack[++sp];
+                if (lanes->lane_index != NULL && ins->arg == lanes->depth - 1)
+                    memcpy(top, lanes->lane_index, n * sizeof(double));
+                else
+                {
+                    value = lanes->indices[ins->arg];
+                    for (i = 0; i < n; i++)
+                        top[i] = value;
+                }
+                break;
+            case PROG_OP_LOOP:
+                /* the whole loop is evaluated at once, continue after its end */
+                top = stack[sp--];
+                prog_loop_lanes(prog, (unsigned int)(ins - prog->code), lanes, stack[sp], top, n);
+                ins += ins->arg;
+                break;
+            case PROG_OP_SUM:
+            case PROG_OP_PRODUCT:
+                /* never reached, LOOP jumps over */
+                break;
+            case PROG_OP_FUNCTION:
+                /* arguments are on top of stack in order, result replaces the first one */
+                arity = rpn_function_arity(ins->arg);
+                sp -= arity - 1;
+                for (k = 0; k < arity; k++)
+                    args[k] = stack[sp + k];
+                rpn_apply_function_block_args(ins->arg, args, n);
+                break;
+            case PROG_OP_IF:
+                top = stack[sp];
+                all = 1;
+                none = 1;
+                for (i = 0; i < n; i++)
+                {
+                    all &= (top[i] != 0.0);
+                    none &= (top[i] == 0.0);
+                }
+
+                /* the condition is dropped, when only one branch is evaluated */
+                if (all)
+                {
+                    sp--;
+                    branches[++level] = PROG_BRANCH_FIRST;
+                }
+                else if (none)
+                {
+                    sp--;
+                    branches[++level] = PROG_BRANCH_SECOND;
+                    ins += ins->arg;
+                }
+                else
+                    branches[++level] = PROG_BRANCH_BOTH;
+                break;
+            case PROG_OP_ELSE:
+                if (branches[level] == PROG_BRANCH_FIRST)
+                {
+                    level--;
+                    ins += ins->arg;
+                }
+                break;
+            case PROG_OP_SELECT:
+                if (branches[level--] == PROG_BRANCH_BOTH)
+                {
+                    sp -= 2;
+                    args[0] = stack[sp];
+                    args[1] = stack[sp + 1];
+                    args[2] = stack[sp + 2];
+                    rpn_apply_function_block_args(FUNC_IF, args, n);
+                }
+                break;
+            default:
+                top = stack[sp--];
+                below = stack[sp];
+                switch (ins->opcode)
+                {
+                    case PROG_OP_ADD:
+                        for (i = 0; i < n; i++)
+                            below[i] = below[i] + top[i];
+                        break;
+                    case PROG_OP_SUBTRACT:
+                        for (i = 0; i < n; i++)
+                            below[i] = below[i] - top[i];
+                        break;
+                    case PROG_OP_MULTIPLY:
+                        for (i = 0; i < n; i++)
+                            below[i] = below[i] * top[i];
+                        break;
+                    case PROG_OP_DIVIDE:
+                        for (i = 0; i < n; i++)
+                            below[i] = below[i] / top[i];
+                        break;
+                    case PROG_OP_POWER:
+                        for (i = 0; i < n; i++)
+                            below[i] = pow(below[i], top[i]);
+                        break;
+                    case PROG_OP_LESS:
+                        for (i = 0; i < n; i++)
+                            below[i] = (below[i] < top[i]) ? 1.0 : 0.0;
+                        break;
+                    case PROG_OP_LESS_EQUAL:
+                        for (i = 0; i < n; i++)
+                            below[i] = (below[i] <= top[i]) ? 1.0 : 0.0;
+                        break;
+                    case PROG_OP_GREATER:
+                        for (i = 0; i < n; i++)
+                            below[i] = (below[i] > top[i]) ? 1.0 : 0.0;
+                        break;
+                    case PROG_OP_GREATER_EQUAL:
+                        for (i = 0; i < n; i++)
+                            below[i] = (below[i] >= top[i]) ? 1.0 : 0.0;
+                        break;
+                    case PROG_OP_EQUAL:
+                        for (i = 0; i < n; i++)
+                            below[i] = (below[i] == top[i]) ? 1.0 : 0.0;
+                        break;
+                    case PROG_OP_NOT_EQUAL:
+                        for (i = 0; i < n; i++)
+                            below[i] = (below[i] != top[i]) ? 1.0 : 0.0;
+                        break;
+                }
+                break;
+        }
+    }
+
+    /* the same as RPN stack evaluation - empty program evaluates to zero */
+    if (sp >= 0)
+        memcpy(out, stack[sp], n * sizeof(double));
+    else
+        memset(out, 0, n * sizeof(double));
+}
+
+/**
+ * Reduces one part of sum or product range (pool task routine) - the body is evaluated for
+ * block of index values at once, and the values are summed (multiplied) in index order
+ */
+static void prog_reduce_part(void* arg, int index)
+{
+    prog_reduction* red = (prog_reduction*)arg;
+    prog_lanes lanes;
+    double lane_index[PROG_BLOCK_SIZE], terms[PROG_BLOCK_SIZE];
+    double value, compensation;
+    unsigned int body_end;
+    long first, last, k;
+    int n, i;
+
+    first = (long)index * PROG_REDUCE_PART;
+    last = (red->count - first > PROG_REDUCE_PART) ? first + PROG_REDUCE_PART : red->count;
+    body_end = red->loop + red->prog->code[red->loop].arg;
+
+    lanes.variables = NULL;
+    lanes.base = 0;
+    lanes.values = red->values;
+    lanes.indices = red->indices;
+    lanes.depth = red->depth + 1;
+    lanes.lane_index = lane_index;
+
+    value = red->product ? 1.0 : 0.0;
+    compensation = 0.0;
+    for (k = first; k < last; k += PROG_BLOCK_SIZE)
+    {
+        n = (last - k > PROG_BLOCK_SIZE) ? PROG_BLOCK_SIZE : (int)(last - k);
+        for (i = 0; i < n; i++)
+            lane_index[i] = red->from + (double)(k + i);
+
+        prog_run_lanes(red->prog, red->loop + 1, body_end, &lanes, n, terms);
+
+        if (red->product)
+        {
+            for (i = 0; i < n; i++)
+                value *= terms[i];
+        }
+        else
+        {
+            for (i = 0; i < n; i++)
+                prog_kahan_add(&value, &compensation, terms[i]);
+        }
+    }
+
+    red->parts[index] = value;
+}
+
+/**
+ * Evaluates sum or product, whose LOOP instruction is on supplied position, with index going
+ * from "from" by one while not exceeding "to"; "indices" are index values of enclosing loops
+ * - the range is split to parts of fixed size, which are reduced using thread pool (if any)
+ *   and then folded always in the same order, so the result does not depend on thread count
+ * returns NaN if there are too many iterations
+ */
+static double prog_loop(rpn_program* prog, unsigned int loop, double from, double to, const double* values,
+                        const double* indices, int depth, thread_pool* pool)
+{
+    prog_reduction red;
+    double value, compensation;
+    int parts, i;
+
+    red.product = (prog->code[loop + prog->code[loop].arg].opcode == PROG_OP_PRODUCT);
+    red.count = rpn_iteration_count(from, to);
+    if (red.count < 0)
+        return NAN;
+    if (red.count == 0)
+        return red.product ? 1.0 : 0.0;
+
+    parts = (int)((red.count + PROG_REDUCE_PART - 1) / PROG_REDUCE_PART);
+    red.parts = (double*)malloc(parts * sizeof(double));
+    if (red.parts == NULL)
+        return NAN;
+
+    red.prog = prog;
+    red.loop = loop;
+    red.values = values;
+    red.depth = depth;
+    red.from = from;
+    if (depth > 0)
+        memcpy(red.indices, indices, depth * sizeof(double));
+
+    pool_run(pool, prog_reduce_part, &red, parts);
+
+    value = red.parts[0];
+    compensation = 0.0;
+    for (i = 1; i < parts; i++)
+    {
+        if (red.product)
+            value *= red.parts[i];
+        else
+            prog_kahan_add(&value, &compensation, red.parts[i]);
+    }
+
+    free(red.parts);
+
+    return value;
+}
+
+/**
+ * Evaluates instructions [begin, end) of program using supplied variable values and index
+ * values of "depth" running loops; loops are reduced using supplied thread pool (may be NULL)
+ * - the evaluation stack lives in local array, so there's no allocation (except for loops)
+ */
+static double prog_run(rpn_program* prog, unsigned int begin, unsigned int end, const double* variable_values,
+                       const double* indices, int depth, thread_pool* pool)
+{
+    double stack[PROG_MAX_STACK_DEPTH];
+    prog_instruction* ins;
+    prog_instruction* last;
+    int sp;
+
+    sp = -1;
+    last = prog->code + end;
+
+    for (ins = prog->code + begin; ins != last; ins++)
+    {
+        switch (ins->opcode)
+        {
+            case PROG_OP_CONST:
+                stack[++sp] = prog->constants[ins->arg];
+                break;
+            case PROG_OP_VARIABLE:
+                stack[++sp] = variable_values[ins->arg];
+                break;
+            case PROG_OP_INDEX:
+                stack[++sp] = indices[ins->arg];
+                break;
+            case PROG_OP_ADD:
+                sp--;
+                stack[sp] = stack[sp] + stack[sp + 1];
+                break;
+            case PROG_OP_SUBTRACT:
+                sp--;
+                stack[sp] = stack[sp] - stack[sp + 1];
+                break;
+            case PROG_OP_MULTIPLY:
+                sp--;
+                stack[sp] = stack[sp] * stack[sp + 1];
+                break;
+            case PROG_OP_DIVIDE:
+                sp--;
+                stack[sp] = stack[sp] / stack[sp + 1];
+                break;
+            case PROG_OP_POWER:
+                sp--;
+                stack[sp] = pow(stack[sp], stack[sp + 1]);
+                break;
+            case PROG_OP_FUNCTION:
+                /* arguments are on top of stack in order, result replaces the first one */
+                sp -= rpn_function_arity(ins->arg) - 1;
+                stack[sp] = rpn_apply_function_args(ins->arg, &stack[sp]);
+                break;
+            case PROG_OP_IF:
+                /* false condition jumps to ELSE, so the second branch follows */
+                if (stack[sp--] == 0.0)
+                    ins += ins->arg;
+                break;
+            case PROG_OP_ELSE:
+                /* the end of first branch, skip the second one including SELECT */
+                ins += ins->arg;
+                break;
+            case PROG_OP_SELECT:
+                /* the second branch value is already in place of condition */
+                break;
+            case PROG_OP_LOOP:
+                /* the whole loop is evaluated at once, continue after its end */
+                sp--;
+                stack[sp] = prog_loop(prog, (unsigned int)(ins - prog->code), stack[sp], stack[sp + 1], variable_values, indices, depth, pool);
+                ins += ins->arg;
+                break;
+            case PROG_OP_SUM:
+            case PROG_OP_PRODUCT:
+                /* never reached, LOOP jumps over */
+                break;
+            default:
+                sp--;
+                stack[sp] = rpn_apply_binary(prog_opcode_operator(ins->opcode), stack[sp], stack[sp + 1]);
+                break;
+        }
+    }
+
+    /* the same as RPN stack evaluation - empty program evaluates to zero */
+    return (sp >= 0) ? stack[sp] : 0.0;
+}
+
+/**
+ * Evaluates program of one variable using supplied variable value
+ */
+double prog_evaluate(rpn_program* prog, double variable_value)
+{
+    return prog_evaluate_vars(prog, &variable_value);
+}
+
+/**
+ * Evaluates program using supplied variable values (one for each program variable)
+ */
+double prog_evaluate_vars(rpn_program* prog, const double* variable_values)
+{
+    return prog_run(prog, 0, prog->header->instruction_count, variable_values, NULL, 0, NULL);
+}
+
+/**
+ * Evaluates program using supplied variable values; parts of sums and products are reduced
+ * in parallel using supplied thread pool - the result is the same as of prog_evaluate_vars
+ */
+double prog_evaluate_parallel(rpn_program* prog, const double* variable_values, thread_pool* pool)
+{
+    return prog_run(prog, 0, prog->header->instruction_count, variable_values, NULL, 0, pool);
+}
+
+/**
+ * Evaluates program for "count" samples at once; value of variable N in sample i is taken
+ * from variables[N][i], and result is stored to out[i]
+ * - see prog_run_lanes; sums and products are evaluated for every sample separately, each of
+ *   them for blocks of index values
+ */
+void prog_evaluate_block(rpn_program* prog, double** variables, int count, double* out)
+{
+    prog_lanes lanes;
+    int base, n;
+
+    lanes.variables = variables;
+    lanes.values = NULL;
+    lanes.indices = NULL;
+    lanes.depth = 0;
+    lanes.lane_index = NULL;
+
+    for (base = 0; base < count; base += PROG_BLOCK_SIZE)
+    {
+        n = (count - base < PROG_BLOCK_SIZE) ? count - base : PROG_BLOCK_SIZE;
+        lanes.base = base;
+        prog_run_lanes(prog, 0, prog->header->instruction_count, &lanes, n, out + base);
+    }
+}
+
+/**
+ * Creates program from image in memory - validates header, size, checksum and bounds
+ * the image is not copied, the program takes ownership of it (has to be allocated by malloc)
+ * returns NULL and sets error, if the image is not valid
+ */
+rpn_program* prog_from_image(void* image, long size, int* error)
+{
+    rpn_program* prog;
+    prog_header* header = (prog_header*)image;
+    long header_size;
+
+    *error = PROG_LOAD_FORMAT;
+
+    if (size < PROG_HEADER_V1_SIZE || memcmp(header->magic, PROG_MAGIC, 4) != 0)
+        return NULL;
+
+    if (header->version < PROG_MIN_FORMAT_VERSION || header->version > PROG_FORMAT_VERSION
+        || header->byte_order != (unsigned int)PROG_BYTE_ORDER_MARK)
+    {
+        *error = PROG_LOAD_VERSION;
+        return NULL;
+    }
+
+    /* version 1 header ends before variable count */
+    header_size = (header->version == 1) ? PROG_HEADER_V1_SIZE : (long)sizeof(prog_header);
+    if (size < header_size || (header->version > 1 && header->reserved != 0))
+        return NULL;
+
+    /* verify the counts before computing size, so it cannot overflow */
+    if (header->constant_count > (unsigned long)size / sizeof(double)
+        || header->instruction_count > (unsigned long)size / sizeof(prog_instruction)
+        || header->source_length > (unsigned long)size
+        || prog_image_size(header_size, header->instruction_count, header->constant_count, header->source_length) != size)
+        return NULL;
+
+    if (prog_checksum((unsigned char*)image + header_size, size - header_size) != header->checksum)
+    {
+        *error = PROG_LOAD_CHECKSUM;
+        return NULL;
+    }
+
+    prog = (rpn_program*)malloc(sizeof(rpn_program));
+    if (prog == NULL)
+    {
+        *error = PROG_LOAD_MEMORY;
+        return NULL;
+    }
+
+    prog->image = image;
+    prog->image_size = size;
+    prog->header_size = header_size;
+    prog->variable_count = (header->version == 1) ? 1 : header->variable_count;
+    prog->mapped = 0;
+    prog_locate_sections(prog);
+
+    *error = prog_validate(prog);
+    if (*error != PROG_LOAD_OK)
+    {
+        free(prog);
+        return NULL;
+    }
+
+    return prog;
+}
+
+/**
+ * Writes program image to file
+ * returns 0 on success, 1 on failure
+ */
+int prog_save(rpn_program* prog, const char* filename)
+{
+    FILE* f;
+    int res;
+
+    f = fopen(filename, "wb");
+    if (f == NULL)
+        return 1;
+
+    res = (fwrite(prog->image, 1, prog->image_size, f) == (size_t)prog->image_size) ? 0 : 1;
+
+    if (fclose(f) != 0)
+        res = 1;
+
+    return res;
+}
+
+/**
+ * Loads program from file - the file is mapped to memory and evaluated directly from there
+ * (on platforms without mmap, it's read to allocated memory)
+ * returns NULL and sets error, if the file could not be loaded
+ */
+rpn_program* prog_load(const char* filename, int* error)
+{
+    rpn_program* prog;
+    void* image;
+    long size;
+#ifndef _WIN32
+    int fd;
+    struct stat st;
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0)
+    {
+        if (fd >= 0)
+            close(fd);
+        *error = PROG_LOAD_IO;
+        return NULL;
+    }
+
+    size = (long)st.st_size;
+    if (size < PROG_HEADER_V1_SIZE)
+    {
+        close(fd);
+        *error = PROG_LOAD_FORMAT;
+        return NULL;
+    }
+
+    image = mmap(NULL, (size_t)size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED)
+    {
+        *error = PROG_LOAD_IO;
+        return NULL;
+    }
+
+    prog = prog_from_image(image, size, error);
+    if (prog == NULL)
+    {
+        munmap(image, (size_t)size);
+        return NULL;
+    }
+
+    prog->mapped = 1;
+#else
+    FILE* f;
+
+    f = fopen(filename, "rb");
+    if (f == NULL)
+    {
+        *error = PROG_LOAD_IO;
+        return NULL;
+    }
+
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    image = malloc(size > 0 ? size : 1);
+    if (image == NULL || (long)fread(image, 1, size, f) != size)
+    {
+        free(image);
+        fclose(f);
+        *error = PROG_LOAD_IO;
+        return NULL;
+    }
+    fclose(f);
+
+    prog = prog_from_image(image, size, error);
+    if (prog == NULL)
+        free(image);
+#endif
+
+    return prog;
+}
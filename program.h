@@ -0,0 +1,127 @@
+#ifndef MATHPARSER_PROGRAM_H
+#define MATHPARSER_PROGRAM_H
+
+#define PROG_MAGIC "MPRG"                   /* identifies compiled program image */
+#define PROG_FORMAT_VERSION 4               /* current version of compiled program image format */
+#define PROG_MIN_FORMAT_VERSION 1           /* oldest version of compiled program image, which is still loadable */
+#define PROG_HEADER_V1_SIZE 32              /* version 1 header size (without variable count, only variable 0 is used) */
+#define PROG_BYTE_ORDER_MARK 0x01020304UL   /* stored natively, detects images from different byte order machines */
+#define PROG_MAX_STACK_DEPTH RPN_STACK_SIZE /* maximum evaluation stack depth of loadable program */
+#define PROG_BLOCK_SIZE 128                 /* number of samples evaluated at once by block evaluation */
+
+#define PROG_FLAG_X_DEPENDENT 0x0001        /* program result depends on value of variable 0 (x) */
+
+/*
+ * Compiled program image is one contiguous, position independent block of memory:
+ *
+ *   [prog_header][constants (double)][instructions (prog_instruction)][source text]
+ *
+ * The same block is written to file, so the file may be mapped to memory and evaluated
+ * directly without any copy or conversion.
+ *
+ * Conditional if(c, a, b) is compiled as "c IF a ELSE b SELECT"; the IF and ELSE arguments
+ * are forward distances to the matching ELSE and SELECT instruction. Single value evaluation
+ * jumps over the branch not taken, block evaluation skips it only when the condition agrees
+ * in the whole block, and selects from both branches otherwise.
+ *
+ * Sum or product is compiled as "from to LOOP body SUM" (or PRODUCT); the LOOP argument is
+ * forward distance to its SUM or PRODUCT, whose argument is the same distance backwards. The body
+ * refers to index variables by INDEX instruction with nesting level of the loop (0 = outermost).
+ * The whole loop is evaluated when LOOP is reached - the body is evaluated for blocks of index
+ * values at once, and the range is split to parts, which may be reduced in parallel.
+ */
+
+/* thread pool (pool.h), used by parallel evaluation */
+struct _thread_pool;
+
+enum prog_opcode
+{
+    PROG_OP_CONST,                  /* push constant, argument is index to constant table */
+    PROG_OP_VARIABLE,               /* push variable value, argument is variable index */
+    PROG_OP_ADD,                    /* pop two values, push sum */
+    PROG_OP_SUBTRACT,               /* pop two values, push difference */
+    PROG_OP_MULTIPLY,               /* pop two values, push product */
+    PROG_OP_DIVIDE,                 /* pop two values, push quotient */
+    PROG_OP_POWER,                  /* pop two values, push power */
+    PROG_OP_FUNCTION,               /* pop function arguments, push function value; argument is function identifier */
+    PROG_OP_LESS,                   /* pop two values, push 1 if the first is less than the second, 0 otherwise (since version 3) */
+    PROG_OP_LESS_EQUAL,             /* the same for <= */
+    PROG_OP_GREATER,                /* the same for > */
+    PROG_OP_GREATER_EQUAL,          /* the same for >= */
+    PROG_OP_EQUAL,                  /* the same for == */
+    PROG_OP_NOT_EQUAL,              /* the same for != */
+    PROG_OP_IF,                     /* start of first branch of conditional, condition is on top of stack */
+    PROG_OP_ELSE,                   /* end of first branch, start of the second one */
+    PROG_OP_SELECT,                 /* end of conditional, selects branch value by condition */
+    PROG_OP_INDEX,                  /* push value of index variable, argument is loop nesting level (since version 4) */
+    PROG_OP_LOOP,                   /* pop range of sum or product, its body follows */
+    PROG_OP_SUM,                    /* end of sum body, pushes the sum */
+    PROG_OP_PRODUCT,                /* end of product body, pushes the product */
+
+    PROG_OP_COUNT                   /* number of opcodes, not an opcode */
+};
+
+enum prog_load_error
+{
+    PROG_LOAD_OK = 0,               /* no error, program loaded */
+    PROG_LOAD_IO,                   /* file could not be opened, read or mapped */
+    PROG_LOAD_FORMAT,               /* not a compiled program image, or truncated one */
+    PROG_LOAD_VERSION,              /* unsupported format version or byte order */
+    PROG_LOAD_CHECKSUM,             /* checksum does not match contents */
+    PROG_LOAD_BOUNDS,               /* instruction refers to something out of bounds */
+    PROG_LOAD_MEMORY                /* memory allocation failed */
+};
+
+/* image header; 40 bytes, so the constant table which follows is aligned */
+typedef struct
+{
+    char magic[4];                  /* PROG_MAGIC */
+    unsigned short version;         /* PROG_FORMAT_VERSION */
+    unsigned short flags;           /* PROG_FLAG_* */
+    unsigned int byte_order;        /* PROG_BYTE_ORDER_MARK */
+    unsigned int instruction_count; /* number of instructions */
+    unsigned int constant_count;    /* number of constants */
+    unsigned int stack_depth;       /* maximum evaluation stack depth */
+    unsigned int source_length;     /* length of source expression text */
+    unsigned int checksum;          /* checksum of everything following header */
+    unsigned int variable_count;    /* number of variables (since version 2) */
+    unsigned int reserved;          /* always zero */
+} prog_header;
+
+/* single instruction; 4 bytes */
+typedef struct
+{
+    unsigned char opcode;           /* enum prog_opcode */
+    unsigned char reserved;         /* always zero */
+    unsigned short arg;             /* opcode argument */
+} prog_instruction;
+
+/* compiled program, all pointers point to the image */
+typedef struct
+{
+    prog_header* header;
+    double* constants;
+    prog_instruction* code;
+    char* source;                   /* source expression, not terminated (see header) */
+
+    void* image;                    /* image block */
+    long image_size;                /* image block size in bytes */
+    long header_size;               /* header size of image version */
+    unsigned int variable_count;    /* number of variables, evaluation needs value of each of them */
+    int mapped;                     /* image is mapped file, not allocated memory */
+} rpn_program;
+
+rpn_program* prog_compile(c_stack* rpn_stack, const char* source, int source_length, int* error);
+int prog_opcode_operator(int opcode);
+void prog_destroy(rpn_program* prog);
+
+double prog_evaluate(rpn_program* prog, double variable_value);
+double prog_evaluate_vars(rpn_program* prog, const double* variable_values);
+void prog_evaluate_block(rpn_program* prog, double** variables, int count, double* out);
+double prog_evaluate_parallel(rpn_program* prog, const double* variable_values, struct _thread_pool* pool);
+
+rpn_program* prog_from_image(void* image, long size, int* error);
+int prog_save(rpn_program* prog, const char* filename);
+rpn_program* prog_load(const char* filename, int* error);
+
+#endif
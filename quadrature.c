@@ -0,0 +1,364 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include "stack.h"
+#include "rpn.h"
+#include "main.h"
+#include "shunting_yard.h"
+#include "program.h"
+#include "pool.h"
+#include "quadrature.h"
+
+/*
+ * Adaptive Gauss-Kronrod quadrature - integral over every panel is estimated by 15-point Kronrod
+ * rule, and its error by difference from 7-point Gauss rule using every other of the same nodes.
+ * Panels are kept in heap ordered by error; every round bisects the worst ones (until their
+ * error removed would be enough, at most QUAD_ROUND_PANELS), and all their children are evaluated
+ * at once - QUAD_PANELS_PER_TASK panels per task, so one block evaluation covers all nodes of the
+ * task. Integration ends when the sum of errors gets within tolerance.
+ *
+ * Rounds depend only on the errors, never on number of threads or timing, so the result is
+ * the same for serial and parallel run.
+ */
+
+/* Kronrod nodes (positive half, the last one is the center), every other one is Gauss node */
+static const double quad_kronrod_nodes[8] =
+{
+    0.991455371120812639206854697526329, 0.949107912342758524526189684047851,
+    0.864864423359769072789712788640926, 0.741531185599394439863864773280788,
+    0.586087235467691130294144845693013, 0.405845151377397166906606412076961,
+    0.207784955007898467600689403773245, 0.000000000000000000000000000000000
+};
+
+/* Kronrod weights of the same nodes */
+static const double quad_kronrod_weights[8] =
+{
+    0.022935322010529224963732008058970, 0.063092092629978553290700663189204,
+    0.104790010322250183839876322541518, 0.140653259715525918745189590510238,
+    0.169004726639267902826583426598550, 0.190350578064785409913256402421014,
+    0.204432940075298892414161999234649, 0.209482141084727828012999174891714
+};
+
+/* Gauss weights of nodes 1, 3, 5 and 7 (the center) */
+static const double quad_gauss_weights[4] =
+{
+    0.129484966168869693270611432679082, 0.279705391489276667901467771423780,
+    0.381830050505118944950369775488975, 0.417959183673469387755102040816327
+};
+
+/* one panel of the interval */
+typedef struct
+{
+    double a, b;
+    double value;                       /* Kronrod estimate of integral */
+    double error;                       /* its error estimate */
+} quad_panel;
+
+/* shared state of panel evaluation */
+typedef struct
+{
+    rpn_program* prog;
+    quad_panel* panels;                 /* panels to be evaluated (ends are set) */
+    int count;
+} quad_round;
+
+/**
+ * Evaluates Kronrod and Gauss rules of panels from their node values
+ */
+static void quad_rules(quad_panel* panel, const double* f)
+{
+    double half, kronrod, gauss, mean, resabs, resasc, err;
+    int k;
+
+    half = (panel->b - panel->a) / 2;
+
+    /* nodes go from the left end to the right one, f[7] is the center */
+    kronrod = quad_kronrod_weights[7] * f[7];
+    gauss = quad_gauss_weights[3] * f[7];
+    resabs = fabs(kronrod);
+    for (k = 0; k < 7; k++)
+    {
+        kronrod += quad_kronrod_weights[k] * (f[k] + f[14 - k]);
+        resabs += quad_kronrod_weights[k] * (fabs(f[k]) + fabs(f[14 - k]));
+        if (k % 2 == 1)
+            gauss += quad_gauss_weights[k / 2] * (f[k] + f[14 - k]);
+    }
+
+    /* the error estimate of QUADPACK - |K - G| is error of Gauss rule, Kronrod one is much better */
+    mean = kronrod / 2;
+    resasc = quad_kronrod_weights[7] * fabs(f[7] - mean);
+    for (k = 0; k < 7; k++)
+        resasc += quad_kronrod_weights[k] * (fabs(f[k] - mean) + fabs(f[14 - k] - mean));
+
+    err = fabs((kronrod - gauss) * half);
+    resabs *= fabs(half);
+    resasc *= fabs(half);
+    if (resasc != 0 && err != 0)
+        err = resasc * ((200 * err / resasc < 1) ? pow(200 * err / resasc, 1.5) : 1);
+    if (resabs > DBL_MIN / (50 * DBL_EPSILON) && err < 50 * DBL_EPSILON * resabs)
+        err = 50 * DBL_EPSILON * resabs;
+
+    panel->value = kronrod * half;
+    panel->error = err;
+}
+
+/**
+ * Evaluates group of panels by one block evaluation (task routine)
+ */
+static void quad_evaluate_task(void* arg, int index)
+{
+    quad_round* round = (quad_round*)arg;
+    double x[QUAD_PANELS_PER_TASK * QUAD_NODES];
+    double f[QUAD_PANELS_PER_TASK * QUAD_NODES];
+    double* variables[1];
+    quad_panel* panel;
+    double center, half;
+    int first, count, p, k;
+
+    first = index * QUAD_PANELS_PER_TASK;
+    count = (round->count - first < QUAD_PANELS_PER_TASK) ? round->count - first : QUAD_PANELS_PER_TASK;
+
+    for (p = 0; p < count; p++)
+    {
+        panel = &round->panels[first + p];
+        center = panel->a + (panel->b - panel->a) / 2;
+        half = (panel->b - panel->a) / 2;
+        for (k = 0; k < 7; k++)
+        {
+            x[p * QUAD_NODES + k] = center - half * quad_kronrod_nodes[k];
+            x[p * QUAD_NODES + 14 - k] = center + half * quad_kronrod_nodes[k];
+        }
+        x[p * QUAD_NODES + 7] = center;
+    }
+
+    variables[0] = x;
+    prog_evaluate_block(round->prog, variables, count * QUAD_NODES, f);
+
+    for (p = 0; p < count; p++)
+        quad_rules(&round->panels[first + p], f + p * QUAD_NODES);
+}
+
+/**
+ * Evaluates panels, QUAD_PANELS_PER_TASK of them per task, using supplied thread pool (may be NULL)
+ */
+static void quad_evaluate(rpn_program* prog, quad_panel* panels, int count, thread_pool* pool)
+{
+    quad_round round;
+
+    round.prog = prog;
+    round.panels = panels;
+    round.count = count;
+    pool_run(pool, quad_evaluate_task, &round, (count + QUAD_PANELS_PER_TASK - 1) / QUAD_PANELS_PER_TASK);
+}
+
+/**
+ * Decides, whether error of the first panel is greater than of the second one (undefined error is
+ * the greatest)
+ */
+static int quad_worse(const quad_panel* first, const quad_panel* second)
+{
+    if (first->error != first->error)
+        return second->error == second->error;
+    return first->error > second->error;
+}
+
+/**
+ * Inserts panel to heap of "count" panels
+ */
+static void quad_heap_push(quad_panel* heap, int count, const quad_panel* panel)
+{
+    int i, parent;
+
+    i = count;
+    while (i > 0)
+    {
+        parent = (i - 1) / 2;
+        if (!quad_worse(panel, &heap[parent]))
+            break;
+        heap[i] = heap[parent];
+        i = parent;
+    }
+    heap[i] = *panel;
+}
+
+/**
+ * Removes the worst panel from heap of "count" panels and stores it to "panel"
+ */
+static void quad_heap_pop(quad_panel* heap, int count, quad_panel* panel)
+{
+    quad_panel last;
+    int i, child;
+
+    *panel = heap[0];
+    last = heap[count - 1];
+    count--;
+
+    i = 0;
+    for (;;)
+    {
+        child = 2 * i + 1;
+        if (child >= count)
+            break;
+        if (child + 1 < count && quad_worse(&heap[child + 1], &heap[child]))
+            child++;
+        if (!quad_worse(&heap[child], &last))
+            break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    if (count > 0)
+        heap[i] = last;
+}
+
+/**
+ * Sums values and errors of all panels
+ */
+static void quad_sum(const quad_panel* heap, int count, double* value, double* error)
+{
+    int i;
+
+    *value = 0;
+    *error = 0;
+    for (i = 0; i < count; i++)
+    {
+        *value += heap[i].value;
+        *error += heap[i].error;
+    }
+}
+
+/**
+ * Integrates program of one variable over [a, b] by adaptive Gauss-Kronrod (G7K15) quadrature to
+ * supplied absolute tolerance; panels are evaluated in parallel using supplied thread pool (may be
+ * NULL), the result is the same for any number of threads
+ * - if the tolerance is not reached within QUAD_MAX_PANELS panels (i.e. the integral diverges, or
+ *   the function is not defined on the whole interval), "converged" of result is 0
+ * Returns 0 on success, 1 if the program has more variables, the bounds are not finite or there's
+ * not enough memory
+ */
+int quad_integrate(rpn_program* prog, double a, double b, double tolerance, thread_pool* pool, quad_result* result)
+{
+    quad_panel* heap;
+    quad_panel* round;
+    quad_panel worst;
+    double value, error, popped, sign, mid;
+    int count, bisected, i;
+
+    memset(result, 0, sizeof(quad_result));
+    if (prog->variable_count > 1 || a - a != 0 || b - b != 0)
+        return 1;
+
+    if (a == b)
+    {
+        result->converged = 1;
+        return 0;
+    }
+
+    /* reversed bounds change sign */
+    sign = 1;
+    if (a > b)
+    {
+        mid = a;
+        a = b;
+        b = mid;
+        sign = -1;
+    }
+
+    heap = (quad_panel*)malloc(sizeof(quad_panel) * QUAD_MAX_PANELS);
+    round = (quad_panel*)malloc(sizeof(quad_panel) * 2 * QUAD_ROUND_PANELS);
+    if (heap == NULL || round == NULL)
+    {
+        free(heap);
+        free(round);
+        return 1;
+    }
+
+    for (i = 0; i < QUAD_INITIAL_PANELS; i++)
+    {
+        round[i].a = a + (b - a) * i / QUAD_INITIAL_PANELS;
+        round[i].b = (i + 1 < QUAD_INITIAL_PANELS) ? a + (b - a) * (i + 1) / QUAD_INITIAL_PANELS : b;
+    }
+    quad_evaluate(prog, round, QUAD_INITIAL_PANELS, pool);
+    result->evaluations = QUAD_INITIAL_PANELS * QUAD_NODES;
+
+    count = 0;
+    for (i = 0; i < QUAD_INITIAL_PANELS; i++)
+        quad_heap_push(heap, count++, &round[i]);
+    quad_sum(heap, count, &value, &error);
+
+    while (!(error <= tolerance) && count + QUAD_ROUND_PANELS <= QUAD_MAX_PANELS)
+    {
+        /* the worst panels, until the rest is within tolerance */
+        bisected = 0;
+        popped = 0;
+        while (bisected < QUAD_ROUND_PANELS && count > 0 && !(error - popped <= tolerance))
+        {
+            mid = heap[0].a + (heap[0].b - heap[0].a) / 2;
+            if (mid <= heap[0].a || mid >= heap[0].b)
+                break;
+
+            quad_heap_pop(heap, count--, &worst);
+            popped += worst.error;
+            round[2 * bisected].a = worst.a;
+            round[2 * bisected].b = mid;
+            round[2 * bisected + 1].a = mid;
+            round[2 * bisected + 1].b = worst.b;
+            bisected++;
+        }
+
+        /* the worst panel can not be bisected any more */
+        if (bisected == 0)
+            break;
+
+        quad_evaluate(prog, round, 2 * bisected, pool);
+        result->evaluations += 2 * bisected * QUAD_NODES;
+        for (i = 0; i < 2 * bisected; i++)
+            quad_heap_push(heap, count++, &round[i]);
+
+        quad_sum(heap, count, &value, &error);
+    }
+
+    result->value = sign * value;
+    result->error = error;
+    result->panels = count;
+    result->converged = (error <= tolerance) ? 1 : 0;
+
+    free(heap);
+    free(round);
+
+    return 0;
+}
+
+/**
+ * Integrates expression of variable x over [a, b] to supplied absolute tolerance (0 means
+ * QUAD_DEFAULT_TOLERANCE) - see quad_integrate
+ * Returns 0 on success, 1 if the expression is not valid or there's not enough memory
+ */
+int quad_integrate_expression(const char* expression, double a, double b, double tolerance, quad_result* result)
+{
+    c_stack* parsed;
+    rpn_program* prog;
+    char *copy, *error_ptr;
+    int error, res;
+
+    memset(result, 0, sizeof(quad_result));
+
+    copy = (char*)malloc(strlen(expression) + 1);
+    if (copy == NULL)
+        return 1;
+    strcpy(copy, expression);
+
+    parsed = sy_generate_rpn_stack(copy, &error, &error_ptr);
+    prog = (parsed != NULL && error == SYNTAX_ERROR_NONE) ? prog_compile(parsed, copy, (int)strlen(copy), NULL) : NULL;
+    if (parsed != NULL)
+        stck_destroy(parsed);
+    free(copy);
+    if (prog == NULL)
+        return 1;
+
+    res = quad_integrate(prog, a, b, (tolerance > 0) ? tolerance : QUAD_DEFAULT_TOLERANCE, NULL, result);
+    prog_destroy(prog);
+
+    return res;
+}
@@ -0,0 +1,24 @@
+#ifndef MATHPARSER_QUADRATURE_H
+#define MATHPARSER_QUADRATURE_H
+
+#define QUAD_NODES 15                   /* number of Gauss-Kronrod nodes of one panel */
+#define QUAD_PANELS_PER_TASK 8          /* number of panels evaluated by one task (all their nodes fit one block) */
+#define QUAD_INITIAL_PANELS 8           /* number of equal panels the interval is split to at first */
+#define QUAD_ROUND_PANELS 64            /* maximum number of the worst panels bisected in one round */
+#define QUAD_MAX_PANELS 65536           /* maximum number of panels, integration stops there */
+#define QUAD_DEFAULT_TOLERANCE 1e-10    /* implicit absolute tolerance of integral */
+
+/* result of integration */
+typedef struct
+{
+    double value;                       /* integral */
+    double error;                       /* estimate of absolute error */
+    int panels;                         /* number of panels the interval was split to */
+    long evaluations;                   /* number of function evaluations */
+    int converged;                      /* the error is within tolerance */
+} quad_result;
+
+int quad_integrate(rpn_program* prog, double a, double b, double tolerance, thread_pool* pool, quad_result* result);
+int quad_integrate_expression(const char* expression, double a, double b, double tolerance, quad_result* result);
+
+#endif
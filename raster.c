@@ -0,0 +1,874 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "pool.h"
+#include "raster.h"
+
+/*
+ * Raster output draws the same page as PostScript output, but into RGB pixel buffer. Drawing
+ * operations are only recorded (in pixel coordinates) to display list; when the page is complete,
+ * the image is split to horizontal bands of RASTER_BAND_HEIGHT rows, and every band is rendered
+ * by its own task - it fills its rows with background and draws all primitives clipped to them.
+ * Bands do not share any pixel, so they may be rendered in parallel with no locking.
+ *
+ * Lines are anti-aliased - the coverage of pixel is estimated from distance of its center to
+ * the segment (a "capsule" with round caps), so joints of polyline segments need no special care.
+ * Text is drawn by built-in 5x7 bitmap font, scaled by whole pixels. Images are scaled to their
+ * rectangle by nearest pixel.
+ *
+ * The image is written either as binary PPM, or as PNG with its own minimal encoder - rows use
+ * the "Sub" filter (so the uniform areas become runs of zeros), and are compressed by single
+ * deflate block with fixed Huffman codes, encoding only runs of repeated bytes (distance 1). If it
+ * does not help, the data are stored uncompressed.
+ */
+
+/* 5x7 font for ASCII 32..126; every glyph is 5 columns, bit 0 of column is the top row */
+static const unsigned char raster_font[95][RASTER_GLYPH_WIDTH] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00}, {0x00, 0x00, 0x5F, 0x00, 0x00}, {0x00, 0x07, 0x00, 0x07, 0x00}, {0x14, 0x7F, 0x14, 0x7F, 0x14},
+    {0x24, 0x2A, 0x7F, 0x2A, 0x12}, {0x23, 0x13, 0x08, 0x64, 0x62}, {0x36, 0x49, 0x55, 0x22, 0x50}, {0x00, 0x05, 0x03, 0x00, 0x00},
+    {0x00, 0x1C, 0x22, 0x41, 0x00}, {0x00, 0x41, 0x22, 0x1C, 0x00}, {0x14, 0x08, 0x3E, 0x08, 0x14}, {0x08, 0x08, 0x3E, 0x08, 0x08},
+    {0x00, 0x50, 0x30, 0x00, 0x00}, {0x08, 0x08, 0x08, 0x08, 0x08}, {0x00, 0x60, 0x60, 0x00, 0x00}, {0x20, 0x10, 0x08, 0x04, 0x02},
+    {0x3E, 0x51, 0x49, 0x45, 0x3E}, {0x00, 0x42, 0x7F, 0x40, 0x00}, {0x42, 0x61, 0x51, 0x49, 0x46}, {0x21, 0x41, 0x45, 0x4B, 0x31},
+    {0x18, 0x14, 0x12, 0x7F, 0x10}, {0x27, 0x45, 0x45, 0x45, 0x39}, {0x3C, 0x4A, 0x49, 0x49, 0x30}, {0x01, 0x71, 0x09, 0x05, 0x03},
+    {0x36, 0x49, 0x49, 0x49, 0x36}, {0x06, 0x49, 0x49, 0x29, 0x1E}, {0x00, 0x36, 0x36, 0x00, 0x00}, {0x00, 0x56, 0x36, 0x00, 0x00},
+    {0x08, 0x14, 0x22, 0x41, 0x00}, {0x14, 0x14, 0x14, 0x14, 0x14}, {0x00, 0x41, 0x22, 0x14, 0x08}, {0x02, 0x01, 0x51, 0x09, 0x06},
+    {0x32, 0x49, 0x79, 0x41, 0x3E}, {0x7E, 0x11, 0x11, 0x11, 0x7E}, {0x7F, 0x49, 0x49, 0x49, 0x36}, {0x3E, 0x41, 0x41, 0x41, 0x22},
+    {0x7F, 0x41, 0x41, 0x22, 0x1C}, {0x7F, 0x49, 0x49, 0x49, 0x41}, {0x7F, 0x09, 0x09, 0x01, 0x01}, {0x3E, 0x41, 0x41, 0x51, 0x32},
+    {0x7F, 0x08, 0x08, 0x08, 0x7F}, {0x00, 0x41, 0x7F, 0x41, 0x00}, {0x20, 0x40, 0x41, 0x3F, 0x01}, {0x7F, 0x08, 0x14, 0x22, 0x41},
+    {0x7F, 0x40, 0x40, 0x40, 0x40}, {0x7F, 0x02, 0x04, 0x02, 0x7F}, {0x7F, 0x04, 0x08, 0x10, 0x7F}, {0x3E, 0x41, 0x41, 0x41, 0x3E},
+    {0x7F, 0x09, 0x09, 0x09, 0x06}, {0x3E, 0x41, 0x51, 0x21, 0x5E}, {0x7F, 0x09, 0x19, 0x29, 0x46}, {0x46, 0x49, 0x49, 0x49, 0x31},
+    {0x01, 0x01, 0x7F, 0x01, 0x01}, {0x3F, 0x40, 0x40, 0x40, 0x3F}, {0x1F, 0x20, 0x40, 0x20, 0x1F}, {0x7F, 0x20, 0x18, 0x20, 0x7F},
+    {0x63, 0x14, 0x08, 0x14, 0x63}, {0x03, 0x04, 0x78, 0x04, 0x03}, {0x61, 0x51, 0x49, 0x45, 0x43}, {0x00, 0x7F, 0x41, 0x41, 0x00},
+    {0x02, 0x04, 0x08, 0x10, 0x20}, {0x00, 0x41, 0x41, 0x7F, 0x00}, {0x04, 0x02, 0x01, 0x02, 0x04}, {0x40, 0x40, 0x40, 0x40, 0x40},
+    {0x00, 0x01, 0x02, 0x04, 0x00}, {0x20, 0x54, 0x54, 0x54, 0x78}, {0x7F, 0x48, 0x44, 0x44, 0x38}, {0x38, 0x44, 0x44, 0x44, 0x20},
+    {0x38, 0x44, 0x44, 0x48, 0x7F}, {0x38, 0x54, 0x54, 0x54, 0x18}, {0x08, 0x7E, 0x09, 0x01, 0x02}, {0x08, 0x14, 0x54, 0x54, 0x3C},
+    {0x7F, 0x08, 0x04, 0x04, 0x78}, {0x00, 0x44, 0x7D, 0x40, 0x00}, {0x20, 0x40, 0x44, 0x3D, 0x00}, {0x00, 0x7F, 0x10, 0x28, 0x44},
+    {0x00, 0x41, 0x7F, 0x40, 0x00}, {0x7C, 0x04, 0x18, 0x04, 0x78}, {0x7C, 0x08, 0x04, 0x04, 0x78}, {0x38, 0x44, 0x44, 0x44, 0x38},
+    {0x7C, 0x14, 0x14, 0x14, 0x08}, {0x08, 0x14, 0x14, 0x18, 0x7C}, {0x7C, 0x08, 0x04, 0x04, 0x08}, {0x48, 0x54, 0x54, 0x54, 0x20},
+    {0x04, 0x3F, 0x44, 0x40, 0x20}, {0x3C, 0x40, 0x40, 0x20, 0x7C}, {0x1C, 0x20, 0x40, 0x20, 0x1C}, {0x3C, 0x40, 0x30, 0x40, 0x3C},
+    {0x44, 0x28, 0x10, 0x28, 0x44}, {0x0C, 0x50, 0x50, 0x50, 0x3C}, {0x44, 0x64, 0x54, 0x4C, 0x44}, {0x00, 0x08, 0x36, 0x41, 0x00},
+    {0x00, 0x00, 0x7F, 0x00, 0x00}, {0x00, 0x41, 0x36, 0x08, 0x00}, {0x08, 0x04, 0x08, 0x10, 0x08}
+};
+
+/* base match lengths of deflate length symbols 257..285, and numbers of their extra bits */
+static const int raster_length_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const int raster_length_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+/* deflate stream written by parts (filtered rows); bits are packed from least significant one */
+typedef struct
+{
+    unsigned char* data;                /* output buffer */
+    long length;                        /* number of complete bytes written */
+    unsigned long bits;                 /* bits not written yet */
+    int bit_count;                      /* number of bits not written yet */
+    int previous;                       /* last byte of data compressed so far (-1 at start) */
+    unsigned long adler_a, adler_b;     /* Adler-32 sums of data compressed so far */
+    unsigned int codes[288];            /* fixed Huffman codes of literal/length symbols, bit-reversed */
+    int code_lengths[288];              /* bit lengths of fixed Huffman codes */
+} raster_deflater;
+
+/**
+ * Recognizes raster format by filename extension (.ppm or .png, in any case)
+ */
+int raster_format_of(const char* filename)
+{
+    const char* ext = strrchr(filename, '.');
+    char lower[5];
+    int i;
+
+    if (ext == NULL || strlen(ext) != 4)
+        return RASTER_FORMAT_NONE;
+
+    for (i = 0; i < 4; i++)
+        lower[i] = (ext[i] >= 'A' && ext[i] <= 'Z') ? (char)(ext[i] - 'A' + 'a') : ext[i];
+    lower[4] = '\0';
+
+    if (strcmp(lower, ".ppm") == 0)
+        return RASTER_FORMAT_PPM;
+    if (strcmp(lower, ".png") == 0)
+        return RASTER_FORMAT_PNG;
+    return RASTER_FORMAT_NONE;
+}
+
+/**
+ * Creates empty image of supplied size; the square page area of RASTER_PAGE_SIZE units is mapped
+ * to it (by the shorter side)
+ */
+raster_image* raster_create(int width, int height)
+{
+    raster_image* img;
+
+    if (width <= 0 || height <= 0)
+        return NULL;
+
+    img = (raster_image*)malloc(sizeof(raster_image));
+    if (img == NULL)
+        return NULL;
+
+    img->width = width;
+    img->height = height;
+    img->scale = ((width < height) ? width : height) / RASTER_PAGE_SIZE;
+    img->pixels = (unsigned char*)malloc((size_t)width * height * 3);
+    img->capacity = RASTER_INITIAL_PRIMITIVES;
+    img->primitives = (raster_primitive*)malloc(sizeof(raster_primitive) * img->capacity);
+    img->text_capacity = RASTER_INITIAL_PRIMITIVES;
+    img->texts = (char*)malloc(img->text_capacity);
+    img->count = 0;
+    if (img->pixels == NULL || img->primitives == NULL || img->texts == NULL)
+    {
+        raster_destroy(img);
+        return NULL;
+    }
+
+    img->text_length = 0;
+    img->failed = 0;
+    memset(img->color, 0, sizeof(img->color));
+    img->line_width = 1.0;
+    img->font_size = 10;
+    img->pos_x = img->pos_y = 0;
+    img->start_x = img->start_y = 0;
+
+    return img;
+}
+
+/**
+ * Destroys image with its display list
+ */
+void raster_destroy(raster_image* img)
+{
+    long i;
+
+    if (img->primitives != NULL)
+    {
+        for (i = 0; i < img->count; i++)
+        {
+            if (img->primitives[i].type == RASTER_PRIMITIVE_IMAGE)
+                free(img->primitives[i].data);
+        }
+    }
+    free(img->pixels);
+    free(img->primitives);
+    free(img->texts);
+    free(img);
+}
+
+/**
+ * Appends primitive of current color to display list, returns NULL if it could not be grown
+ */
+static raster_primitive* raster_add(raster_image* img, int type)
+{
+    raster_primitive* grown;
+    raster_primitive* prim;
+
+    if (img->count == img->capacity)
+    {
+        grown = (raster_primitive*)realloc(img->primitives, sizeof(raster_primitive) * img->capacity * 2);
+        if (grown == NULL)
+        {
+            img->failed = 1;
+            return NULL;
+        }
+        img->primitives = grown;
+        img->capacity *= 2;
+    }
+
+    prim = &img->primitives[img->count++];
+    prim->type = type;
+    memcpy(prim->color, img->color, sizeof(prim->color));
+    return prim;
+}
+
+/**
+ * Converts color component (0..1) to byte
+ */
+static unsigned char raster_component(double value)
+{
+    if (!(value > 0))
+        return 0;
+    if (value >= 1)
+        return 255;
+    return (unsigned char)(value * 255 + 0.5);
+}
+
+/**
+ * Sets color of following primitives
+ */
+void raster_set_color(raster_image* img, double r, double g, double b)
+{
+    img->color[0] = raster_component(r);
+    img->color[1] = raster_component(g);
+    img->color[2] = raster_component(b);
+}
+
+/**
+ * Sets width of following lines (in page units)
+ */
+void raster_set_line_width(raster_image* img, double width)
+{
+    img->line_width = width;
+}
+
+/**
+ * Sets font size of following texts (in page units)
+ */
+void raster_set_font_size(raster_image* img, int size)
+{
+    img->font_size = size;
+}
+
+/**
+ * Moves current point, starting new path there
+ */
+void raster_move_to(raster_image* img, double x, double y)
+{
+    img->pos_x = img->start_x = x;
+    img->pos_y = img->start_y = y;
+}
+
+/**
+ * Records line from current point to supplied one, which becomes current
+ */
+void raster_line_to(raster_image* img, double x, double y)
+{
+    raster_primitive* prim = raster_add(img, RASTER_PRIMITIVE_LINE);
+
+    if (prim != NULL)
+    {
+        prim->x0 = img->pos_x * img->scale;
+        prim->y0 = img->height - img->pos_y * img->scale;
+        prim->x1 = x * img->scale;
+        prim->y1 = img->height - y * img->scale;
+        prim->width = img->line_width * img->scale;
+    }
+
+    img->pos_x = x;
+    img->pos_y = y;
+}
+
+/**
+ * Records line from current point back to start of path
+ */
+void raster_close_path(raster_image* img)
+{
+    raster_line_to(img, img->start_x, img->start_y);
+}
+
+/**
+ * Records text starting at current point (on baseline); current point moves past it
+ */
+void raster_text(raster_image* img, const char* text)
+{
+    raster_primitive* prim;
+    long length = (long)strlen(text);
+    long capacity;
+    char* grown;
+    int glyph_scale;
+
+    if (img->text_length + length + 1 > img->text_capacity)
+    {
+        capacity = img->text_capacity * 2;
+        while (img->text_length + length + 1 > capacity)
+            capacity *= 2;
+        grown = (char*)realloc(img->texts, capacity);
+        if (grown == NULL)
+        {
+            img->failed = 1;
+            return;
+        }
+        img->texts = grown;
+        img->text_capacity = capacity;
+    }
+
+    prim = raster_add(img, RASTER_PRIMITIVE_TEXT);
+    if (prim == NULL)
+        return;
+
+    /* glyph (7 font pixels tall) roughly matches the cap height of font of that size */
+    glyph_scale = (int)(img->font_size * img->scale / 10.0 + 0.5);
+    if (glyph_scale < 1)
+        glyph_scale = 1;
+
+    prim->x0 = floor(img->pos_x * img->scale + 0.5);
+    prim->y0 = floor(img->height - img->pos_y * img->scale + 0.5);
+    prim->width = glyph_scale;
+    prim->text = img->text_length;
+    memcpy(img->texts + img->text_length, text, length + 1);
+    img->text_length += length + 1;
+
+    img->pos_x += (double)length * RASTER_GLYPH_ADVANCE * glyph_scale / img->scale;
+}
+
+/**
+ * Records RGB image (pixel_width x pixel_height pixels, the top row first) scaled to rectangle with
+ * supplied lower left corner and size (in page units)
+ */
+void raster_image_rgb(raster_image* img, double x, double y, double width, double height, int pixel_width, int pixel_height,
+                      const unsigned char* rgb)
+{
+    raster_primitive* prim;
+    unsigned char* data;
+
+    data = (unsigned char*)malloc((size_t)pixel_width * pixel_height * 3);
+    if (data == NULL)
+    {
+        img->failed = 1;
+        return;
+    }
+
+    prim = raster_add(img, RASTER_PRIMITIVE_IMAGE);
+    if (prim == NULL)
+    {
+        free(data);
+        return;
+    }
+
+    memcpy(data, rgb, (size_t)pixel_width * pixel_height * 3);
+    prim->data = data;
+    prim->data_width = pixel_width;
+    prim->data_height = pixel_height;
+    prim->x0 = x * img->scale;
+    prim->y0 = img->height - (y + height) * img->scale;
+    prim->x1 = (x + width) * img->scale;
+    prim->y1 = img->height - y * img->scale;
+}
+
+/**
+ * Blends color into pixel with supplied coverage (0..1)
+ */
+static void raster_blend(unsigned char* pixel, const unsigned char* color, double coverage)
+{
+    int i;
+
+    for (i = 0; i < 3; i++)
+        pixel[i] = (unsigned char)(pixel[i] + (color[i] - pixel[i]) * coverage + 0.5);
+}
+
+/**
+ * Draws anti-aliased line to rows first..last of image
+ */
+static void raster_draw_line(raster_image* img, const raster_primitive* prim, int first, int last)
+{
+    double half = prim->width / 2;
+    double reach = half + 1;
+    double outer = half + 0.5;
+    double opacity = (prim->width < 1) ? prim->width : 1;
+    double dx = prim->x1 - prim->x0, dy = prim->y1 - prim->y0;
+    double len = sqrt(dx*dx + dy*dy);
+    double box_left, box_right, top, bottom;
+    double cy, t, t_step, dist, dist_step, end_x, end_y, coverage, center, span;
+    int row, col, col_first, col_last;
+    unsigned char* line;
+
+    top = ((prim->y0 < prim->y1) ? prim->y0 : prim->y1) - reach;
+    bottom = ((prim->y0 > prim->y1) ? prim->y0 : prim->y1) + reach;
+    box_left = ((prim->x0 < prim->x1) ? prim->x0 : prim->x1) - reach;
+    box_right = ((prim->x0 > prim->x1) ? prim->x0 : prim->x1) + reach;
+
+    if (bottom < first || top >= last + 1 || box_right < 0 || box_left >= img->width)
+        return;
+
+    if (top > first)
+        first = (int)top;
+    if (bottom < last + 1)
+        last = (int)bottom;
+    if (box_left < 0)
+        box_left = 0;
+    if (box_right > img->width - 1)
+        box_right = img->width - 1;
+
+    /* position along the segment (0..1) and distance from its line both change linearly by columns */
+    t_step = (len > 0) ? dx / (len * len) : 0;
+    dist_step = (len > 0) ? dy / len : 0;
+
+    for (row = first; row <= last; row++)
+    {
+        cy = row + 0.5;
+        col_first = (int)box_left;
+        col_last = (int)box_right;
+
+        /* steep enough line crosses the row only in narrow span around its intersection */
+        if (fabs(dy) * 4 > fabs(dx))
+        {
+            center = prim->x0 + (cy - prim->y0) * dx / dy;
+            span = reach * len / fabs(dy);
+            if (center - span > col_first)
+                col_first = (int)(center - span);
+            if (center + span < col_last)
+                col_last = (int)(center + span);
+        }
+
+        t = (len > 0) ? ((col_first + 0.5 - prim->x0) * dx + (cy - prim->y0) * dy) / (len * len) : 0;
+        dist = (len > 0) ? ((col_first + 0.5 - prim->x0) * dy - (cy - prim->y0) * dx) / len : 0;
+
+        line = img->pixels + (size_t)row * img->width * 3;
+        for (col = col_first; col <= col_last; col++, t += t_step, dist += dist_step)
+        {
+            /* distance of pixel center to the segment - to its line, or to the nearer end */
+            if (t >= 0 && t <= 1)
+                coverage = outer - fabs(dist);
+            else
+            {
+                end_x = ((t < 0) ? prim->x0 : prim->x1) - (col + 0.5);
+                end_y = ((t < 0) ? prim->y0 : prim->y1) - cy;
+                coverage = end_x*end_x + end_y*end_y;
+                if (coverage >= outer * outer)
+                    continue;
+                coverage = outer - sqrt(coverage);
+            }
+
+            if (coverage <= 0)
+                continue;
+            if (coverage >= 1 && opacity >= 1)
+            {
+                line[col * 3] = prim->color[0];
+                line[col * 3 + 1] = prim->color[1];
+                line[col * 3 + 2] = prim->color[2];
+                continue;
+            }
+            if (coverage > 1)
+                coverage = 1;
+            raster_blend(line + col * 3, prim->color, coverage * opacity);
+        }
+    }
+}
+
+/**
+ * Draws text to rows first..last of image
+ */
+static void raster_draw_text(raster_image* img, const raster_primitive* prim, int first, int last)
+{
+    const char* chr;
+    const unsigned char* glyph;
+    int scale = (int)prim->width;
+    int left = (int)prim->x0;
+    int top = (int)prim->y0 - RASTER_GLYPH_HEIGHT * scale;
+    int col, bit, x, y, x_end, y_end, i;
+    unsigned char* pixel;
+
+    if (top > last || top + RASTER_GLYPH_HEIGHT * scale <= first)
+        return;
+
+    for (chr = img->texts + prim->text; *chr != '\0'; chr++, left += RASTER_GLYPH_ADVANCE * scale)
+    {
+        glyph = raster_font[(*chr >= 32 && *chr <= 126) ? *chr - 32 : '?' - 32];
+
+        for (col = 0; col < RASTER_GLYPH_WIDTH; col++)
+        {
+            for (bit = 0; bit < RASTER_GLYPH_HEIGHT; bit++)
+            {
+                if (!(glyph[col] & (1 << bit)))
+                    continue;
+
+                /* font pixel is square of scale x scale image pixels */
+                y_end = top + (bit + 1) * scale;
+                x_end = left + (col + 1) * scale;
+                for (y = top + bit * scale; y < y_end; y++)
+                {
+                    if (y < first || y > last)
+                        continue;
+                    for (x = left + col * scale; x < x_end; x++)
+                    {
+                        if (x < 0 || x >= img->width)
+                            continue;
+                        pixel = img->pixels + ((size_t)y * img->width + x) * 3;
+                        for (i = 0; i < 3; i++)
+                            pixel[i] = prim->color[i];
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Draws image to rows first..last of image, every pixel takes color of image pixel under its center
+ */
+static void raster_draw_image(raster_image* img, const raster_primitive* prim, int first, int last)
+{
+    int row, col, col_first, col_last, src_row, src_col;
+    double scale_x = prim->data_width / (prim->x1 - prim->x0);
+    double scale_y = prim->data_height / (prim->y1 - prim->y0);
+    const unsigned char* src;
+    unsigned char* line;
+
+    /* pixels with centers inside the rectangle */
+    if (prim->y0 - 0.5 > first)
+        first = (int)ceil(prim->y0 - 0.5);
+    if (prim->y1 - 0.5 < last + 1)
+        last = (int)ceil(prim->y1 - 0.5) - 1;
+    col_first = (prim->x0 - 0.5 > 0) ? (int)ceil(prim->x0 - 0.5) : 0;
+    col_last = (prim->x1 - 0.5 < img->width) ? (int)ceil(prim->x1 - 0.5) - 1 : img->width - 1;
+
+    for (row = first; row <= last; row++)
+    {
+        src_row = (int)((row + 0.5 - prim->y0) * scale_y);
+        if (src_row >= prim->data_height)
+            src_row = prim->data_height - 1;
+        src = prim->data + (size_t)src_row * prim->data_width * 3;
+        line = img->pixels + (size_t)row * img->width * 3;
+
+        for (col = col_first; col <= col_last; col++)
+        {
+            src_col = (int)((col + 0.5 - prim->x0) * scale_x);
+            if (src_col >= prim->data_width)
+                src_col = prim->data_width - 1;
+            memcpy(line + col * 3, src + src_col * 3, 3);
+        }
+    }
+}
+
+/**
+ * Renders one band of image - fills it with white and draws all primitives clipped to it
+ * (task routine)
+ */
+static void raster_render_band(void* arg, int index)
+{
+    raster_image* img = (raster_image*)arg;
+    int first = index * RASTER_BAND_HEIGHT;
+    int last = first + RASTER_BAND_HEIGHT - 1;
+    long i;
+
+    if (last >= img->height)
+        last = img->height - 1;
+
+    memset(img->pixels + (size_t)first * img->width * 3, 255, (size_t)(last - first + 1) * img->width * 3);
+
+    for (i = 0; i < img->count; i++)
+    {
+        if (img->primitives[i].type == RASTER_PRIMITIVE_LINE)
+            raster_draw_line(img, &img->primitives[i], first, last);
+        else if (img->primitives[i].type == RASTER_PRIMITIVE_TEXT)
+            raster_draw_text(img, &img->primitives[i], first, last);
+        else
+            raster_draw_image(img, &img->primitives[i], first, last);
+    }
+}
+
+/**
+ * Renders recorded primitives to pixels, by bands using supplied thread pool (may be NULL)
+ */
+void raster_render(raster_image* img, thread_pool* pool)
+{
+    pool_run(pool, raster_render_band, img, (img->height + RASTER_BAND_HEIGHT - 1) / RASTER_BAND_HEIGHT);
+}
+
+/**
+ * Appends bits to deflate output (least significant first)
+ */
+static void raster_put_bits(raster_deflater* def, unsigned long value, int count)
+{
+    def->bits |= value << def->bit_count;
+    def->bit_count += count;
+    while (def->bit_count >= 8)
+    {
+        def->data[def->length++] = (unsigned char)(def->bits & 0xFF);
+        def->bits >>= 8;
+        def->bit_count -= 8;
+    }
+}
+
+/**
+ * Initializes deflate stream written to supplied buffer; fixed Huffman codes are prepared
+ * bit-reversed, as they are packed from most significant bit
+ */
+static void raster_deflate_init(raster_deflater* def, unsigned char* output)
+{
+    unsigned int code;
+    int symbol, i;
+
+    def->data = output;
+    def->length = 0;
+    def->bits = 0;
+    def->bit_count = 0;
+    def->previous = -1;
+    def->adler_a = 1;
+    def->adler_b = 0;
+
+    for (symbol = 0; symbol < 288; symbol++)
+    {
+        if (symbol < 144)
+        {
+            code = 0x30 + symbol;
+            def->code_lengths[symbol] = 8;
+        }
+        else if (symbol < 256)
+        {
+            code = 0x190 + symbol - 144;
+            def->code_lengths[symbol] = 9;
+        }
+        else if (symbol < 280)
+        {
+            code = symbol - 256;
+            def->code_lengths[symbol] = 7;
+        }
+        else
+        {
+            code = 0xC0 + symbol - 280;
+            def->code_lengths[symbol] = 8;
+        }
+
+        def->codes[symbol] = 0;
+        for (i = 0; i < def->code_lengths[symbol]; i++)
+            def->codes[symbol] |= ((code >> i) & 1) << (def->code_lengths[symbol] - 1 - i);
+    }
+}
+
+/**
+ * Adds data to Adler-32 sums; sums are reduced once per RASTER_ADLER_BLOCK bytes
+ */
+static void raster_adler(raster_deflater* def, const unsigned char* data, long size)
+{
+    long i, k;
+
+    for (i = 0; i < size; i += RASTER_ADLER_BLOCK)
+    {
+        for (k = i; k < i + RASTER_ADLER_BLOCK && k < size; k++)
+        {
+            def->adler_a += data[k];
+            def->adler_b += def->adler_a;
+        }
+        def->adler_a %= 65521;
+        def->adler_b %= 65521;
+    }
+}
+
+/**
+ * Compresses next part of data to single deflate block with fixed Huffman codes (started by first
+ * part), encoding runs of repeated bytes as matches at distance 1
+ */
+static void raster_deflate_runs(raster_deflater* def, const unsigned char* data, long size)
+{
+    long i, run;
+    int code, last;
+
+    /* final block, fixed Huffman codes */
+    if (def->previous < 0 && def->length == 0 && def->bit_count == 0)
+        raster_put_bits(def, 3, 3);
+
+    raster_adler(def, data, size);
+
+    last = def->previous;
+    i = 0;
+    while (i < size)
+    {
+        run = 0;
+        while (last >= 0 && run < RASTER_MAX_MATCH && i + run < size && data[i + run] == last)
+            run++;
+
+        if (run < 3)
+        {
+            raster_put_bits(def, def->codes[data[i]], def->code_lengths[data[i]]);
+            last = data[i];
+            i++;
+            continue;
+        }
+
+        for (code = 28; raster_length_base[code] > run; code--)
+            ;
+        raster_put_bits(def, def->codes[257 + code], def->code_lengths[257 + code]);
+        raster_put_bits(def, run - raster_length_base[code], raster_length_extra[code]);
+        /* distance 1 is code 0 (5 bits) */
+        raster_put_bits(def, 0, 5);
+        i += run;
+    }
+    def->previous = last;
+}
+
+/**
+ * Finishes block with fixed Huffman codes, pads the stream to whole bytes
+ */
+static void raster_deflate_finish(raster_deflater* def)
+{
+    raster_put_bits(def, def->codes[256], def->code_lengths[256]);
+    if (def->bit_count > 0)
+        raster_put_bits(def, 0, 8 - def->bit_count);
+}
+
+/**
+ * Stores next part of data to uncompressed deflate blocks; the last block of the final part
+ * finishes the stream
+ */
+static void raster_deflate_stored(raster_deflater* def, const unsigned char* data, long size, int final)
+{
+    long pos = 0, block;
+
+    raster_adler(def, data, size);
+
+    do
+    {
+        block = size - pos;
+        if (block > RASTER_STORED_BLOCK)
+            block = RASTER_STORED_BLOCK;
+
+        def->data[def->length++] = (unsigned char)((final && pos + block == size) ? 1 : 0);
+        def->data[def->length++] = (unsigned char)(block & 0xFF);
+        def->data[def->length++] = (unsigned char)(block >> 8);
+        def->data[def->length++] = (unsigned char)(~block & 0xFF);
+        def->data[def->length++] = (unsigned char)((~block >> 8) & 0xFF);
+        memcpy(def->data + def->length, data + pos, block);
+        def->length += block;
+        pos += block;
+    } while (pos < size);
+}
+
+/**
+ * Filters image row for PNG by "Sub" filter - difference from the same component of pixel on the left
+ */
+static void raster_filter_row(const raster_image* img, int y, unsigned char* out)
+{
+    long stride = (long)img->width * 3;
+    const unsigned char* row = img->pixels + (size_t)y * stride;
+    long i;
+
+    out[0] = 1;
+    out[1] = row[0];
+    out[2] = row[1];
+    out[3] = row[2];
+    for (i = 3; i < stride; i++)
+        out[1 + i] = (unsigned char)(row[i] - row[i - 3]);
+}
+
+/**
+ * Writes 32-bit value in big endian order
+ */
+static void raster_put_u32(unsigned char* output, unsigned long value)
+{
+    output[0] = (unsigned char)((value >> 24) & 0xFF);
+    output[1] = (unsigned char)((value >> 16) & 0xFF);
+    output[2] = (unsigned char)((value >> 8) & 0xFF);
+    output[3] = (unsigned char)(value & 0xFF);
+}
+
+/**
+ * Finishes PNG chunk, whose data of supplied length were written after its length and type;
+ * fills the length and appends CRC; returns size of whole chunk
+ */
+static long raster_finish_chunk(unsigned char* chunk, long length, const unsigned long* crc_table)
+{
+    unsigned long crc = 0xFFFFFFFFUL;
+    long i;
+
+    raster_put_u32(chunk, (unsigned long)length);
+    for (i = 4; i < length + 8; i++)
+        crc = crc_table[(crc ^ chunk[i]) & 0xFF] ^ (crc >> 8);
+    raster_put_u32(chunk + length + 8, crc ^ 0xFFFFFFFFUL);
+
+    return length + 12;
+}
+
+/**
+ * Encodes rendered image as PNG (8-bit RGB); returns allocated buffer and stores its size,
+ * or returns NULL if there's not enough memory
+ */
+unsigned char* raster_encode_png(const raster_image* img, long* size)
+{
+    static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    unsigned long crc_table[256];
+    unsigned long crc;
+    long row_size = (long)img->width * 3 + 1;
+    long raw_size = row_size * img->height;
+    long bound, length;
+    raster_deflater def;
+    unsigned char* row;
+    unsigned char* png;
+    unsigned char* idat;
+    int y, i, k;
+
+    row = (unsigned char*)malloc(row_size);
+    /* stored blocks take 5 bytes per block (at least one per row); fixed codes at most 9 bits per byte */
+    bound = raw_size + raw_size / 8 + 5 * (raw_size / RASTER_STORED_BLOCK + img->height) + 64;
+    png = (unsigned char*)malloc(bound);
+    if (row == NULL || png == NULL)
+    {
+        free(row);
+        free(png);
+        return NULL;
+    }
+
+    for (i = 0; i < 256; i++)
+    {
+        crc = (unsigned long)i;
+        for (k = 0; k < 8; k++)
+            crc = (crc & 1) ? (0xEDB88320UL ^ (crc >> 1)) : (crc >> 1);
+        crc_table[i] = crc;
+    }
+
+    memcpy(png, signature, 8);
+    length = 8;
+
+    /* IHDR - size, 8 bits per component, RGB, no interlacing */
+    memcpy(png + length + 4, "IHDR", 4);
+    raster_put_u32(png + length + 8, (unsigned long)img->width);
+    raster_put_u32(png + length + 12, (unsigned long)img->height);
+    png[length + 16] = 8;
+    png[length + 17] = 2;
+    png[length + 18] = 0;
+    png[length + 19] = 0;
+    png[length + 20] = 0;
+    length += raster_finish_chunk(png + length, 13, crc_table);
+
+    /* IDAT - zlib stream (no preset dictionary, fastest compression level) of filtered rows */
+    idat = png + length;
+    memcpy(idat + 4, "IDAT", 4);
+    idat[8] = 0x78;
+    idat[9] = 0x01;
+
+    raster_deflate_init(&def, idat + 10);
+    for (y = 0; y < img->height; y++)
+    {
+        raster_filter_row(img, y, row);
+        raster_deflate_runs(&def, row, row_size);
+    }
+    raster_deflate_finish(&def);
+
+    /* compression did not help, store the rows */
+    if (def.length > raw_size + 5 * (raw_size / RASTER_STORED_BLOCK + img->height))
+    {
+        raster_deflate_init(&def, idat + 10);
+        for (y = 0; y < img->height; y++)
+        {
+            raster_filter_row(img, y, row);
+            raster_deflate_stored(&def, row, row_size, y == img->height - 1);
+        }
+    }
+
+    raster_put_u32(idat + 10 + def.length, (def.adler_b << 16) | def.adler_a);
+    length += raster_finish_chunk(idat, def.length + 6, crc_table);
+
+    /* IEND */
+    memcpy(png + length + 4, "IEND", 4);
+    length += raster_finish_chunk(png + length, 0, crc_table);
+
+    free(row);
+    *size = length;
+    return png;
+}
+
+/**
+ * Writes rendered image to file in supplied format; returns 0 on success, 1 on failure
+ */
+int raster_write(raster_image* img, int format, FILE* file)
+{
+    unsigned char* png;
+    long size;
+    int res;
+
+    if (format == RASTER_FORMAT_PPM)
+    {
+        fprintf(file, "P6\n%i %i\n255\n", img->width, img->height);
+        return fwrite(img->pixels, 3, (size_t)img->width * img->height, file) != (size_t)img->width * img->height;
+    }
+
+    png = raster_encode_png(img, &size);
+    if (png == NULL)
+        return 1;
+    res = fwrite(png, 1, size, file) != (size_t)size;
+    free(png);
+
+    return res;
+}
@@ -0,0 +1,85 @@
+#ifndef MATHPARSER_RASTER_H
+#define MATHPARSER_RASTER_H
+
+#define RASTER_PAGE_SIZE 620.0          /* size of square page area (in PostScript units) mapped to the whole image */
+#define RASTER_BAND_HEIGHT 32           /* number of image rows rendered by one task */
+#define RASTER_INITIAL_PRIMITIVES 1024  /* initial number of primitives the display list has space for */
+#define RASTER_GLYPH_WIDTH 5            /* width of font glyph (in font pixels) */
+#define RASTER_GLYPH_HEIGHT 7           /* height of font glyph (in font pixels) */
+#define RASTER_GLYPH_ADVANCE 6          /* distance of neighbouring glyphs (in font pixels) */
+#define RASTER_MAX_MATCH 258            /* maximum length of repeated bytes encoded by one deflate match */
+#define RASTER_STORED_BLOCK 65535       /* maximum size of stored deflate block */
+#define RASTER_ADLER_BLOCK 5552         /* maximum number of bytes summed by Adler-32 with no overflow */
+
+/* thread pool (pool.h), used by parallel rendering */
+struct _thread_pool;
+
+enum raster_format
+{
+    RASTER_FORMAT_NONE = -1,            /* not a raster file */
+    RASTER_FORMAT_PPM,                  /* binary portable pixmap (P6) */
+    RASTER_FORMAT_PNG                   /* PNG, deflate compressed */
+};
+
+enum raster_primitive_type
+{
+    RASTER_PRIMITIVE_LINE,              /* anti-aliased line segment with round caps */
+    RASTER_PRIMITIVE_TEXT,              /* text in built-in bitmap font */
+    RASTER_PRIMITIVE_IMAGE              /* RGB image scaled to rectangle */
+};
+
+/* recorded drawing primitive, in image coordinates (pixels, Y grows down) */
+typedef struct
+{
+    int type;                           /* enum raster_primitive_type */
+    unsigned char color[3];             /* red, green, blue */
+    double x0, y0, x1, y1;              /* line ends; text uses (x0, y0) as left end of baseline; image corners */
+    double width;                       /* line width; glyph scale of text */
+    long text;                          /* offset of text in text buffer */
+    unsigned char* data;                /* RGB pixels of image (owned by primitive) */
+    int data_width, data_height;        /* image size */
+} raster_primitive;
+
+/* raster image - drawing operations are recorded to display list, which is rendered at once by
+ * horizontal bands in parallel */
+typedef struct _raster_image
+{
+    int width, height;                  /* image size in pixels */
+    double scale;                       /* pixels per page unit */
+    unsigned char* pixels;              /* RGB pixels, the top row first */
+
+    raster_primitive* primitives;       /* display list */
+    long count;                         /* number of recorded primitives */
+    long capacity;                      /* number of primitives the display list has space for */
+    char* texts;                        /* terminated texts of text primitives */
+    long text_length;                   /* used size of text buffer */
+    long text_capacity;                 /* allocated size of text buffer */
+    int failed;                         /* memory allocation failed, some primitives were lost */
+
+    unsigned char color[3];             /* current color */
+    double line_width;                  /* current line width (page units) */
+    int font_size;                      /* current font size (page units) */
+    double pos_x, pos_y;                /* current point (page units) */
+    double start_x, start_y;            /* start of current path (page units) */
+} raster_image;
+
+int raster_format_of(const char* filename);
+
+raster_image* raster_create(int width, int height);
+void raster_destroy(raster_image* img);
+
+void raster_set_color(raster_image* img, double r, double g, double b);
+void raster_set_line_width(raster_image* img, double width);
+void raster_set_font_size(raster_image* img, int size);
+void raster_move_to(raster_image* img, double x, double y);
+void raster_line_to(raster_image* img, double x, double y);
+void raster_close_path(raster_image* img);
+void raster_text(raster_image* img, const char* text);
+void raster_image_rgb(raster_image* img, double x, double y, double width, double height, int pixel_width, int pixel_height,
+                      const unsigned char* rgb);
+
+void raster_render(raster_image* img, struct _thread_pool* pool);
+unsigned char* raster_encode_png(const raster_image* img, long* size);
+int raster_write(raster_image* img, int format, FILE* file);
+
+#endif
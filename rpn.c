@@ -1,227 +1,548 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <math.h>
-#include "stack.h"
-#include "rpn.h"
-#include "main.h"
-
-/**
- * Builds element with specified type
- * - there's nothing special in this function, just allocate memory, set type and that's it
- */
-rpn_element* rpn_build_element(enum rpn_token_type type)
-{
-    rpn_element* tmp = (rpn_element*)malloc(sizeof(rpn_element));
-    memset(tmp, 0, sizeof(rpn_element));
-
-    tmp->type = type;
-
-    return tmp;
-}
-
-/**
- * Applies function (supplied as token identifier) to supplied value and returns it
- */
-static double rpn_apply_function(enum supported_functions func, double value)
-{
-    /* this may fit into some sort of array with function pointers, but I use this
-     * because I think, I have better control about what's going on here, and also,
-     * as you can see, the argument is not always the same - this may be solved by
-     * writing own "intermediate" function which would call the math.h function */
-
-    switch (func)
-    {
-        case FUNC_ABS:
-            return fabs(value);
-        case FUNC_EXP:
-            return exp(value);
-        case FUNC_SIN:
-            return sin(value);
-        case FUNC_COS:
-            return cos(value);
-        case FUNC_TAN:
-            return tan(value);
-        case FUNC_COTAN:
-            return 1.0/tan(value);
-        case FUNC_ASIN:
-            return asin(value);
-        case FUNC_ACOS:
-            return acos(value);
-        case FUNC_ATAN:
-            return atan(value);
-        case FUNC_ACOTAN:
-            return atan(1.0 / value);
-        case FUNC_LOG10:
-            return log10(value);
-        case FUNC_LN:
-            return log(value);
-        case FUNC_SINH:
-            return sinh(value);
-        case FUNC_COSH:
-            return cosh(value);
-        case FUNC_TANH:
-            return tanh(value);
-        case FUNC_TODEG:
-            return value*180.0 / M_PI;
-        case FUNC_TORAD:
-            return value*M_PI / 180.0;
-
-        default:
-        case FUNC_UNSUPPORTED:
-            return value;
-    }
-}
-
-/**
- * Pops two values from stacks and returns them to memory, where supplied pointers point at
- * - also performs cleanup
- */
-static void rpn_pop_two_values(c_stack *stck, double *one, double *two)
-{
-    rpn_element* el;
-
-    el = stck_pop(stck);
-    *one = el->value.as_double;
-    free(el);
-    el = stck_pop(stck);
-    *two = el->value.as_double;
-    free(el);
-}
-
-/**
- * Helper function for applying operator (supplied as enum type) to N operands on stack
- * the amount of operands is decided in switch body, as well, as their order
- */
-static double rpn_apply_operator(enum operator_type op, c_stack *stck)
-{
-    double one, two;
-
-    switch (op)
-    {
-        case OP_ADD:
-        {
-            rpn_pop_two_values(stck, &one, &two);
-            return one + two;
-        }
-        case OP_SUBTRACT:
-        {
-            rpn_pop_two_values(stck, &one, &two);
-            return two - one;
-        }
-        case OP_MULTIPLY:
-        {
-            rpn_pop_two_values(stck, &one, &two);
-            return one * two;
-        }
-        case OP_DIVIDE:
-        {
-            rpn_pop_two_values(stck, &one, &two);
-            return two / one;
-        }
-        case OP_EXP_RAISE:
-        {
-            rpn_pop_two_values(stck, &one, &two);
-            return pow(two, one);
-        }
-        default:
-        {
-            return 0.0;
-        }
-    }
-}
-
-/**
- * Helper function for cloning element in stack to be able to destroy the copy
- * instead of original element (we need to reuse the original in more evaluations)
- */
-static rpn_element* rpn_clone(rpn_element* source)
-{
-    rpn_element *tmp = (rpn_element*)malloc(sizeof(rpn_element));
-    memcpy(tmp, source, sizeof(rpn_element));
-    return tmp;
-}
-
-/**
- * Evaluates RPN stack supplied in argument, also considers argument value supplied
- * NOTE: for evaluating using more variables, we would need to assign "IDs" to every
- * variable and supply variable value map with value for every variable. But since we
- * deal with only one variable, passing one variable value is enough
- */
-double rpn_evaluate_stack(c_stack* stck, double variable_value)
-{
-    int stck_pos;
-    double tmp_val;
-    rpn_element *rpn_el, *rpn_el_tmp;
-    c_stack* rpn_stack;
-
-    /* create new stack used for evaluating */
-    rpn_stack = stck_create(stck->curr+1);
-    stck_pos = 0;
-
-    if (rpn_stack == NULL)
-    {
-        /* this may bring serious console spam, but it's very unlikely to happen */
-        printf("Error during RPN stack allocation!\n");
-        return 0.0;
-    }
-
-    /* go through every element in supplied stack */
-    while (stck_pos <= stck->curr)
-    {
-        /* here we access elements in supplied stack as if it's only dynamic array
-         * it used to work as stack in preprocessing method (shunting yard algorhitm) */
-        rpn_el = stck_get(stck, stck_pos);
-
-        /* constants are just pushed to working stack */
-        if (rpn_el->type == RPN_TOKEN_CONST)
-        {
-            stck_push(rpn_stack, rpn_clone(rpn_el));
-        }
-        /* variables are evaluated using supplied value and pushed to stack */
-        else if (rpn_el->type == RPN_TOKEN_VARIABLE)
-        {
-            /* assign value instead of ID - this we can afford when dealing with only one variable */
-            rpn_el = rpn_clone(rpn_el);
-
-            rpn_el->type = RPN_TOKEN_CONST;
-            rpn_el->value.as_double = variable_value;
-
-            stck_push(rpn_stack, rpn_el);
-        }
-        /* processing function will pop value(s) from stack, evaluate them and push result back */
-        else if (rpn_el->type == RPN_TOKEN_FUNCTION)
-        {
-            rpn_el_tmp = stck_pop(rpn_stack);
-            tmp_val = rpn_apply_function(rpn_el->value.as_function, rpn_el_tmp->value.as_double);
-            rpn_el_tmp->value.as_double = tmp_val;
-
-            stck_push(rpn_stack, rpn_el_tmp);
-        }
-        /* processing operator will pop value(s) from stack, evaluate the expression and push result back */
-        else if (rpn_el->type == RPN_TOKEN_OPERATOR)
-        {
-            tmp_val = rpn_apply_operator(rpn_el->value.as_operator, rpn_stack);
-
-            rpn_el_tmp = rpn_build_element(RPN_TOKEN_CONST);
-            rpn_el_tmp->value.as_double = tmp_val;
-
-            stck_push(rpn_stack, rpn_el_tmp);
-        }
-
-        /* move to next element */
-        stck_pos++;
-    }
-
-    /* the last element left on stack is our result */
-    rpn_el = stck_pop(rpn_stack);
-
-    /* take the result and free element */
-    tmp_val = (rpn_el != NULL) ? rpn_el->value.as_double : 0.0;
-    free(rpn_el);
-
-    /* and clean up the stack we used */
-    stck_destroy(rpn_stack);
-
-    return tmp_val;
-}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "stack.h"
+#include "rpn.h"
+#include "main.h"
+
+/**
+ * Builds element with specified type
+ * - there's nothing special in this function, just allocate memory, set type and that's it
+ */
+rpn_element* rpn_build_element(enum rpn_token_type type)
+{
+    rpn_element* tmp = (rpn_element*)malloc(sizeof(rpn_element));
+    memset(tmp, 0, sizeof(rpn_element));
+
+    tmp->type = type;
+
+    return tmp;
+}
+
+/**
+ * Applies function (supplied as token identifier) to supplied value and returns it
+ */
+double rpn_apply_function(int func, double value)
+{
+    /* this may fit into some sort of array with function pointers, but I use this
+     * because I think, I have better control about what's going on here, and also,
+     * as you can see, the argument is not always the same - this may be solved by
+     * writing own "intermediate" function which would call the math.h function */
+
+    switch (func)
+    {
+        case FUNC_ABS:
+            return fabs(value);
+        case FUNC_EXP:
+            return exp(value);
+        case FUNC_SIN:
+            return sin(value);
+        case FUNC_COS:
+            return cos(value);
+        case FUNC_TAN:
+            return tan(value);
+        case FUNC_COTAN:
+            return 1.0/tan(value);
+        case FUNC_ASIN:
+            return asin(value);
+        case FUNC_ACOS:
+            return acos(value);
+        case FUNC_ATAN:
+            return atan(value);
+        case FUNC_ACOTAN:
+            return atan(1.0 / value);
+        case FUNC_LOG10:
+            return log10(value);
+        case FUNC_LN:
+            return log(value);
+        case FUNC_SINH:
+            return sinh(value);
+        case FUNC_COSH:
+            return cosh(value);
+        case FUNC_TANH:
+            return tanh(value);
+        case FUNC_TODEG:
+            return value*180.0 / M_PI;
+        case FUNC_TORAD:
+            return value*M_PI / 180.0;
+
+        default:
+        case FUNC_UNSUPPORTED:
+            return value;
+    }
+}
+
+/**
+ * Applies function (supplied as token identifier) to every value of supplied array in place
+ * - the function is decided once for the whole array, not once for every value
+ */
+void rpn_apply_function_block(int func, double* values, int count)
+{
+    int i;
+
+    switch (func)
+    {
+        case FUNC_ABS:
+            for (i = 0; i < count; i++)
+                values[i] = fabs(values[i]);
+            break;
+        case FUNC_SIN:
+            for (i = 0; i < count; i++)
+                values[i] = sin(values[i]);
+            break;
+        case FUNC_COS:
+            for (i = 0; i < count; i++)
+                values[i] = cos(values[i]);
+            break;
+        case FUNC_TODEG:
+            for (i = 0; i < count; i++)
+                values[i] = values[i]*180.0 / M_PI;
+            break;
+        case FUNC_TORAD:
+            for (i = 0; i < count; i++)
+                values[i] = values[i]*M_PI / 180.0;
+            break;
+        default:
+            /* the rest is not that common, so let it go through generic way */
+            for (i = 0; i < count; i++)
+                values[i] = rpn_apply_function(func, values[i]);
+            break;
+    }
+}
+
+/**
+ * Returns number of arguments of built-in function (supplied as token identifier)
+ */
+int rpn_function_arity(int func)
+{
+    switch (func)
+    {
+        case FUNC_MIN:
+        case FUNC_MAX:
+        case FUNC_ATAN2:
+        case FUNC_HYPOT:
+        case FUNC_SUM:
+        case FUNC_PROD:
+        case FUNC_LOOP:
+            return 2;
+        case FUNC_CLAMP:
+        case FUNC_FMA:
+        case FUNC_IF:
+            return 3;
+        default:
+            return 1;
+    }
+}
+
+/**
+ * Computes length of hypotenuse without overflow or underflow of intermediate result
+ * (hypot itself is not part of C89 library)
+ */
+static double rpn_hypot(double x, double y)
+{
+    double ratio;
+
+    x = fabs(x);
+    y = fabs(y);
+
+    /* the bigger one goes to x */
+    if (x < y)
+    {
+        ratio = x;
+        x = y;
+        y = ratio;
+    }
+
+    /* zero and infinity would produce NaN as ratio */
+    if (x == 0.0 || x - x != 0.0)
+        return x;
+
+    ratio = y / x;
+    return x * sqrt(1.0 + ratio * ratio);
+}
+
+/**
+ * Applies function (supplied as token identifier) to supplied arguments and returns result
+ * - number of arguments is given by rpn_function_arity
+ * - min and max return NaN if any argument is NaN (regardless of its position)
+ */
+double rpn_apply_function_args(int func, const double* args)
+{
+    switch (func)
+    {
+        case FUNC_MIN:
+            return (args[0] < args[1] || args[0] != args[0]) ? args[0] : args[1];
+        case FUNC_MAX:
+            return (args[0] > args[1] || args[0] != args[0]) ? args[0] : args[1];
+        case FUNC_ATAN2:
+            return atan2(args[0], args[1]);
+        case FUNC_HYPOT:
+            return rpn_hypot(args[0], args[1]);
+        case FUNC_CLAMP:
+            return (args[0] < args[1]) ? args[1] : ((args[0] > args[2]) ? args[2] : args[0]);
+        case FUNC_FMA:
+            return args[0] * args[1] + args[2];
+        case FUNC_IF:
+            return (args[0] != 0.0) ? args[1] : args[2];
+        default:
+            return rpn_apply_function(func, args[0]);
+    }
+}
+
+/**
+ * Applies function (supplied as token identifier) to arrays of arguments - i-th result is computed
+ * from i-th value of every argument array, and stored in place of the first argument
+ * - every function has its own loop without branches, so it may be vectorized by compiler
+ */
+void rpn_apply_function_block_args(int func, double** args, int count)
+{
+    double *a, *b, *c;
+    int i;
+
+    /* only arguments of the function are supplied */
+    a = args[0];
+    b = (rpn_function_arity(func) > 1) ? args[1] : NULL;
+    c = (rpn_function_arity(func) > 2) ? args[2] : NULL;
+
+    switch (func)
+    {
+        case FUNC_MIN:
+            for (i = 0; i < count; i++)
+                a[i] = (a[i] < b[i] || a[i] != a[i]) ? a[i] : b[i];
+            break;
+        case FUNC_MAX:
+            for (i = 0; i < count; i++)
+                a[i] = (a[i] > b[i] || a[i] != a[i]) ? a[i] : b[i];
+            break;
+        case FUNC_ATAN2:
+            for (i = 0; i < count; i++)
+                a[i] = atan2(a[i], b[i]);
+            break;
+        case FUNC_HYPOT:
+            for (i = 0; i < count; i++)
+                a[i] = rpn_hypot(a[i], b[i]);
+            break;
+        case FUNC_CLAMP:
+            for (i = 0; i < count; i++)
+                a[i] = (a[i] < b[i]) ? b[i] : ((a[i] > c[i]) ? c[i] : a[i]);
+            break;
+        case FUNC_FMA:
+            for (i = 0; i < count; i++)
+                a[i] = a[i] * b[i] + c[i];
+            break;
+        case FUNC_IF:
+            /* masked select, both branches are already evaluated */
+            for (i = 0; i < count; i++)
+                a[i] = (a[i] != 0.0) ? b[i] : c[i];
+            break;
+        default:
+            rpn_apply_function_block(func, a, count);
+            break;
+    }
+}
+
+/**
+ * Returns number of iterations of sum or product with supplied range - the index goes from the
+ * first value by one, while it does not exceed the second value
+ * returns -1 if there are more than RPN_MAX_ITERATIONS iterations (or the range is infinite)
+ */
+long rpn_iteration_count(double from, double to)
+{
+    /* also handles NaN, every comparison with it is false */
+    if (!(to >= from))
+        return 0;
+
+    if (!(to - from < (double)RPN_MAX_ITERATIONS))
+        return -1;
+
+    return (long)floor(to - from) + 1;
+}
+
+/**
+ * Finds the end (sum or product) of loop, which starts on supplied position of RPN stack
+ */
+static int rpn_loop_end(c_stack* stck, int pos)
+{
+    rpn_element* el;
+    int depth = 0;
+
+    for (; pos <= stck->curr; pos++)
+    {
+        el = stck_get(stck, pos);
+        if (el->type != RPN_TOKEN_FUNCTION)
+            continue;
+
+        if (el->value.as_function == FUNC_LOOP)
+            depth++;
+        else if ((el->value.as_function == FUNC_SUM || el->value.as_function == FUNC_PROD) && --depth == 0)
+            break;
+    }
+
+    return pos;
+}
+
+/**
+ * Pops two values from stacks and returns them to memory, where supplied pointers point at
+ * - also performs cleanup
+ */
+static void rpn_pop_two_values(c_stack *stck, double *one, double *two)
+{
+    rpn_element* el;
+
+    el = stck_pop(stck);
+    *one = el->value.as_double;
+    free(el);
+    el = stck_pop(stck);
+    *two = el->value.as_double;
+    free(el);
+}
+
+/**
+ * Applies binary operator (supplied as enum type) to supplied operands and returns result
+ */
+double rpn_apply_binary(int op, double left, double right)
+{
+    switch (op)
+    {
+        case OP_ADD:
+            return left + right;
+        case OP_SUBTRACT:
+            return left - right;
+        case OP_MULTIPLY:
+            return left * right;
+        case OP_DIVIDE:
+            return left / right;
+        case OP_EXP_RAISE:
+            return pow(left, right);
+        /* comparisons result in 1 (true) or 0 (false) */
+        case OP_LESS:
+            return (left < right) ? 1.0 : 0.0;
+        case OP_LESS_EQUAL:
+            return (left <= right) ? 1.0 : 0.0;
+        case OP_GREATER:
+            return (left > right) ? 1.0 : 0.0;
+        case OP_GREATER_EQUAL:
+            return (left >= right) ? 1.0 : 0.0;
+        case OP_EQUAL:
+            return (left == right) ? 1.0 : 0.0;
+        case OP_NOT_EQUAL:
+            return (left != right) ? 1.0 : 0.0;
+        default:
+            return 0.0;
+    }
+}
+
+/**
+ * Helper function for applying operator (supplied as enum type) to N operands on stack
+ * the amount of operands is decided in switch body, as well, as their order
+ */
+static double rpn_apply_operator(enum operator_type op, c_stack *stck)
+{
+    double one, two;
+
+    switch (op)
+    {
+        case OP_ADD:
+        case OP_SUBTRACT:
+        case OP_MULTIPLY:
+        case OP_DIVIDE:
+        case OP_EXP_RAISE:
+        case OP_LESS:
+        case OP_LESS_EQUAL:
+        case OP_GREATER:
+        case OP_GREATER_EQUAL:
+        case OP_EQUAL:
+        case OP_NOT_EQUAL:
+        {
+            rpn_pop_two_values(stck, &one, &two);
+            return rpn_apply_binary(op, two, one);
+        }
+        default:
+        {
+            return 0.0;
+        }
+    }
+}
+
+/**
+ * Helper function for cloning element in stack to be able to destroy the copy
+ * instead of original element (we need to reuse the original in more evaluations)
+ */
+static rpn_element* rpn_clone(rpn_element* source)
+{
+    rpn_element *tmp = (rpn_element*)malloc(sizeof(rpn_element));
+    memcpy(tmp, source, sizeof(rpn_element));
+    return tmp;
+}
+
+/**
+ * Evaluates RPN stack supplied in argument, also considers argument value supplied
+ * - the expression may use only one variable (the first one)
+ */
+double rpn_evaluate_stack(c_stack* stck, double variable_value)
+{
+    return rpn_evaluate_stack_vars(stck, &variable_value);
+}
+
+/**
+ * Evaluates RPN stack supplied in argument using variable value map - the variable identifier
+ * is index to supplied array of values
+ * - body of sum or product is evaluated repeatedly by returning to its start; terms are summed
+ *   using Kahan (compensated) summation
+ */
+double rpn_evaluate_stack_vars(c_stack* stck, const double* variable_values)
+{
+    int stck_pos, i, loops, end;
+    double tmp_val, args[RPN_MAX_ARITY];
+    rpn_element *rpn_el, *rpn_el_tmp;
+    c_stack* rpn_stack;
+
+    /* running loops - index value, range, accumulated value and its compensation */
+    int loop_start[RPN_MAX_LOOP_DEPTH];
+    long loop_count[RPN_MAX_LOOP_DEPTH], loop_done[RPN_MAX_LOOP_DEPTH];
+    double loop_from[RPN_MAX_LOOP_DEPTH], loop_index[RPN_MAX_LOOP_DEPTH];
+    double loop_value[RPN_MAX_LOOP_DEPTH], loop_compensation[RPN_MAX_LOOP_DEPTH];
+
+    /* create new stack used for evaluating */
+    rpn_stack = stck_create(stck->curr+1);
+    stck_pos = 0;
+    loops = 0;
+
+    if (rpn_stack == NULL)
+    {
+        /* this may bring serious console spam, but it's very unlikely to happen */
+        printf("Error during RPN stack allocation!\n");
+        return 0.0;
+    }
+
+    /* go through every element in supplied stack */
+    while (stck_pos <= stck->curr)
+    {
+        /* here we access elements in supplied stack as if it's only dynamic array
+         * it used to work as stack in preprocessing method (shunting yard algorhitm) */
+        rpn_el = stck_get(stck, stck_pos);
+
+        /* constants are just pushed to working stack */
+        if (rpn_el->type == RPN_TOKEN_CONST)
+        {
+            stck_push(rpn_stack, rpn_clone(rpn_el));
+        }
+        /* variables are evaluated using supplied value and pushed to stack */
+        else if (rpn_el->type == RPN_TOKEN_VARIABLE)
+        {
+            /* assign value instead of ID */
+            rpn_el = rpn_clone(rpn_el);
+
+            rpn_el->type = RPN_TOKEN_CONST;
+            if (RPN_IS_INDEX_VARIABLE(rpn_el->value.as_variable))
+                rpn_el->value.as_double = loop_index[RPN_INDEX_LEVEL(rpn_el->value.as_variable)];
+            else
+                rpn_el->value.as_double = variable_values[rpn_el->value.as_variable];
+
+            stck_push(rpn_stack, rpn_el);
+        }
+        /* loop start pops its range and starts evaluating body */
+        else if (rpn_el->type == RPN_TOKEN_FUNCTION && rpn_el->value.as_function == FUNC_LOOP)
+        {
+            rpn_pop_two_values(rpn_stack, &args[1], &args[0]);
+
+            end = rpn_loop_end(stck, stck_pos);
+            if (end > stck->curr || loops == RPN_MAX_LOOP_DEPTH)
+                break;
+
+            loop_start[loops] = stck_pos;
+            loop_count[loops] = rpn_iteration_count(args[0], args[1]);
+            loop_done[loops] = 0;
+            loop_from[loops] = args[0];
+            loop_index[loops] = args[0];
+            loop_value[loops] = (((rpn_element*)stck_get(stck, end))->value.as_function == FUNC_PROD) ? 1.0 : 0.0;
+            loop_compensation[loops] = 0.0;
+
+            /* empty range, or too many iterations - skip the body */
+            if (loop_count[loops] <= 0)
+            {
+                rpn_el_tmp = rpn_build_element(RPN_TOKEN_CONST);
+                rpn_el_tmp->value.as_double = (loop_count[loops] == 0) ? loop_value[loops] : NAN;
+                stck_push(rpn_stack, rpn_el_tmp);
+                stck_pos = end;
+            }
+            else
+                loops++;
+        }
+        /* loop end takes value of body, and either returns to the start of body, or pushes result */
+        else if (rpn_el->type == RPN_TOKEN_FUNCTION && (rpn_el->value.as_function == FUNC_SUM || rpn_el->value.as_function == FUNC_PROD))
+        {
+            if (loops == 0)
+                break;
+
+            rpn_el_tmp = stck_pop(rpn_stack);
+            i = loops - 1;
+
+            if (rpn_el->value.as_function == FUNC_PROD)
+                loop_value[i] *= rpn_el_tmp->value.as_double;
+            else
+            {
+                tmp_val = rpn_el_tmp->value.as_double - loop_compensation[i];
+                args[0] = loop_value[i] + tmp_val;
+                loop_compensation[i] = (args[0] - loop_value[i]) - tmp_val;
+                loop_value[i] = args[0];
+            }
+
+            if (++loop_done[i] < loop_count[i])
+            {
+                free(rpn_el_tmp);
+                loop_index[i] = loop_from[i] + (double)loop_done[i];
+                stck_pos = loop_start[i];
+            }
+            else
+            {
+                rpn_el_tmp->value.as_double = loop_value[i];
+                stck_push(rpn_stack, rpn_el_tmp);
+                loops--;
+            }
+        }
+        /* processing function will pop value(s) from stack, evaluate them and push result back */
+        else if (rpn_el->type == RPN_TOKEN_FUNCTION)
+        {
+            /* arguments are popped in reverse order, the first one is reused for result */
+            for (i = rpn_function_arity(rpn_el->value.as_function) - 1; i > 0; i--)
+            {
+                rpn_el_tmp = stck_pop(rpn_stack);
+                args[i] = rpn_el_tmp->value.as_double;
+                free(rpn_el_tmp);
+            }
+            rpn_el_tmp = stck_pop(rpn_stack);
+            args[0] = rpn_el_tmp->value.as_double;
+
+            rpn_el_tmp->value.as_double = rpn_apply_function_args(rpn_el->value.as_function, args);
+
+            stck_push(rpn_stack, rpn_el_tmp);
+        }
+        /* processing operator will pop value(s) from stack, evaluate the expression and push result back */
+        else if (rpn_el->type == RPN_TOKEN_OPERATOR)
+        {
+            tmp_val = rpn_apply_operator(rpn_el->value.as_operator, rpn_stack);
+
+            rpn_el_tmp = rpn_build_element(RPN_TOKEN_CONST);
+            rpn_el_tmp->value.as_double = tmp_val;
+
+            stck_push(rpn_stack, rpn_el_tmp);
+        }
+
+        /* move to next element */
+        stck_pos++;
+    }
+
+    /* the last element left on stack is our result */
+    rpn_el = stck_pop(rpn_stack);
+
+    /* take the result and free element */
+    tmp_val = (rpn_el != NULL) ? rpn_el->value.as_double : 0.0;
+    free(rpn_el);
+
+    /* and clean up the stack we used */
+    stck_destroy(rpn_stack);
+
+    return tmp_val;
+}
@@ -1,27 +1,44 @@
-#ifndef MATHPARSER_RPN_H
-#define MATHPARSER_RPN_H
-
-enum rpn_token_type
-{
-    RPN_TOKEN_CONST,                /* all numeric constants */
-    RPN_TOKEN_VARIABLE,             /* variable(s) */
-    RPN_TOKEN_OPERATOR,             /* binary operators */
-    RPN_TOKEN_FUNCTION              /* math functions */
-};
-
-typedef struct
-{
-    enum rpn_token_type type;
-    union
-    {
-        int as_variable;            /* for variables */
-        double as_double;           /* for constants */
-        int as_operator;            /* for operators */
-        int as_function;            /* for recognized math functions */
-    } value;
-} rpn_element;
-
-rpn_element* rpn_build_element(enum rpn_token_type type);
-double rpn_evaluate_stack(c_stack* stck, double variable_value);
-
-#endif
+#ifndef MATHPARSER_RPN_H
+#define MATHPARSER_RPN_H
+
+#define RPN_MAX_ARITY 3                 /* maximum number of built-in function arguments */
+#define RPN_MAX_LOOP_DEPTH 8            /* maximum nesting of sums and products */
+#define RPN_MAX_ITERATIONS 100000000L   /* maximum number of iterations of one sum or product, more gives NaN */
+
+#define RPN_INDEX_VARIABLE(level) (-1 - (level))    /* variable identifier of index of sum or product nested on supplied level */
+#define RPN_IS_INDEX_VARIABLE(var) ((var) < 0)
+#define RPN_INDEX_LEVEL(var) (-1 - (var))           /* nesting level (0 = outermost) of index variable */
+
+enum rpn_token_type
+{
+    RPN_TOKEN_CONST,                /* all numeric constants */
+    RPN_TOKEN_VARIABLE,             /* variable(s) */
+    RPN_TOKEN_OPERATOR,             /* binary operators */
+    RPN_TOKEN_FUNCTION              /* math functions */
+};
+
+typedef struct
+{
+    enum rpn_token_type type;
+    union
+    {
+        int as_variable;            /* for variables */
+        double as_double;           /* for constants */
+        int as_operator;            /* for operators */
+        int as_function;            /* for recognized math functions */
+    } value;
+    int arity;                      /* number of arguments (functions only) */
+} rpn_element;
+
+rpn_element* rpn_build_element(enum rpn_token_type type);
+double rpn_evaluate_stack(c_stack* stck, double variable_value);
+double rpn_evaluate_stack_vars(c_stack* stck, const double* variable_values);
+double rpn_apply_function(int func, double value);
+double rpn_apply_binary(int op, double left, double right);
+void rpn_apply_function_block(int func, double* values, int count);
+int rpn_function_arity(int func);
+double rpn_apply_function_args(int func, const double* args);
+void rpn_apply_function_block_args(int func, double** args, int count);
+long rpn_iteration_count(double from, double to);
+
+#endif
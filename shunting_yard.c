@@ -1,559 +1,1027 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <math.h>
-#include "stack.h"
-#include "rpn.h"
-#include "main.h"
-#include "shunting_yard.h"
-
-/* helpful macro for routine used when hit some syntax error */
-#define ERROR_ROUTINE(a,b) *error=a; *error_ptr=b; stck_destroy(op_stack); stck_destroy(rpn_stack);
-
-/**
- * Static array of function matching records to allow us matching them by generic way
- */
-static func_match_template func_match[] = {
-        { FUNC_ABS, "abs" },
-        { FUNC_EXP, "exp" },
-
-        { FUNC_SIN, "sin" },
-        { FUNC_COS, "cos" },
-        { FUNC_TAN, "tan" },
-        { FUNC_COTAN, "cotan" },
-
-        { FUNC_ASIN, "asin" },
-        { FUNC_ACOS, "acos" },
-        { FUNC_ATAN, "atan" },
-        { FUNC_ACOTAN, "acotan" },
-
-        { FUNC_LOG10, "log" },
-        { FUNC_LN, "ln" },
-
-        { FUNC_SINH, "sinh" },
-        { FUNC_COSH, "cosh" },
-        { FUNC_TANH, "tanh" },
-
-        { FUNC_TODEG, "todeg" },
-        { FUNC_TORAD, "torad" }
-};
-
-/**
- * Helper function to retrieve numeric representation of character digit
- * if not a number, return -1
- */
-static int sy_get_number(char chr)
-{
-    if (chr >= '0' && chr <= '9')
-        return chr - '0';
-
-    return -1;
-}
-
-/**
- * Helper function to retrieve operator token identifier
- * if not an operator, return -1 (OP_NONE constant)
- */
-static int sy_get_operator(char chr)
-{
-    switch (chr)
-    {
-        case '+':
-            return OP_ADD;
-        case '-':
-            return OP_SUBTRACT;
-        case '*':
-            return OP_MULTIPLY;
-        case '/':
-            return OP_DIVIDE;
-        case '^':
-            return OP_EXP_RAISE;
-    }
-
-    return OP_NONE;
-}
-
-/**
- * Helper function to retrieve parenthesis token identifier
- * if not a parenthesis, return -1 (PARENTHESIS_NONE constant)
- */
-static int sy_get_parenthesis(char chr)
-{
-    if (chr == '(')
-        return PARENTHESIS_LEFT;
-    if (chr == ')')
-        return PARENTHESIS_RIGHT;
-    return PARENTHESIS_NONE;
-}
-
-/**
- * Helper function to retrieve function token identifier
- * if not a function, return -1 (FUNC_UNSUPPORTED constant)
- */
-static int sy_get_function(char** chr)
-{
-    int i;
-    int size = (int) (sizeof(func_match) / sizeof(func_match_template));
-
-    /* iterate through supported function map and try to match at least one of them */
-    for (i = 0; i < size; i++)
-    {
-        /* compares function name with string on input */
-        if (strncmp(*chr, func_match[i].func_name, strlen(func_match[i].func_name)) == 0)
-        {
-            /* if matched, move the input pointer by function identifier length */
-            *chr += strlen(func_match[i].func_name);
-            return func_match[i].func_id;
-        }
-    }
-
-    return FUNC_UNSUPPORTED;
-}
-
-/**
- * Helper function to retrieve variable identifier
- * this method is highly customized to specification of semestral work
- * - parses only one character string and returns 1 as "found" if the char
- *   is alphanumeric
- */
-static int sy_get_variable(char** chr)
-{
-    char var = **chr;
-
-    /* parse only one-character (one letter) variables */
-    /*if ((var > 'a' && var < 'z') || (var > 'A' && var < 'Z'))*/
-
-    /* for now, parse just 'x' variable, nothing more is needed */
-    if (var == 'x')
-    {
-        *chr += 1;
-        return 1;
-    }
-
-    return -1;
-}
-
-/*
- * Compares two operators and decides the priority (has greater, equal or lower)
- * returns 1 if first has greater priority than second (i.e. * over +)
- * returns 0 if both operators are equal
- * returns -1 if first has lower priority than second (i.e. + and *)
- */
-static int sy_operator_priority(int first, int second)
-{
-    /* exponential operator ^ has always greater priority than other operators */
-
-    if (first == OP_EXP_RAISE && second == OP_EXP_RAISE)
-        return 0;
-
-    if (first == OP_EXP_RAISE)
-        return 1;
-
-    if (second == OP_EXP_RAISE)
-        return -1;
-
-    /* test different "priority classes" */
-
-    if ((first == OP_ADD || first == OP_SUBTRACT) && (second == OP_MULTIPLY || second == OP_DIVIDE))
-        return -1;
-
-    if ((first == OP_MULTIPLY || first == OP_DIVIDE) && (second == OP_ADD || second == OP_SUBTRACT))
-        return 1;
-
-    /* test same "priority classes" */
-
-    if ((first == OP_ADD || first == OP_SUBTRACT) && (second == OP_ADD || second == OP_SUBTRACT))
-        return 0;
-
-    if ((first == OP_MULTIPLY || first == OP_DIVIDE) && (second == OP_MULTIPLY || second == OP_DIVIDE))
-        return 0;
-
-    /* now everything should be tested, so anything else is considered error */
-
-    return 2;
-}
-
-/**
- * Generates RPN represented expression from input string
- * if something fails, sets flag and returns position of character, where everything failed
- */
-c_stack* sy_generate_rpn_stack(char *input, int *error, char** error_ptr)
-{
-    /* output stack of rpn_elements */
-    c_stack *rpn_stack;
-    /* temporary stack of operators */
-    c_stack *op_stack;
-
-    rpn_element *rpn_el_tmp;
-
-    char chr;
-    int tmp, sign, stored_sign, flag, digit;
-    double dtmp, weight;
-    rpn_element *last_el;
-
-    if (strlen(input) == 0)
-    {
-        *error = SYNTAX_ERROR_NOTHING_TO_PARSE;
-        return NULL;
-    }
-
-    /* create stacks used in Shunting yard algorhitm */
-    rpn_stack = stck_create(RPN_STACK_SIZE);
-    op_stack = stck_create(SY_OP_STACK_SIZE);
-
-    /* memory allocation went wrong */
-    if (rpn_stack == NULL || op_stack == NULL)
-    {
-        *error = GENERAL_MEMORY_ERROR;
-        *error_ptr = NULL;
-        /* since this error should be incremental, we verify only first stack */
-        if (rpn_stack != NULL)
-            stck_destroy(rpn_stack);
-        return NULL;
-    }
-
-    *error = SYNTAX_ERROR_NONE;
-    *error_ptr = NULL;
-    stored_sign = 1;
-    last_el = NULL;
-
-    /* go through string character by character */
-    while (*input != (char)0)
-    {
-        chr = *input;
-
-        /* first, try to parse numeric constant (integer / real) */
-        tmp = sy_get_number(chr);
-        /* note that "dot" character is also considered as beginning of numeric constant */
-        if (tmp != -1 || chr == '.')
-        {
-            /* if the function is followed by constant, not parenthesis, it's error */
-            if (last_el != NULL && last_el->type == RPN_TOKEN_FUNCTION)
-            {
-                ERROR_ROUTINE(SYNTAX_ERROR_FUNCTION_PARENTHESIS, input);
-                return NULL;
-            }
-
-            /* this allows parsing of real numbers in i.e. ".5E2" format */
-            /* if the dot is not the first character... */
-            if (chr != '.')
-            {
-                /* parse the integer part as it should be */
-                while ((digit = sy_get_number(*(++input))) != (int)-1)
-                {
-                    tmp = tmp * 10 + digit;
-                }
-            }
-            /* if it begins with dot, the integer part is equal 0 */
-            else
-            {
-                tmp = 0;
-            }
-
-            dtmp = (double)(tmp);
-
-            /*
-             * I am fully informed about strtod existance, but I just wanted
-             * to try writing float number parsing routine by myself
-             *
-             * This, in addition, detects errors more preciselly
-             */
-
-            /* if non-integer part is present */
-            if (*input == '.')
-            {
-                /* parse it and add to working value */
-                weight = 0.1;
-                while ((digit = sy_get_number(*(++input))) != (int)-1)
-                {
-                    dtmp += (double)(digit)*weight;
-                    weight /= 10.0;
-                }
-
-                /* if decadic exponent is present */
-                if (*input == 'E' || *input == 'e')
-                {
-                    sign = 1;
-                    tmp = 0;
-
-                    /* move pointer (so we won't parse 'e' again) */
-                    chr = *(++input);
-
-                    /* the exponent may have sign */
-                    if (chr == '-')
-                    {
-                        sign = -1;
-                    }
-                    else if (chr == '+')
-                    {
-                        /* sign already set to 1 */
-                    }
-                    else
-                    {
-                        /* the exponent mark ('e' or 'E') has to be followed by number */
-                        if ((digit = sy_get_number(chr)) != (int)-1)
-                            tmp = digit;
-                        else
-                        {
-                            ERROR_ROUTINE(SYNTAX_ERROR_REAL_NOTATION, input);
-                            return NULL;
-                        }
-                    }
-
-                    /* parse the value of exponent */
-                    while ((digit = sy_get_number(*(++input))) != (int)-1)
-                    {
-                        tmp  = tmp*10 + digit;
-                    }
-
-                    /* and proceed it to working value */
-                    dtmp = dtmp * pow(10.0, (double)(sign*tmp));
-                }
-            }
-
-            /* apply stored sign (may be stored i.e. from parsing exponent operator */
-            dtmp = dtmp*stored_sign;
-            stored_sign = 1;
-
-            /* build element and push it to stack */
-            rpn_el_tmp = rpn_build_element(RPN_TOKEN_CONST);
-            last_el = rpn_el_tmp;
-            rpn_el_tmp->value.as_double = dtmp;
-            stck_push(rpn_stack, rpn_el_tmp);
-
-            continue;
-        }
-
-        /* try to parse operator */
-        tmp = sy_get_operator(chr);
-        if (tmp != OP_NONE)
-        {
-            /* if the function is followed by operator, not parenthesis, it's error */
-            if (last_el != NULL && last_el->type == RPN_TOKEN_FUNCTION)
-            {
-                ERROR_ROUTINE(SYNTAX_ERROR_FUNCTION_PARENTHESIS, input);
-                return NULL;
-            }
-
-            /* let's validate unary operators and operands of binary operators */
-            if ((last_el == NULL && rpn_stack->curr == STCK_INVALID) || (last_el != NULL && last_el->type == RPN_TOKEN_OPERATOR && last_el->value.as_operator != PARENTHESIS_RIGHT))
-            {
-                /* unary operators + and - */
-                if ((tmp == OP_ADD || tmp == OP_SUBTRACT))
-                {
-                    /* if two same-priority operators came, that's pretty suspicious */
-                    if (last_el != NULL && (last_el->value.as_operator == OP_ADD || last_el->value.as_operator == OP_SUBTRACT))
-                    {
-                        /* unary minus can appear directly after binary plus - anything else in this block is considered error */
-                        if (tmp != OP_SUBTRACT || last_el->value.as_operator != OP_ADD)
-                        {
-                            ERROR_ROUTINE(SYNTAX_ERROR_OPERATOR_FREQUENCY, input);
-                            return NULL;
-                        }
-                    }
-
-                    /* unary operator after exponent mark */
-                    if (last_el != NULL && last_el->value.as_operator == OP_EXP_RAISE)
-                    {
-                        if (tmp == OP_SUBTRACT)
-                        {
-                            stored_sign = -1;
-                        }
-
-                        input++;
-                        continue;
-                    }
-
-                    /* insert "hidden zero" element, because -5 (unary minus) has the same value as 0-5, as well, as +5 and 0+5 */
-                    rpn_el_tmp = rpn_build_element(RPN_TOKEN_CONST);
-                    last_el = rpn_el_tmp;
-                    rpn_el_tmp->value.as_double = 0;
-                    stck_push(rpn_stack, rpn_el_tmp);
-                }
-                else
-                {
-                    ERROR_ROUTINE(SYNTAX_ERROR_BINARY_OPERATOR_OPERANDS, input);
-                    return NULL;
-                }
-            }
-
-            /* "look" at last element in operator stack */
-            rpn_el_tmp = stck_peek(op_stack);
-
-            if (rpn_el_tmp != NULL)
-            {
-                sign = sy_operator_priority(tmp, rpn_el_tmp->value.as_operator);
-                /* lower priority operator came */
-                if (sign == -1 || (sign == 0 && tmp != OP_EXP_RAISE))
-                {
-                    /* "eat" all greater or equal priority operators and push them onto RPN stack */
-                    while ((rpn_el_tmp = stck_peek(op_stack)) != NULL)
-                    {
-                        if (sy_operator_priority(tmp, rpn_el_tmp->value.as_operator) <= 0)
-                        {
-                            stck_push(rpn_stack, stck_pop(op_stack));
-                        }
-                        else
-                        {
-                            break;
-                        }
-                    }
-                }
-                /* greater priority operator came */
-                else if (sign == 1)
-                {
-                    /* just push operator element on stack - handled below */
-                }
-                /* exponential operator came, and previous also was exponential (special case, only one right-associative operator) */
-                else if (sign == 0 && tmp == OP_EXP_RAISE)
-                {
-                    /* just push operator element on stack - handled below */
-                }
-            }
-
-            rpn_el_tmp = rpn_build_element(RPN_TOKEN_OPERATOR);
-            last_el = rpn_el_tmp;
-            rpn_el_tmp->value.as_operator = tmp;
-            stck_push(op_stack, rpn_el_tmp);
-            ++input;
-            continue;
-        }
-
-        /* now try to parse parenthesis */
-        tmp = sy_get_parenthesis(chr);
-        if (tmp != PARENTHESIS_NONE)
-        {
-            /* left parenthesis is simply pushed to operator stack */
-            if (tmp == PARENTHESIS_LEFT)
-            {
-                /* opening bracket with preceding constant or variable is wrong */
-                if (last_el != NULL && (last_el->type == RPN_TOKEN_VARIABLE || last_el->type == RPN_TOKEN_CONST))
-                {
-                    ERROR_ROUTINE(SYNTAX_ERROR_UNEXPECTED_SYMBOL, input);
-                    return NULL;
-                }
-
-                rpn_el_tmp = rpn_build_element(RPN_TOKEN_OPERATOR);
-                last_el = rpn_el_tmp;
-                rpn_el_tmp->value.as_operator = tmp;
-                stck_push(op_stack, rpn_el_tmp);
-            }
-            else
-            {
-                /* closing bracket immediatelly after function token is also wrong */
-                if (last_el != NULL && last_el->type == RPN_TOKEN_FUNCTION)
-                {
-                    ERROR_ROUTINE(SYNTAX_ERROR_FUNCTION_PARENTHESIS, input);
-                    return NULL;
-                }
-
-                flag = -1;
-
-                /* go through operators in operator stack and push operators, that aren't parenthesis
-                   on rpn stack, until we hit left parenthesis */
-                while ((rpn_el_tmp = stck_pop(op_stack)) != NULL)
-                {
-                    if (rpn_el_tmp->value.as_operator == PARENTHESIS_LEFT)
-                    {
-                        /* parenthesis found flag */
-                        flag = 1;
-
-                        if (last_el == rpn_el_tmp)
-                            last_el = NULL;
-
-                        /* we won't reuse this, let's free it */
-                        free(rpn_el_tmp);
-
-                        /* also look, if parentheses was used to match math function argument */
-                        rpn_el_tmp = stck_peek(op_stack);
-                        if (rpn_el_tmp != NULL && rpn_el_tmp->type == RPN_TOKEN_FUNCTION)
-                            stck_push(rpn_stack, stck_pop(op_stack));
-
-                        break;
-                    }
-
-                    last_el = NULL;
-                    stck_push(rpn_stack, rpn_el_tmp);
-                }
-
-                /* if we hit the bottom without parenthesis being found, it means that opening parenthesis is missing */
-                if (flag == -1)
-                {
-                    ERROR_ROUTINE(SYNTAX_ERROR_MISSING_PARENTHESIS, input);
-                    return NULL;
-                }
-            }
-
-            ++input;
-            continue;
-        }
-
-        /* now try to parse function */
-        tmp = sy_get_function(&input);
-        if (tmp != FUNC_UNSUPPORTED)
-        {
-            /* functions are just thrown onto stack */
-            rpn_el_tmp = rpn_build_element(RPN_TOKEN_FUNCTION);
-            last_el = rpn_el_tmp;
-            rpn_el_tmp->value.as_function = tmp;
-            stck_push(op_stack, rpn_el_tmp);
-            continue;
-        }
-
-        /* as last thing, try to parse variable (one letter token) */
-        tmp = sy_get_variable(&input);
-        if (tmp != -1)
-        {
-            /* as well, as constant, the variable should not appear as next element after function
-             * token without parenthesis being immediatelly open */
-            if (last_el != NULL && last_el->type == RPN_TOKEN_FUNCTION)
-            {
-                ERROR_ROUTINE(SYNTAX_ERROR_FUNCTION_PARENTHESIS, input);
-                return NULL;
-            }
-
-            rpn_el_tmp = rpn_build_element(RPN_TOKEN_VARIABLE);
-            last_el = rpn_el_tmp;
-            rpn_el_tmp->value.as_variable = tmp;
-            stck_push(rpn_stack, rpn_el_tmp);
-            continue;
-        }
-
-        /* ignore whitespaces */
-        if (chr == ' ')
-        {
-            ++input;
-            continue;
-        }
-
-        /* this means we have some unexpected character / token on input */
-        ERROR_ROUTINE(SYNTAX_ERROR_INVALID_CHARACTER, input);
-        return NULL;
-    }
-
-    /* if last element of expression was an operator (binary), it's an error */
-    if (last_el != NULL && last_el->type == RPN_TOKEN_OPERATOR)
-    {
-        ERROR_ROUTINE(SYNTAX_ERROR_BINARY_OPERATOR_OPERANDS, input);
-        return NULL;
-    }
-
-    /* every operator left in operator stack should be pushed to output stack */
-    while ((rpn_el_tmp = stck_pop(op_stack)) != NULL)
-    {
-        /* ..except parenthesis
-         * this also validates proper closing of parenthesis */
-        if (rpn_el_tmp->type == RPN_TOKEN_OPERATOR && rpn_el_tmp->value.as_operator == PARENTHESIS_LEFT)
-        {
-            free(rpn_el_tmp);
-            ERROR_ROUTINE(SYNTAX_ERROR_MISSING_PARENTHESIS, input);
-            return NULL;
-        }
-        stck_push(rpn_stack, rpn_el_tmp);
-    }
-
-    /* clean up temporary operator stack */
-    stck_destroy(op_stack);
-
-    return rpn_stack;
-}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "stack.h"
+#include "rpn.h"
+#include "main.h"
+#include "shunting_yard.h"
+#include "userfunc.h"
+
+/* helpful macro for routine used when hit some syntax error */
+#define ERROR_ROUTINE(a,b) *error=a; *error_ptr=b; stck_destroy(op_stack); stck_destroy(rpn_stack);
+
+/**
+ * Static array of function matching records to allow us matching them by generic way
+ */
+static func_match_template func_match[] = {
+        { FUNC_ABS, "abs" },
+        { FUNC_EXP, "exp" },
+
+        { FUNC_SIN, "sin" },
+        { FUNC_COS, "cos" },
+        { FUNC_TAN, "tan" },
+        { FUNC_COTAN, "cotan" },
+
+        { FUNC_ASIN, "asin" },
+        { FUNC_ACOS, "acos" },
+        { FUNC_ATAN, "atan" },
+        { FUNC_ACOTAN, "acotan" },
+
+        { FUNC_LOG10, "log" },
+        { FUNC_LN, "ln" },
+
+        { FUNC_SINH, "sinh" },
+        { FUNC_COSH, "cosh" },
+        { FUNC_TANH, "tanh" },
+
+        { FUNC_TODEG, "todeg" },
+        { FUNC_TORAD, "torad" },
+
+        { FUNC_MIN, "min" },
+        { FUNC_MAX, "max" },
+        { FUNC_ATAN2, "atan2" },
+        { FUNC_HYPOT, "hypot" },
+        { FUNC_CLAMP, "clamp" },
+        { FUNC_FMA, "fma" },
+        { FUNC_IF, "if" },
+        { FUNC_SUM, "sum" },
+        { FUNC_PROD, "prod" }
+};
+
+/**
+ * Static array of operator names, indexed by operator identifier
+ */
+static const char* operator_names[] = {
+        "+", "-", "*", "/", "^",
+        "<", "<=", ">", ">=", "==", "!=",
+        "?", ":", "(", ")"
+};
+
+/**
+ * Helper function to read character on supplied position, or zero character, when
+ * the position is past the end of parsed input (input does not need to be terminated)
+ */
+static char sy_char_at(char* chr, char* end)
+{
+    return (chr < end) ? *chr : (char)0;
+}
+
+/**
+ * Helper function to retrieve numeric representation of character digit
+ * if not a number, return -1
+ */
+static int sy_get_number(char chr)
+{
+    if (chr >= '0' && chr <= '9')
+        return chr - '0';
+
+    return -1;
+}
+
+/**
+ * Helper function to retrieve operator token identifier, and length of its textual form
+ * (comparison operators may have two characters)
+ * if not an operator, return -1 (OP_NONE constant)
+ */
+static int sy_get_operator(char* chr, char* end, int* length)
+{
+    char next = sy_char_at(chr + 1, end);
+
+    *length = 1;
+
+    switch (*chr)
+    {
+        case '+':
+            return OP_ADD;
+        case '-':
+            return OP_SUBTRACT;
+        case '*':
+            return OP_MULTIPLY;
+        case '/':
+            return OP_DIVIDE;
+        case '^':
+            return OP_EXP_RAISE;
+        case '?':
+            return OP_CONDITION;
+        case '<':
+            if (next != '=')
+                return OP_LESS;
+            *length = 2;
+            return OP_LESS_EQUAL;
+        case '>':
+            if (next != '=')
+                return OP_GREATER;
+            *length = 2;
+            return OP_GREATER_EQUAL;
+        case '=':
+        case '!':
+            /* single '=' or '!' is not an operator */
+            if (next != '=')
+                return OP_NONE;
+            *length = 2;
+            return (*chr == '=') ? OP_EQUAL : OP_NOT_EQUAL;
+    }
+
+    return OP_NONE;
+}
+
+/**
+ * Retrieves textual form of operator with supplied identifier, or NULL if not found
+ */
+const char* sy_get_operator_name(int op)
+{
+    if (op < 0 || op >= (int) (sizeof(operator_names) / sizeof(operator_names[0])))
+        return NULL;
+
+    return operator_names[op];
+}
+
+/**
+ * Helper function to retrieve parenthesis token identifier
+ * if not a parenthesis, return -1 (PARENTHESIS_NONE constant)
+ */
+static int sy_get_parenthesis(char chr)
+{
+    if (chr == '(')
+        return PARENTHESIS_LEFT;
+    if (chr == ')')
+        return PARENTHESIS_RIGHT;
+    return PARENTHESIS_NONE;
+}
+
+/**
+ * Helper function to retrieve function token identifier
+ * if not a function, return -1 (FUNC_UNSUPPORTED constant)
+ * - the longest matching name wins (i.e. "sinh" is not "sin" followed by "h"), built-in
+ *   and user defined functions are matched together
+ */
+static int sy_get_function(char** chr, char* end)
+{
+    int i, len, best, best_len;
+    int size = (int) (sizeof(func_match) / sizeof(func_match_template));
+
+    best = FUNC_UNSUPPORTED;
+    best_len = 0;
+
+    /* iterate through supported function map and try to match at least one of them */
+    for (i = 0; i < size; i++)
+    {
+        len = (int)strlen(func_match[i].func_name);
+
+        /* compares function name with string on input (only if the rest of input is long enough) */
+        if (len > best_len && end - *chr >= len && strncmp(*chr, func_match[i].func_name, len) == 0)
+        {
+            best = func_match[i].func_id;
+            best_len = len;
+        }
+    }
+
+    i = uf_match(*chr, end, &len);
+    if (i != FUNC_UNSUPPORTED && len > best_len)
+    {
+        best = i;
+        best_len = len;
+    }
+
+    /* if matched, move the input pointer by function identifier length */
+    *chr += best_len;
+    return best;
+}
+
+/**
+ * Helper function to verify number of arguments of function with supplied identifier
+ * returns 1 if the number is acceptable
+ */
+static int sy_check_function_arity(int func_id, int arity)
+{
+    if (UF_IS_FUNCTION(func_id))
+        return arity == uf_arity(func_id);
+
+    /* sum and product have index variable name and three expressions */
+    if (func_id == FUNC_SUM || func_id == FUNC_PROD)
+        return arity == 3;
+
+    /* minimum and maximum accept any number of values, they are chained */
+    if (func_id == FUNC_MIN || func_id == FUNC_MAX)
+        return arity >= 2;
+
+    return arity == rpn_function_arity(func_id);
+}
+
+/**
+ * Retrieves textual name of function with supplied identifier, or NULL if not found
+ */
+const char* sy_get_function_name(int func_id)
+{
+    int i;
+    int size = (int) (sizeof(func_match) / sizeof(func_match_template));
+
+    for (i = 0; i < size; i++)
+    {
+        if (func_match[i].func_id == func_id)
+            return func_match[i].func_name;
+    }
+
+    return NULL;
+}
+
+/**
+ * Helper function to retrieve variable identifier
+ * this method is highly customized to specification of semestral work
+ * - without variable names, parses only one character string and returns SY_VARIABLE_X if the char is 'x'
+ * - with variable names, parses the longest matching name and returns its index
+ * - when slots are enabled, parses also "$N" placeholders and returns SY_VARIABLE_SLOT(N)
+ */
+static int sy_get_variable(char** chr, char* end, int flags, const char** names, int name_count)
+{
+    char var = sy_char_at(*chr, end);
+    int slot, digit, i, len, best, best_len;
+
+    if (names != NULL)
+    {
+        best = -1;
+        best_len = 0;
+        for (i = 0; i < name_count; i++)
+        {
+            len = (int)strlen(names[i]);
+            if (len > best_len && end - *chr >= len && strncmp(*chr, names[i], len) == 0)
+            {
+                best = i;
+                best_len = len;
+            }
+        }
+
+        *chr += best_len;
+        return best;
+    }
+
+    /* parse only one-character (one letter) variables */
+    /*if ((var > 'a' && var < 'z') || (var > 'A' && var < 'Z'))*/
+
+    /* for now, parse just 'x' variable, nothing more is needed */
+    if (var == 'x')
+    {
+        *chr += 1;
+        return SY_VARIABLE_X;
+    }
+
+    /* placeholder has to have at least one digit */
+    if (var == '$' && (flags & SY_FLAG_SLOTS) && sy_get_number(sy_char_at(*chr + 1, end)) != -1)
+    {
+        slot = 0;
+        *chr += 1;
+        while ((digit = sy_get_number(sy_char_at(*chr, end))) != -1)
+        {
+            slot = slot * 10 + digit;
+            *chr += 1;
+        }
+        return SY_VARIABLE_SLOT(slot);
+    }
+
+    return -1;
+}
+
+/**
+ * Helper function to retrieve length of identifier (letter followed by letters, digits or
+ * underscores) on supplied position, returns 0 if there is no identifier
+ */
+static int sy_identifier_length(char* chr, char* end)
+{
+    char* start = chr;
+    char c = sy_char_at(chr, end);
+
+    if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')))
+        return 0;
+
+    do
+    {
+        c = sy_char_at(++chr, end);
+    } while ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || sy_get_number(c) != -1 || c == '_');
+
+    return (int)(chr - start);
+}
+
+/*
+ * Helper function to retrieve priority class of operator, greater value binds tighter
+ * returns -1 for parentheses, which are not comparable with anything
+ */
+static int sy_operator_level(int op)
+{
+    switch (op)
+    {
+        case OP_EXP_RAISE:
+            return 4;
+        case OP_MULTIPLY:
+        case OP_DIVIDE:
+            return 3;
+        case OP_ADD:
+        case OP_SUBTRACT:
+            return 2;
+        case OP_LESS:
+        case OP_LESS_EQUAL:
+        case OP_GREATER:
+        case OP_GREATER_EQUAL:
+        case OP_EQUAL:
+        case OP_NOT_EQUAL:
+            return 1;
+        case OP_CONDITION:
+        case OP_ELSE:
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+/*
+ * Compares two operators and decides the priority (has greater, equal or lower)
+ * returns 1 if first has greater priority than second (i.e. * over +)
+ * returns 0 if both operators are equal
+ * returns -1 if first has lower priority than second (i.e. + and *)
+ * returns 2 if the operators cannot be compared (parenthesis)
+ */
+static int sy_operator_priority(int first, int second)
+{
+    int first_level = sy_operator_level(first);
+    int second_level = sy_operator_level(second);
+
+    if (first_level < 0 || second_level < 0)
+        return 2;
+
+    if (first_level > second_level)
+        return 1;
+    if (first_level < second_level)
+        return -1;
+
+    return 0;
+}
+
+/*
+ * Determines, if the operator is right-associative - exponent (2^3^2 is 2^(3^2)) and
+ * conditional (a ? b : c ? d : e is a ? b : (c ? d : e))
+ */
+static int sy_operator_right_associative(int op)
+{
+    return (op == OP_EXP_RAISE || op == OP_CONDITION) ? 1 : 0;
+}
+
+/*
+ * Pushes element to parser stack; if the stack is full, the element is freed and overflow flag
+ * is set, so that the expression is rejected instead of being silently cut
+ */
+static void sy_push(c_stack* stack, rpn_element* el, int* overflow)
+{
+    if (stck_push(stack, el) != 0)
+    {
+        free(el);
+        *overflow = 1;
+    }
+}
+
+/*
+ * Moves operator popped from operator stack to output; the second part of conditional
+ * operator is output as "if" function with three arguments
+ * returns 1 if the operator is '?' without its ':' part (the element is not moved then)
+ */
+static int sy_output_operator(c_stack* rpn_stack, rpn_element* el, int* overflow)
+{
+    if (el->type == RPN_TOKEN_OPERATOR && el->value.as_operator == OP_CONDITION)
+        return 1;
+
+    if (el->type == RPN_TOKEN_OPERATOR && el->value.as_operator == OP_ELSE)
+    {
+        el->type = RPN_TOKEN_FUNCTION;
+        el->value.as_function = FUNC_IF;
+        el->arity = 3;
+    }
+
+    sy_push(rpn_stack, el, overflow);
+    return 0;
+}
+
+/**
+ * Generates RPN represented expression from input string
+ * if something fails, sets flag and returns position of character, where everything failed
+ */
+c_stack* sy_generate_rpn_stack(char *input, int *error, char** error_ptr)
+{
+    return sy_generate_rpn_stack_n(input, (int)strlen(input), error, error_ptr);
+}
+
+/**
+ * Generates RPN represented expression from first "length" characters of input
+ * - the input does not need to be zero-terminated, so it may point i.e. to the middle
+ *   of memory mapped file
+ */
+c_stack* sy_generate_rpn_stack_n(char *input, int length, int *error, char** error_ptr)
+{
+    return sy_generate_rpn_stack_ex(input, length, 0, error, error_ptr);
+}
+
+/**
+ * Generates RPN represented expression from first "length" characters of input, using
+ * supplied parser flags (SY_FLAG_*)
+ */
+c_stack* sy_generate_rpn_stack_ex(char *input, int length, int flags, int *error, char** error_ptr)
+{
+    return sy_generate_rpn_stack_vars(input, length, flags, NULL, 0, error, error_ptr);
+}
+
+/**
+ * Generates RPN represented expression from first "length" characters of input, using
+ * supplied parser flags (SY_FLAG_*) and variable names - variable identifier is the index
+ * of its name; if no names are supplied, the only variable is 'x'
+ */
+c_stack* sy_generate_rpn_stack_vars(char *input, int length, int flags, const char** variables, int variable_count, int *error, char** error_ptr)
+{
+    /* output stack of rpn_elements */
+    c_stack *rpn_stack;
+    /* temporary stack of operators */
+    c_stack *op_stack;
+
+    rpn_element *rpn_el_tmp;
+
+    char chr;
+    int tmp, sign, stored_sign, flag, digit, empty, op_length, overflow;
+    double dtmp, weight;
+    rpn_element *last_el, *chained;
+    char *end;
+
+    /* index variables of sums and products being parsed; the index is usable (active) only
+     * in body, not in range expressions */
+    char* index_names[RPN_MAX_LOOP_DEPTH];
+    int index_lengths[RPN_MAX_LOOP_DEPTH];
+    int index_active[RPN_MAX_LOOP_DEPTH];
+    int open_loops = 0;
+
+    if (length <= 0)
+    {
+        *error = SYNTAX_ERROR_NOTHING_TO_PARSE;
+        *error_ptr = NULL;
+        return NULL;
+    }
+
+    end = input + length;
+
+    /* create stacks used in Shunting yard algorhitm */
+    rpn_stack = stck_create(RPN_STACK_SIZE);
+    op_stack = stck_create(SY_OP_STACK_SIZE);
+
+    /* memory allocation went wrong */
+    if (rpn_stack == NULL || op_stack == NULL)
+    {
+        *error = GENERAL_MEMORY_ERROR;
+        *error_ptr = NULL;
+        /* since this error should be incremental, we verify only first stack */
+        if (rpn_stack != NULL)
+            stck_destroy(rpn_stack);
+        return NULL;
+    }
+
+    *error = SYNTAX_ERROR_NONE;
+    *error_ptr = NULL;
+    stored_sign = 1;
+    last_el = NULL;
+    overflow = 0;
+
+    /* go through string character by character */
+    while (input < end)
+    {
+        /* some element did not fit to stack (the last one may be referenced as last_el, but it's
+         * not used any more) */
+        if (overflow)
+        {
+            ERROR_ROUTINE(SYNTAX_ERROR_TOO_LONG, input);
+            return NULL;
+        }
+
+        chr = *input;
+
+        /* first, try to parse numeric constant (integer / real) */
+        tmp = sy_get_number(chr);
+        /* note that "dot" character is also considered as beginning of numeric constant */
+        if (tmp != -1 || chr == '.')
+        {
+            /* if the function is followed by constant, not parenthesis, it's error */
+            if (last_el != NULL && last_el->type == RPN_TOKEN_FUNCTION)
+            {
+                ERROR_ROUTINE(SYNTAX_ERROR_FUNCTION_PARENTHESIS, input);
+                return NULL;
+            }
+
+            /* this allows parsing of real numbers in i.e. ".5E2" format */
+            /* if the dot is not the first character... */
+            if (chr != '.')
+            {
+                /* parse the integer part as it should be */
+                while ((digit = sy_get_number(sy_char_at(++input, end))) != (int)-1)
+                {
+                    tmp = tmp * 10 + digit;
+                }
+            }
+            /* if it begins with dot, the integer part is equal 0 */
+            else
+            {
+                tmp = 0;
+            }
+
+            dtmp = (double)(tmp);
+
+            /*
+             * I am fully informed about strtod existance, but I just wanted
+             * to try writing float number parsing routine by myself
+             *
+             * This, in addition, detects errors more preciselly
+             */
+
+            /* if non-integer part is present */
+            if (sy_char_at(input, end) == '.')
+            {
+                /* parse it and add to working value */
+                weight = 0.1;
+                while ((digit = sy_get_number(sy_char_at(++input, end))) != (int)-1)
+                {
+                    dtmp += (double)(digit)*weight;
+                    weight /= 10.0;
+                }
+
+                /* if decadic exponent is present */
+                if (sy_char_at(input, end) == 'E' || sy_char_at(input, end) == 'e')
+                {
+                    sign = 1;
+                    tmp = 0;
+
+                    /* move pointer (so we won't parse 'e' again) */
+                    chr = sy_char_at(++input, end);
+
+                    /* the exponent may have sign */
+                    if (chr == '-')
+                    {
+                        sign = -1;
+                    }
+                    else if (chr == '+')
+                    {
+                        /* sign already set to 1 */
+                    }
+                    else
+                    {
+                        /* the exponent mark ('e' or 'E') has to be followed by number */
+                        if ((digit = sy_get_number(chr)) != (int)-1)
+                            tmp = digit;
+                        else
+                        {
+                            ERROR_ROUTINE(SYNTAX_ERROR_REAL_NOTATION, input);
+                            return NULL;
+                        }
+                    }
+
+                    /* parse the value of exponent */
+                    while ((digit = sy_get_number(sy_char_at(++input, end))) != (int)-1)
+                    {
+                        tmp  = tmp*10 + digit;
+                    }
+
+                    /* and proceed it to working value */
+                    dtmp = dtmp * pow(10.0, (double)(sign*tmp));
+                }
+            }
+
+            /* apply stored sign (may be stored i.e. from parsing exponent operator */
+            dtmp = dtmp*stored_sign;
+            stored_sign = 1;
+
+            /* build element and push it to stack */
+            rpn_el_tmp = rpn_build_element(RPN_TOKEN_CONST);
+            last_el = rpn_el_tmp;
+            rpn_el_tmp->value.as_double = dtmp;
+            sy_push(rpn_stack, rpn_el_tmp, &overflow);
+
+            continue;
+        }
+
+        /* try to parse operator */
+        tmp = sy_get_operator(input, end, &op_length);
+        if (tmp != OP_NONE)
+        {
+            /* if the function is followed by operator, not parenthesis, it's error */
+            if (last_el != NULL && last_el->type == RPN_TOKEN_FUNCTION)
+            {
+                ERROR_ROUTINE(SYNTAX_ERROR_FUNCTION_PARENTHESIS, input);
+                return NULL;
+            }
+
+            /* let's validate unary operators and operands of binary operators */
+            if ((last_el == NULL && rpn_stack->curr == STCK_INVALID) || (last_el != NULL && last_el->type == RPN_TOKEN_OPERATOR && last_el->value.as_operator != PARENTHESIS_RIGHT))
+            {
+                /* unary operators + and - */
+                if ((tmp == OP_ADD || tmp == OP_SUBTRACT))
+                {
+                    /* if two same-priority operators came, that's pretty suspicious */
+                    if (last_el != NULL && (last_el->value.as_operator == OP_ADD || last_el->value.as_operator == OP_SUBTRACT))
+                    {
+                        /* unary minus can appear directly after binary plus - anything else in this block is considered error */
+                        if (tmp != OP_SUBTRACT || last_el->value.as_operator != OP_ADD)
+                        {
+                            ERROR_ROUTINE(SYNTAX_ERROR_OPERATOR_FREQUENCY, input);
+                            return NULL;
+                        }
+                    }
+
+                    /* unary operator after exponent mark */
+                    if (last_el != NULL && last_el->value.as_operator == OP_EXP_RAISE)
+                    {
+                        if (tmp == OP_SUBTRACT)
+                        {
+                            stored_sign = -1;
+                        }
+
+                        input++;
+                        continue;
+                    }
+
+                    /* insert "hidden zero" element, because -5 (unary minus) has the same value as 0-5, as well, as +5 and 0+5 */
+                    rpn_el_tmp = rpn_build_element(RPN_TOKEN_CONST);
+                    last_el = rpn_el_tmp;
+                    rpn_el_tmp->value.as_double = 0;
+                    sy_push(rpn_stack, rpn_el_tmp, &overflow);
+                }
+                else
+                {
+                    ERROR_ROUTINE(SYNTAX_ERROR_BINARY_OPERATOR_OPERANDS, input);
+                    return NULL;
+                }
+            }
+
+            /* "eat" all greater priority operators (and equal priority ones, unless the new operator
+             * is right-associative) and push them onto RPN stack */
+            while ((rpn_el_tmp = stck_peek(op_stack)) != NULL)
+            {
+                sign = sy_operator_priority(tmp, rpn_el_tmp->value.as_operator);
+                if (sign == -1 || (sign == 0 && !sy_operator_right_associative(tmp)))
+                    sy_output_operator(rpn_stack, stck_pop(op_stack), &overflow);
+                else
+                    break;
+            }
+
+            rpn_el_tmp = rpn_build_element(RPN_TOKEN_OPERATOR);
+            last_el = rpn_el_tmp;
+            rpn_el_tmp->value.as_operator = tmp;
+            sy_push(op_stack, rpn_el_tmp, &overflow);
+            input += op_length;
+            continue;
+        }
+
+        /* now try to parse parenthesis */
+        tmp = sy_get_parenthesis(chr);
+        if (tmp != PARENTHESIS_NONE)
+        {
+            /* left parenthesis is simply pushed to operator stack */
+            if (tmp == PARENTHESIS_LEFT)
+            {
+                /* opening bracket with preceding constant or variable is wrong */
+                if (last_el != NULL && (last_el->type == RPN_TOKEN_VARIABLE || last_el->type == RPN_TOKEN_CONST))
+                {
+                    ERROR_ROUTINE(SYNTAX_ERROR_UNEXPECTED_SYMBOL, input);
+                    return NULL;
+                }
+
+                /* sum and product begin with index variable name followed by comma */
+                if (last_el != NULL && last_el->type == RPN_TOKEN_FUNCTION
+                    && (last_el->value.as_function == FUNC_SUM || last_el->value.as_function == FUNC_PROD))
+                {
+                    do
+                    {
+                        ++input;
+                    } while (sy_char_at(input, end) == ' ');
+
+                    if (open_loops == RPN_MAX_LOOP_DEPTH || (tmp = sy_identifier_length(input, end)) == 0)
+                    {
+                        ERROR_ROUTINE(SYNTAX_ERROR_INDEX_VARIABLE, input);
+                        return NULL;
+                    }
+
+                    index_names[open_loops] = input;
+                    index_lengths[open_loops] = tmp;
+                    index_active[open_loops] = 0;
+
+                    input += tmp;
+                    while (sy_char_at(input, end) == ' ')
+                        ++input;
+
+                    if (sy_char_at(input, end) != ',')
+                    {
+                        ERROR_ROUTINE(SYNTAX_ERROR_INDEX_VARIABLE, input);
+                        return NULL;
+                    }
+
+                    open_loops++;
+                    tmp = PARENTHESIS_LEFT;
+                }
+
+                rpn_el_tmp = rpn_build_element(RPN_TOKEN_OPERATOR);
+                last_el = rpn_el_tmp;
+                rpn_el_tmp->value.as_operator = tmp;
+                sy_push(op_stack, rpn_el_tmp, &overflow);
+            }
+            else
+            {
+                /* closing bracket immediatelly after function token is also wrong */
+                if (last_el != NULL && last_el->type == RPN_TOKEN_FUNCTION)
+                {
+                    ERROR_ROUTINE(SYNTAX_ERROR_FUNCTION_PARENTHESIS, input);
+                    return NULL;
+                }
+
+                flag = -1;
+                empty = 0;
+
+                /* go through operators in operator stack and push operators, that aren't parenthesis
+                   on rpn stack, until we hit left parenthesis */
+                while ((rpn_el_tmp = stck_pop(op_stack)) != NULL)
+                {
+                    if (rpn_el_tmp->value.as_operator == PARENTHESIS_LEFT)
+                    {
+                        /* parenthesis found flag */
+                        flag = 1;
+
+                        /* nothing between parentheses (or after last comma) */
+                        if (last_el == rpn_el_tmp)
+                        {
+                            last_el = NULL;
+                            empty = 1;
+                        }
+
+                        /* we won't reuse this, let's free it */
+                        free(rpn_el_tmp);
+
+                        /* also look, if parentheses was used to match math function argument */
+                        rpn_el_tmp = stck_peek(op_stack);
+                        if (rpn_el_tmp != NULL && rpn_el_tmp->type == RPN_TOKEN_FUNCTION)
+                        {
+                            /* empty parentheses mean no arguments, but argument after comma must not be empty */
+                            if (empty && rpn_el_tmp->arity > 1)
+                            {
+                                ERROR_ROUTINE(SYNTAX_ERROR_MISSING_OPERAND, input);
+                                return NULL;
+                            }
+                            if (empty)
+                                rpn_el_tmp->arity = 0;
+
+                            if (!sy_check_function_arity(rpn_el_tmp->value.as_function, rpn_el_tmp->arity))
+                            {
+                                ERROR_ROUTINE(SYNTAX_ERROR_ARGUMENT_COUNT, input);
+                                return NULL;
+                            }
+
+                            /* more values than two are chained - min(a, b, c) is the same as min(a, min(b, c)) */
+                            if (rpn_el_tmp->value.as_function == FUNC_MIN || rpn_el_tmp->value.as_function == FUNC_MAX)
+                            {
+                                for (; rpn_el_tmp->arity > 2; rpn_el_tmp->arity--)
+                                {
+                                    chained = rpn_build_element(RPN_TOKEN_FUNCTION);
+                                    chained->value.as_function = rpn_el_tmp->value.as_function;
+                                    chained->arity = 2;
+                                    sy_push(rpn_stack, chained, &overflow);
+                                }
+                            }
+
+                            /* range and body are already in output, index variable is not a value */
+                            if (rpn_el_tmp->value.as_function == FUNC_SUM || rpn_el_tmp->value.as_function == FUNC_PROD)
+                            {
+                                rpn_el_tmp->arity = 2;
+                                open_loops--;
+                            }
+
+                            sy_push(rpn_stack, stck_pop(op_stack), &overflow);
+                        }
+
+                        break;
+                    }
+
+                    last_el = NULL;
+                    if (sy_output_operator(rpn_stack, rpn_el_tmp, &overflow))
+                    {
+                        free(rpn_el_tmp);
+                        ERROR_ROUTINE(SYNTAX_ERROR_INCOMPLETE_CONDITION, input);
+                        return NULL;
+                    }
+                }
+
+                /* if we hit the bottom without parenthesis being found, it means that opening parenthesis is missing */
+                if (flag == -1)
+                {
+                    ERROR_ROUTINE(SYNTAX_ERROR_MISSING_PARENTHESIS, input);
+                    return NULL;
+                }
+            }
+
+            ++input;
+            continue;
+        }
+
+        /* comma separates function arguments */
+        if (chr == ',')
+        {
+            /* the same as at the end of expression - argument must not end with operator or function */
+            if (last_el != NULL && last_el->type == RPN_TOKEN_FUNCTION)
+            {
+                ERROR_ROUTINE(SYNTAX_ERROR_FUNCTION_PARENTHESIS, input);
+                return NULL;
+            }
+            if (last_el != NULL && last_el->type == RPN_TOKEN_OPERATOR && last_el->value.as_operator != PARENTHESIS_LEFT)
+            {
+                ERROR_ROUTINE(SYNTAX_ERROR_BINARY_OPERATOR_OPERANDS, input);
+                return NULL;
+            }
+
+            /* finish the argument - push operators to rpn stack until we hit left parenthesis */
+            while ((rpn_el_tmp = stck_peek(op_stack)) != NULL && rpn_el_tmp->type == RPN_TOKEN_OPERATOR
+                   && rpn_el_tmp->value.as_operator != PARENTHESIS_LEFT)
+            {
+                if (rpn_el_tmp->value.as_operator == OP_CONDITION)
+                {
+                    ERROR_ROUTINE(SYNTAX_ERROR_INCOMPLETE_CONDITION, input);
+                    return NULL;
+                }
+                sy_output_operator(rpn_stack, stck_pop(op_stack), &overflow);
+                last_el = NULL;
+            }
+
+            /* the parenthesis has to belong to function call */
+            if (rpn_el_tmp == NULL || rpn_el_tmp->type != RPN_TOKEN_OPERATOR || op_stack->curr < 1
+                || ((rpn_element*)stck_get(op_stack, op_stack->curr - 1))->type != RPN_TOKEN_FUNCTION)
+            {
+                ERROR_ROUTINE(SYNTAX_ERROR_UNEXPECTED_SYMBOL, input);
+                return NULL;
+            }
+
+            /* argument must not be empty */
+            if (last_el == rpn_el_tmp)
+            {
+                ERROR_ROUTINE(SYNTAX_ERROR_MISSING_OPERAND, input);
+                return NULL;
+            }
+
+            chained = stck_get(op_stack, op_stack->curr - 1);
+            chained->arity++;
+
+            /* range of sum or product is complete, the body follows - it is evaluated in a loop
+             * with the index variable */
+            if ((chained->value.as_function == FUNC_SUM || chained->value.as_function == FUNC_PROD) && chained->arity == 3)
+            {
+                chained = rpn_build_element(RPN_TOKEN_FUNCTION);
+                chained->value.as_function = FUNC_LOOP;
+                chained->arity = 2;
+                sy_push(rpn_stack, chained, &overflow);
+                index_active[open_loops - 1] = 1;
+            }
+
+            /* the next argument is parsed the same way as if the parenthesis was just opened */
+            last_el = rpn_el_tmp;
+            ++input;
+            continue;
+        }
+
+        /* colon finishes the first branch of conditional operator */
+        if (chr == ':')
+        {
+            /* the branch must not end with operator or function, the same as function argument */
+            if (last_el != NULL && last_el->type == RPN_TOKEN_FUNCTION)
+            {
+                ERROR_ROUTINE(SYNTAX_ERROR_FUNCTION_PARENTHESIS, input);
+                return NULL;
+            }
+            if (last_el == NULL || (last_el->type == RPN_TOKEN_OPERATOR && last_el->value.as_operator != PARENTHESIS_RIGHT))
+            {
+                ERROR_ROUTINE(SYNTAX_ERROR_BINARY_OPERATOR_OPERANDS, input);
+                return NULL;
+            }
+
+            /* push operators of the branch to rpn stack until we hit the matching '?' */
+            while ((rpn_el_tmp = stck_peek(op_stack)) != NULL && rpn_el_tmp->type == RPN_TOKEN_OPERATOR
+                   && rpn_el_tmp->value.as_operator != OP_CONDITION && rpn_el_tmp->value.as_operator != PARENTHESIS_LEFT)
+            {
+                sy_output_operator(rpn_stack, stck_pop(op_stack), &overflow);
+            }
+
+            if (rpn_el_tmp == NULL || rpn_el_tmp->type != RPN_TOKEN_OPERATOR || rpn_el_tmp->value.as_operator != OP_CONDITION)
+            {
+                ERROR_ROUTINE(SYNTAX_ERROR_UNEXPECTED_SYMBOL, input);
+                return NULL;
+            }
+
+            /* the '?' stays on operator stack as ':', the second branch is parsed as operand of it */
+            rpn_el_tmp->value.as_operator = OP_ELSE;
+            last_el = rpn_el_tmp;
+            ++input;
+            continue;
+        }
+
+        /* index variable of enclosing sum or product (the innermost one wins); its identifier
+         * is the nesting level of loop among loops running at the time */
+        op_length = sy_identifier_length(input, end);
+        for (tmp = open_loops - 1; op_length > 0 && tmp >= 0; tmp--)
+        {
+            if (index_active[tmp] && index_lengths[tmp] == op_length && strncmp(input, index_names[tmp], op_length) == 0)
+                break;
+        }
+        if (op_length > 0 && tmp >= 0)
+        {
+            if (last_el != NULL && last_el->type == RPN_TOKEN_FUNCTION)
+            {
+                ERROR_ROUTINE(SYNTAX_ERROR_FUNCTION_PARENTHESIS, input);
+                return NULL;
+            }
+
+            for (flag = 0; tmp > 0; tmp--)
+                flag += index_active[tmp - 1];
+
+            rpn_el_tmp = rpn_build_element(RPN_TOKEN_VARIABLE);
+            last_el = rpn_el_tmp;
+            rpn_el_tmp->value.as_variable = RPN_INDEX_VARIABLE(flag);
+            sy_push(rpn_stack, rpn_el_tmp, &overflow);
+            input += op_length;
+            continue;
+        }
+
+        /* now try to parse function */
+        tmp = sy_get_function(&input, end);
+        if (tmp != FUNC_UNSUPPORTED)
+        {
+            /* functions are just thrown onto stack */
+            rpn_el_tmp = rpn_build_element(RPN_TOKEN_FUNCTION);
+            last_el = rpn_el_tmp;
+            rpn_el_tmp->value.as_function = tmp;
+            rpn_el_tmp->arity = 1;
+            sy_push(op_stack, rpn_el_tmp, &overflow);
+            continue;
+        }
+
+        /* as last thing, try to parse variable (one letter token) */
+        tmp = sy_get_variable(&input, end, flags, variables, variable_count);
+        if (tmp != -1)
+        {
+            /* as well, as constant, the variable should not appear as next element after function
+             * token without parenthesis being immediatelly open */
+            if (last_el != NULL && last_el->type == RPN_TOKEN_FUNCTION)
+            {
+                ERROR_ROUTINE(SYNTAX_ERROR_FUNCTION_PARENTHESIS, input);
+                return NULL;
+            }
+
+            rpn_el_tmp = rpn_build_element(RPN_TOKEN_VARIABLE);
+            last_el = rpn_el_tmp;
+            rpn_el_tmp->value.as_variable = tmp;
+            sy_push(rpn_stack, rpn_el_tmp, &overflow);
+            continue;
+        }
+
+        /* ignore whitespaces */
+        if (chr == ' ')
+        {
+            ++input;
+            continue;
+        }
+
+        /* this means we have some unexpected character / token on input */
+        ERROR_ROUTINE(SYNTAX_ERROR_INVALID_CHARACTER, input);
+        return NULL;
+    }
+
+    /* if last element of expression was an operator (binary), it's an error */
+    if (last_el != NULL && last_el->type == RPN_TOKEN_OPERATOR)
+    {
+        ERROR_ROUTINE(SYNTAX_ERROR_BINARY_OPERATOR_OPERANDS, input);
+        return NULL;
+    }
+
+    /* every operator left in operator stack should be pushed to output stack */
+    while ((rpn_el_tmp = stck_pop(op_stack)) != NULL)
+    {
+        /* ..except parenthesis
+         * this also validates proper closing of parenthesis */
+        if (rpn_el_tmp->type == RPN_TOKEN_OPERATOR && rpn_el_tmp->value.as_operator == PARENTHESIS_LEFT)
+        {
+            free(rpn_el_tmp);
+            ERROR_ROUTINE(SYNTAX_ERROR_MISSING_PARENTHESIS, input);
+            return NULL;
+        }
+        if (sy_output_operator(rpn_stack, rpn_el_tmp, &overflow))
+        {
+            free(rpn_el_tmp);
+            ERROR_ROUTINE(SYNTAX_ERROR_INCOMPLETE_CONDITION, input);
+            return NULL;
+        }
+    }
+
+    if (overflow)
+    {
+        ERROR_ROUTINE(SYNTAX_ERROR_TOO_LONG, input);
+        return NULL;
+    }
+
+    /* clean up temporary operator stack */
+    stck_destroy(op_stack);
+
+    return rpn_stack;
+}
@@ -1,13 +1,23 @@
-#ifndef MATHPARSER_SY_H
-#define MATHPARSER_SY_H
-
-/* template for function matching record */
-typedef struct _func_match_template
-{
-    int func_id;
-    const char* func_name;
-} func_match_template;
-
-c_stack* sy_generate_rpn_stack(char *input, int *error, char** error_ptr);
-
-#endif
+#ifndef MATHPARSER_SY_H
+#define MATHPARSER_SY_H
+
+#define SY_FLAG_SLOTS 0x0001            /* accept "$N" placeholders (used for already evaluated subexpressions) */
+
+#define SY_VARIABLE_X 0                 /* variable identifier of x */
+#define SY_VARIABLE_SLOT(n) ((n) + 1)   /* variable identifier of "$n" placeholder */
+
+/* template for function matching record */
+typedef struct _func_match_template
+{
+    int func_id;
+    const char* func_name;
+} func_match_template;
+
+c_stack* sy_generate_rpn_stack(char *input, int *error, char** error_ptr);
+c_stack* sy_generate_rpn_stack_n(char *input, int length, int *error, char** error_ptr);
+c_stack* sy_generate_rpn_stack_ex(char *input, int length, int flags, int *error, char** error_ptr);
+c_stack* sy_generate_rpn_stack_vars(char *input, int length, int flags, const char** variables, int variable_count, int *error, char** error_ptr);
+const char* sy_get_function_name(int func_id);
+const char* sy_get_operator_name(int op);
+
+#endif
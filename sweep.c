@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "stack.h"
+#include "program.h"
+#include "multi.h"
+#include "pool.h"
+#include "drawing.h"
+#include "sweep.h"
+
+/*
+ * Frames of parameter sweep are independent plots of the same compiled function, which differ only
+ * in bound parameter value. Every frame is rendered by one task of thread pool to its own document,
+ * with sampling inside the frame serial; the compiled program is shared by all of them, and its
+ * subexpressions not depending on x are evaluated once per frame (when the parameter is bound).
+ */
+
+/* shared state of one sweep */
+typedef struct
+{
+    char* expression;                   /* source expression, printed in legend of every frame */
+    multi_program* functions;           /* compiled function with one parameter */
+    const sweep_spec* sweep;
+    char* output_prefix;
+    double* limits;
+    drawing_options options;            /* drawing options with creation date shared by all frames */
+    volatile long failed;               /* number of frames, which could not be drawn */
+} sweep_context;
+
+/**
+ * Renders one frame (pool task routine)
+ */
+static void sweep_frame(void* arg, int index)
+{
+    sweep_context* ctx = (sweep_context*)arg;
+    multi_program frame;
+    double value;
+    char *filename, *legend;
+
+    value = ctx->sweep->from;
+    if (ctx->sweep->frames > 1)
+        value += index * (ctx->sweep->to - ctx->sweep->from) / (ctx->sweep->frames - 1);
+
+    /* the copy shares compiled programs, only bound values are its own */
+    frame = *ctx->functions;
+    multi_bind(&frame, &value);
+
+    filename = (char*)malloc(strlen(ctx->output_prefix) + 32);
+    legend = (char*)malloc(strlen(ctx->expression) + strlen(ctx->sweep->parameter) + 40);
+    if (filename == NULL || legend == NULL)
+    {
+        free(filename);
+        free(legend);
+        pool_atomic_add(&ctx->failed, 1);
+        return;
+    }
+
+    sprintf(filename, SWEEP_FILE_FORMATTER, ctx->output_prefix, index);
+    sprintf(legend, "%s, %s = " SWEEP_VALUE_FORMATTER, ctx->expression, ctx->sweep->parameter, value);
+
+    if (drawing_process_output(&legend, &frame, filename, ctx->limits, NULL, &ctx->options) != 0)
+        pool_atomic_add(&ctx->failed, 1);
+
+    free(filename);
+    free(legend);
+}
+
+/**
+ * Renders frames of parameter sweep of function (compiled with one parameter) to files named by
+ * output prefix and frame index; frames are rendered in parallel using supplied number of threads
+ * (0 = all processors), and the rate is printed
+ * Returns 0 on success, 1 if some frame could not be drawn
+ */
+int sweep_render(char* expression, multi_program* functions, const sweep_spec* sweep, char* output_prefix, double* limits,
+                 int threads, const drawing_options* options)
+{
+    sweep_context ctx;
+    thread_pool* pool;
+    char creation_date[64];
+    time_t now;
+    double start, elapsed;
+
+    ctx.expression = expression;
+    ctx.functions = functions;
+    ctx.sweep = sweep;
+    ctx.output_prefix = output_prefix;
+    ctx.limits = limits;
+    ctx.options = *options;
+    ctx.failed = 0;
+
+    /* asctime result is static, so it's formatted only once for all frames */
+    now = time(NULL);
+    strncpy(creation_date, asctime(gmtime(&now)), sizeof(creation_date) - 1);
+    creation_date[sizeof(creation_date) - 1] = '\0';
+    ctx.options.creation_date = creation_date;
+
+    pool = pool_create(threads);
+
+    start = pool_wall_time();
+    pool_run(pool, sweep_frame, &ctx, sweep->frames);
+    elapsed = pool_wall_time() - start;
+
+    printf("Rendered %i frames in %.3f s (%.1f frames per second) using %i threads\n", sweep->frames - (int)ctx.failed, elapsed,
+           (elapsed > 0) ? (sweep->frames - ctx.failed) / elapsed : 0.0, pool_thread_count(pool));
+
+    if (pool != NULL)
+        pool_destroy(pool);
+
+    return (ctx.failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,20 @@
+#ifndef MATHPARSER_SWEEP_H
+#define MATHPARSER_SWEEP_H
+
+#define SWEEP_VALUE_FORMATTER "%.6g"    /* formatter of parameter value in frame legend */
+#define SWEEP_FILE_FORMATTER "%s%04i.ps" /* frame file name from output prefix and frame index */
+#define SWEEP_MAX_FRAMES 1000000        /* maximum number of frames of one sweep */
+
+/* parameter sweep - "frames" values of parameter evenly distributed over [from, to] */
+typedef struct
+{
+    const char* parameter;              /* parameter name */
+    double from;
+    double to;
+    int frames;
+} sweep_spec;
+
+int sweep_render(char* expression, multi_program* functions, const sweep_spec* sweep, char* output_prefix, double* limits,
+                 int threads, const drawing_options* options);
+
+#endif
@@ -1,150 +1,3730 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <math.h>
-#include <string.h>
-#include "stack.h"
-#include "rpn.h"
-#include "main.h"
-#include "shunting_yard.h"
-#include "test.h"
-
-/* structure for storing test case */
-typedef struct
-{
-    const char* expression;
-    double expected_result;
-    int error;
-} test_case;
-
-/* static array of test cases */
-static test_case cases[] = {
-
-    /* success tests */
-    /* all results from more complex expressions confirmed using WolframAlpha (http://www.wolframalpha.com) */
-
-    /* expression,            expected result,  error */
-    { "2+2",                        4.0,        0 },
-    { "5-2",                        3.0,        0 },
-    { "125-85",                     40.0,       0 },
-    { "12*8",                       96.0,       0 },
-    { "6*2/4",                      3.0,        0 },
-    { "6/2*4",                      12.0,       0 },
-    { "2^3",                        8.0,        0 },
-    { "2^3^2",                      512.0,      0 },
-    { "(2^3)^2",                    64.0,       0 },
-    { "2^(3^2)",                    512.0,      0 },
-    { "-5+2",                       -3.0,       0 },
-    { "-5-2",                       -7.0,       0 },
-    { "2*sin(1.92)",                1.879291,   0 },
-    { "-2*sin(1.92)",               -1.879291,  0 },
-    { "(x*sin(x)+x)",               2.996242,   0 },
-    { "2^-3",                       0.125,      0 },
-    { "25*(225-52",                 0.0,        1 },
-    { "3*5-2*(8-3)+7-6/2",          9.0,        0 },
-    { "(3*5-2*(8-3)+7-6/2)/3",      3.0,        0 },
-    { "2*abs(x-3)",                 3.0,        0 },
-    { "5+-4",                       1.0,        0 },
-    { "2*2*2*2*2*2",                64.0,       0 },
-    { "2+2*6+4",                    18.0,       0 },
-    { "sin(cos(tan(abs(-5))))",     -0.825786,  0 },
-    { "sin(2-cos(tan(2+5)-3))",     0.574759,   0 },
-    { "-cos(-sin(2*2))",            -0.727035,  0 },
-    { "asin(0.5)",                  0.523599,   0 },
-    { "todeg(asin(0.5))",           30.0,       0 },
-    { "torad(180.0)",               3.1415927,  0 },
-    { "x-x",                        0.0,        0 },
-    { "2^0",                        1.0,        0 },
-    { "2/0",                        INFINITY,   0 }, /* for needs of drawing plot the "infinity" value is sufficient indicator */
-    { "1/x",                        0.666667,   0 },
-    { "0^0",                        1.0,        0 },
-    { "5*(3*(2*(1*(-5))))",         -150.0,     0 },
-    { "-(2+5)",                     -7.0,       0 },
-
-    /* error tests */
-    { "-",          0.0, 5 },
-    { "*",          0.0, 5 },
-    { "2*",         0.0, 5 },
-    { "*2",         0.0, 5 },
-    { "^10",        0.0, 5 },
-    { "!?",         0.0, 6 },
-    { "5++4",       0.0, 3 },
-    { "5--4",       0.0, 3 },
-    { "--5--4",     0.0, 3 },
-    { "sin5",       0.0, 4 },
-    { "sin(5",      0.0, 1 },
-    { "",           0.0, 7 },
-    { "(sin)",      0.0, 4 },
-    { "()",         0.0, 0 }, /* may be considered error, but empty value is also value, assuming 0 */
-};
-
-/* evaluation test function - goes through all test cases and verifies their output / error */
-int test_evaluation(void)
-{
-    int i;
-    int size;
-    c_stack *tmp;
-    int error;
-    char *error_ptr, *expr_cpy;
-    int fail, success, failed;
-    double res;
-
-    /* counters */
-    success = 0;
-    failed = 0;
-    error = 0;
-    error_ptr = NULL;
-    tmp = NULL;
-
-    /* go through every case */
-    size = (int) (sizeof(cases) / sizeof(test_case));
-    for (i = 0; i < size; i++)
-    {
-        fail = 0;
-
-        /* for not passing const parameter to function retaining non-const, copy it */
-        expr_cpy = (char*)malloc(sizeof(char)*strlen(cases[i].expression)+1);
-        strcpy(expr_cpy, cases[i].expression);
-
-        printf("Expression: %s\n", cases[i].expression);
-        /* generate stack */
-        tmp = sy_generate_rpn_stack(expr_cpy, &error, &error_ptr);
-
-        /* verify expected error if set */
-        if (cases[i].error > 0 || (cases[i].error == 0 && error != 0))
-        {
-            printf("Error:      %i (expected %i)\n", error, cases[i].error);
-            if (error != cases[i].error)
-                fail = 1;
-        }
-        /* if no error, evaluate stack */
-        if (error == 0)
-        {
-            res = rpn_evaluate_stack(tmp, TEST_CASE_VARIABLE_VAL);
-            printf("Result:     %f (expected %f)\n", res, cases[i].expected_result);
-            /* verify result */
-            if (fabs(res - cases[i].expected_result) > COMPARISON_EPSILON)
-                fail = 1;
-        }
-
-        /* increase appropriate counter */
-        if (fail == 0)
-        {
-            printf("OK\n\n");
-            success++;
-        }
-        else
-        {
-            printf("FAILED\n\n");
-            failed++;
-        }
-
-        if (tmp)
-            stck_destroy(tmp);
-
-        free(expr_cpy);
-    }
-
-    printf("Done.\nSuccess: %i\nFailed: %i\n\n", success, failed);
-
-    return (failed == 0) ? 0 : 1;
-}
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include "stack.h"
+#include "rpn.h"
+#include "main.h"
+#include "shunting_yard.h"
+#include "program.h"
+#include "multi.h"
+#include "cache.h"
+#include "incremental.h"
+#include "userfunc.h"
+#include "pool.h"
+#include "grid.h"
+#include "drawing.h"
+#include "polyline.h"
+#include "raster.h"
+#include "heatmap.h"
+#include "implicit.h"
+#include "analysis.h"
+#include "quadrature.h"
+#include "postscript.h"
+#include "bulk.h"
+#include "test.h"
+
+/* structure for storing test case */
+typedef struct
+{
+    const char* expression;
+    double expected_result;
+    int error;
+} test_case;
+
+/* static array of test cases */
+static test_case cases[] = {
+
+    /* success tests */
+    /* all results from more complex expressions confirmed using WolframAlpha (http://www.wolframalpha.com) */
+
+    /* expression,            expected result,  error */
+    { "2+2",                        4.0,        0 },
+    { "5-2",                        3.0,        0 },
+    { "125-85",                     40.0,       0 },
+    { "12*8",                       96.0,       0 },
+    { "6*2/4",                      3.0,        0 },
+    { "6/2*4",                      12.0,       0 },
+    { "2^3",                        8.0,        0 },
+    { "2^3^2",                      512.0,      0 },
+    { "(2^3)^2",                    64.0,       0 },
+    { "2^(3^2)",                    512.0,      0 },
+    { "-5+2",                       -3.0,       0 },
+    { "-5-2",                       -7.0,       0 },
+    { "2*sin(1.92)",                1.879291,   0 },
+    { "-2*sin(1.92)",               -1.879291,  0 },
+    { "(x*sin(x)+x)",               2.996242,   0 },
+    { "2^-3",                       0.125,      0 },
+    { "25*(225-52",                 0.0,        1 },
+    { "3*5-2*(8-3)+7-6/2",          9.0,        0 },
+    { "(3*5-2*(8-3)+7-6/2)/3",      3.0,        0 },
+    { "2*abs(x-3)",                 3.0,        0 },
+    { "5+-4",                       1.0,        0 },
+    { "2*2*2*2*2*2",                64.0,       0 },
+    { "2+2*6+4",                    18.0,       0 },
+    { "sin(cos(tan(abs(-5))))",     -0.825786,  0 },
+    { "sin(2-cos(tan(2+5)-3))",     0.574759,   0 },
+    { "-cos(-sin(2*2))",            -0.727035,  0 },
+    { "asin(0.5)",                  0.523599,   0 },
+    { "todeg(asin(0.5))",           30.0,       0 },
+    { "torad(180.0)",               3.1415927,  0 },
+    { "x-x",                        0.0,        0 },
+    { "2^0",                        1.0,        0 },
+    { "2/0",                        INFINITY,   0 }, /* for needs of drawing plot the "infinity" value is sufficient indicator */
+    { "1/x",                        0.666667,   0 },
+    { "0^0",                        1.0,        0 },
+    { "5*(3*(2*(1*(-5))))",         -150.0,     0 },
+    { "-(2+5)",                     -7.0,       0 },
+    { "max(x, 2)",                  2.0,        0 },
+    { "min(3, x, 2)",               1.5,        0 },
+    { "atan2(1, x)",                0.588003,   0 },
+    { "hypot(3, 4)",                5.0,        0 },
+    { "clamp(x*3, 0, 4)",           4.0,        0 },
+    { "fma(x, 2, 1)",               4.0,        0 },
+    { "x < 2",                      1.0,        0 },
+    { "x >= 2",                     0.0,        0 },
+    { "x == 1.5",                   1.0,        0 },
+    { "2 != 2",                     0.0,        0 },
+    { "1 + x <= 2*x",               1.0,        0 },
+    { "x > 1 ? x*2 : -x",           3.0,        0 },
+    { "x < 1 ? 1 : x < 2 ? 2 : 3",  2.0,        0 },
+    { "1 ? 2 ? 3 : 4 : 5",          3.0,        0 },
+    { "if(x <= 1, 5, 1 + x^2)",     3.25,       0 },
+    { "(x > 1 ? 1 : 0) + 1 < 3",    1.0,        0 },
+    { "sum(k, 1, 4, k*x)",          15.0,       0 },
+    { "prod(k, 1, 4, k)",           24.0,       0 },
+    { "sum(k, 1, 0, k)",            0.0,        0 }, /* empty range gives identity */
+    { "prod(i, 1, 0, x)",           1.0,        0 },
+    { "sum(k, 1, 3, sum(j, 1, k, j*x))", 15.0,  0 },
+    { "sum(k, 1, 10000, sin(k*x)/k)", 0.820865, 0 },
+    { "2*sum(n, x, x+2, n)",        15.0,       0 },
+    { "max(0/0, x)",                NAN,        0 }, /* NaN wins regardless of its position */
+    { "max(x, 0/0)",                NAN,        0 },
+    { "min(0/0, x)",                NAN,        0 },
+    { "min(1, x, 0/0)",             NAN,        0 },
+
+    /* error tests */
+    { "-",          0.0, 5 },
+    { "*",          0.0, 5 },
+    { "2*",         0.0, 5 },
+    { "*2",         0.0, 5 },
+    { "^10",        0.0, 5 },
+    { "!?",         0.0, 6 },
+    { "5++4",       0.0, 3 },
+    { "5--4",       0.0, 3 },
+    { "--5--4",     0.0, 3 },
+    { "sin5",       0.0, 4 },
+    { "sin(5",      0.0, 1 },
+    { "",           0.0, 7 },
+    { "(sin)",      0.0, 4 },
+    { "()",         0.0, 0 }, /* may be considered error, but empty value is also value, assuming 0 */
+    { "atan2(1)",   0.0, 11 },
+    { "max(1)",     0.0, 11 },
+    { "x ? 1",      0.0, 14 },
+    { "(x ? 1) : 2", 0.0, 14 },
+    { "x : 1",      0.0, 8 },
+    { "x ? : 1",    0.0, 5 },
+    { "x = 1",      0.0, 6 },
+    { "if(x, 1)",   0.0, 11 },
+    { "sum(1, 2, 3)", 0.0, 15 },
+    { "sum(k, 1, 2)", 0.0, 11 },
+    { "k + sum(k, 1, 2, k)", 0.0, 6 },
+    { "sum(k, 1, k, 1)", 0.0, 6 },  /* index is not defined in range */
+    { "min(1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,21,22,23,24,25,26,27,28,29,30,31,32,33,34,35)", 0.0, 16 },  /* chained arguments do not fit to parser stack */
+};
+
+/* evaluation test function - goes through all test cases and verifies their output / error */
+int test_evaluation(void)
+{
+    int i;
+    int size;
+    c_stack *tmp;
+    int error;
+    char *error_ptr, *expr_cpy;
+    int fail, success, failed;
+    double res;
+
+    /* counters */
+    success = 0;
+    failed = 0;
+    error = 0;
+    error_ptr = NULL;
+    tmp = NULL;
+
+    /* go through every case */
+    size = (int) (sizeof(cases) / sizeof(test_case));
+    for (i = 0; i < size; i++)
+    {
+        fail = 0;
+
+        /* for not passing const parameter to function retaining non-const, copy it */
+        expr_cpy = (char*)malloc(sizeof(char)*strlen(cases[i].expression)+1);
+        strcpy(expr_cpy, cases[i].expression);
+
+        printf("Expression: %s\n", cases[i].expression);
+        /* generate stack */
+        tmp = sy_generate_rpn_stack(expr_cpy, &error, &error_ptr);
+
+        /* verify expected error if set */
+        if (cases[i].error > 0 || (cases[i].error == 0 && error != 0))
+        {
+            printf("Error:      %i (expected %i)\n", error, cases[i].error);
+            if (error != cases[i].error)
+                fail = 1;
+        }
+        /* if no error, evaluate stack */
+        if (error == 0)
+        {
+            res = rpn_evaluate_stack(tmp, TEST_CASE_VARIABLE_VAL);
+            printf("Result:     %f (expected %f)\n", res, cases[i].expected_result);
+            /* verify result (NaN has to be NaN) */
+            if (fabs(res - cases[i].expected_result) > COMPARISON_EPSILON || (res != res) != (cases[i].expected_result != cases[i].expected_result))
+                fail = 1;
+        }
+
+        /* increase appropriate counter */
+        if (fail == 0)
+        {
+            printf("OK\n\n");
+            success++;
+        }
+        else
+        {
+            printf("FAILED\n\n");
+            failed++;
+        }
+
+        if (tmp)
+            stck_destroy(tmp);
+
+        free(expr_cpy);
+    }
+
+    printf("Done.\nSuccess: %i\nFailed: %i\n\n", success, failed);
+
+    return (failed == 0) ? 0 : 1;
+}
+
+/**
+ * Helper function to copy program image to newly allocated memory, so it can be loaded
+ * as if it was read from file
+ */
+static void* test_copy_image(rpn_program* prog)
+{
+    void* image = malloc(prog->image_size);
+    memcpy(image, prog->image, prog->image_size);
+    return image;
+}
+
+/**
+ * Helper function to load (possibly damaged) image copy and verify the load error
+ * returns 1 if the load error matches expected one
+ */
+static int test_load_image(void* image, long size, int expected_error)
+{
+    rpn_program* loaded;
+    int error;
+
+    loaded = prog_from_image(image, size, &error);
+    if (loaded != NULL)
+        prog_destroy(loaded);
+    else
+        free(image);
+
+    return (error == expected_error) ? 1 : 0;
+}
+
+/* serialization test function - compiles every valid test case, stores and loads its binary image,
+ * and verifies the loaded program evaluates to the same value; also verifies damaged images are refused */
+int test_serialization(void)
+{
+    int i, size, error, fail, success, failed;
+    c_stack *tmp;
+    char *error_ptr, *expr_cpy;
+    rpn_program *prog, *loaded;
+    unsigned char* image;
+    double expected, res, variable, block_res;
+    double* variables[1];
+
+    success = 0;
+    failed = 0;
+
+    size = (int) (sizeof(cases) / sizeof(test_case));
+    for (i = 0; i < size; i++)
+    {
+        if (cases[i].error != 0)
+            continue;
+
+        fail = 0;
+
+        expr_cpy = (char*)malloc(sizeof(char)*strlen(cases[i].expression)+1);
+        strcpy(expr_cpy, cases[i].expression);
+
+        printf("Round-trip: %s\n", cases[i].expression);
+
+        tmp = sy_generate_rpn_stack(expr_cpy, &error, &error_ptr);
+        expected = rpn_evaluate_stack(tmp, TEST_CASE_VARIABLE_VAL);
+
+        prog = prog_compile(tmp, expr_cpy, (int)strlen(expr_cpy), NULL);
+        loaded = (prog != NULL) ? prog_from_image(test_copy_image(prog), prog->image_size, &error) : NULL;
+
+        if (loaded == NULL)
+        {
+            printf("Load error: %i\n", error);
+            fail = 1;
+        }
+        else
+        {
+            res = prog_evaluate(loaded, TEST_CASE_VARIABLE_VAL);
+
+            /* values have to be exactly the same, including infinity and NaN */
+            if (memcmp(&res, &expected, sizeof(double)) != 0)
+                fail = 1;
+
+            /* block evaluation has to agree with scalar one */
+            variable = TEST_CASE_VARIABLE_VAL;
+            variables[0] = &variable;
+            prog_evaluate_block(loaded, variables, 1, &block_res);
+            if (memcmp(&block_res, &expected, sizeof(double)) != 0)
+                fail = 1;
+            /* x-dependency flag has to match the source */
+            if (((loaded->header->flags & PROG_FLAG_X_DEPENDENT) != 0) != (strchr(cases[i].expression, 'x') != NULL))
+                fail = 1;
+            if (loaded->header->source_length != strlen(cases[i].expression) || memcmp(loaded->source, cases[i].expression, loaded->header->source_length) != 0)
+                fail = 1;
+
+            printf("Result:     %f (expected %f)\n", res, expected);
+            prog_destroy(loaded);
+        }
+
+        if (prog != NULL)
+        {
+            /* damaged byte in the body */
+            image = (unsigned char*)test_copy_image(prog);
+            image[prog->image_size - 1] ^= 0x5A;
+            fail |= !test_load_image(image, prog->image_size, PROG_LOAD_CHECKSUM);
+
+            /* unknown version */
+            image = (unsigned char*)test_copy_image(prog);
+            ((prog_header*)image)->version = PROG_FORMAT_VERSION + 1;
+            fail |= !test_load_image(image, prog->image_size, PROG_LOAD_VERSION);
+
+            /* truncated image */
+            image = (unsigned char*)test_copy_image(prog);
+            fail |= !test_load_image(image, prog->image_size - 1, PROG_LOAD_FORMAT);
+
+            prog_destroy(prog);
+        }
+        else
+        {
+            fail = 1;
+        }
+
+        if (fail == 0)
+        {
+            printf("OK\n\n");
+            success++;
+        }
+        else
+        {
+            printf("FAILED\n\n");
+            failed++;
+        }
+
+        stck_destroy(tmp);
+        free(expr_cpy);
+    }
+
+    printf("Done.\nSuccess: %i\nFailed: %i\n\n", success, failed);
+
+    return (failed == 0) ? 0 : 1;
+}
+
+/* structure for storing cache test step */
+typedef struct
+{
+    const char* expression;
+    double expected_result;
+    int error;
+    long hits, canonical_hits, misses;      /* expected counters after the step */
+} cache_test_case;
+
+/* static array of cache test steps, processed in order using one cache (capacity 3) */
+static cache_test_case cache_cases[] = {
+    /* expression,      expected result, error, hits, canonical hits, misses */
+    { "2 * x",          3.0,        0,      0,  0,  1 },
+    { "2*x",            3.0,        0,      1,  0,  1 },
+    { " 2*  x ",        3.0,        0,      2,  0,  1 },
+    { "x*2",            3.0,        0,      2,  1,  2 },
+    { "x*2.0",          3.0,        0,      2,  2,  3 },
+    { "12",             12.0,       0,      2,  2,  4 },
+    { "1 2",            0.0,        10,     2,  2,  5 }, /* two values are not a program; space separates tokens, so it must not hit "12" */
+    { "5++4",           0.0,        3,      2,  2,  6 },
+    { "sin(x)",         0.997495,   0,      2,  2,  7 },
+    { "cos(x)",         0.070737,   0,      2,  2,  8 },
+    { "12",             12.0,       0,      2,  2,  9 }, /* evicted meanwhile, reused "2*x" got second chance */
+    { "2*x",            3.0,        0,      3,  2,  9 },
+};
+
+/* cache test function - verifies normalization, canonical ordering, counters and eviction */
+int test_cache(void)
+{
+    int i, size, error, fail, success, failed;
+    char *error_ptr, *expr_cpy;
+    expr_cache* cache;
+    cache_entry* entry;
+    cache_stats stats;
+    double res;
+
+    success = 0;
+    failed = 0;
+
+    cache = cache_create(3, 0, CACHE_CANONICAL_ORDER);
+
+    size = (int) (sizeof(cache_cases) / sizeof(cache_test_case));
+    for (i = 0; i < size; i++)
+    {
+        fail = 0;
+
+        expr_cpy = (char*)malloc(sizeof(char)*strlen(cache_cases[i].expression)+1);
+        strcpy(expr_cpy, cache_cases[i].expression);
+
+        printf("Cached:     %s\n", cache_cases[i].expression);
+
+        entry = cache_get(cache, expr_cpy, (int)strlen(expr_cpy), &error, &error_ptr);
+        if (error != cache_cases[i].error)
+            fail = 1;
+
+        if (entry != NULL)
+        {
+            res = prog_evaluate(entry->program, TEST_CASE_VARIABLE_VAL);
+            printf("Result:     %f (expected %f)\n", res, cache_cases[i].expected_result);
+            if (fabs(res - cache_cases[i].expected_result) > COMPARISON_EPSILON)
+                fail = 1;
+            cache_release(cache, entry);
+        }
+
+        cache_get_stats(cache, &stats);
+        printf("Counters:   %li/%li/%li (expected %li/%li/%li)\n", stats.hits, stats.canonical_hits, stats.misses,
+               cache_cases[i].hits, cache_cases[i].canonical_hits, cache_cases[i].misses);
+        if (stats.hits != cache_cases[i].hits || stats.canonical_hits != cache_cases[i].canonical_hits
+            || stats.misses != cache_cases[i].misses || stats.entries > 3)
+            fail = 1;
+
+        if (fail == 0)
+        {
+            printf("OK\n\n");
+            success++;
+        }
+        else
+        {
+            printf("FAILED\n\n");
+            failed++;
+        }
+
+        free(expr_cpy);
+    }
+
+    /* expression growing too long by inlining is reported as such, not as missing operand */
+    expr_cpy = (char*)malloc(sizeof(char)*strlen(TEST_CACHE_DEFINITION)+1);
+    strcpy(expr_cpy, TEST_CACHE_DEFINITION);
+    printf("Cached:     %s with %s\n", TEST_CACHE_INLINED, TEST_CACHE_DEFINITION);
+    entry = NULL;
+    if (uf_define(expr_cpy, &error_ptr) == SYNTAX_ERROR_NONE)
+        entry = cache_get(cache, TEST_CACHE_INLINED, (int)strlen(TEST_CACHE_INLINED), &error, &error_ptr);
+    else
+        error = SYNTAX_ERROR_NONE;
+    printf("Error:      %i (expected %i)\n", error, SYNTAX_ERROR_TOO_LONG);
+    if (entry == NULL && error == SYNTAX_ERROR_TOO_LONG)
+    {
+        printf("OK\n\n");
+        success++;
+    }
+    else
+    {
+        printf("FAILED\n\n");
+        failed++;
+        if (entry != NULL)
+            cache_release(cache, entry);
+    }
+    uf_clear();
+    free(expr_cpy);
+
+    cache_destroy(cache);
+
+    printf("Done.\nSuccess: %i\nFailed: %i\n\n", success, failed);
+
+    return (failed == 0) ? 0 : 1;
+}
+
+/* structure for storing incremental parsing test step */
+typedef struct
+{
+    int offset, deleted;                    /* edit position and number of deleted characters */
+    const char* inserted;                   /* inserted text */
+    const char* expected_text;              /* text after edit */
+    int error;                              /* expected error */
+    int groups_parsed;                      /* expected number of groups parsed again (-1 = do not check) */
+} inc_test_case;
+
+/* static array of incremental parsing test steps, applied in order to one session */
+static inc_test_case inc_cases[] = {
+    /* offset, deleted, inserted, expected text,                    error, parsed groups */
+    { 0,  0, "sin(x*(1+x))+(2*x)",  "sin(x*(1+x))+(2*x)",           0,  4 },
+    { 14, 1, "3",                   "sin(x*(1+x))+(3*x)",           0,  1 },    /* only the last group */
+    { 9,  1, "x^2",                 "sin(x*(1+x^2))+(3*x)",         0,  1 },    /* innermost group, parents keep programs */
+    { 18, 0, "-",                   "sin(x*(1+x^2))+(3*-x)",        0,  1 },
+    { 4,  0, "(",                   "sin((x*(1+x^2))+(3*-x)",       1,  -1 },   /* error, previous tree is kept */
+    { 4,  1, "",                    "sin(x*(1+x^2))+(3*-x)",        0,  0 },    /* back to the same text, nothing parsed */
+    { 0,  3, "cos",                 "cos(x*(1+x^2))+(3*-x)",        0,  1 },
+    { 20, 0, "+cos(x*(1+x^2))",     "cos(x*(1+x^2))+(3*-x+cos(x*(1+x^2)))", 0, 1 }, /* duplicate group reused */
+};
+
+/* incremental parsing test function - every edit is verified against full parse of resulting text */
+int test_incremental(void)
+{
+    double samples[TEST_INC_SAMPLES];
+    int i, j, size, error, error_offset, fail, success, failed;
+    c_stack *tmp;
+    char *error_ptr;
+    double *values, expected;
+    inc_session* session;
+
+    success = 0;
+    failed = 0;
+
+    for (i = 0; i < TEST_INC_SAMPLES; i++)
+        samples[i] = -2.0 + 4.0 * i / (TEST_INC_SAMPLES - 1);
+
+    session = inc_create(samples, TEST_INC_SAMPLES);
+
+    size = (int) (sizeof(inc_cases) / sizeof(inc_test_case));
+    for (i = 0; i < size; i++)
+    {
+        fail = 0;
+
+        error = inc_edit(session, inc_cases[i].offset, inc_cases[i].deleted, inc_cases[i].inserted, (int)strlen(inc_cases[i].inserted), &error_offset);
+
+        printf("Edited:     %s\n", session->text);
+        printf("Error:      %i (expected %i), parsed groups %i (expected %i), reused %i\n", error, inc_cases[i].error,
+               session->stats.groups_parsed, inc_cases[i].groups_parsed, session->stats.groups_reused);
+
+        if (strcmp(session->text, inc_cases[i].expected_text) != 0 || error != inc_cases[i].error)
+            fail = 1;
+        if (inc_cases[i].groups_parsed >= 0 && session->stats.groups_parsed != inc_cases[i].groups_parsed)
+            fail = 1;
+
+        /* compare all samples with full parse */
+        values = inc_values(session);
+        if (error == 0)
+        {
+            tmp = sy_generate_rpn_stack(session->text, &error, &error_ptr);
+            for (j = 0; j < TEST_INC_SAMPLES && values != NULL && tmp != NULL; j++)
+            {
+                expected = rpn_evaluate_stack(tmp, samples[j]);
+                if (fabs(values[j] - expected) > COMPARISON_EPSILON)
+                    fail = 1;
+            }
+            if (values == NULL || tmp == NULL)
+                fail = 1;
+            if (tmp != NULL)
+                stck_destroy(tmp);
+        }
+        else if (values != NULL)
+        {
+            fail = 1;
+        }
+
+        if (fail == 0)
+        {
+            printf("OK\n\n");
+            success++;
+        }
+        else
+        {
+            printf("FAILED\n\n");
+            failed++;
+        }
+    }
+
+    inc_destroy(session);
+
+    printf("Done.\nSuccess: %i\nFailed: %i\n\n", success, failed);
+
+    return (failed == 0) ? 0 : 1;
+}
+
+/* writes balanced tree of groups with leaves first..first+count-1 - the first leaf of the whole
+ * tree is "max(x,0)", leaf i is "x*i+1"; returns length of written text */
+static int test_inc_tree(char* text, int first, int count)
+{
+    int length;
+
+    if (count == 1)
+        return (first == 0) ? sprintf(text, "max(x,0)") : sprintf(text, "x*%i+1", first);
+
+    length = sprintf(text, "(");
+    length += test_inc_tree(text + length, first, count / 2);
+    length += sprintf(text + length, ")+(");
+    length += test_inc_tree(text + length, first + count / 2, count - count / 2);
+    length += sprintf(text + length, ")");
+
+    return length;
+}
+
+/* incremental parsing test of expression with many groups - an edit has to parse only the
+ * edited group, and the groups on the path to the root, which keep their program, evaluate
+ * only samples that changed */
+int test_incremental_large(void)
+{
+    double samples[TEST_INC_SAMPLES];
+    char* text;
+    int i, j, length, leaves, offset, error, error_offset, changed, fail, success, failed;
+    int expected_reused[2], expected_samples[2];
+    const char* replaced[2];
+    double start, build_time, edit_time, expected;
+    double* values;
+    inc_session* session;
+
+    success = 0;
+    failed = 0;
+
+    changed = 0;
+    for (i = 0; i < TEST_INC_SAMPLES; i++)
+    {
+        samples[i] = -2.0 + 4.0 * i / (TEST_INC_SAMPLES - 1);
+        if (samples[i] < 1.0)
+            changed++;
+    }
+
+    leaves = 1 << TEST_INC_DEPTH;
+    text = (char*)malloc(leaves * INC_SLOT_TEXT_SIZE * 2);
+    session = inc_create(samples, TEST_INC_SAMPLES);
+    if (text == NULL || session == NULL)
+    {
+        free(text);
+        if (session != NULL)
+            inc_destroy(session);
+        printf("FAILED\n\nDone.\nSuccess: 0\nFailed: 1\n\n");
+        return 1;
+    }
+
+    length = test_inc_tree(text, 0, leaves);
+
+    start = pool_wall_time();
+    error = inc_set_text(session, text, length, &error_offset);
+    build_time = pool_wall_time() - start;
+    printf("Built:      %i groups in %.3f ms\n\n", 2 * leaves - 1, build_time * 1000.0);
+
+    /* constant of one leaf changes all samples of the leaf and of groups on the path */
+    replaced[0] = "2";
+    expected_reused[0] = TEST_INC_DEPTH;
+    expected_samples[0] = (TEST_INC_DEPTH + 1) * TEST_INC_SAMPLES;
+    /* argument of max changes all samples of it and of the max, but the sum only where x < 1;
+     * the other argument is reused too */
+    replaced[1] = "1";
+    expected_reused[1] = TEST_INC_DEPTH + 1;
+    expected_samples[1] = 2 * TEST_INC_SAMPLES + TEST_INC_DEPTH * changed;
+
+    for (i = 0; i < 2 && error == SYNTAX_ERROR_NONE; i++)
+    {
+        fail = 0;
+
+        offset = (i == 0) ? (int)(strstr(session->text, "x*1000+1") - session->text) + 7 : (int)(strstr(session->text, "max(x,0)") - session->text) + 6;
+        start = pool_wall_time();
+        error = inc_edit(session, offset, 1, replaced[i], 1, &error_offset);
+        edit_time = pool_wall_time() - start;
+
+        printf("Edited:     %s at %i in %.3f ms\n", replaced[i], offset, edit_time * 1000.0);
+        printf("Groups:     parsed %i (expected 1), reused %i (expected %i), programs reused %i (expected %i)\n",
+               session->stats.groups_parsed, session->stats.groups_reused, expected_reused[i],
+               session->stats.programs_reused, TEST_INC_DEPTH + i);
+        printf("Samples:    %i (expected %i)\n", session->stats.samples_evaluated, expected_samples[i]);
+        if (error != SYNTAX_ERROR_NONE || session->stats.groups_parsed != 1 || session->stats.groups_reused != expected_reused[i]
+            || session->stats.programs_reused != TEST_INC_DEPTH + i || session->stats.samples_evaluated != expected_samples[i])
+            fail = 1;
+
+        /* the sum of leaves (one of them is "x*1000+2" now), the text is too long to be parsed as a whole */
+        values = inc_values(session);
+        for (j = 0; j < TEST_INC_SAMPLES && values != NULL; j++)
+        {
+            expected = ((samples[j] > (double)i) ? samples[j] : (double)i) + samples[j] * ((double)leaves * (leaves - 1) / 2) + leaves;
+            if (fabs(values[j] - expected) > COMPARISON_EPSILON)
+            {
+                printf("Sample %i: %f (expected %f)\n", j, values[j], expected);
+                fail = 1;
+            }
+        }
+        if (values == NULL)
+            fail = 1;
+
+        if (fail == 0)
+        {
+            printf("OK\n\n");
+            success++;
+        }
+        else
+        {
+            printf("FAILED\n\n");
+            failed++;
+        }
+    }
+
+    if (error != SYNTAX_ERROR_NONE)
+        failed++;
+
+    inc_destroy(session);
+    free(text);
+
+    printf("Done.\nSuccess: %i\nFailed: %i\n\n", success, failed);
+
+    return (failed == 0) ? 0 : 1;
+}
+
+/* structure for storing user defined function test step */
+typedef struct
+{
+    const char* text;                       /* definition (contains '=') or expression */
+    double expected_result;
+    int error;
+    int instructions;                       /* expected instruction count after inlining (-1 = do not check) */
+} def_test_case;
+
+/* static array of user defined function test steps, processed in order */
+static def_test_case def_cases[] = {
+    /* definition or expression,    expected result, error, instructions */
+    { "f(t) = t^2 + 1",             0.0,        0,      -1 },
+    { "f(x)",                       3.25,       0,      5 },
+    { "f(2)",                       5.0,        0,      1 },    /* folded to constant */
+    { "g(a, b) = a*f(b) - b",       0.0,        0,      -1 },
+    { "g(2, x)",                    5.0,        0,      9 },
+    { "g(f(1), (x+1)*2)",           47.0,       0,      -1 },
+    { "c() = 2*atan(1)",            0.0,        0,      -1 },
+    { "c()*x",                      2.356194,   0,      3 },
+    { "sinh(1)",                    1.175201,   0,      1 },    /* the longest function name matches */
+    { "h(t) = h(t-1)",              0.0,        13,     -1 },
+    { "f(t) = g(t, 1)",             0.0,        13,     -1 },   /* recursion through another function */
+    { "f(a, b) = a + b",            0.0,        12,     -1 },   /* callers expect one argument */
+    { "sin(t) = t",                 0.0,        12,     -1 },
+    { "k(t, t) = t",                0.0,        12,     -1 },
+    { "k(t) = t + x",               0.0,        6,      -1 },   /* only parameters may be used */
+    { "f(1, 2)",                    0.0,        11,     -1 },
+    { "sin()",                      0.0,        11,     -1 },
+    { "g(1,)",                      0.0,        10,     -1 },
+    { "g(1,,2)",                    0.0,        10,     -1 },
+    { "(1, 2)",                     0.0,        8,      -1 },
+    { "f(t) = 2*t",                 0.0,        0,      -1 },
+    { "g(2, x)",                    4.5,        0,      -1 },   /* redefinition affects callers */
+    { "s(t) = t < 0 ? -1 : 1",      0.0,        0,      -1 },
+    { "s(x - 2)*x",                 -1.5,       0,      -1 },
+    { "s(3)",                       1.0,        0,      1 },    /* folded to constant */
+    { "q(t) = sum(j, 1, t, j*t)",   0.0,        0,      -1 },
+    { "q(x + 0.5)",                 6.0,        0,      -1 },
+    { "sum(k, 1, 3, q(k))",         25.0,       0,      -1 },   /* index of inlined sum is nested in caller's one */
+};
+
+/* user defined function test function - verifies definitions, inlining and constant folding; every
+ * valid expression is also verified by incremental parsing (arguments are groups of their own) */
+int test_definitions(void)
+{
+    double sample = TEST_CASE_VARIABLE_VAL;
+    int i, size, error, error_offset, fail, success, failed;
+    c_stack *tmp;
+    char *error_ptr, *expr_cpy;
+    rpn_program *prog;
+    inc_session* session;
+    double res;
+
+    success = 0;
+    failed = 0;
+
+    session = inc_create(&sample, 1);
+
+    size = (int) (sizeof(def_cases) / sizeof(def_test_case));
+    for (i = 0; i < size; i++)
+    {
+        fail = 0;
+
+        expr_cpy = (char*)malloc(sizeof(char)*strlen(def_cases[i].text)+1);
+        strcpy(expr_cpy, def_cases[i].text);
+
+        if (strchr(expr_cpy, '=') != NULL)
+        {
+            printf("Definition: %s\n", def_cases[i].text);
+            error = uf_define(expr_cpy, &error_ptr);
+            printf("Error:      %i (expected %i)\n", error, def_cases[i].error);
+            if (error != def_cases[i].error)
+                fail = 1;
+        }
+        else
+        {
+            printf("Expression: %s\n", def_cases[i].text);
+            tmp = sy_generate_rpn_stack(expr_cpy, &error, &error_ptr);
+            printf("Error:      %i (expected %i)\n", error, def_cases[i].error);
+            if (error != def_cases[i].error)
+                fail = 1;
+
+            if (tmp != NULL && error == 0)
+            {
+                prog = prog_compile(tmp, expr_cpy, (int)strlen(expr_cpy), NULL);
+                if (prog != NULL)
+                {
+                    res = prog_evaluate(prog, TEST_CASE_VARIABLE_VAL);
+                    printf("Result:     %f (expected %f), instructions %u\n", res, def_cases[i].expected_result, prog->header->instruction_count);
+                    if (fabs(res - def_cases[i].expected_result) > COMPARISON_EPSILON)
+                        fail = 1;
+                    if (def_cases[i].instructions >= 0 && prog->header->instruction_count != (unsigned int)def_cases[i].instructions)
+                        fail = 1;
+                    prog_destroy(prog);
+                }
+                else
+                {
+                    fail = 1;
+                }
+
+                if (inc_set_text(session, expr_cpy, (int)strlen(expr_cpy), &error_offset) != 0
+                    || fabs(inc_values(session)[0] - def_cases[i].expected_result) > COMPARISON_EPSILON)
+                    fail = 1;
+            }
+
+            if (tmp != NULL)
+                stck_destroy(tmp);
+        }
+
+        if (fail == 0)
+        {
+            printf("OK\n\n");
+            success++;
+        }
+        else
+        {
+            printf("FAILED\n\n");
+            failed++;
+        }
+
+        free(expr_cpy);
+    }
+
+    inc_destroy(session);
+    uf_clear();
+
+    printf("Done.\nSuccess: %i\nFailed: %i\n\n", success, failed);
+
+    return (failed == 0) ? 0 : 1;
+}
+
+/* structure for storing grid evaluation test case */
+typedef struct
+{
+    const char* expression;
+    const char* variables[GRID_MAX_DIMENSIONS];     /* variable names, axis N belongs to variable N */
+    int variable_count;
+    grid_spec grid;
+    int error;                                      /* expected grid evaluation result */
+} grid_test_case;
+
+/* static array of grid evaluation test cases */
+static grid_test_case grid_cases[] = {
+    /* expression,      variables,          count, grid (dimensions, axes), error */
+    { "sin(x)*cos(y)+y", { "x", "y" },      2, { 2, { { -3.0, 3.0, 37 }, { -1.0, 2.0, 53 } } },                       0 },
+    { "x*y-z/2",        { "x", "y", "z" },  3, { 3, { { 0.0, 1.0, 5 }, { -2.0, 2.0, 7 }, { 0.0, 10.0, 300 } } },    0 },
+    { "x^2",            { "x", "y" },       2, { 2, { { -1.0, 1.0, 40 }, { 0.0, 0.0, 1 } } },                         0 },
+    { "y",              { "x", "y" },       2, { 1, { { 0.0, 1.0, 10 } } },                                            1 }, /* y has no axis */
+    { "alpha*beta",     { "alpha", "beta" }, 2, { 2, { { 1.0, 2.0, 3 }, { 1.0, 2.0, 2000 } } },                       0 },
+};
+
+/* structure for storing grid variable list test case */
+typedef struct
+{
+    const char* names[GRID_MAX_DIMENSIONS];
+    int count;
+    int duplicate;                                  /* expected index of repeated name, -1 if none */
+} grid_names_test_case;
+
+/* static array of grid variable list test cases */
+static grid_names_test_case grid_names_cases[] = {
+    /* variables,                   count, duplicate */
+    { { "x", "y" },                 2,      -1 },
+    { { "x", "x" },                 2,      1 },
+    { { "x", "y", "z", "y" },       4,      3 },
+    { { "alpha", "alph" },          2,      -1 },   /* prefix is a different name */
+};
+
+/**
+ * Helper function to compile expression, store it as version 1 image (the same as current one,
+ * just without variable count in header) and load it again; returns NULL and sets error on failure
+ */
+static rpn_program* test_load_v1_image(const char* expression, int* error)
+{
+    c_stack* tmp;
+    char *error_ptr, *expr_cpy;
+    rpn_program *prog, *loaded;
+    unsigned char* image;
+
+    expr_cpy = (char*)malloc(strlen(expression) + 1);
+    strcpy(expr_cpy, expression);
+
+    tmp = sy_generate_rpn_stack(expr_cpy, error, &error_ptr);
+    prog = prog_compile(tmp, expr_cpy, (int)strlen(expr_cpy), NULL);
+    image = (unsigned char*)malloc(prog->image_size);
+    memcpy(image, prog->image, PROG_HEADER_V1_SIZE);
+    memcpy(image + PROG_HEADER_V1_SIZE, (unsigned char*)prog->image + prog->header_size, prog->image_size - prog->header_size);
+    ((prog_header*)image)->version = 1;
+
+    loaded = prog_from_image(image, prog->image_size - prog->header_size + PROG_HEADER_V1_SIZE, error);
+    if (loaded == NULL)
+        free(image);
+
+    prog_destroy(prog);
+    stck_destroy(tmp);
+    free(expr_cpy);
+
+    return loaded;
+}
+
+/* grid evaluation test function - every sample is verified against scalar evaluation, and parallel
+ * evaluation has to give exactly the same values as serial one; also verifies image of more variables
+ * survives serialization, version 1 images are still loadable unless they contain newer opcodes,
+ * and repeated variable names are found */
+int test_grid(void)
+{
+    double coordinates[GRID_MAX_DIMENSIONS];
+    int i, d, size, error, fail, success, failed;
+    long j, count, rest;
+    c_stack *tmp;
+    char *error_ptr, *expr_cpy;
+    rpn_program *prog, *loaded;
+    thread_pool* pool;
+    double *serial, *parallel, expected;
+    const grid_axis* axis;
+
+    success = 0;
+    failed = 0;
+
+    pool = pool_create(3);
+
+    size = (int) (sizeof(grid_cases) / sizeof(grid_test_case));
+    for (i = 0; i < size; i++)
+    {
+        fail = 0;
+
+        expr_cpy = (char*)malloc(sizeof(char)*strlen(grid_cases[i].expression)+1);
+        strcpy(expr_cpy, grid_cases[i].expression);
+
+        printf("Grid:       %s\n", grid_cases[i].expression);
+
+        tmp = sy_generate_rpn_stack_vars(expr_cpy, (int)strlen(expr_cpy), 0, grid_cases[i].variables, grid_cases[i].variable_count, &error, &error_ptr);
+        prog = (tmp != NULL && error == 0) ? prog_compile(tmp, expr_cpy, (int)strlen(expr_cpy), NULL) : NULL;
+        count = grid_sample_count(&grid_cases[i].grid);
+
+        if (prog != NULL && count > 0)
+        {
+            serial = (double*)malloc(sizeof(double) * count);
+            parallel = (double*)malloc(sizeof(double) * count);
+
+            error = grid_evaluate(prog, &grid_cases[i].grid, serial, NULL);
+            printf("Error:      %i (expected %i), %li samples\n", error, grid_cases[i].error, count);
+            if (error != grid_cases[i].error)
+                fail = 1;
+
+            if (error == 0)
+            {
+                grid_evaluate(prog, &grid_cases[i].grid, parallel, pool);
+                if (memcmp(serial, parallel, sizeof(double) * count) != 0)
+                    fail = 1;
+
+                for (j = 0; j < count; j++)
+                {
+                    rest = j;
+                    for (d = grid_cases[i].grid.dimensions - 1; d >= 0; d--)
+                    {
+                        axis = &grid_cases[i].grid.axes[d];
+                        coordinates[d] = (axis->count > 1) ? axis->min + (axis->max - axis->min) * (rest % axis->count) / (axis->count - 1) : axis->min;
+                        rest /= axis->count;
+                    }
+
+                    expected = prog_evaluate_vars(prog, coordinates);
+                    if (fabs(serial[j] - expected) > COMPARISON_EPSILON)
+                        fail = 1;
+                }
+            }
+
+            /* program of more variables has to survive serialization */
+            loaded = prog_from_image(test_copy_image(prog), prog->image_size, &error);
+            if (loaded == NULL || loaded->variable_count != prog->variable_count)
+                fail = 1;
+            if (loaded != NULL)
+                prog_destroy(loaded);
+
+            free(serial);
+            free(parallel);
+        }
+        else
+        {
+            fail = 1;
+        }
+
+        if (fail == 0)
+        {
+            printf("OK\n\n");
+            success++;
+        }
+        else
+        {
+            printf("FAILED\n\n");
+            failed++;
+        }
+
+        if (prog != NULL)
+            prog_destroy(prog);
+        if (tmp != NULL)
+            stck_destroy(tmp);
+        free(expr_cpy);
+    }
+
+    pool_destroy(pool);
+
+    /* version 1 image - the same as current one, just without variable count in header */
+    fail = 0;
+    printf("Version 1:  2*x+1\n");
+
+    loaded = test_load_v1_image("2*x+1", &error);
+    if (loaded == NULL || loaded->variable_count != 1 || prog_evaluate(loaded, TEST_CASE_VARIABLE_VAL) != 4.0)
+        fail = 1;
+    if (loaded != NULL)
+        prog_destroy(loaded);
+
+    /* comparisons, conditionals and sums did not exist in version 1, so such image is damaged */
+    loaded = test_load_v1_image("x < 1", &error);
+    if (loaded != NULL || error != PROG_LOAD_FORMAT)
+        fail = 1;
+    if (loaded != NULL)
+        prog_destroy(loaded);
+
+    loaded = test_load_v1_image("sum(k, 1, 3, k)", &error);
+    if (loaded != NULL || error != PROG_LOAD_FORMAT)
+        fail = 1;
+    if (loaded != NULL)
+        prog_destroy(loaded);
+
+    if (fail == 0)
+    {
+        printf("OK\n\n");
+        success++;
+    }
+    else
+    {
+        printf("FAILED\n\n");
+        failed++;
+    }
+
+    /* every variable needs its own axis, so the names have to differ */
+    size = (int) (sizeof(grid_names_cases) / sizeof(grid_names_test_case));
+    for (i = 0; i < size; i++)
+    {
+        d = grid_find_duplicate(grid_names_cases[i].names, grid_names_cases[i].count);
+        printf("Variables:  %i, repeated %i (expected %i)\n", grid_names_cases[i].count, d, grid_names_cases[i].duplicate);
+        if (d == grid_names_cases[i].duplicate)
+        {
+            printf("OK\n\n");
+            success++;
+        }
+        else
+        {
+            printf("FAILED\n\n");
+            failed++;
+        }
+    }
+
+    printf("Done.\nSuccess: %i\nFailed: %i\n\n", success, failed);
+
+    return (failed == 0) ? 0 : 1;
+}
+
+/* static array of expressions with conditionals, evaluated in samples covering more blocks */
+static const char* conditional_cases[] = {
+    "x < 0 ? -x : x^2",
+    "if(x > -10, sin(x), ln(x))",                       /* the whole block takes the first branch */
+    "if(x > 10, ln(x), cos(x))",                        /* the whole block takes the second branch */
+    "x < -1 ? 1 : x < 1 ? x : 2",
+    "(x >= 0 ? 1 : -1) * (x == 0 ? 0 : 1) + min(x, 0)",
+    "if(x != 0, 1/x, 0) + (x > 2.5 ? 1 : 0 ? 2 : 3)",
+};
+
+/* conditional test function - block evaluation (which skips or selects branches) has to give exactly
+ * the same values as single value evaluation (which jumps over the branch not taken) */
+int test_conditionals(void)
+{
+    double samples[TEST_COND_SAMPLES], block[TEST_COND_SAMPLES];
+    double* variables[1];
+    int i, j, size, error, fail, success, failed;
+    c_stack *tmp;
+    char *error_ptr, *expr_cpy;
+    rpn_program *prog;
+
+    success = 0;
+    failed = 0;
+
+    /* zero is one of samples */
+    for (j = 0; j < TEST_COND_SAMPLES; j++)
+        samples[j] = -3.0 + 0.02 * j;
+    variables[0] = samples;
+
+    size = (int) (sizeof(conditional_cases) / sizeof(conditional_cases[0]));
+    for (i = 0; i < size; i++)
+    {
+        fail = 0;
+
+        expr_cpy = (char*)malloc(sizeof(char)*strlen(conditional_cases[i])+1);
+        strcpy(expr_cpy, conditional_cases[i]);
+
+        printf("Conditional: %s\n", conditional_cases[i]);
+
+        tmp = sy_generate_rpn_stack(expr_cpy, &error, &error_ptr);
+        prog = (tmp != NULL) ? prog_compile(tmp, expr_cpy, (int)strlen(expr_cpy), NULL) : NULL;
+
+        if (prog != NULL)
+        {
+            prog_evaluate_block(prog, variables, TEST_COND_SAMPLES, block);
+
+            for (j = 0; j < TEST_COND_SAMPLES; j++)
+            {
+                if (block[j] != prog_evaluate(prog, samples[j]))
+                    fail = 1;
+                if (fabs(block[j] - rpn_evaluate_stack(tmp, samples[j])) > COMPARISON_EPSILON)
+                    fail = 1;
+            }
+
+            prog_destroy(prog);
+        }
+        else
+        {
+            fail = 1;
+        }
+
+        if (fail == 0)
+        {
+            printf("OK\n\n");
+            success++;
+        }
+        else
+        {
+            printf("FAILED\n\n");
+            failed++;
+        }
+
+        if (tmp != NULL)
+            stck_destroy(tmp);
+        free(expr_cpy);
+    }
+
+    printf("Done.\nSuccess: %i\nFailed: %i\n\n", success, failed);
+
+    return (failed == 0) ? 0 : 1;
+}
+
+/* static array of expressions with sums and products, evaluated in samples covering more blocks */
+static const char* reduction_cases[] = {
+    "sum(k, 1, 20, x^k/k)",
+    "prod(k, 1, 5, 1 + x/k)",
+    "sum(k, 1, 3, sum(j, k, 4, j*k*x))",
+    "sum(k, 1, 4, k < x ? k : -k)",                     /* conditional selected in block of index values */
+    "sum(k, 1, x + 3, k)",                              /* range differs between samples */
+    "sum(k, 1, 10000, sin(k*x)/k^2)",                   /* more parts of range */
+    "sum(x, 1, 3, x)",                                  /* index shadows variable */
+};
+
+/* task of reduction test evaluating parallel sums of one sample from within pool task */
+typedef struct
+{
+    rpn_program* prog;                      /* evaluated program */
+    const double* samples;                  /* variable value of every task */
+    double* values;                         /* value of every task */
+    thread_pool* pool;                      /* pool running the tasks, passed to parallel evaluation too */
+} reduction_task;
+
+/* pool task routine of reduction test - nested parallel evaluation is processed serially */
+static void test_reduce_task(void* arg, int index)
+{
+    reduction_task* task = (reduction_task*)arg;
+
+    task->values[index] = prog_evaluate_parallel(task->prog, &task->samples[index], task->pool);
+}
+
+/* reduction test function - block evaluation, single value evaluation and parallel evaluation have to
+ * give exactly the same values, close to RPN evaluation (which sums in different order); parallel
+ * evaluation from within tasks of the same pool must give them as well */
+int test_reductions(void)
+{
+    double samples[TEST_REDUCE_SAMPLES], block[TEST_REDUCE_SAMPLES];
+    double* variables[1];
+    double nested[TEST_REDUCE_SAMPLES];
+    double value;
+    int i, j, size, error, fail, success, failed;
+    c_stack *tmp;
+    char *error_ptr, *expr_cpy;
+    rpn_program *prog;
+    thread_pool *pool;
+    reduction_task task;
+
+    success = 0;
+    failed = 0;
+
+    for (j = 0; j < TEST_REDUCE_SAMPLES; j++)
+        samples[j] = -2.0 + 0.1 * j;
+    variables[0] = samples;
+
+    pool = pool_create(3);
+
+    size = (int) (sizeof(reduction_cases) / sizeof(reduction_cases[0]));
+    for (i = 0; i <= size; i++)
+    {
+        fail = 0;
+
+        /* the last case has too many iterations, so it evaluates to NaN */
+        expr_cpy = (char*)malloc(sizeof(char)*strlen((i < size) ? reduction_cases[i] : "sum(k, 0, 1.0e9, 1)")+1);
+        strcpy(expr_cpy, (i < size) ? reduction_cases[i] : "sum(k, 0, 1.0e9, 1)");
+
+        printf("Reduction: %s\n", expr_cpy);
+
+        tmp = sy_generate_rpn_stack(expr_cpy, &error, &error_ptr);
+        prog = (tmp != NULL) ? prog_compile(tmp, expr_cpy, (int)strlen(expr_cpy), NULL) : NULL;
+
+        if (prog != NULL && i == size)
+        {
+            /* NaN is the only value not equal to itself */
+            value = prog_evaluate(prog, 0.0);
+            if (value == value)
+                fail = 1;
+            value = rpn_evaluate_stack(tmp, 0.0);
+            if (value == value)
+                fail = 1;
+
+            prog_destroy(prog);
+        }
+        else if (prog != NULL)
+        {
+            prog_evaluate_block(prog, variables, TEST_REDUCE_SAMPLES, block);
+
+            task.prog = prog;
+            task.samples = samples;
+            task.values = nested;
+            task.pool = pool;
+            pool_run(pool, test_reduce_task, &task, TEST_REDUCE_SAMPLES);
+
+            for (j = 0; j < TEST_REDUCE_SAMPLES; j++)
+            {
+                value = prog_evaluate(prog, samples[j]);
+                if (block[j] != value || prog_evaluate_parallel(prog, &samples[j], pool) != value || nested[j] != value)
+                    fail = 1;
+                if (fabs(block[j] - rpn_evaluate_stack(tmp, samples[j])) > COMPARISON_EPSILON)
+                    fail = 1;
+            }
+
+            prog_destroy(prog);
+        }
+        else
+        {
+            fail = 1;
+        }
+
+        if (fail == 0)
+        {
+            printf("OK\n\n");
+            success++;
+        }
+        else
+        {
+            printf("FAILED\n\n");
+            failed++;
+        }
+
+        if (tmp != NULL)
+            stck_destroy(tmp);
+        free(expr_cpy);
+    }
+
+    pool_destroy(pool);
+
+    printf("Done.\nSuccess: %i\nFailed: %i\n\n", success, failed);
+
+    return (failed == 0) ? 0 : 1;
+}
+
+/* static array of expressions sampled for plot, some of them with values out of limits or NaN */
+static const char* sampling_cases[] = {
+    "sin(x)*x",
+    "1/x",
+    "ln(x)",
+    "x^3 - 4*x",
+    "sum(k, 1, 50, sin(k*x)/k)",
+    "exp(-x)",                  /* the first samples are out of limits */
+};
+
+/* parallel sampling test function - values and indexes of minimum and maximum have to be the same
+ * for any number of threads, and the same as if samples were processed one by one */
+int test_sampling(void)
+{
+    double limits[4] = { -10.0, 10.0, -5.0, 5.0 };
+    double *serial, *parallel, *x_values, step;
+    int i, j, size, error, fail, success, failed;
+    int fmin, fmax, pmin, pmax;
+    c_stack *tmp;
+    char *error_ptr, *expr_cpy;
+    rpn_program *prog;
+    thread_pool *pool;
+
+    success = 0;
+    failed = 0;
+
+    step = (limits[1] - limits[0]) / (TEST_SAMPLING_COUNT - 1);
+    x_values = (double*)malloc(sizeof(double) * TEST_SAMPLING_COUNT);
+    serial = (double*)malloc(sizeof(double) * TEST_SAMPLING_COUNT);
+    parallel = (double*)malloc(sizeof(double) * TEST_SAMPLING_COUNT);
+    pool = pool_create(4);
+
+    size = (int) (sizeof(sampling_cases) / sizeof(sampling_cases[0]));
+    for (i = 0; i < size; i++)
+    {
+        fail = 0;
+
+        expr_cpy = (char*)malloc(sizeof(char)*strlen(sampling_cases[i])+1);
+        strcpy(expr_cpy, sampling_cases[i]);
+
+        printf("Sampling: %s\n", sampling_cases[i]);
+
+        tmp = sy_generate_rpn_stack(expr_cpy, &error, &error_ptr);
+        prog = (tmp != NULL) ? prog_compile(tmp, expr_cpy, (int)strlen(expr_cpy), NULL) : NULL;
+
+        if (prog != NULL)
+        {
+            drawing_sample(prog, limits, x_values, serial, TEST_SAMPLING_COUNT, NULL, &fmin, &fmax);
+            drawing_sample(prog, limits, x_values, parallel, TEST_SAMPLING_COUNT, pool, &pmin, &pmax);
+
+            if (memcmp(serial, parallel, sizeof(double) * TEST_SAMPLING_COUNT) != 0 || fmin != pmin || fmax != pmax)
+                fail = 1;
+
+            /* reference - samples processed one by one (the first one may be out of limits) */
+            pmin = -1;
+            pmax = -1;
+            for (j = 0; j < TEST_SAMPLING_COUNT; j++)
+            {
+                if (x_values[j] != limits[0] + j * step || (serial[j] != prog_evaluate(prog, x_values[j]) && serial[j] == serial[j]))
+                    fail = 1;
+
+                if (serial[j] <= limits[3] && (pmax < 0 || serial[j] > serial[pmax]))
+                    pmax = j;
+                if (serial[j] >= limits[2] && (pmin < 0 || serial[j] < serial[pmin]))
+                    pmin = j;
+            }
+            if (fmin != ((pmin < 0) ? 0 : pmin) || fmax != ((pmax < 0) ? 0 : pmax))
+                fail = 1;
+
+            prog_destroy(prog);
+        }
+        else
+        {
+            fail = 1;
+        }
+
+        if (fail == 0)
+        {
+            printf("OK\n\n");
+            success++;
+        }
+        else
+        {
+            printf("FAILED\n\n");
+            failed++;
+        }
+
+        if (tmp != NULL)
+            stck_destroy(tmp);
+        free(expr_cpy);
+    }
+
+    pool_destroy(pool);
+    free(x_values);
+    free(serial);
+    free(parallel);
+
+    printf("Done.\nSuccess: %i\nFailed: %i\n\n", success, failed);
+
+    return (failed == 0) ? 0 : 1;
+}
+
+/* structure for storing adaptive sampling test case */
+typedef struct
+{
+    const char* expression;
+    int max_samples;                        /* expected maximum number of samples */
+    int accurate;                           /* the samples have to describe function accurately everywhere */
+} adaptive_test_case;
+
+/* static array of adaptive sampling test cases */
+static adaptive_test_case adaptive_cases[] = {
+    /* expression,                  samples,                accurate */
+    { "2*x + 1",                    256,                    1 },        /* refined only where it leaves the plot */
+    { "x^2/10 - 3",                 1000,                   1 },
+    { "sin(x)*3",                   1000,                   1 },
+    { "ln(x)",                      1000,                   0 },        /* NaN for negative values */
+    { "1/x",                        2000,                   0 },
+    { "sin(1/x)*4",                 TEST_SAMPLING_COUNT,    0 },        /* uses all evaluations */
+};
+
+/* adaptive sampling test function - samples have to be sorted, evaluated correctly, the same for any
+ * number of threads, and their linear interpolation has to be close to the function */
+int test_adaptive_sampling(void)
+{
+    double limits[4] = { -10.0, 10.0, -5.0, 5.0 };
+    double *x_values, *values, *px_values, *pvalues;
+    double x, expected, interpolated;
+    int i, j, k, size, count, pcount, error, fail, success, failed;
+    int fmin, fmax, pmin, pmax;
+    c_stack *tmp;
+    char *error_ptr, *expr_cpy;
+    rpn_program *prog;
+    thread_pool *pool;
+
+    success = 0;
+    failed = 0;
+
+    x_values = (double*)malloc(sizeof(double) * TEST_SAMPLING_COUNT);
+    values = (double*)malloc(sizeof(double) * TEST_SAMPLING_COUNT);
+    px_values = (double*)malloc(sizeof(double) * TEST_SAMPLING_COUNT);
+    pvalues = (double*)malloc(sizeof(double) * TEST_SAMPLING_COUNT);
+    pool = pool_create(4);
+
+    size = (int) (sizeof(adaptive_cases) / sizeof(adaptive_test_case));
+    for (i = 0; i < size; i++)
+    {
+        fail = 0;
+
+        expr_cpy = (char*)malloc(sizeof(char)*strlen(adaptive_cases[i].expression)+1);
+        strcpy(expr_cpy, adaptive_cases[i].expression);
+
+        printf("Adaptive sampling: %s\n", adaptive_cases[i].expression);
+
+        tmp = sy_generate_rpn_stack(expr_cpy, &error, &error_ptr);
+        prog = (tmp != NULL) ? prog_compile(tmp, expr_cpy, (int)strlen(expr_cpy), NULL) : NULL;
+
+        if (prog != NULL)
+        {
+            count = drawing_sample_adaptive(prog, limits, x_values, values, TEST_SAMPLING_COUNT, NULL, &fmin, &fmax);
+            pcount = drawing_sample_adaptive(prog, limits, px_values, pvalues, TEST_SAMPLING_COUNT, pool, &pmin, &pmax);
+
+            printf("Samples:    %i (at most %i expected)\n", count, adaptive_cases[i].max_samples);
+
+            if (count != pcount || fmin != pmin || fmax != pmax || count > adaptive_cases[i].max_samples
+                || memcmp(x_values, px_values, sizeof(double) * count) != 0 || memcmp(values, pvalues, sizeof(double) * count) != 0)
+                fail = 1;
+
+            if (count < 2 || x_values[0] != limits[0] || x_values[count - 1] != limits[1])
+                fail = 1;
+
+            for (j = 0; j < count && fail == 0; j++)
+            {
+                if ((j > 0 && x_values[j] <= x_values[j - 1])
+                    || (values[j] != prog_evaluate(prog, x_values[j]) && values[j] == values[j]))
+                    fail = 1;
+            }
+
+            /* compare linear interpolation of samples with function in uniformly distributed points */
+            for (j = 0, k = 0; j < TEST_SAMPLING_COUNT && adaptive_cases[i].accurate && fail == 0; j++)
+            {
+                x = limits[0] + j * (limits[1] - limits[0]) / (TEST_SAMPLING_COUNT - 1);
+                while (k < count - 2 && x_values[k + 1] < x)
+                    k++;
+
+                expected = prog_evaluate(prog, x);
+                interpolated = values[k] + (values[k + 1] - values[k]) * (x - x_values[k]) / (x_values[k + 1] - x_values[k]);
+                if (fabs(expected - interpolated) * (DRAW_Y_END - DRAW_Y_BEGIN) / (limits[3] - limits[2]) > TEST_ADAPTIVE_TOLERANCE)
+                    fail = 1;
+            }
+
+            prog_destroy(prog);
+        }
+        else
+        {
+            fail = 1;
+        }
+
+        if (fail == 0)
+        {
+            printf("OK\n\n");
+            success++;
+        }
+        else
+        {
+            printf("FAILED\n\n");
+            failed++;
+        }
+
+        if (tmp != NULL)
+            stck_destroy(tmp);
+        free(expr_cpy);
+    }
+
+    pool_destroy(pool);
+    free(x_values);
+    free(values);
+    free(px_values);
+    free(pvalues);
+
+    printf("Done.\nSuccess: %i\nFailed: %i\n\n", success, failed);
+
+    return (failed == 0) ? 0 : 1;
+}
+
+/* structure for storing decimation test case */
+typedef struct
+{
+    const char* expression;                 /* y coordinate as function of x coordinate (in device units) */
+    long count;                             /* number of points fed to decimation */
+} decimation_test_case;
+
+/* static array of decimation test cases; points with |y| > 250 are left out (pen is lifted) */
+static decimation_test_case decimation_cases[] = {
+    { "sin(x*3)*200",                   1000000 },
+    { "x",                              100000 },
+    { "sin(x/20)*300",                  200000 },      /* leaves the range repeatedly */
+    { "sin(x*7)*100 + x/10",            300 },         /* less points than columns */
+};
+
+/* polyline collected by test sink */
+typedef struct
+{
+    poly_point* points;
+    int* commands;
+    long count;
+    long capacity;
+} test_polyline;
+
+/**
+ * Test sink - stores polyline commands (context is test_polyline structure)
+ */
+static void test_polyline_sink(void* context, int command, double x, double y)
+{
+    test_polyline* line = (test_polyline*)context;
+
+    if (line->count >= line->capacity)
+        return;
+
+    line->points[line->count].x = x;
+    line->points[line->count].y = y;
+    line->points[line->count].index = line->count;
+    line->commands[line->count] = command;
+    line->count++;
+}
+
+/**
+ * Finds minimal and maximal Y coordinate of polyline points in every pixel column
+ */
+static void test_column_extremes(const test_polyline* line, double* col_min, double* col_max, int columns)
+{
+    int i, column;
+
+    for (i = 0; i < columns; i++)
+    {
+        col_min[i] = 1e300;
+        col_max[i] = -1e300;
+    }
+
+    for (i = 0; i < line->count; i++)
+    {
+        if (line->commands[i] == POLY_END)
+            continue;
+        column = (int)floor((line->points[i].x - DRAW_X_BEGIN) / POLY_COLUMN_WIDTH);
+        if (line->points[i].y < col_min[column])
+            col_min[column] = line->points[i].y;
+        if (line->points[i].y > col_max[column])
+            col_max[column] = line->points[i].y;
+    }
+}
+
+/* decimation test function - decimated polyline has to keep the same pixel columns extremes,
+ * ends and pen moves, and has to have at most 4 points per column */
+int test_decimation(void)
+{
+    test_polyline input, output;
+    poly_decimator decimator;
+    double *in_min, *in_max, *out_min, *out_max;
+    double x, y;
+    int i, size, error, fail, success, failed, columns, inside, in_moves, out_moves;
+    long j;
+    c_stack *tmp;
+    char *error_ptr, *expr_cpy;
+    rpn_program *prog;
+
+    success = 0;
+    failed = 0;
+
+    columns = (int)((DRAW_X_END - DRAW_X_BEGIN) / POLY_COLUMN_WIDTH) + 1;
+    in_min = (double*)malloc(sizeof(double) * columns);
+    in_max = (double*)malloc(sizeof(double) * columns);
+    out_min = (double*)malloc(sizeof(double) * columns);
+    out_max = (double*)malloc(sizeof(double) * columns);
+
+    size = (int) (sizeof(decimation_cases) / sizeof(decimation_test_case));
+    for (i = 0; i < size; i++)
+    {
+        fail = 0;
+
+        expr_cpy = (char*)malloc(sizeof(char)*strlen(decimation_cases[i].expression)+1);
+        strcpy(expr_cpy, decimation_cases[i].expression);
+
+        printf("Decimation: %s, %li points\n", decimation_cases[i].expression, decimation_cases[i].count);
+
+        tmp = sy_generate_rpn_stack(expr_cpy, &error, &error_ptr);
+        prog = (tmp != NULL) ? prog_compile(tmp, expr_cpy, (int)strlen(expr_cpy), NULL) : NULL;
+
+        if (prog != NULL)
+        {
+            /* every point and command is stored twice - pen is lifted at most once per point */
+            input.capacity = decimation_cases[i].count * 2;
+            input.points = (poly_point*)malloc(sizeof(poly_point) * input.capacity);
+            input.commands = (int*)malloc(sizeof(int) * input.capacity);
+            input.count = 0;
+            output.capacity = input.capacity;
+            output.points = (poly_point*)malloc(sizeof(poly_point) * output.capacity);
+            output.commands = (int*)malloc(sizeof(int) * output.capacity);
+            output.count = 0;
+
+            poly_decimator_init(&decimator, DRAW_X_BEGIN, POLY_COLUMN_WIDTH, test_polyline_sink, &output);
+
+            inside = 0;
+            for (j = 0; j < decimation_cases[i].count; j++)
+            {
+                x = DRAW_X_BEGIN + (DRAW_X_END - DRAW_X_BEGIN) * j / (decimation_cases[i].count - 1);
+                y = prog_evaluate(prog, x);
+
+                if (fabs(y) > 250.0)
+                {
+                    if (inside)
+                    {
+                        test_polyline_sink(&input, POLY_END, 0, 0);
+                        poly_decimate(&decimator, POLY_END, 0, 0);
+                    }
+                    inside = 0;
+                    continue;
+                }
+
+                test_polyline_sink(&input, inside ? POLY_DRAW : POLY_MOVE, x, y);
+                poly_decimate(&decimator, inside ? POLY_DRAW : POLY_MOVE, x, y);
+                inside = 1;
+            }
+            if (inside)
+            {
+                test_polyline_sink(&input, POLY_END, 0, 0);
+                poly_decimate(&decimator, POLY_END, 0, 0);
+            }
+
+            printf("Points:     %li -> %li\n", decimator.points_in, decimator.points_out);
+
+            /* the same polylines with the same ends */
+            in_moves = 0;
+            out_moves = 0;
+            for (j = 0; j < input.count; j++)
+                in_moves += (input.commands[j] == POLY_MOVE) ? 1 : 0;
+            for (j = 0; j < output.count; j++)
+            {
+                out_moves += (output.commands[j] == POLY_MOVE) ? 1 : 0;
+                if (j > 0 && output.commands[j] != POLY_END && output.commands[j - 1] != POLY_END
+                    && output.points[j].x < output.points[j - 1].x)
+                    fail = 1;
+            }
+            /* at most first, last, minimum and maximum of every column (the column may be split by pen move) */
+            if (decimator.points_out > 4 * (columns + in_moves) || decimator.points_out > decimator.points_in
+                || output.count == output.capacity)
+                fail = 1;
+
+            if (in_moves != out_moves || input.count < 2 || output.count < 2
+                || output.points[0].x != input.points[0].x || output.points[0].y != input.points[0].y
+                || output.points[output.count - 2].x != input.points[input.count - 2].x
+                || output.points[output.count - 2].y != input.points[input.count - 2].y)
+                fail = 1;
+
+            /* the same pixels covered */
+            test_column_extremes(&input, in_min, in_max, columns);
+            test_column_extremes(&output, out_min, out_max, columns);
+            if (memcmp(in_min, out_min, sizeof(double) * columns) != 0 || memcmp(in_max, out_max, sizeof(double) * columns) != 0)
+                fail = 1;
+
+            free(input.points);
+            free(input.commands);
+            free(output.points);
+            free(output.commands);
+            prog_destroy(prog);
+        }
+        else
+        {
+            fail = 1;
+        }
+
+        if (fail == 0)
+        {
+            printf("OK\n\n");
+            success++;
+        }
+        else
+        {
+            printf("FAILED\n\n");
+            failed++;
+        }
+
+        if (tmp != NULL)
+            stck_destroy(tmp);
+        free(expr_cpy);
+    }
+
+    free(in_min);
+    free(in_max);
+    free(out_min);
+    free(out_max);
+
+    printf("Done.\nSuccess: %i\nFailed: %i\n\n", success, failed);
+
+    return (failed == 0) ? 0 : 1;
+}
+
+/* structure for storing simplification test case */
+typedef struct
+{
+    const char* expression;                 /* y coordinate as function of x coordinate (in device units) */
+    long count;                             /* number of points fed to simplification */
+    long max_points;                        /* expected maximum number of points passed on */
+} simplification_test_case;
+
+/* static array of simplification test cases; points with |y| > 250 are left out (pen is lifted) */
+static simplification_test_case simplification_cases[] = {
+    { "x/3 - 100",                      10000,      11 },       /* straight line, vertex kept at end of every window */
+    { "sin(x/40)*200",                  3000,       200 },
+    { "sin(x/20)*300",                  5000,       300 },      /* leaves the range repeatedly */
+    { "sin(x*3)*200",                   2000,       2000 },     /* nothing to simplify */
+    { "(x - 300)^2/200 - 200",          100000,     400 },
+};
+
+/**
+ * Verifies, that simplified polyline is subsequence of the original one with the same pen moves,
+ * and every removed point is not farther than tolerance from the simplified line (x has to increase)
+ */
+static int test_check_simplified(const test_polyline* input, const test_polyline* output, double tolerance)
+{
+    long i, j;
+    double dx, dy, t, px, py;
+    const poly_point *a, *b;
+
+    j = 0;
+    for (i = 0; i < input->count; i++)
+    {
+        if (j >= output->count)
+            return 1;
+
+        if (input->commands[i] == POLY_END || input->commands[i] == POLY_MOVE || input->points[i].x == output->points[j].x)
+        {
+            if (input->commands[i] != output->commands[j]
+                || (input->commands[i] != POLY_END && (input->points[i].x != output->points[j].x || input->points[i].y != output->points[j].y)))
+                return 1;
+            j++;
+            continue;
+        }
+
+        /* removed point lies between previous and next kept point */
+        a = &output->points[j - 1];
+        b = &output->points[j];
+        if (output->commands[j] != POLY_DRAW || b->x < input->points[i].x)
+            return 1;
+
+        dx = b->x - a->x;
+        dy = b->y - a->y;
+        px = input->points[i].x - a->x;
+        py = input->points[i].y - a->y;
+        t = (px * dx + py * dy) / (dx * dx + dy * dy);
+        t = (t < 0.0) ? 0.0 : ((t > 1.0) ? 1.0 : t);
+        if (sqrt((px - t * dx) * (px - t * dx) + (py - t * dy) * (py - t * dy)) > tolerance)
+            return 1;
+    }
+
+    return (j == output->count) ? 0 : 1;
+}
+
+/* simplification test function - simplified polyline has to be close to the original one, and
+ * has to have less points */
+int test_simplification(void)
+{
+    test_polyline input, output;
+    poly_simplifier* simplifier;
+    double x, y;
+    int i, size, error, fail, success, failed, inside;
+    long j;
+    c_stack *tmp;
+    char *error_ptr, *expr_cpy;
+    rpn_program *prog;
+
+    success = 0;
+    failed = 0;
+
+    /* the structure holds whole window, do not place it on stack */
+    simplifier = (poly_simplifier*)malloc(sizeof(poly_simplifier));
+
+    size = (int) (sizeof(simplification_cases) / sizeof(simplification_test_case));
+    for (i = 0; i < size; i++)
+    {
+        fail = 0;
+
+        expr_cpy = (char*)malloc(sizeof(char)*strlen(simplification_cases[i].expression)+1);
+        strcpy(expr_cpy, simplification_cases[i].expression);
+
+        printf("Simplification: %s, %li points\n", simplification_cases[i].expression, simplification_cases[i].count);
+
+        tmp = sy_generate_rpn_stack(expr_cpy, &error, &error_ptr);
+        prog = (tmp != NULL) ? prog_compile(tmp, expr_cpy, (int)strlen(expr_cpy), NULL) : NULL;
+
+        if (prog != NULL)
+        {
+            input.capacity = simplification_cases[i].count * 2;
+            input.points = (poly_point*)malloc(sizeof(poly_point) * input.capacity);
+            input.commands = (int*)malloc(sizeof(int) * input.capacity);
+            input.count = 0;
+            output.capacity = input.capacity;
+            output.points = (poly_point*)malloc(sizeof(poly_point) * output.capacity);
+            output.commands = (int*)malloc(sizeof(int) * output.capacity);
+            output.count = 0;
+
+            poly_simplifier_init(simplifier, POLY_SIMPLIFY_TOLERANCE, test_polyline_sink, &output);
+
+            inside = 0;
+            for (j = 0; j < simplification_cases[i].count; j++)
+            {
+                x = DRAW_X_BEGIN + (DRAW_X_END - DRAW_X_BEGIN) * j / (simplification_cases[i].count - 1);
+                y = prog_evaluate(prog, x);
+
+                if (fabs(y) > 250.0)
+                {
+                    if (inside)
+                    {
+                        test_polyline_sink(&input, POLY_END, 0, 0);
+                        poly_simplify(simplifier, POLY_END, 0, 0);
+                    }
+                    inside = 0;
+                    continue;
+                }
+
+                test_polyline_sink(&input, inside ? POLY_DRAW : POLY_MOVE, x, y);
+                poly_simplify(simplifier, inside ? POLY_DRAW : POLY_MOVE, x, y);
+                inside = 1;
+            }
+            if (inside)
+            {
+                test_polyline_sink(&input, POLY_END, 0, 0);
+                poly_simplify(simplifier, POLY_END, 0, 0);
+            }
+
+            printf("Points:     %li -> %li (at most %li expected)\n", simplifier->points_in, simplifier->points_out,
+                simplification_cases[i].max_points);
+
+            if (simplifier->points_out > simplification_cases[i].max_points || output.count == output.capacity
+                || test_check_simplified(&input, &output, POLY_SIMPLIFY_TOLERANCE) != 0)
+                fail = 1;
+
+            free(input.points);
+            free(input.commands);
+            free(output.points);
+            free(output.commands);
+            prog_destroy(prog);
+        }
+        else
+        {
+            fail = 1;
+        }
+
+        if (fail == 0)
+        {
+            printf("OK\n\n");
+            success++;
+        }
+        else
+        {
+            printf("FAILED\n\n");
+            failed++;
+        }
+
+        if (tmp != NULL)
+            stck_destroy(tmp);
+        free(expr_cpy);
+    }
+
+    free(simplifier);
+
+    printf("Done.\nSuccess: %i\nFailed: %i\n\n", success, failed);
+
+    return (failed == 0) ? 0 : 1;
+}
+
+/* streamed sampling test function - extremes found by streaming pre-pass have to be the same
+ * as extremes of all samples held in memory, for any number of threads */
+int test_streaming(void)
+{
+    double limits[4] = { -10.0, 10.0, -5.0, 5.0 };
+    double *x_values, *eval_values;
+    drawing_extremes serial, parallel;
+    int i, size, error, fail, success, failed, fmin, fmax;
+    c_stack *tmp;
+    char *error_ptr, *expr_cpy;
+    rpn_program *prog;
+    thread_pool *pool;
+
+    success = 0;
+    failed = 0;
+
+    x_values = (double*)malloc(sizeof(double) * TEST_STREAM_COUNT);
+    eval_values = (double*)malloc(sizeof(double) * TEST_STREAM_COUNT);
+    pool = pool_create(4);
+
+    size = (int) (sizeof(sampling_cases) / sizeof(const char*));
+    for (i = 0; i < size; i++)
+    {
+        fail = 0;
+
+        expr_cpy = (char*)malloc(sizeof(char)*strlen(sampling_cases[i])+1);
+        strcpy(expr_cpy, sampling_cases[i]);
+
+        printf("Streaming: %s\n", sampling_cases[i]);
+
+        tmp = sy_generate_rpn_stack(expr_cpy, &error, &error_ptr);
+        prog = (tmp != NULL) ? prog_compile(tmp, expr_cpy, (int)strlen(expr_cpy), NULL) : NULL;
+
+        if (prog != NULL)
+        {
+            drawing_sample(prog, limits, x_values, eval_values, TEST_STREAM_COUNT, NULL, &fmin, &fmax);
+
+            if (drawing_sample_extremes(prog, limits, TEST_STREAM_COUNT, NULL, &serial) == 0
+                || drawing_sample_extremes(prog, limits, TEST_STREAM_COUNT, pool, &parallel) == 0)
+                fail = 1;
+            else
+            {
+                printf("Minimum:    %f in %f\n", serial.min_value, serial.min_x);
+                printf("Maximum:    %f in %f\n", serial.max_value, serial.max_x);
+
+                if (memcmp(&serial, &parallel, sizeof(drawing_extremes)) != 0
+                    || serial.min_x != x_values[fmin] || serial.max_x != x_values[fmax]
+                    || (serial.min_value != eval_values[fmin] && serial.min_value == serial.min_value)
+                    || (serial.max_value != eval_values[fmax] && serial.max_value == serial.max_value))
+                    fail = 1;
+            }
+
+            prog_destroy(prog);
+        }
+        else
+        {
+            fail = 1;
+        }
+
+        if (fail == 0)
+        {
+            printf("OK\n\n");
+            success++;
+        }
+        else
+        {
+            printf("FAILED\n\n");
+            failed++;
+        }
+
+        if (tmp != NULL)
+            stck_destroy(tmp);
+        free(expr_cpy);
+    }
+
+    pool_destroy(pool);
+    free(x_values);
+    free(eval_values);
+
+    printf("Done.\nSuccess: %i\nFailed: %i\n\n", success, failed);
+
+    return (failed == 0) ? 0 : 1;
+}
+
+/* structure for storing discontinuity test case */
+typedef struct
+{
+    const char* expression;
+    int samples;                            /* number of uniform samples */
+    int polylines;                          /* expected number of polylines */
+    double begin, end;                      /* expected position of the first and the last point (NaN = do not check) */
+} discontinuity_test_case;
+
+/* static array of discontinuity test cases, plotted in limits -10:10:-5:5 */
+static discontinuity_test_case discontinuity_cases[] = {
+    { "1/x",                    200,    2,      -10.0,      10.0 },
+    { "tan(x)",                 200,    7,      NAN,        NAN },      /* poles in odd multiples of pi/2 */
+    { "cotan(x)",               201,    8,      NAN,        NAN },      /* sample in pole 0 */
+    { "tan(x)",                 30,     7,      NAN,        NAN },      /* coarse sampling */
+    { "(4 - x^2)^0.5*2",        200,    1,      -2.0,       2.0 },      /* ends of domain */
+    { "ln(x)",                  200,    1,      0.006738,   10.0 },     /* crosses the bottom edge in exp(-5) */
+    { "atan(x*1000)*3",         200,    1,      -10.0,      10.0 },     /* steep, but continuous */
+    { "x^3*1000",               200,    1,      NAN,        NAN },      /* steep through whole plot */
+    { "if(x < 1, -3, 3)",       200,    2,      -10.0,      10.0 },     /* jump */
+};
+
+/* discontinuity test function - plot of function has to be split exactly in poles, jumps and edges
+ * of domain, and its segments have to follow the function */
+int test_discontinuities(void)
+{
+    double limits[4] = { -10.0, 10.0, -5.0, 5.0 };
+    double *x_values, *eval_values;
+    double step_coef, val_coef, x, expected, chord;
+    test_polyline output;
+    int i, j, size, error, fail, success, failed, fmin, fmax, polylines;
+    c_stack *tmp;
+    char *error_ptr, *expr_cpy;
+    rpn_program *prog;
+
+    success = 0;
+    failed = 0;
+
+    step_coef = (DRAW_X_END - DRAW_X_BEGIN) / (limits[1] - limits[0]);
+    val_coef = (DRAW_Y_END - DRAW_Y_BEGIN) / (limits[3] - limits[2]);
+
+    size = (int) (sizeof(discontinuity_cases) / sizeof(discontinuity_test_case));
+    for (i = 0; i < size; i++)
+    {
+        fail = 0;
+
+        expr_cpy = (char*)malloc(sizeof(char)*strlen(discontinuity_cases[i].expression)+1);
+        strcpy(expr_cpy, discontinuity_cases[i].expression);
+
+        printf("Discontinuity: %s, %i samples\n", discontinuity_cases[i].expression, discontinuity_cases[i].samples);
+
+        tmp = sy_generate_rpn_stack(expr_cpy, &error, &error_ptr);
+        prog = (tmp != NULL) ? prog_compile(tmp, expr_cpy, (int)strlen(expr_cpy), NULL) : NULL;
+
+        if (prog != NULL)
+        {
+            x_values = (double*)malloc(sizeof(double) * discontinuity_cases[i].samples);
+            eval_values = (double*)malloc(sizeof(double) * discontinuity_cases[i].samples);
+            output.capacity = discontinuity_cases[i].samples * 4;
+            output.points = (poly_point*)malloc(sizeof(poly_point) * output.capacity);
+            output.commands = (int*)malloc(sizeof(int) * output.capacity);
+            output.count = 0;
+
+            drawing_sample(prog, limits, x_values, eval_values, discontinuity_cases[i].samples, NULL, &fmin, &fmax);
+            drawing_trace(prog, limits, x_values, eval_values, discontinuity_cases[i].samples, test_polyline_sink, &output);
+
+            polylines = 0;
+            for (j = 0; j < output.count; j++)
+            {
+                if (output.commands[j] == POLY_MOVE)
+                    polylines++;
+
+                /* function in the middle of every segment has to be near its chord */
+                if (output.commands[j] != POLY_DRAW)
+                    continue;
+
+                x = limits[0] + ((output.points[j].x + output.points[j - 1].x) / 2 - DRAW_X_BEGIN) / step_coef;
+                expected = DRAW_Y_BEGIN + (prog_evaluate(prog, x) - limits[2]) * val_coef;
+                chord = (output.points[j].y + output.points[j - 1].y) / 2;
+                if (output.points[j].x != output.points[j - 1].x && !(fabs(expected - chord) < (DRAW_Y_END - DRAW_Y_BEGIN) / 4))
+                    fail = 1;
+            }
+
+            printf("Polylines:  %i (%i expected)\n", polylines, discontinuity_cases[i].polylines);
+
+            if (polylines != discontinuity_cases[i].polylines || output.count == output.capacity || output.count < 2)
+                fail = 1;
+            else if ((discontinuity_cases[i].begin == discontinuity_cases[i].begin
+                      && fabs(output.points[0].x - (DRAW_X_BEGIN + (discontinuity_cases[i].begin - limits[0]) * step_coef)) > 0.01)
+                     || (discontinuity_cases[i].end == discontinuity_cases[i].end
+                      && fabs(output.points[output.count - 2].x - (DRAW_X_BEGIN + (discontinuity_cases[i].end - limits[0]) * step_coef)) > 0.01))
+                fail = 1;
+
+            free(x_values);
+            free(eval_values);
+            free(output.points);
+            free(output.commands);
+            prog_destroy(prog);
+        }
+        else
+        {
+            fail = 1;
+        }
+
+        if (fail == 0)
+        {
+            printf("OK\n\n");
+            success++;
+        }
+        else
+        {
+            printf("FAILED\n\n");
+            failed++;
+        }
+
+        if (tmp != NULL)
+            stck_destroy(tmp);
+        free(expr_cpy);
+    }
+
+    printf("Done.\nSuccess: %i\nFailed: %i\n\n", success, failed);
+
+    return (failed == 0) ? 0 : 1;
+}
+
+/* structure for storing test case of functions evaluated together */
+typedef struct
+{
+    const char* expressions;                /* functions separated by ';' */
+    int shared;                             /* expected number of shared subexpressions */
+} multi_test_case;
+
+/* static array of test cases of functions evaluated together */
+static multi_test_case multi_cases[] = {
+    { "x^3 - 2*x",                                      0 },
+    { "sin(x)^2;sin(x)^2 + cos(x)",                     1 },    /* sin(x) is evaluated only within sin(x)^2 */
+    { "sin(x)*cos(x);cos(x)*2;sin(x) + 1",              2 },
+    { "x^2 + 1;x^2 + 2;(x^2 + 1)*3",                    1 },    /* the whole function is shared */
+    { "sum(k, 1, 5, sin(x)*k) + sin(x);sin(x)",         1 },    /* shared subexpression in sum body */
+    { "sum(k, 1, 5, k*x);sum(k, 1, 5, k*x)*2",          0 },    /* sums are never shared */
+    { "if(x < 0, (-x)^0.5, x^0.5);x^0.5 + (-x)^0.5",   2 },    /* NaN values */
+    { "tan(x);1/x",                                     0 },
+};
+
+/* test function of functions evaluated together - values have to be exactly the same as values of
+ * functions compiled and evaluated separately */
+int test_multi(void)
+{
+    double samples[TEST_MULTI_SAMPLES], block[MULTI_MAX_FUNCTIONS][TEST_MULTI_SAMPLES];
+    double* outputs[MULTI_MAX_FUNCTIONS];
+    char* expressions[MULTI_MAX_FUNCTIONS];
+    c_stack* parsed[MULTI_MAX_FUNCTIONS];
+    rpn_program* separate[MULTI_MAX_FUNCTIONS];
+    double value;
+    int i, j, f, count, size, error, fail, success, failed;
+    char *error_ptr, *expr_cpy, *separator;
+    multi_program *multi;
+
+    success = 0;
+    failed = 0;
+
+    for (j = 0; j < TEST_MULTI_SAMPLES; j++)
+        samples[j] = -3.0 + 0.02 * j;
+    for (f = 0; f < MULTI_MAX_FUNCTIONS; f++)
+        outputs[f] = block[f];
+
+    size = (int) (sizeof(multi_cases) / sizeof(multi_test_case));
+    for (i = 0; i < size; i++)
+    {
+        fail = 0;
+
+        expr_cpy = (char*)malloc(sizeof(char)*strlen(multi_cases[i].expressions)+1);
+        strcpy(expr_cpy, multi_cases[i].expressions);
+
+        printf("Functions: %s\n", multi_cases[i].expressions);
+
+        count = 1;
+        expressions[0] = expr_cpy;
+        while ((separator = strchr(expressions[count - 1], ';')) != NULL)
+        {
+            *separator = '\0';
+            expressions[count++] = separator + 1;
+        }
+
+        for (f = 0; f < count; f++)
+        {
+            parsed[f] = sy_generate_rpn_stack(expressions[f], &error, &error_ptr);
+            separate[f] = (parsed[f] != NULL) ? prog_compile(parsed[f], expressions[f], (int)strlen(expressions[f]), NULL) : NULL;
+            if (separate[f] == NULL)
+                fail = 1;
+        }
+
+        multi = (fail == 0) ? multi_compile(parsed, expressions, count, 0) : NULL;
+
+        if (multi != NULL)
+        {
+            printf("Shared:    %i (%i expected)\n", multi->shared_count, multi_cases[i].shared);
+            if (multi->shared_count != multi_cases[i].shared || multi->count != count)
+                fail = 1;
+
+            multi_evaluate_block(multi, samples, TEST_MULTI_SAMPLES, outputs);
+
+            /* NaN is the only value not equal to itself */
+            for (f = 0; f < count; f++)
+            {
+                for (j = 0; j < TEST_MULTI_SAMPLES; j++)
+                {
+                    value = prog_evaluate(separate[f], samples[j]);
+                    if (block[f][j] != value && (block[f][j] == block[f][j] || value == value))
+                        fail = 1;
+                    if (multi_evaluate(multi, f, samples[j]) != value && value == value)
+                        fail = 1;
+                }
+            }
+
+            multi_destroy(multi);
+        }
+        else
+        {
+            fail = 1;
+        }
+
+        for (f = 0; f < count; f++)
+        {
+            if (parsed[f] != NULL)
+                stck_destroy(parsed[f]);
+            if (separate[f] != NULL)
+                prog_destroy(separate[f]);
+        }
+
+        if (fail == 0)
+        {
+            printf("OK\n\n");
+            success++;
+        }
+        else
+        {
+            printf("FAILED\n\n");
+            failed++;
+        }
+
+        free(expr_cpy);
+    }
+
+    printf("Done.\nSuccess: %i\nFailed: %i\n\n", success, failed);
+
+    return (failed == 0) ? 0 : 1;
+}
+
+/* structure for storing test case of function with parameter */
+typedef struct
+{
+    const char* expression;                 /* function of x and parameter a */
+    int shared;                             /* expected number of shared subexpressions */
+} parameter_test_case;
+
+/* static array of test cases of function with parameter */
+static parameter_test_case parameter_cases[] = {
+    { "sin(a*x)",                                       0 },
+    { "sin(x)*exp(-a/4)",                               1 },    /* evaluated once for bound value */
+    { "a^2*x + a^2",                                    1 },
+    { "sum(k, 1, 4, a*k*x) + cos(a)",                   1 },    /* sum is never shared */
+    { "if(a < 1, x, -x) + sin(x)*sin(x)",               2 },
+};
+
+/* test function of function with parameter - values have to be exactly the same as values of
+ * function of two variables, for every bound parameter value, also for more bound copies */
+int test_parameters(void)
+{
+    double samples[TEST_MULTI_SAMPLES], block[TEST_MULTI_SAMPLES], variables[2];
+    double parameter_values[3] = { -1.5, 0.5, 2.0 };
+    double* outputs[1];
+    char* expressions[1];
+    const char* names[2] = { "x", "a" };
+    multi_program frame;
+    double value;
+    int i, j, k, size, error, fail, success, failed;
+    c_stack *tmp;
+    char *error_ptr, *expr_cpy;
+    rpn_program *prog;
+    multi_program *multi;
+
+    success = 0;
+    failed = 0;
+
+    for (j = 0; j < TEST_MULTI_SAMPLES; j++)
+        samples[j] = -3.0 + 0.02 * j;
+    outputs[0] = block;
+
+    size = (int) (sizeof(parameter_cases) / sizeof(parameter_test_case));
+    for (i = 0; i < size; i++)
+    {
+        fail = 0;
+
+        expr_cpy = (char*)malloc(sizeof(char)*strlen(parameter_cases[i].expression)+1);
+        strcpy(expr_cpy, parameter_cases[i].expression);
+        expressions[0] = expr_cpy;
+
+        printf("Parameter: %s\n", parameter_cases[i].expression);
+
+        tmp = sy_generate_rpn_stack_vars(expr_cpy, (int)strlen(expr_cpy), 0, names, 2, &error, &error_ptr);
+        prog = (tmp != NULL) ? prog_compile(tmp, expr_cpy, (int)strlen(expr_cpy), NULL) : NULL;
+        multi = (prog != NULL) ? multi_compile(&tmp, expressions, 1, 1) : NULL;
+
+        if (multi != NULL)
+        {
+            printf("Shared:    %i (%i expected)\n", multi->shared_count, parameter_cases[i].shared);
+            if (multi->shared_count != parameter_cases[i].shared)
+                fail = 1;
+
+            for (k = 0; k < 3; k++)
+            {
+                /* the copy is bound, the original keeps its values */
+                frame = *multi;
+                multi_bind(&frame, &parameter_values[k]);
+                multi_evaluate_block(&frame, samples, TEST_MULTI_SAMPLES, outputs);
+
+                variables[1] = parameter_values[k];
+                for (j = 0; j < TEST_MULTI_SAMPLES; j++)
+                {
+                    variables[0] = samples[j];
+                    value = prog_evaluate_vars(prog, variables);
+                    if (block[j] != value || multi_evaluate(&frame, 0, samples[j]) != value)
+                        fail = 1;
+                }
+            }
+
+            if (multi->parameters[0] != 0.0)
+                fail = 1;
+
+            multi_destroy(multi);
+        }
+        else
+        {
+            fail = 1;
+        }
+
+        if (prog != NULL)
+            prog_destroy(prog);
+
+        if (fail == 0)
+        {
+            printf("OK\n\n");
+            success++;
+        }
+        else
+        {
+            printf("FAILED\n\n");
+            failed++;
+        }
+
+        if (tmp != NULL)
+            stck_destroy(tmp);
+        free(expr_cpy);
+    }
+
+    printf("Done.\nSuccess: %i\nFailed: %i\n\n", success, failed);
+
+    return (failed == 0) ? 0 : 1;
+}
+
+/* structure for storing test case of raster line */
+typedef struct
+{
+    double x0, y0, x1, y1;                  /* line ends (page units) */
+    double width;                           /* line width (page units) */
+    double on_x, on_y;                      /* point on the line, (partially) covered by line color */
+    double off_x, off_y;                    /* point away from the line, left white */
+} raster_test_case;
+
+/* static array of test cases of raster lines */
+static raster_test_case raster_cases[] = {
+    { 25, 300, 570, 300,        1,      300, 300,       300, 310 },     /* horizontal */
+    { 300, 25, 300, 570,        2,      300, 100,       296, 100 },     /* vertical */
+    { 25, 25, 570, 570,         1,      200, 200,       200, 210 },     /* diagonal */
+    { 100, 100, 110, 590,       0.5,    105, 345,       115, 345 },     /* steep, thin */
+    { -100, 50, 700, 60,        3,      310, 55,        310, 45 },      /* out of image */
+};
+
+/**
+ * Retrieves pixel of image at supplied page coordinates
+ */
+static const unsigned char* test_raster_pixel(const raster_image* img, double x, double y)
+{
+    int col = (int)(x * img->scale);
+    int row = (int)(img->height - y * img->scale);
+
+    return img->pixels + ((size_t)row * img->width + col) * 3;
+}
+
+/* test function of raster output - lines have to cover the pixels on them in their color and leave
+ * the other ones white, bands rendered in parallel have to give the same image as serial rendering,
+ * and PNG encoding has to produce valid chunk structure, compressed or stored */
+int test_raster(void)
+{
+    static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    const unsigned char* pixel;
+    unsigned char* serial;
+    unsigned char* png;
+    unsigned long noise;
+    long png_size, raw_size, i;
+    int j, size, fail, success, failed;
+    raster_image* img;
+    thread_pool* pool;
+
+    success = 0;
+    failed = 0;
+
+    pool = pool_create(3);
+
+    size = (int) (sizeof(raster_cases) / sizeof(raster_test_case));
+    for (j = 0; j < size; j++)
+    {
+        fail = 0;
+
+        printf("Raster:    line %g:%g - %g:%g, width %g\n", raster_cases[j].x0, raster_cases[j].y0,
+               raster_cases[j].x1, raster_cases[j].y1, raster_cases[j].width);
+
+        img = raster_create(TEST_RASTER_SIZE, TEST_RASTER_SIZE + 7);
+        serial = (unsigned char*)malloc((size_t)TEST_RASTER_SIZE * (TEST_RASTER_SIZE + 7) * 3);
+        if (img == NULL || serial == NULL)
+        {
+            printf("FAILED\n\n");
+            failed++;
+            if (img != NULL)
+                raster_destroy(img);
+            free(serial);
+            continue;
+        }
+
+        raster_set_color(img, 0, 0, 1);
+        raster_set_line_width(img, raster_cases[j].width);
+        raster_move_to(img, raster_cases[j].x0, raster_cases[j].y0);
+        raster_line_to(img, raster_cases[j].x1, raster_cases[j].y1);
+        raster_set_color(img, 0, 0, 0);
+        raster_move_to(img, 30, 600);
+        raster_text(img, "f(x) = -1.5e+10");
+
+        raster_render(img, NULL);
+        memcpy(serial, img->pixels, (size_t)TEST_RASTER_SIZE * (TEST_RASTER_SIZE + 7) * 3);
+        raster_render(img, pool);
+        if (memcmp(serial, img->pixels, (size_t)TEST_RASTER_SIZE * (TEST_RASTER_SIZE + 7) * 3) != 0)
+        {
+            printf("Parallel rendering differs\n");
+            fail = 1;
+        }
+
+        pixel = test_raster_pixel(img, raster_cases[j].on_x, raster_cases[j].on_y);
+        if (pixel[2] != 255 || pixel[0] != pixel[1] || pixel[0] > TEST_RASTER_COVERED)
+            fail = 1;
+        printf("On line:   %i %i %i\n", pixel[0], pixel[1], pixel[2]);
+
+        pixel = test_raster_pixel(img, raster_cases[j].off_x, raster_cases[j].off_y);
+        if (pixel[0] != 255 || pixel[1] != 255 || pixel[2] != 255)
+            fail = 1;
+        printf("Off line:  %i %i %i\n", pixel[0], pixel[1], pixel[2]);
+
+        /* the last case is encoded from noise, which cannot be compressed by runs */
+        if (j == size - 1)
+        {
+            noise = 12345;
+            for (i = 0; i < (long)TEST_RASTER_SIZE * (TEST_RASTER_SIZE + 7) * 3; i++)
+            {
+                noise = (noise * 1103515245UL + 12345UL) & 0xFFFFFFFFUL;
+                img->pixels[i] = (unsigned char)(noise >> 16);
+            }
+        }
+
+        raw_size = ((long)TEST_RASTER_SIZE * 3 + 1) * (TEST_RASTER_SIZE + 7);
+        png = raster_encode_png(img, &png_size);
+        if (png != NULL)
+        {
+            printf("PNG size:  %li (%li raw)\n", png_size, raw_size);
+            /* signature, IHDR of image size, IDAT starting with zlib header, and IEND at the end */
+            if (memcmp(png, signature, 8) != 0 || memcmp(png + 12, "IHDR", 4) != 0 || png[18] * 256 + png[19] != TEST_RASTER_SIZE
+                || png[22] * 256 + png[23] != TEST_RASTER_SIZE + 7 || memcmp(png + 37, "IDAT", 4) != 0 || png[41] != 0x78
+                || memcmp(png + png_size - 8, "IEND", 4) != 0)
+                fail = 1;
+            /* noise is stored (block type 0), plot is compressed (block type 1) */
+            if (((png[43] >> 1) & 3) != ((j == size - 1) ? 0 : 1))
+                fail = 1;
+            if (j < size - 1 && png_size * 4 > raw_size)
+                fail = 1;
+            free(png);
+        }
+        else
+        {
+            fail = 1;
+        }
+
+        if (fail == 0)
+        {
+            printf("OK\n\n");
+            success++;
+        }
+        else
+        {
+            printf("FAILED\n\n");
+            failed++;
+        }
+
+        free(serial);
+        raster_destroy(img);
+    }
+
+    pool_destroy(pool);
+
+    printf("Done.\nSuccess: %i\nFailed: %i\n\n", success, failed);
+
+    return (failed == 0) ? 0 : 1;
+}
+
+/* structure for storing test case of heatmap */
+typedef struct
+{
+    const char* expression;                 /* function of x and y */
+    double limits[4];                       /* xmin, xmax, ymin, ymax */
+    int width, height;                      /* heatmap size */
+} heatmap_test_case;
+
+/* static array of test cases of heatmaps */
+static heatmap_test_case heatmap_cases[] = {
+    { "sin(x)*cos(y)",          { -3, 3, -3, 3 },       97, 61 },
+    { "x^2 + y^2",              { -1, 2, -2, 1 },       64, 64 },
+    { "ln(x*y)",                { -2, 2, -2, 2 },       50, 40 },       /* half of pixels out of domain */
+    { "y",                      { 0, 1, -5, 5 },        3, 33 },
+};
+
+/* test function of heatmaps - values evaluated by tiles in parallel have to be the same as
+ * evaluated one by one in pixel centers; colorization by more colormaps reuses the values and has
+ * to be the same for serial and parallel run; the smallest value is black and the largest one white
+ * in gray colormap */
+int test_heatmap(void)
+{
+    double variables[2];
+    const char* names[2] = { "y", "x" };
+    unsigned char *serial, *parallel, *pixel;
+    double *values_copy;
+    double value;
+    long count, k;
+    int i, j, size, error, fail, success, failed, gray, jet, contours;
+    c_stack *tmp;
+    char *error_ptr, *expr_cpy;
+    rpn_program *prog;
+    heat_map *map;
+    thread_pool *pool;
+
+    success = 0;
+    failed = 0;
+
+    pool = pool_create(3);
+    gray = heat_find_colormap("gray");
+    jet = heat_find_colormap("jet");
+
+    size = (int) (sizeof(heatmap_cases) / sizeof(heatmap_test_case));
+    for (i = 0; i < size; i++)
+    {
+        fail = 0;
+
+        expr_cpy = (char*)malloc(sizeof(char)*strlen(heatmap_cases[i].expression)+1);
+        strcpy(expr_cpy, heatmap_cases[i].expression);
+
+        printf("Heatmap:   %s (%i x %i)\n", heatmap_cases[i].expression, heatmap_cases[i].width, heatmap_cases[i].height);
+
+        tmp = sy_generate_rpn_stack_vars(expr_cpy, (int)strlen(expr_cpy), 0, names, 2, &error, &error_ptr);
+        prog = (tmp != NULL) ? prog_compile(tmp, expr_cpy, (int)strlen(expr_cpy), NULL) : NULL;
+        map = (prog != NULL) ? heat_evaluate(prog, heatmap_cases[i].limits, heatmap_cases[i].width, heatmap_cases[i].height, pool) : NULL;
+
+        count = (long)heatmap_cases[i].width * heatmap_cases[i].height;
+        serial = (unsigned char*)malloc(count * 3);
+        parallel = (unsigned char*)malloc(count * 3);
+        values_copy = (double*)malloc(sizeof(double) * count);
+
+        if (map != NULL && serial != NULL && parallel != NULL && values_copy != NULL && gray >= 0 && jet >= 0)
+        {
+            /* pixel centers, the top row first */
+            for (j = 0; j < count; j++)
+            {
+                variables[0] = heatmap_cases[i].limits[3] - (j / map->width + 0.5) * (heatmap_cases[i].limits[3] - heatmap_cases[i].limits[2]) / map->height;
+                variables[1] = heatmap_cases[i].limits[0] + (j % map->width + 0.5) * (heatmap_cases[i].limits[1] - heatmap_cases[i].limits[0]) / map->width;
+                value = prog_evaluate_vars(prog, variables);
+                if (fabs(value - map->values[j]) > COMPARISON_EPSILON && !(value != value && map->values[j] != map->values[j]))
+                    fail = 1;
+            }
+            printf("Range:     %g .. %g\n", map->min, map->max);
+
+            memcpy(values_copy, map->values, sizeof(double) * count);
+
+            heat_colorize(map, jet, 0, serial, NULL);
+            heat_colorize(map, jet, 0, parallel, pool);
+            if (memcmp(serial, parallel, count * 3) != 0)
+                fail = 1;
+
+            /* the same values, other colormap */
+            heat_colorize(map, gray, 0, parallel, pool);
+            if (memcmp(serial, parallel, count * 3) == 0 || memcmp(values_copy, map->values, sizeof(double) * count) != 0)
+                fail = 1;
+
+            for (k = 0; k < count; k++)
+            {
+                pixel = parallel + k * 3;
+                if ((map->values[k] == map->min && pixel[0] != 0) || (map->values[k] == map->max && pixel[0] != 255)
+                    || pixel[0] != pixel[1] || pixel[1] != pixel[2])
+                    fail = 1;
+            }
+
+            /* contours are black pixels, there's none in gray colormap otherwise (except the minimum) */
+            heat_colorize(map, gray, 8, parallel, pool);
+            contours = 0;
+            for (k = 0; k < count; k++)
+            {
+                if (parallel[k * 3] == 0 && map->values[k] != map->min)
+                    contours++;
+            }
+            printf("Contours:  %i pixels\n", contours);
+            if (contours == 0)
+                fail = 1;
+        }
+        else
+        {
+            fail = 1;
+        }
+
+        if (fail == 0)
+        {
+            printf("OK\n\n");
+            success++;
+        }
+        else
+        {
+            printf("FAILED\n\n");
+            failed++;
+        }
+
+        if (map != NULL)
+            heat_destroy(map);
+        if (prog != NULL)
+            prog_destroy(prog);
+        if (tmp != NULL)
+            stck_destroy(tmp);
+        free(serial);
+        free(parallel);
+        free(values_copy);
+        free(expr_cpy);
+    }
+
+    pool_destroy(pool);
+
+    printf("Done.\nSuccess: %i\nFailed: %i\n\n", success, failed);
+
+    return (failed == 0) ? 0 : 1;
+}
+
+/* structure for storing test case of implicit curve */
+typedef struct
+{
+    const char* expression;                 /* function of x and y, the curve is F(x, y) = 0 */
+    double limits[4];                       /* xmin, xmax, ymin, ymax */
+    int coarse, depth, flags;               /* quadtree */
+    int paths, closed;                      /* expected number of polylines and closed ones among them */
+} implicit_test_case;
+
+/* static array of test cases of implicit curves */
+static implicit_test_case implicit_cases[] = {
+    { "x^2 + y^2 - 4",                  { -3, 3, -3, 3 },   16, 4, 0,                       1, 1 },
+    { "x^2 + y^2 - 4",                  { -3, 3, -3, 3 },   16, 4, IMPL_FLAG_CENTER_CHECK,  1, 1 },
+    { "y - sin(x)",                     { -5, 5, -3, 3 },   8, 5, 0,                        1, 0 },
+    { "x*y - 1",                        { -3, 3, -3, 3 },   32, 3, 0,                       2, 0 },
+    { "x^2/9 + y^2 - 1",                { -4, 4, -2, 2 },   4, 6, 0,                        1, 1 },
+    { "(x-0.5)^2 + (y-0.5)^2 - 0.01",   { -2, 2, -2, 2 },   4, 5, 0,                        0, 0 },     /* between coarse corners */
+    { "(x-0.5)^2 + (y-0.5)^2 - 0.01",   { -2, 2, -2, 2 },   4, 5, IMPL_FLAG_CENTER_CHECK,   1, 1 },     /* found by center */
+    { "ln(1 - x^2 - y^2) + 1",          { -2, 2, -2, 2 },   16, 4, 0,                       1, 1 },     /* out of domain around */
+};
+
+/* test function of implicit curves - the traced points have to lay on the curve (the function is
+ * almost zero there), segments have to be chained to expected number of polylines, the result has
+ * to be the same for serial and parallel run, and the quadtree has to evaluate far less points than
+ * the dense grid of the same resolution */
+int test_implicit(void)
+{
+    double variables[2];
+    const char* names[2] = { "x", "y" };
+    test_polyline serial, parallel;
+    impl_stats serial_stats, parallel_stats;
+    double value, max_error, dense;
+    long k, start;
+    int i, size, error, fail, success, failed, res, paths, closed;
+    c_stack *tmp;
+    char *error_ptr, *expr_cpy;
+    rpn_program *prog;
+    thread_pool *pool;
+
+    success = 0;
+    failed = 0;
+
+    pool = pool_create(3);
+    serial.capacity = parallel.capacity = TEST_IMPLICIT_POINTS;
+    serial.points = (poly_point*)malloc(sizeof(poly_point) * TEST_IMPLICIT_POINTS);
+    serial.commands = (int*)malloc(sizeof(int) * TEST_IMPLICIT_POINTS);
+    parallel.points = (poly_point*)malloc(sizeof(poly_point) * TEST_IMPLICIT_POINTS);
+    parallel.commands = (int*)malloc(sizeof(int) * TEST_IMPLICIT_POINTS);
+
+    size = (int) (sizeof(implicit_cases) / sizeof(implicit_test_case));
+    for (i = 0; i < size; i++)
+    {
+        fail = 0;
+
+        expr_cpy = (char*)malloc(sizeof(char)*strlen(implicit_cases[i].expression)+1);
+        strcpy(expr_cpy, implicit_cases[i].expression);
+
+        printf("Implicit:  %s = 0 (%i cells, depth %i%s)\n", implicit_cases[i].expression, implicit_cases[i].coarse,
+               implicit_cases[i].depth, (implicit_cases[i].flags & IMPL_FLAG_CENTER_CHECK) ? ", centers" : "");
+
+        tmp = sy_generate_rpn_stack_vars(expr_cpy, (int)strlen(expr_cpy), 0, names, 2, &error, &error_ptr);
+        prog = (tmp != NULL) ? prog_compile(tmp, expr_cpy, (int)strlen(expr_cpy), NULL) : NULL;
+
+        if (prog != NULL && serial.points != NULL && serial.commands != NULL && parallel.points != NULL && parallel.commands != NULL)
+        {
+            serial.count = 0;
+            parallel.count = 0;
+            res = impl_trace(prog, implicit_cases[i].limits, implicit_cases[i].coarse, implicit_cases[i].depth,
+                             implicit_cases[i].flags, NULL, test_polyline_sink, &serial, &serial_stats);
+            res |= impl_trace(prog, implicit_cases[i].limits, implicit_cases[i].coarse, implicit_cases[i].depth,
+                              implicit_cases[i].flags, pool, test_polyline_sink, &parallel, &parallel_stats);
+
+            /* the same polylines in the same order */
+            if (res != 0 || serial.count != parallel.count || serial.count >= TEST_IMPLICIT_POINTS
+                || memcmp(serial.points, parallel.points, sizeof(poly_point) * serial.count) != 0
+                || memcmp(serial.commands, parallel.commands, sizeof(int) * serial.count) != 0
+                || memcmp(&serial_stats, &parallel_stats, sizeof(impl_stats)) != 0)
+                fail = 1;
+
+            paths = 0;
+            closed = 0;
+            start = 0;
+            max_error = 0;
+            for (k = 0; k < serial.count; k++)
+            {
+                if (serial.commands[k] == POLY_END)
+                {
+                    paths++;
+                    if (k - start > 3 && serial.points[start].x == serial.points[k - 1].x && serial.points[start].y == serial.points[k - 1].y)
+                        closed++;
+                    start = k + 1;
+                    continue;
+                }
+
+                variables[0] = serial.points[k].x;
+                variables[1] = serial.points[k].y;
+                value = prog_evaluate_vars(prog, variables);
+                if (!(fabs(value) <= max_error))
+                    max_error = fabs(value);
+            }
+
+            dense = (double)(implicit_cases[i].coarse << implicit_cases[i].depth) + 1;
+            dense *= dense;
+            printf("Traced:    %li segments in %i paths (%i closed), max |F| %g\n", serial_stats.segments, paths, closed, max_error);
+            printf("Evaluated: %li of %.0f points\n", serial_stats.points, dense);
+
+            if (paths != implicit_cases[i].paths || closed != implicit_cases[i].closed || paths != serial_stats.paths
+                || !(max_error <= TEST_IMPLICIT_TOLERANCE) || serial_stats.points * 4 > dense)
+                fail = 1;
+        }
+        else
+        {
+            fail = 1;
+        }
+
+        if (fail == 0)
+        {
+            printf("OK\n\n");
+            success++;
+        }
+        else
+        {
+            printf("FAILED\n\n");
+            failed++;
+        }
+
+        if (prog != NULL)
+            prog_destroy(prog);
+        if (tmp != NULL)
+            stck_destroy(tmp);
+        free(expr_cpy);
+    }
+
+    free(serial.points);
+    free(serial.commands);
+    free(parallel.points);
+    free(parallel.commands);
+    pool_destroy(pool);
+
+    printf("Done.\nSuccess: %i\nFailed: %i\n\n", success, failed);
+
+    return (failed == 0) ? 0 : 1;
+}
+
+/* structure for storing test case of root and extremum finding */
+typedef struct
+{
+    const char* expression;
+    double from, to;
+    int intervals;                          /* coarse grid intervals (0 = default) */
+    int roots, minima, maxima;              /* expected number of found points */
+} analysis_test_case;
+
+/* static array of test cases of root and extremum finding */
+static analysis_test_case analysis_cases[] = {
+    { "sin(x)",                         -10, 10,    0,      7, 3, 3 },
+    { "x^2 - 2",                        -3, 3,      0,      2, 1, 0 },
+    { "x^3 - x",                        -2, 2,      0,      3, 1, 1 },      /* root 0 is coarse sample */
+    { "1/x",                            -1, 2,      0,      0, 0, 0 },      /* pole is not root */
+    { "abs(x - 0.3) - 0.1",             -1, 1,      100,    2, 1, 0 },      /* corner minimum */
+    { "ln(x) - 1",                      -1, 5,      0,      1, 0, 0 },      /* partly out of domain */
+    { "sin(1/x)",                       0.05, 1,    4096,   6, 3, 3 },
+    { "cos(x*x)",                       0, 10,      100000, 32, 16, 15 },   /* more tasks */
+};
+
+/* test function of root and extremum finding - roots have to be precise, extrema have to be smaller
+ * (greater) than their surroundings, and the result has to be the same for serial and parallel run */
+int test_analysis(void)
+{
+    anl_result serial, parallel;
+    double around;
+    int i, j, size, error, fail, success, failed, counts[3];
+    c_stack *tmp;
+    char *error_ptr, *expr_cpy;
+    rpn_program *prog;
+    thread_pool *pool;
+
+    success = 0;
+    failed = 0;
+
+    pool = pool_create(3);
+
+    size = (int) (sizeof(analysis_cases) / sizeof(analysis_test_case));
+    for (i = 0; i < size; i++)
+    {
+        fail = 0;
+
+        expr_cpy = (char*)malloc(sizeof(char)*strlen(analysis_cases[i].expression)+1);
+        strcpy(expr_cpy, analysis_cases[i].expression);
+
+        printf("Analysis:  %s on [%g, %g]\n", analysis_cases[i].expression, analysis_cases[i].from, analysis_cases[i].to);
+
+        tmp = sy_generate_rpn_stack(expr_cpy, &error, &error_ptr);
+        prog = (tmp != NULL) ? prog_compile(tmp, expr_cpy, (int)strlen(expr_cpy), NULL) : NULL;
+
+        if (prog != NULL
+            && anl_find(prog, analysis_cases[i].from, analysis_cases[i].to, analysis_cases[i].intervals, NULL, &serial) == 0)
+        {
+            if (anl_find(prog, analysis_cases[i].from, analysis_cases[i].to, analysis_cases[i].intervals, pool, &parallel) != 0
+                || serial.count != parallel.count || serial.evaluations != parallel.evaluations)
+                fail = 1;
+            for (j = 0; j < serial.count && j < parallel.count; j++)
+            {
+                if (serial.points[j].kind != parallel.points[j].kind || serial.points[j].x != parallel.points[j].x
+                    || serial.points[j].value != parallel.points[j].value || serial.points[j].iterations != parallel.points[j].iterations)
+                    fail = 1;
+            }
+            anl_release(&parallel);
+
+            counts[ANL_ROOT] = counts[ANL_MINIMUM] = counts[ANL_MAXIMUM] = 0;
+            for (j = 0; j < serial.count; j++)
+            {
+                counts[serial.points[j].kind]++;
+                if (j > 0 && serial.points[j].x < serial.points[j - 1].x)
+                    fail = 1;
+                if (serial.points[j].value != prog_evaluate(prog, serial.points[j].x))
+                    fail = 1;
+
+                if (serial.points[j].kind == ANL_ROOT)
+                {
+                    if (!(fabs(serial.points[j].value) <= TEST_ANALYSIS_ROOT_VALUE))
+                        fail = 1;
+                    continue;
+                }
+
+                /* both neighbourhoods of extremum */
+                around = TEST_ANALYSIS_NEIGHBOURHOOD * (fabs(serial.points[j].x) + 1);
+                if ((serial.points[j].kind == ANL_MINIMUM
+                     && (prog_evaluate(prog, serial.points[j].x - around) < serial.points[j].value
+                         || prog_evaluate(prog, serial.points[j].x + around) < serial.points[j].value))
+                    || (serial.points[j].kind == ANL_MAXIMUM
+                        && (prog_evaluate(prog, serial.points[j].x - around) > serial.points[j].value
+                            || prog_evaluate(prog, serial.points[j].x + around) > serial.points[j].value)))
+                    fail = 1;
+            }
+
+            printf("Found:     %i roots, %i minima, %i maxima (%li evaluations)\n", counts[ANL_ROOT], counts[ANL_MINIMUM],
+                   counts[ANL_MAXIMUM], serial.evaluations);
+            if (counts[ANL_ROOT] != analysis_cases[i].roots || counts[ANL_MINIMUM] != analysis_cases[i].minima
+                || counts[ANL_MAXIMUM] != analysis_cases[i].maxima)
+                fail = 1;
+
+            anl_release(&serial);
+        }
+        else
+        {
+            fail = 1;
+        }
+
+        if (fail == 0)
+        {
+            printf("OK\n\n");
+            success++;
+        }
+        else
+        {
+            printf("FAILED\n\n");
+            failed++;
+        }
+
+        if (prog != NULL)
+            prog_destroy(prog);
+        if (tmp != NULL)
+            stck_destroy(tmp);
+        free(expr_cpy);
+    }
+
+    pool_destroy(pool);
+
+    printf("Done.\nSuccess: %i\nFailed: %i\n\n", success, failed);
+
+    return (failed == 0) ? 0 : 1;
+}
+
+/* structure for storing test case of integration */
+typedef struct
+{
+    const char* expression;
+    double a, b;                            /* bounds */
+    double tolerance;
+    double expected;                        /* integral, NaN if it should not converge */
+} integration_test_case;
+
+/* static array of test cases of integration */
+static integration_test_case integration_cases[] = {
+    { "x^2",                    0, 3,       1e-10,  9 },
+    { "sin(x)",                 0, 3.14159265358979323846, 1e-10, 2 },
+    { "exp(-x^2)",              -5, 5,      1e-10,  1.772453850902791 },
+    { "1/x",                    1, 10,      1e-12,  2.302585092994046 },
+    { "x",                      2, 0,       1e-10,  -2 },                   /* reversed bounds */
+    { "abs(x - 0.3)",           -1, 1,      1e-10,  1.09 },                 /* kink */
+    { "sin(50*x)",              0, 1,       1e-10,  0.0007006794301577335 },/* oscillating */
+    { "ln(x)",                  0, 1,       1e-8,   -1 },                   /* singular end */
+    { "if(x < 1, 0, 1)",        0, 3,       1e-8,   2 },                    /* jump */
+    { "1/x",                    -1, 1,      1e-8,   NAN },                  /* pole */
+};
+
+/* test function of integration - the integral has to be within tolerance of the expected one, with
+ * error estimate within tolerance too, and the same for serial and parallel run; expression
+ * interface has to give the same result */
+int test_integration(void)
+{
+    quad_result serial, parallel, expression;
+    int i, size, error, fail, success, failed, res;
+    c_stack *tmp;
+    char *error_ptr, *expr_cpy;
+    rpn_program *prog;
+    thread_pool *pool;
+
+    success = 0;
+    failed = 0;
+
+    pool = pool_create(3);
+
+    size = (int) (sizeof(integration_cases) / sizeof(integration_test_case));
+    for (i = 0; i < size; i++)
+    {
+        fail = 0;
+
+        expr_cpy = (char*)malloc(sizeof(char)*strlen(integration_cases[i].expression)+1);
+        strcpy(expr_cpy, integration_cases[i].expression);
+
+        printf("Integral:  %s on [%g, %g]\n", integration_cases[i].expression, integration_cases[i].a, integration_cases[i].b);
+
+        tmp = sy_generate_rpn_stack(expr_cpy, &error, &error_ptr);
+        prog = (tmp != NULL) ? prog_compile(tmp, expr_cpy, (int)strlen(expr_cpy), NULL) : NULL;
+
+        if (prog != NULL)
+        {
+            res = quad_integrate(prog, integration_cases[i].a, integration_cases[i].b, integration_cases[i].tolerance, NULL, &serial);
+            res |= quad_integrate(prog, integration_cases[i].a, integration_cases[i].b, integration_cases[i].tolerance, pool, &parallel);
+            res |= quad_integrate_expression(integration_cases[i].expression, integration_cases[i].a, integration_cases[i].b,
+                                             integration_cases[i].tolerance, &expression);
+
+            printf("Result:    %.15g (error %g, %i panels, %li evaluations)\n", serial.value, serial.error, serial.panels,
+                   serial.evaluations);
+
+            /* compared bitwise, the integral may be NaN */
+            if (res != 0 || memcmp(&serial.value, &parallel.value, sizeof(double)) != 0
+                || memcmp(&serial.error, &parallel.error, sizeof(double)) != 0 || serial.panels != parallel.panels
+                || serial.evaluations != parallel.evaluations || memcmp(&serial.value, &expression.value, sizeof(double)) != 0)
+                fail = 1;
+
+            if (integration_cases[i].expected != integration_cases[i].expected)
+            {
+                if (serial.converged)
+                    fail = 1;
+            }
+            else if (!serial.converged || !(fabs(serial.value - integration_cases[i].expected) <= integration_cases[i].tolerance)
+                     || !(serial.error <= integration_cases[i].tolerance))
+                fail = 1;
+        }
+        else
+        {
+            fail = 1;
+        }
+
+        if (fail == 0)
+        {
+            printf("OK\n\n");
+            success++;
+        }
+        else
+        {
+            printf("FAILED\n\n");
+            failed++;
+        }
+
+        if (prog != NULL)
+            prog_destroy(prog);
+        if (tmp != NULL)
+            stck_destroy(tmp);
+        free(expr_cpy);
+    }
+
+    pool_destroy(pool);
+
+    printf("Done.\nSuccess: %i\nFailed: %i\n\n", success, failed);
+
+    return (failed == 0) ? 0 : 1;
+}
+
+/* static array of numbers formatted exactly (ties of exact binary values, signs, rounding over
+ * integer part, values printf has to handle) */
+static double format_cases[] = {
+    0, 1, -1, 0.5, 1.5, 2.5, -2.5, 0.125, 0.375, 1e-7, 5e-7, -5e-7, 4.9999995e-7, 0.0000015, 0.0000025,
+    123.4567895, 999999.9999995, 999999999.9999999, 0.1, 0.7, 2.675, 1.0000005, 1e9, -1e9, 1e15,
+    1e300, -1e-300, INFINITY, -INFINITY, NAN
+};
+
+/* test function of number formatting of PostScript output - every number has to be formatted the
+ * same as by printf, for every supported number of decimals; the speed of both is measured */
+int test_formatting(void)
+{
+    char expected[PS_NUMBER_LENGTH], formatted[PS_NUMBER_LENGTH];
+    double* values;
+    double val, start, fast_time, printf_time;
+    unsigned long seed;
+    long bytes;
+    int i, d, size, length, success, failed;
+
+    success = 0;
+    failed = 0;
+
+    values = (double*)malloc(sizeof(double) * TEST_FORMAT_VALUES);
+    if (values == NULL)
+        return 1;
+
+    /* random numbers of various magnitudes (both signs) follow the cases */
+    size = (int) (sizeof(format_cases) / sizeof(double));
+    seed = 12345;
+    for (i = 0; i < TEST_FORMAT_VALUES; i++)
+    {
+        if (i < size)
+        {
+            values[i] = format_cases[i];
+            continue;
+        }
+        seed = (seed * 1103515245 + 12345) & 0x7FFFFFFF;
+        val = (double)seed / 0x7FFFFFFF * pow(10, (double)(i % 19 - 9));
+        values[i] = (i % 2 == 0) ? val : -val;
+    }
+
+    for (d = 0; d <= PS_MAX_DECIMALS; d++)
+    {
+        printf("Formatting: %i decimals\n", d);
+        length = 0;
+        for (i = 0; i < TEST_FORMAT_VALUES && length == 0; i++)
+        {
+            sprintf(expected, "%.*f", d, values[i]);
+            if (ps_format_number(formatted, values[i], d) != (int)strlen(expected) || strcmp(formatted, expected) != 0)
+            {
+                printf("Expected:  %s\nFormatted: %s\n", expected, formatted);
+                length = 1;
+            }
+        }
+
+        if (length == 0)
+        {
+            printf("OK\n\n");
+            success++;
+        }
+        else
+        {
+            printf("FAILED\n\n");
+            failed++;
+        }
+    }
+
+    /* output speed of default precision */
+    bytes = 0;
+    start = pool_wall_time();
+    for (i = 0; i < TEST_FORMAT_VALUES; i++)
+        bytes += ps_format_number(formatted, values[i], PS_DECIMALS);
+    fast_time = pool_wall_time() - start;
+
+    start = pool_wall_time();
+    for (i = 0; i < TEST_FORMAT_VALUES; i++)
+        sprintf(expected, "%.*f", PS_DECIMALS, values[i]);
+    printf_time = pool_wall_time() - start;
+
+    printf("Formatted %li bytes: %.1f MB/s (printf %.1f MB/s)\n\n", bytes, bytes / (fast_time * 1e6 + 1e-9),
+           bytes / (printf_time * 1e6 + 1e-9));
+
+    free(values);
+
+    printf("Done.\nSuccess: %i\nFailed: %i\n\n", success, failed);
+
+    return (failed == 0) ? 0 : 1;
+}
+
+/* static array of decimals of compact PostScript output tests (0 = plain output) */
+static int compact_cases[] = { 0, 1, 2, 3, 6 };
+
+/* draws test paths with supplied document, stores their vertices */
+static void test_draw_paths(ps_document* doc, double* vertices)
+{
+    ps_pen* pen;
+    int i;
+
+    ps_write_header(doc, "test", "test", "now\n");
+    ps_set_line_width(doc, 2);
+    ps_set_color(doc, 0.7, 0.7, 0.7);
+
+    pen = ps_create_pen(doc, 25, 25);
+    for (i = 0; i < TEST_COMPACT_VERTICES; i++)
+    {
+        vertices[2 * i] = 25 + 545.0 * i / (TEST_COMPACT_VERTICES - 1);
+        vertices[2 * i + 1] = 297.5 + 272.5 * sin(i / 7.3) * cos(i / 131.1);
+        if (i == 0 || i == TEST_COMPACT_VERTICES / 2)
+        {
+            /* the second path is closed, and goes on from its start */
+            if (i > 0)
+            {
+                ps_pen_close_path(pen);
+                ps_pen_up(pen);
+                ps_set_position(doc, 100, 100);
+                ps_print_text_val(doc, 1.5, "%g");
+            }
+            ps_pen_move(pen, vertices[2 * i], vertices[2 * i + 1]);
+            ps_pen_down(pen);
+        }
+        else
+            ps_pen_draw(pen, vertices[2 * i], vertices[2 * i + 1]);
+    }
+    ps_pen_up(pen);
+    ps_destroy_pen(pen);
+}
+
+/* reads path vertices from PostScript file written by test_draw_paths (both plain and compact
+ * commands), and counts occurrences of supplied operator (may be NULL); returns number of vertices
+ * read */
+static int test_read_paths(const char* filename, double* vertices, int max_count, const char* counted, int* occurrences)
+{
+    char line[1024];
+    char *token, *end;
+    double stack[2], number, x, y, start_x, start_y;
+    int count, path, vertex;
+    FILE* file;
+
+    file = fopen(filename, "r");
+    if (file == NULL)
+        return -1;
+
+    count = 0;
+    path = 0;
+    *occurrences = 0;
+    stack[0] = stack[1] = 0;
+    x = y = start_x = start_y = 0;
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        /* comments and prolog */
+        if (line[0] == '%' || strstr(line, "bind def") != NULL)
+            continue;
+
+        for (token = strtok(line, " \n"); token != NULL; token = strtok(NULL, " \n"))
+        {
+            number = strtod(token, &end);
+            if (*end == '\0')
+            {
+                stack[0] = stack[1];
+                stack[1] = number;
+                continue;
+            }
+
+            if (counted != NULL && strcmp(token, counted) == 0)
+                (*occurrences)++;
+
+            vertex = 0;
+            if (strcmp(token, "n") == 0 || strcmp(token, "newpath") == 0)
+                path = 1;
+            else if (strcmp(token, "s") == 0 || strcmp(token, "stroke") == 0)
+                path = 0;
+            else if (strcmp(token, "m") == 0 || strcmp(token, "moveto") == 0)
+            {
+                x = start_x = stack[0];
+                y = start_y = stack[1];
+                /* text positions (out of path) are not vertices */
+                vertex = path;
+            }
+            else if (strcmp(token, "l") == 0 || strcmp(token, "lineto") == 0)
+            {
+                x = stack[0];
+                y = stack[1];
+                vertex = 1;
+            }
+            else if (strcmp(token, "r") == 0)
+            {
+                x += stack[0];
+                y += stack[1];
+                vertex = 1;
+            }
+            else if (strcmp(token, "p") == 0 || strcmp(token, "closepath") == 0)
+            {
+                x = start_x;
+                y = start_y;
+            }
+
+            if (vertex && count < max_count)
+            {
+                vertices[2 * count] = x;
+                vertices[2 * count + 1] = y;
+                count++;
+            }
+        }
+    }
+
+    fclose(file);
+    return count;
+}
+
+/* test function of compact PostScript output - vertices of paths read back from output have to
+ * be within rounding of its decimals from drawn ones (so the rendered result is the same at any
+ * device resolution coarser than that), and output sizes are compared */
+int test_compact_output(void)
+{
+    double *drawn, *read;
+    double tolerance;
+    ps_document* doc;
+    long size, plain_size;
+    int i, j, size_cases, count, fail, success, failed;
+    FILE* file;
+
+    success = 0;
+    failed = 0;
+    plain_size = 0;
+
+    drawn = (double*)malloc(sizeof(double) * 2 * TEST_COMPACT_VERTICES);
+    read = (double*)malloc(sizeof(double) * 2 * TEST_COMPACT_VERTICES);
+    if (drawn == NULL || read == NULL)
+    {
+        free(drawn);
+        free(read);
+        return 1;
+    }
+
+    size_cases = (int) (sizeof(compact_cases) / sizeof(int));
+    for (i = 0; i < size_cases; i++)
+    {
+        fail = 0;
+
+        if (compact_cases[i] == 0)
+            printf("Output:    plain\n");
+        else
+            printf("Output:    compact, %i decimals\n", compact_cases[i]);
+
+        doc = ps_create_document(TEST_COMPACT_FILE);
+        if (doc == NULL)
+        {
+            printf("FAILED\n\n");
+            failed++;
+            continue;
+        }
+        if (compact_cases[i] > 0)
+            ps_set_compact(doc, compact_cases[i]);
+        test_draw_paths(doc, drawn);
+        ps_close_document(doc);
+
+        count = test_read_paths(TEST_COMPACT_FILE, read, TEST_COMPACT_VERTICES, NULL, &j);
+
+        size = 0;
+        file = fopen(TEST_COMPACT_FILE, "rb");
+        if (file != NULL)
+        {
+            fseek(file, 0, SEEK_END);
+            size = ftell(file);
+            fclose(file);
+        }
+        remove(TEST_COMPACT_FILE);
+
+        if (compact_cases[i] == 0)
+            plain_size = size;
+        printf("Size:      %li bytes (%.2f of plain)\n", size, (double)size / plain_size);
+
+        tolerance = 0.5 * pow(10, -((compact_cases[i] > 0) ? compact_cases[i] : PS_DECIMALS)) + 1e-9;
+        if (count != TEST_COMPACT_VERTICES)
+            fail = 1;
+        for (j = 0; j < 2 * TEST_COMPACT_VERTICES && fail == 0; j++)
+        {
+            if (!(fabs(read[j] - drawn[j]) <= tolerance))
+            {
+                printf("Vertex %i: %f instead of %f\n", j / 2, read[j], drawn[j]);
+                fail = 1;
+            }
+        }
+
+        if (fail == 0)
+        {
+            printf("OK\n\n");
+            success++;
+        }
+        else
+        {
+            printf("FAILED\n\n");
+            failed++;
+        }
+    }
+
+    free(drawn);
+    free(read);
+
+    printf("Done.\nSuccess: %i\nFailed: %i\n\n", success, failed);
+
+    return (failed == 0) ? 0 : 1;
+}
+
+/* structure for storing test case of graphics state tracking */
+typedef struct
+{
+    const char* operator_name;              /* counted operator */
+    int occurrences;                        /* expected number of its occurrences */
+} state_test_case;
+
+/* static array of test cases of graphics state tracking (operators of grid drawn by test) */
+static state_test_case state_cases[] = {
+    { "setrgbcolor",    3 },                /* gray lines, black label, gray lines again */
+    { "setlinewidth",   1 },
+    { "setfont",        1 },
+    { "newpath",        2 },                /* lines before and after label are joined to one path */
+    { "stroke",         2 },
+    { "moveto",         2 * TEST_STATE_LINES + 1 },     /* the repeated text position is dropped */
+    { "show",           1 },
+};
+
+/* draws grid of lines with setting the same state for every one of them, stores their vertices
+ * (label in the middle breaks the grid to two paths) */
+static void test_draw_grid(ps_document* doc, double* vertices)
+{
+    ps_pen* pen;
+    int i;
+
+    ps_write_header(doc, "test", "test", "now\n");
+    pen = ps_create_pen(doc, 0, 0);
+    for (i = 0; i < 2 * TEST_STATE_LINES; i++)
+    {
+        if (i == TEST_STATE_LINES)
+        {
+            ps_set_color(doc, 0, 0, 0);
+            ps_set_font(doc, "Times-Roman", 10);
+            ps_set_position(doc, 10, 10);
+            ps_set_position(doc, 10, 10);
+            ps_print_text(doc, "label");
+        }
+
+        ps_set_color(doc, 0.7, 0.7, 0.7);
+        ps_set_line_width(doc, 1);
+        ps_set_font(doc, "Times-Roman", 10);
+
+        vertices[4 * i] = vertices[4 * i + 2] = 25 + 10.5 * i;
+        vertices[4 * i + 1] = 25;
+        vertices[4 * i + 3] = 570;
+        ps_pen_move(pen, vertices[4 * i], vertices[4 * i + 1]);
+        ps_pen_down(pen);
+        ps_pen_draw(pen, vertices[4 * i + 2], vertices[4 * i + 3]);
+        ps_pen_up(pen);
+    }
+    ps_destroy_pen(pen);
+}
+
+/* test function of graphics state tracking - redundant state changes have to be dropped, and
+ * lines drawn with the same state stroked at once, while all of them are kept */
+int test_graphics_state(void)
+{
+    double drawn[8 * TEST_STATE_LINES], read[8 * TEST_STATE_LINES];
+    ps_document* doc;
+    int i, j, size, count, occurrences, fail, success, failed;
+
+    success = 0;
+    failed = 0;
+
+    size = (int) (sizeof(state_cases) / sizeof(state_test_case));
+    for (i = 0; i < size; i++)
+    {
+        fail = 0;
+
+        printf("Operator:  %s\n", state_cases[i].operator_name);
+
+        doc = ps_create_document(TEST_COMPACT_FILE);
+        if (doc == NULL)
+        {
+            printf("FAILED\n\n");
+            failed++;
+            continue;
+        }
+        test_draw_grid(doc, drawn);
+        ps_close_document(doc);
+
+        count = test_read_paths(TEST_COMPACT_FILE, read, 4 * TEST_STATE_LINES, state_cases[i].operator_name, &occurrences);
+        remove(TEST_COMPACT_FILE);
+
+        printf("Written:   %i times (expected %i)\n", occurrences, state_cases[i].occurrences);
+        if (occurrences != state_cases[i].occurrences || count != 4 * TEST_STATE_LINES)
+            fail = 1;
+        for (j = 0; j < 8 * TEST_STATE_LINES && fail == 0; j++)
+        {
+            if (!(fabs(read[j] - drawn[j]) <= 1e-6))
+                fail = 1;
+        }
+
+        if (fail == 0)
+        {
+            printf("OK\n\n");
+            success++;
+        }
+        else
+        {
+            printf("FAILED\n\n");
+            failed++;
+        }
+    }
+
+    printf("Done.\nSuccess: %i\nFailed: %i\n\n", success, failed);
+
+    return (failed == 0) ? 0 : 1;
+}
+
+/* static array of test cases of legend layout (numbers of functions drawn together) */
+static int legend_cases[] = { 1, 3, 4, DRAW_LEGEND_MAX_ROWS, DRAW_LEGEND_MAX_ROWS + 1, MULTI_MAX_FUNCTIONS };
+
+/**
+ * Decides, whether supplied rectangle of image (rows and columns clipped to it) contains pixel,
+ * which is not white
+ */
+static int test_inked(const unsigned char* pixels, int width, int height, int top, int bottom, int left, int right)
+{
+    int row, col;
+
+    for (row = (top > 0) ? top : 0; row < bottom && row < height; row++)
+    {
+        for (col = (left > 0) ? left : 0; col < right && col < width; col++)
+        {
+            if (pixels[((size_t)row * width + col) * 3] != 255 || pixels[((size_t)row * width + col) * 3 + 1] != 255
+                || pixels[((size_t)row * width + col) * 3 + 2] != 255)
+                return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* test function of legend layout - every line of legend has to lie above the plot, within its width
+ * and within the page (raster page and PostScript page), lines must not overlap, and every one of
+ * them has to be drawn within the raster image, not touching its top edge nor the next column */
+int test_legend(void)
+{
+    char* expressions[MULTI_MAX_FUNCTIONS];
+    unsigned char* pixels;
+    double x, y, x2, y2, page_height, scale, column_width;
+    int i, f, g, size, count, width, height, row, fail, success, failed;
+    ps_document* doc;
+    FILE* file;
+
+    success = 0;
+    failed = 0;
+
+    for (f = 0; f < MULTI_MAX_FUNCTIONS; f++)
+        expressions[f] = "sin(x) * cos(x) + 12345.678 * x ^ 2 - 1";
+
+    size = (int) (sizeof(legend_cases) / sizeof(int));
+    for (i = 0; i < size; i++)
+    {
+        fail = 0;
+        count = legend_cases[i];
+        page_height = drawing_page_height(count);
+
+        printf("Legend:    %i functions, page height %g\n", count, page_height);
+
+        column_width = DRAW_X_END - DRAW_X_BEGIN;
+        for (f = 0; f < count; f++)
+        {
+            drawing_legend_position(count, f, &x, &y);
+            if (x < DRAW_X_BEGIN || x >= DRAW_X_END || y < DRAW_Y_END + DRAW_LEGEND_OFFSET
+                || y + DRAW_LABEL_FONT_SIZE > page_height || y + DRAW_LABEL_FONT_SIZE > DRAW_PAGE_HEIGHT)
+            {
+                printf("Line %i at %g:%g\n", f + 1, x, y);
+                fail = 1;
+            }
+            for (g = 0; g < f; g++)
+            {
+                drawing_legend_position(count, g, &x2, &y2);
+                if (x2 == x && fabs(y2 - y) < DRAW_LEGEND_LINE_HEIGHT)
+                    fail = 1;
+                if (x2 != x && fabs(x2 - x) < column_width)
+                    column_width = fabs(x2 - x);
+            }
+        }
+
+        /* legend rendered to raster image of the height output of that many functions gets */
+        height = (int)ceil(DRAW_RASTER_SIZE * page_height / RASTER_PAGE_SIZE);
+        doc = ps_create_raster_document(TEST_LEGEND_FILE, RASTER_FORMAT_PPM, DRAW_RASTER_SIZE, height, NULL);
+        if (doc == NULL)
+        {
+            printf("FAILED\n\n");
+            failed++;
+            continue;
+        }
+        ps_write_header(doc, "test", "test", "now\n");
+        ps_set_font(doc, DRAW_LABEL_FONT_FAMILY, DRAW_LABEL_FONT_SIZE);
+        drawing_print_legend(doc, expressions, count);
+        ps_close_document(doc);
+
+        pixels = NULL;
+        file = fopen(TEST_LEGEND_FILE, "rb");
+        if (file != NULL && fscanf(file, "P6 %i %i 255", &width, &height) == 2 && fgetc(file) != EOF
+            && width == DRAW_RASTER_SIZE && height >= DRAW_RASTER_SIZE)
+        {
+            pixels = (unsigned char*)malloc((size_t)width * height * 3);
+            if (pixels != NULL && fread(pixels, 3, (size_t)width * height, file) != (size_t)width * height)
+            {
+                free(pixels);
+                pixels = NULL;
+            }
+        }
+        if (file != NULL)
+            fclose(file);
+        remove(TEST_LEGEND_FILE);
+
+        if (pixels == NULL)
+            fail = 1;
+        else
+        {
+            scale = DRAW_RASTER_SIZE / RASTER_PAGE_SIZE;
+            if (test_inked(pixels, width, height, 0, 1, 0, width))
+            {
+                printf("Legend touches top edge of image\n");
+                fail = 1;
+            }
+            for (f = 0; f < count; f++)
+            {
+                drawing_legend_position(count, f, &x, &y);
+                row = (int)(height - y * scale);
+                if (!test_inked(pixels, width, height, row - (int)(DRAW_LABEL_FONT_SIZE * scale), row + 1,
+                                (int)(x * scale), (int)((x + column_width) * scale)))
+                {
+                    printf("Line %i is not drawn\n", f + 1);
+                    fail = 1;
+                }
+                if (test_inked(pixels, width, height, row - (int)(DRAW_LABEL_FONT_SIZE * scale), row + 1,
+                               (int)((x + column_width) * scale) - TEST_LEGEND_GAP, (int)((x + column_width) * scale)))
+                {
+                    printf("Line %i reaches next column\n", f + 1);
+                    fail = 1;
+                }
+            }
+            free(pixels);
+        }
+
+        if (fail == 0)
+        {
+            printf("OK\n\n");
+            success++;
+        }
+        else
+        {
+            printf("FAILED\n\n");
+            failed++;
+        }
+    }
+
+    printf("Done.\nSuccess: %i\nFailed: %i\n\n", success, failed);
+
+    return (failed == 0) ? 0 : 1;
+}
+
+/* structure for storing test case of bulk processing */
+typedef struct
+{
+    const char* input;                      /* file contents */
+    int mode;                               /* enum bulk_mode */
+    const char* expected;                   /* expected output (values evaluated in TEST_BULK_VALUE) */
+    int errors;                             /* expected number of lines with errors */
+} bulk_test_case;
+
+/* static array of test cases of bulk processing */
+static bulk_test_case bulk_cases[] = {
+    { "2+3\r\n2*x\r\n",                   BULK_MODE_EVALUATE, "5\n4\n",                  0 },    /* CRLF */
+    { "1+1\nx*x",                          BULK_MODE_EVALUATE, "2\n4\n",                  0 },    /* no final newline */
+    { "sin(x\n1+*2\n\n  1 + x\n",          BULK_MODE_EVALUATE, "error 1 5\nerror 5 2\nerror 7 -1\n3\n", 3 },
+    { "sin(x\r\n\r\n",                     BULK_MODE_EVALUATE, "error 1 5\nerror 7 -1\n", 2 },  /* errors and CRLF */
+    { "",                                   BULK_MODE_EVALUATE, "",                         0 },
+    { "1\n2\n3\n4\n5\n6\n7\n8\n9\n10\n11\n12", BULK_MODE_EVALUATE, "1\n2\n3\n4\n5\n6\n7\n8\n9\n10\n11\n12\n", 0 },
+    { "2*x+1\r\n (x+1)*(x-1)",             BULK_MODE_RPN,      "2 x * 1 +\nx 1 + x 1 - *\n", 0 },
+};
+
+/* test function of bulk processing - output has to be the same for any split of input to line
+ * ranges (ranges are cut at every byte boundary), serial and parallel */
+int test_bulk(void)
+{
+    char output[TEST_BULK_OUTPUT];
+    char* input;
+    expr_cache* cache;
+    thread_pool* pool;
+    bulk_stats stats;
+    FILE* file;
+    long length;
+    int i, size, chunks, fail, success, failed, res;
+
+    success = 0;
+    failed = 0;
+
+    pool = pool_create(3);
+
+    size = (int) (sizeof(bulk_cases) / sizeof(bulk_test_case));
+    for (i = 0; i < size; i++)
+    {
+        fail = 0;
+
+        printf("Bulk input: %i bytes, %s\n", (int)strlen(bulk_cases[i].input),
+               (bulk_cases[i].mode == BULK_MODE_RPN) ? "compiled form" : "values");
+
+        /* processing does not write to the input, but it is not declared const */
+        input = (char*)malloc(strlen(bulk_cases[i].input) + 1);
+        cache = cache_create(0, 0, 0);
+        file = tmpfile();
+        if (input == NULL || cache == NULL || file == NULL)
+            fail = 1;
+        else
+            strcpy(input, bulk_cases[i].input);
+
+        for (chunks = 1; chunks <= (int)strlen(bulk_cases[i].input) + 2 && fail == 0; chunks++)
+        {
+            rewind(file);
+            res = bulk_process(input, (long)strlen(input), (enum bulk_mode)bulk_cases[i].mode, TEST_BULK_VALUE, cache,
+                               (chunks % 2 == 0) ? pool : NULL, chunks, file, &stats);
+            length = ftell(file);
+            rewind(file);
+            if (res != 0 || length < 0 || length >= TEST_BULK_OUTPUT || (long)fread(output, 1, (size_t)length, file) != length)
+            {
+                fail = 1;
+                break;
+            }
+            output[length] = '\0';
+
+            if (strcmp(output, bulk_cases[i].expected) != 0 || stats.errors != bulk_cases[i].errors)
+            {
+                printf("%i ranges:\n%sinstead of:\n%s", chunks, output, bulk_cases[i].expected);
+                fail = 1;
+            }
+        }
+
+        if (fail == 0)
+        {
+            printf("OK\n\n");
+            success++;
+        }
+        else
+        {
+            printf("FAILED\n\n");
+            failed++;
+        }
+
+        if (file != NULL)
+            fclose(file);
+        if (cache != NULL)
+            cache_destroy(cache);
+        free(input);
+    }
+
+    pool_destroy(pool);
+
+    printf("Done.\nSuccess: %i\nFailed: %i\n\n", success, failed);
+
+    return (failed == 0) ? 0 : 1;
+}
+
+/* test function of bulk processing of mostly distinct lines - every TEST_DISTINCT_PERIOD-th line repeats one
+ * expression, the others are unique, so the cache keeps evicting; verifies output, cache limits and survival
+ * of the repeated expression and measures throughput (serially, so the expression misses only once) */
+int test_bulk_distinct(void)
+{
+    char line[TEST_DISTINCT_LINE];
+    char *input, *ptr;
+    expr_cache* cache;
+    bulk_stats stats;
+    cache_stats cstats;
+    FILE* file;
+    double start, elapsed, value;
+    long length;
+    int i, fail, repeated;
+
+    fail = 0;
+
+    cache = cache_create(0, 0, CACHE_CANONICAL_ORDER);
+    input = (char*)malloc((size_t)TEST_DISTINCT_LINES * TEST_DISTINCT_LINE);
+    file = tmpfile();
+    if (cache == NULL || input == NULL || file == NULL)
+        fail = 1;
+
+    length = 0;
+    repeated = 0;
+    for (i = 0; i < TEST_DISTINCT_LINES && fail == 0; i++)
+    {
+        if (i % TEST_DISTINCT_PERIOD == 0)
+        {
+            strcpy(line, "x+1\n");
+            repeated++;
+        }
+        else
+            sprintf(line, "x*%i+1\n", i);
+        strcpy(input + length, line);
+        length += (long)strlen(line);
+    }
+
+    if (fail == 0)
+    {
+        start = pool_wall_time();
+        if (bulk_process(input, length, BULK_MODE_EVALUATE, TEST_BULK_VALUE, cache, NULL, 0, file, &stats) != 0
+            || stats.lines != TEST_DISTINCT_LINES || stats.errors != 0)
+            fail = 1;
+        elapsed = pool_wall_time() - start;
+
+        rewind(file);
+        for (i = 0; i < TEST_DISTINCT_LINES && fail == 0; i++)
+        {
+            if (fgets(line, TEST_DISTINCT_LINE, file) == NULL)
+            {
+                fail = 1;
+                break;
+            }
+            value = strtod(line, &ptr);
+            if (ptr == line || fabs(value - ((i % TEST_DISTINCT_PERIOD == 0) ? 3.0 : 2.0 * i + 1.0)) > COMPARISON_EPSILON)
+            {
+                printf("Line %i: %s", i + 1, line);
+                fail = 1;
+            }
+        }
+
+        cache_get_stats(cache, &cstats);
+        printf("Distinct lines: %i in %.3f s, hits %li, misses %li, evictions %li, entries %li\n",
+               TEST_DISTINCT_LINES, elapsed, cstats.hits, cstats.misses, cstats.evictions, cstats.entries);
+        /* repeated line has to stay cached although it is surrounded by unique ones */
+        if (cstats.evictions == 0 || cstats.entries > CACHE_DEFAULT_CAPACITY || cstats.hits < repeated - 1)
+            fail = 1;
+    }
+
+    if (fail == 0)
+        printf("OK\n\n");
+    else
+        printf("FAILED\n\n");
+
+    if (file != NULL)
+        fclose(file);
+    if (cache != NULL)
+        cache_destroy(cache);
+    free(input);
+
+    printf("Done.\nSuccess: %i\nFailed: %i\n\n", (fail == 0) ? 1 : 0, fail);
+
+    return fail;
+}
@@ -1,9 +1,63 @@
-#ifndef MATHPARSER_TEST_H
-#define MATHPARSER_TEST_H
-
-#define TEST_CASE_VARIABLE_VAL 1.5      /* variable value used for tests */
-#define COMPARISON_EPSILON 0.001        /* epsilon for result comparison */
-
-int test_evaluation(void);
-
-#endif
+#ifndef MATHPARSER_TEST_H
+#define MATHPARSER_TEST_H
+
+#define TEST_CASE_VARIABLE_VAL 1.5      /* variable value used for tests */
+#define COMPARISON_EPSILON 0.001        /* epsilon for result comparison */
+#define TEST_CACHE_DEFINITION "w(t) = t*t*t*t*t*t*t*t"   /* function defined for cache test of too long expression */
+#define TEST_CACHE_INLINED "w(w(w(w(w(w(x))))))"          /* expression too long after inlining */
+#define TEST_INC_SAMPLES 33             /* number of samples used for incremental parsing tests */
+#define TEST_INC_DEPTH 11               /* depth of balanced group tree used for incremental parsing tests of long text */
+#define TEST_COND_SAMPLES 301           /* number of samples used for conditional tests (more blocks) */
+#define TEST_REDUCE_SAMPLES 41          /* number of samples used for sum and product tests */
+#define TEST_SAMPLING_COUNT 10001       /* number of plot samples used for parallel sampling tests (more chunks) */
+#define TEST_STREAM_COUNT 50001         /* number of plot samples used for streamed sampling tests (more stream chunks) */
+#define TEST_ADAPTIVE_TOLERANCE 0.5     /* maximum distance of adaptively sampled plot from function (in plot units) */
+#define TEST_MULTI_SAMPLES 301          /* number of samples used for tests of functions evaluated together (more blocks) */
+#define TEST_RASTER_SIZE 620            /* width of images used for raster tests (one pixel per page unit; more bands) */
+#define TEST_RASTER_COVERED 240         /* maximum red component of white pixel covered by blue line */
+#define TEST_IMPLICIT_POINTS 65536      /* maximum number of polyline commands of traced implicit curve */
+#define TEST_IMPLICIT_TOLERANCE 0.01    /* maximum function value in points of traced implicit curve */
+#define TEST_ANALYSIS_ROOT_VALUE 1e-12  /* maximum function value in found root */
+#define TEST_ANALYSIS_NEIGHBOURHOOD 1e-6    /* relative distance of points compared to found extremum */
+#define TEST_FORMAT_VALUES 200000       /* number of numbers formatted by number formatting tests */
+#define TEST_COMPACT_VERTICES 20000     /* number of path vertices written by compact output tests */
+#define TEST_COMPACT_FILE "test_output.ps"  /* temporary file of compact output tests */
+#define TEST_BULK_VALUE 2.0             /* variable value of bulk processing tests */
+#define TEST_BULK_OUTPUT 1024           /* maximum output size of bulk processing test case */
+#define TEST_DISTINCT_LINES 100000     /* number of lines processed by bulk tests of distinct input */
+#define TEST_DISTINCT_PERIOD 8          /* every this line of distinct input repeats the same expression */
+#define TEST_DISTINCT_LINE 64           /* maximum length of line of distinct input and its output */
+#define TEST_STATE_LINES 10             /* number of grid lines drawn by graphics state tests on either side of label */
+#define TEST_LEGEND_FILE "test_legend.ppm"  /* temporary file of legend layout tests */
+#define TEST_LEGEND_GAP 8               /* width of blank stripe (in pixels) required at the end of legend column */
+
+int test_evaluation(void);
+int test_serialization(void);
+int test_cache(void);
+int test_incremental(void);
+int test_incremental_large(void);
+int test_definitions(void);
+int test_grid(void);
+int test_conditionals(void);
+int test_reductions(void);
+int test_sampling(void);
+int test_adaptive_sampling(void);
+int test_decimation(void);
+int test_simplification(void);
+int test_streaming(void);
+int test_discontinuities(void);
+int test_multi(void);
+int test_parameters(void);
+int test_raster(void);
+int test_heatmap(void);
+int test_implicit(void);
+int test_analysis(void);
+int test_integration(void);
+int test_formatting(void);
+int test_compact_output(void);
+int test_graphics_state(void);
+int test_legend(void);
+int test_bulk(void);
+int test_bulk_distinct(void);
+
+#endif
@@ -0,0 +1,568 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "stack.h"
+#include "rpn.h"
+#include "main.h"
+#include "shunting_yard.h"
+#include "userfunc.h"
+
+/*
+ * User defined functions, i.e. "f(t) = t^2 + 1"
+ *
+ * Every definition is parsed to RPN form, where parameters are variables with index equal to
+ * parameter position. Calls of user defined functions are never evaluated - the compiler calls
+ * uf_expand, which replaces every call by function body with parameters substituted by argument
+ * subexpressions, and folds subexpressions with constant operands. So the call itself costs
+ * nothing at evaluation time.
+ *
+ * Definitions refer to other definitions by identifier, so redefinition affects every function
+ * using it. That's why the recursion is checked through the whole call graph on every definition.
+ *
+ * The registry is not synchronized - all definitions have to be made before expressions are
+ * parsed or compiled by more threads.
+ */
+
+/* function definition record */
+typedef struct
+{
+    char name[UF_MAX_NAME_LENGTH + 1];  /* function name */
+    int arity;                          /* number of parameters */
+    c_stack* body;                      /* function body in RPN form, NULL while the definition is parsed */
+} uf_definition;
+
+/**
+ * Static array of user defined functions, in order of definition
+ */
+static uf_definition uf_definitions[UF_MAX_DEFINITIONS];
+static int uf_definition_count = 0;
+
+/**
+ * Helper function to retrieve length of identifier (letter followed by letters, digits or
+ * underscores) on supplied position; returns 0 if there's no identifier
+ */
+static int uf_identifier_length(char* chr)
+{
+    int len;
+
+    if (!((chr[0] >= 'a' && chr[0] <= 'z') || (chr[0] >= 'A' && chr[0] <= 'Z')))
+        return 0;
+
+    for (len = 1; (chr[len] >= 'a' && chr[len] <= 'z') || (chr[len] >= 'A' && chr[len] <= 'Z')
+                  || (chr[len] >= '0' && chr[len] <= '9') || chr[len] == '_'; len++)
+        ;
+
+    return len;
+}
+
+/**
+ * Helper function to skip spaces
+ */
+static char* uf_skip_spaces(char* chr)
+{
+    while (*chr == ' ')
+        chr++;
+
+    return chr;
+}
+
+/**
+ * Finds definition with supplied name, returns its index or -1 if not found
+ */
+static int uf_find(const char* name)
+{
+    int i;
+
+    for (i = 0; i < uf_definition_count; i++)
+    {
+        if (strcmp(uf_definitions[i].name, name) == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+/**
+ * Decides, whether the supplied name may be used as function or parameter name - it must not
+ * hide variable or built-in function
+ */
+static int uf_name_usable(const char* name)
+{
+    const char* builtin;
+    int i;
+
+    if (strcmp(name, "x") == 0)
+        return 0;
+
+    for (i = 0; i < FUNC_COUNT; i++)
+    {
+        builtin = sy_get_function_name(i);
+        if (builtin != NULL && strcmp(name, builtin) == 0)
+            return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * Reads identifier to supplied buffer; returns pointer past the identifier, or NULL if there's no
+ * identifier or it's too long
+ */
+static char* uf_read_name(char* chr, char* name)
+{
+    int len = uf_identifier_length(chr);
+
+    if (len == 0 || len > UF_MAX_NAME_LENGTH)
+        return NULL;
+
+    memcpy(name, chr, len);
+    name[len] = '\0';
+
+    return chr + len;
+}
+
+/**
+ * Verifies, whether RPN form calls function with supplied index, directly or through other
+ * definitions; "visited" marks definitions already searched
+ */
+static int uf_calls(c_stack* body, int index, int* visited)
+{
+    rpn_element* el;
+    int i, callee;
+
+    for (i = 0; i <= body->curr; i++)
+    {
+        el = stck_get(body, i);
+        if (el->type != RPN_TOKEN_FUNCTION || !UF_IS_FUNCTION(el->value.as_function))
+            continue;
+
+        callee = el->value.as_function - UF_FUNCTION_BASE;
+        if (callee == index)
+            return 1;
+
+        if (!visited[callee])
+        {
+            visited[callee] = 1;
+            if (uf_definitions[callee].body != NULL && uf_calls(uf_definitions[callee].body, index, visited))
+                return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Parses function definition in "name(param, ...) = body" format and adds it to registry (or
+ * replaces existing definition with the same name and the same number of parameters)
+ * returns error code (SYNTAX_ERROR_NONE on success) and sets position, where everything failed
+ */
+int uf_define(char* definition, char** error_ptr)
+{
+    char params[UF_MAX_PARAMETERS][UF_MAX_NAME_LENGTH + 1];
+    const char* param_names[UF_MAX_PARAMETERS];
+    char name[UF_MAX_NAME_LENGTH + 1];
+    int visited[UF_MAX_DEFINITIONS];
+    char *chr, *name_ptr;
+    c_stack *body, *expanded;
+    int arity, index, added, error, i;
+
+    /* function name */
+    name_ptr = uf_skip_spaces(definition);
+    *error_ptr = name_ptr;
+    chr = uf_read_name(name_ptr, name);
+    if (chr == NULL || !uf_name_usable(name))
+        return SYNTAX_ERROR_DEFINITION;
+
+    chr = uf_skip_spaces(chr);
+    *error_ptr = chr;
+    if (*chr != '(')
+        return SYNTAX_ERROR_DEFINITION;
+
+    /* parameter list */
+    arity = 0;
+    chr = uf_skip_spaces(chr + 1);
+    while (*chr != ')')
+    {
+        *error_ptr = chr;
+        if (arity == UF_MAX_PARAMETERS)
+            return SYNTAX_ERROR_DEFINITION;
+
+        chr = uf_read_name(chr, params[arity]);
+        if (chr == NULL || !uf_name_usable(params[arity]) || uf_find(params[arity]) != -1 || strcmp(params[arity], name) == 0)
+            return SYNTAX_ERROR_DEFINITION;
+
+        /* parameter names have to be unique */
+        for (i = 0; i < arity; i++)
+        {
+            if (strcmp(params[i], params[arity]) == 0)
+                return SYNTAX_ERROR_DEFINITION;
+        }
+
+        param_names[arity] = params[arity];
+        arity++;
+
+        chr = uf_skip_spaces(chr);
+        *error_ptr = chr;
+        if (*chr == ',')
+            chr = uf_skip_spaces(chr + 1);
+        else if (*chr != ')')
+            return SYNTAX_ERROR_DEFINITION;
+    }
+
+    chr = uf_skip_spaces(chr + 1);
+    *error_ptr = chr;
+    if (*chr != '=')
+        return SYNTAX_ERROR_DEFINITION;
+    chr++;
+
+    /* the function has to be known before its body is parsed, so the recursive call is recognized */
+    index = uf_find(name);
+    added = 0;
+    if (index == -1)
+    {
+        if (uf_definition_count == UF_MAX_DEFINITIONS)
+            return SYNTAX_ERROR_DEFINITION;
+
+        index = uf_definition_count++;
+        strcpy(uf_definitions[index].name, name);
+        uf_definitions[index].arity = arity;
+        uf_definitions[index].body = NULL;
+        added = 1;
+    }
+    else if (uf_definitions[index].arity != arity)
+    {
+        /* other definitions may call it with original number of arguments */
+        *error_ptr = name_ptr;
+        return SYNTAX_ERROR_DEFINITION;
+    }
+
+    body = sy_generate_rpn_stack_vars(chr, (int)strlen(chr), 0, param_names, arity, &error, error_ptr);
+
+    if (body != NULL && error == SYNTAX_ERROR_NONE)
+    {
+        memset(visited, 0, sizeof(visited));
+        if (uf_calls(body, index, visited))
+        {
+            *error_ptr = name_ptr;
+            error = SYNTAX_ERROR_RECURSION;
+        }
+        else
+        {
+            /* verify the body may be expanded, so every error is reported here, not when used */
+            expanded = uf_expand(body, NULL);
+            if (expanded == NULL)
+            {
+                *error_ptr = chr;
+                error = SYNTAX_ERROR_MISSING_OPERAND;
+            }
+            else
+                stck_destroy(expanded);
+        }
+    }
+
+    if (error != SYNTAX_ERROR_NONE)
+    {
+        if (body != NULL)
+            stck_destroy(body);
+        /* the definition was added last, so it may be simply removed */
+        if (added)
+            uf_definition_count--;
+        return error;
+    }
+
+    if (uf_definitions[index].body != NULL)
+        stck_destroy(uf_definitions[index].body);
+    uf_definitions[index].body = body;
+
+    *error_ptr = NULL;
+    return SYNTAX_ERROR_NONE;
+}
+
+/**
+ * Removes all user defined functions
+ */
+void uf_clear(void)
+{
+    int i;
+
+    for (i = 0; i < uf_definition_count; i++)
+    {
+        if (uf_definitions[i].body != NULL)
+            stck_destroy(uf_definitions[i].body);
+    }
+
+    uf_definition_count = 0;
+}
+
+/**
+ * Matches the longest user defined function name on supplied position (input does not need to be
+ * terminated); returns function identifier and sets name length, or FUNC_UNSUPPORTED if not found
+ */
+int uf_match(char* chr, char* end, int* length)
+{
+    int i, len, best;
+
+    best = FUNC_UNSUPPORTED;
+    *length = 0;
+
+    for (i = 0; i < uf_definition_count; i++)
+    {
+        len = (int)strlen(uf_definitions[i].name);
+        if (len > *length && end - chr >= len && strncmp(chr, uf_definitions[i].name, len) == 0)
+        {
+            best = UF_FUNCTION_ID(i);
+            *length = len;
+        }
+    }
+
+    return best;
+}
+
+/**
+ * Retrieves number of parameters of user defined function, -1 if not defined
+ */
+int uf_arity(int func_id)
+{
+    if (!UF_IS_FUNCTION(func_id) || func_id - UF_FUNCTION_BASE >= uf_definition_count)
+        return -1;
+
+    return uf_definitions[func_id - UF_FUNCTION_BASE].arity;
+}
+
+/**
+ * Returns number of values the element pops from evaluation stack
+ */
+static int uf_element_pops(rpn_element* el)
+{
+    switch (el->type)
+    {
+        case RPN_TOKEN_OPERATOR:
+            return 2;
+        case RPN_TOKEN_FUNCTION:
+            return el->arity;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Finds the first element of subexpression, whose last element is on supplied position
+ * returns -1 if there's no complete subexpression
+ */
+static int uf_subexpression_start(c_stack* out, int pos)
+{
+    int needed = 1;
+
+    for (; pos >= 0; pos--)
+    {
+        needed += uf_element_pops(stck_get(out, pos)) - 1;
+        if (needed == 0)
+            return pos;
+    }
+
+    return -1;
+}
+
+/**
+ * Replaces element on top of output by constant, if all of its operands are constants
+ */
+static void uf_fold(c_stack* out)
+{
+    rpn_element *el, *left, *right;
+    double args[RPN_MAX_ARITY];
+    int i, arity;
+
+    el = stck_peek(out);
+
+    /* range of loop is not its value, and loop result depends on index variable */
+    if (el->type == RPN_TOKEN_FUNCTION && (el->value.as_function == FUNC_LOOP
+        || el->value.as_function == FUNC_SUM || el->value.as_function == FUNC_PROD))
+        return;
+
+    if (el->type == RPN_TOKEN_OPERATOR && out->curr >= 2)
+    {
+        left = stck_get(out, out->curr - 2);
+        right = stck_get(out, out->curr - 1);
+        if (left->type != RPN_TOKEN_CONST || right->type != RPN_TOKEN_CONST)
+            return;
+
+        left->value.as_double = rpn_apply_binary(el->value.as_operator, left->value.as_double, right->value.as_double);
+        free(stck_pop(out));
+        free(stck_pop(out));
+    }
+    else if (el->type == RPN_TOKEN_FUNCTION && el->arity >= 1 && out->curr >= el->arity)
+    {
+        arity = el->arity;
+        for (i = 0; i < arity; i++)
+        {
+            right = stck_get(out, out->curr - arity + i);
+            if (right->type != RPN_TOKEN_CONST)
+                return;
+            args[i] = right->value.as_double;
+        }
+
+        /* result replaces the first argument */
+        right = stck_get(out, out->curr - arity);
+        right->value.as_double = rpn_apply_function_args(el->value.as_function, args);
+        for (i = 0; i < arity; i++)
+            free(stck_pop(out));
+    }
+}
+
+/**
+ * Returns number of sums and products, whose body ends after the last element of output
+ */
+static int uf_open_loops(c_stack* out)
+{
+    rpn_element* el;
+    int i, depth = 0;
+
+    for (i = 0; i <= out->curr; i++)
+    {
+        el = stck_get(out, i);
+        if (el->type != RPN_TOKEN_FUNCTION)
+            continue;
+
+        if (el->value.as_function == FUNC_LOOP)
+            depth++;
+        else if (el->value.as_function == FUNC_SUM || el->value.as_function == FUNC_PROD)
+            depth--;
+    }
+
+    return depth;
+}
+
+/**
+ * Appends copy of element to output; calls of user defined functions are replaced by function
+ * body, and constant subexpressions are folded
+ * - index variables of sums and products in function body are moved by number of loops
+ *   around the call, arguments already have the right ones
+ * returns SYNTAX_ERROR_NONE on success, or code of error, if the expression is not valid or too large
+ */
+static int uf_emit(c_stack* out, rpn_element* el)
+{
+    uf_definition* def;
+    rpn_element **args, *copy, index_el;
+    int starts[UF_MAX_PARAMETERS + 1];
+    int i, j, k, count, res, depth;
+
+    if (el->type != RPN_TOKEN_FUNCTION || !UF_IS_FUNCTION(el->value.as_function))
+    {
+        if (out->curr == out->size - 1)
+            return SYNTAX_ERROR_TOO_LONG;
+
+        copy = (rpn_element*)malloc(sizeof(rpn_element));
+        if (copy == NULL)
+            return GENERAL_MEMORY_ERROR;
+        memcpy(copy, el, sizeof(rpn_element));
+        stck_push(out, copy);
+
+        uf_fold(out);
+        return SYNTAX_ERROR_NONE;
+    }
+
+    def = &uf_definitions[el->value.as_function - UF_FUNCTION_BASE];
+    if (def->body == NULL)
+        return SYNTAX_ERROR_DEFINITION;
+    if (def->arity != el->arity)
+        return SYNTAX_ERROR_ARGUMENT_COUNT;
+
+    /* find arguments - they are the last "arity" subexpressions on output */
+    starts[def->arity] = out->curr + 1;
+    for (k = def->arity - 1; k >= 0; k--)
+    {
+        starts[k] = uf_subexpression_start(out, starts[k + 1] - 1);
+        if (starts[k] < 0)
+            return SYNTAX_ERROR_MISSING_OPERAND;
+    }
+
+    /* take arguments away from output, they are copied to places of parameters */
+    count = starts[def->arity] - starts[0];
+    args = (rpn_element**)malloc(sizeof(rpn_element*) * (count + 1));
+    if (args == NULL)
+        return GENERAL_MEMORY_ERROR;
+    for (i = 0; i < count; i++)
+        args[i] = stck_get(out, starts[0] + i);
+    out->curr = starts[0] - 1;
+
+    depth = uf_open_loops(out);
+
+    res = SYNTAX_ERROR_NONE;
+    for (i = 0; i <= def->body->curr && res == SYNTAX_ERROR_NONE; i++)
+    {
+        el = stck_get(def->body, i);
+
+        if (el->type == RPN_TOKEN_VARIABLE && RPN_IS_INDEX_VARIABLE(el->value.as_variable))
+        {
+            k = RPN_INDEX_LEVEL(el->value.as_variable) + depth;
+            if (k >= RPN_MAX_LOOP_DEPTH)
+                res = SYNTAX_ERROR_INDEX_VARIABLE;
+            else
+            {
+                memcpy(&index_el, el, sizeof(rpn_element));
+                index_el.value.as_variable = RPN_INDEX_VARIABLE(k);
+                res = uf_emit(out, &index_el);
+            }
+        }
+        else if (el->type == RPN_TOKEN_VARIABLE && el->value.as_variable < def->arity)
+        {
+            k = el->value.as_variable;
+            for (j = starts[k]; j < starts[k + 1] && res == SYNTAX_ERROR_NONE; j++)
+                res = uf_emit(out, args[j - starts[0]]);
+        }
+        else
+            res = uf_emit(out, el);
+    }
+
+    for (i = 0; i < count; i++)
+        free(args[i]);
+    free(args);
+
+    return res;
+}
+
+/**
+ * Expands calls of user defined functions in RPN form and folds constant subexpressions
+ * returns newly created RPN stack, or NULL if the expression is not valid or too large (the code
+ * of error is stored to supplied location then, which may be NULL)
+ */
+c_stack* uf_expand(c_stack* rpn_stack, int* error)
+{
+    c_stack* out;
+    rpn_element* el;
+    int i, size, res;
+
+    /* without calls, the expression cannot grow */
+    size = rpn_stack->curr + 1;
+    for (i = 0; i <= rpn_stack->curr; i++)
+    {
+        el = stck_get(rpn_stack, i);
+        if (el->type == RPN_TOKEN_FUNCTION && UF_IS_FUNCTION(el->value.as_function))
+        {
+            size = UF_MAX_EXPANSION;
+            break;
+        }
+    }
+
+    out = stck_create(size + 1);
+    if (out == NULL)
+    {
+        if (error != NULL)
+            *error = GENERAL_MEMORY_ERROR;
+        return NULL;
+    }
+
+    for (i = 0; i <= rpn_stack->curr; i++)
+    {
+        res = uf_emit(out, stck_get(rpn_stack, i));
+        if (res != SYNTAX_ERROR_NONE)
+        {
+            if (error != NULL)
+                *error = res;
+            stck_destroy(out);
+            return NULL;
+        }
+    }
+
+    return out;
+}
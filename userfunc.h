@@ -0,0 +1,21 @@
+#ifndef MATHPARSER_USERFUNC_H
+#define MATHPARSER_USERFUNC_H
+
+#define UF_MAX_DEFINITIONS 64           /* maximum number of user defined functions */
+#define UF_MAX_NAME_LENGTH 31           /* maximum length of function or parameter name */
+#define UF_MAX_PARAMETERS 16            /* maximum number of function parameters */
+#define UF_MAX_EXPANSION 65535          /* maximum number of RPN elements after inlining */
+
+#define UF_FUNCTION_BASE 1024                           /* function identifiers of user defined functions start here */
+#define UF_FUNCTION_ID(index) (UF_FUNCTION_BASE + (index))  /* function identifier of definition with supplied index */
+#define UF_IS_FUNCTION(func_id) ((func_id) >= UF_FUNCTION_BASE)
+
+int uf_define(char* definition, char** error_ptr);
+void uf_clear(void);
+
+int uf_match(char* chr, char* end, int* length);
+int uf_arity(int func_id);
+
+c_stack* uf_expand(c_stack* rpn_stack, int* error);
+
+#endif